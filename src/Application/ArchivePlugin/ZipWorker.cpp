@@ -4,6 +4,7 @@
 #include "ZipHelpers.h"
 #include "CoreTypes.h"
 #include "LoggingFunctions.h"
+#include "Profiler.h"
 
 #include "zzip/zzip.h"
 
@@ -53,6 +54,8 @@ void ZipWorker::run()
     {
         if (!file.doExtract)
             continue;
+
+        PROFILE(ZipWorker_ExtractFile);
         
         // Open file from zip
         ZZIP_FILE *zzipFile = zzip_file_open(archive_, file.relativePath.toStdString().c_str(), ZZIP_ONLYZIP | ZZIP_CASELESS);
@@ -72,6 +72,7 @@ namespace
     const QString cOgreDumpFilename("profiler-ogre-stats.txt");
     const QString cSceneComplexityDumpFilename("profiler-scene-stats.txt");
     const QString cPerfLoggerDumpFilename("profiler-performance-logger.txt");
+    const QString cTraceDumpFilename("profiler-trace.json");
 
     void CopySelectedItemName(QTreeWidget *treeWidget)
     {
@@ -193,6 +194,7 @@ TimeProfilerWindow::TimeProfilerWindow(Framework *fw, QWidget *parent) :
     connect(&updateTimer_, SIGNAL(timeout()), this, SLOT(Refresh()));
 
     connect(ui_.buttonRefresh, SIGNAL(pressed()), this, SLOT(RefreshTimingPage()));
+    connect(ui_.buttonTrace, SIGNAL(toggled(bool)), this, SLOT(OnTraceToggled(bool)));
     connect(ui_.comboTimingRefreshInterval, SIGNAL(currentIndexChanged(int)), this, SLOT(OnTimingIntervalChanged()));
     
     OnTimingIntervalChanged();
@@ -1346,6 +1348,29 @@ static void DumpOgreResManagerStatsToFile(Ogre::ResourceManager *manager, std::o
     }
 }
 
+void TimeProfilerWindow::OnTraceToggled(bool record)
+{
+#ifdef PROFILING
+    Profiler &profiler = *framework_->GetProfiler();
+    if (record)
+    {
+        profiler.StartTrace();
+        ui_.buttonTrace->setText("Stop trace");
+        return;
+    }
+
+    profiler.StopTrace();
+    ui_.buttonTrace->setText("Record trace");
+    QString path = QDir::toNativeSeparators(logDirectory_.absoluteFilePath(cTraceDumpFilename));
+    if (profiler.ExportTrace(path))
+        LogInfo("Profiler trace written to " + path);
+    else
+        LogError("Failed to write profiler trace to " + path);
+#else
+    UNREFERENCED_PARAM(record)
+#endif
+}
+
 void TimeProfilerWindow::DumpOgreResourceStatsToFile()
 {
     QString path = QDir::toNativeSeparators(logDirectory_.absoluteFilePath(cOgreDumpFilename));
@@ -63,6 +63,7 @@ private slots:
     // Log file dumping.
     void DumpOgreResourceStatsToFile();
     void DumpSceneComplexityToFile();   
+    void OnTraceToggled(bool record);
     
     // UI action handlers.
     void ChangeLoggerThreshold();
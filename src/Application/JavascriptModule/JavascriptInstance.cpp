@@ -35,6 +35,7 @@ Q_DECLARE_METATYPE(QScriptClass*)
 
 JavascriptInstance::JavascriptInstance(const QString &fileName, JavascriptModule *module) :
     engine_(0),
+    sharedEngine_(0),
     sourceFile(fileName),
     module_(module),
     evaluated(false)
@@ -45,6 +46,7 @@ JavascriptInstance::JavascriptInstance(const QString &fileName, JavascriptModule
 
 JavascriptInstance::JavascriptInstance(ScriptAssetPtr scriptRef, JavascriptModule *module) :
     engine_(0),
+    sharedEngine_(0),
     module_(module),
     evaluated(false)
 {
@@ -58,6 +60,7 @@ JavascriptInstance::JavascriptInstance(ScriptAssetPtr scriptRef, JavascriptModul
 
 JavascriptInstance::JavascriptInstance(const std::vector<ScriptAssetPtr>& scriptRefs, JavascriptModule *module) :
     engine_(0),
+    sharedEngine_(0),
     module_(module),
     evaluated(false)
 {
@@ -69,10 +72,50 @@ JavascriptInstance::JavascriptInstance(const std::vector<ScriptAssetPtr>& script
     Load();
 }
 
+JavascriptInstance::JavascriptInstance(const std::vector<ScriptAssetPtr>& scriptRefs, JavascriptModule *module, Scene *scene, bool trusted) :
+    engine_(0),
+    sharedEngine_(0),
+    module_(module),
+    evaluated(false)
+{
+    // Make sure we do not push null or empty script assets as sources
+    for (unsigned i = 0; i < scriptRefs.size(); ++i)
+        if (scriptRefs[i] && !scriptRefs[i]->scriptContent.isEmpty()) scriptRefs_.push_back(scriptRefs[i]);
+    
+    sharedEngine_ = module_->AcquireSharedEngine(this, scene, trusted);
+    CreateEngine();
+    Load();
+}
 
 JavascriptInstance::~JavascriptInstance()
 {
     DeleteEngine();
+    if (sharedEngine_)
+        module_->ReleaseSharedEngine(this);
+}
+
+void JavascriptInstance::DetachSharedEngine()
+{
+    if (!sharedEngine_)
+        return;
+    DeleteEngine();
+    module_->ReleaseSharedEngine(this);
+    sharedEngine_ = 0;
+}
+
+void JavascriptInstance::AddSignalConnection(const QScriptValue &signal, const QScriptValueList &arguments)
+{
+    SignalConnection connection;
+    connection.signal = signal;
+    connection.arguments = arguments;
+    signalConnections_.push_back(connection);
+}
+
+QScriptValue JavascriptInstance::GlobalObject() const
+{
+    if (!engine_)
+        return QScriptValue();
+    return sharedEngine_ ? scope_ : engine_->globalObject();
 }
 
 QMap<QString, uint> JavascriptInstance::DumpEngineInformation()
@@ -92,7 +135,7 @@ QMap<QString, uint> JavascriptInstance::DumpEngineInformation()
     uint qobjCount = 0;
     uint qobjMethodCount = 0;   
 
-    GetObjectInformation(engine_->globalObject(), ids, valueCount, objectCount, nullCount, numberCount, boolCount, stringCount, arrayCount, funcCount, qobjCount, qobjMethodCount);
+    GetObjectInformation(GlobalObject(), ids, valueCount, objectCount, nullCount, numberCount, boolCount, stringCount, arrayCount, funcCount, qobjCount, qobjMethodCount);
 
     QMap<QString, uint> dump;
     dump["QScriptValues"] = valueCount;
@@ -304,7 +347,19 @@ void JavascriptInstance::Run()
         QString scriptSourceFilename = (useAssets ? scriptRefs_[i]->Name() : sourceFile);
         QString &scriptContent = (useAssets ? scriptRefs_[i]->scriptContent : program_);
 
-        QScriptValue result = engine_->evaluate(scriptContent, scriptSourceFilename);
+        QScriptValue result;
+        if (sharedEngine_)
+        {
+            // Evaluate in a context whose activation object is the scope, so that the global variables and functions
+            // declared by the script go to the scope, and the functions keep seeing them when called later.
+            QScriptContext *context = engine_->pushContext();
+            context->setActivationObject(scope_);
+            context->setThisObject(scope_);
+            result = engine_->evaluate(scriptContent, scriptSourceFilename);
+            engine_->popContext();
+        }
+        else
+            result = engine_->evaluate(scriptContent, scriptSourceFilename);
         CheckAndPrintException("In run/evaluate: ", result);
     }
     
@@ -326,7 +381,7 @@ bool JavascriptInstance::RegisterService(QObject *serviceObject, const QString &
     }
 
     QScriptValue scriptValue = engine_->newQObject(serviceObject);
-    engine_->globalObject().setProperty(name, scriptValue);
+    GlobalObject().setProperty(name, scriptValue);
     return true;
 }
 
@@ -459,6 +514,19 @@ void JavascriptInstance::CreateEngine()
 {
     if (engine_)
         DeleteEngine();
+
+    if (sharedEngine_)
+    {
+        // The bindings have been exposed to the shared engine already.
+        engine_ = sharedEngine_;
+        scope_ = engine_->newObject();
+        scope_.setData(engine_->newQObject(this)); // Identifies the script of the calling code for JavascriptModule's connect().
+        EC_Script *ec = dynamic_cast<EC_Script *>(owner_.lock().get());
+        module_->PrepareScriptInstance(this, ec);
+        evaluated = false;
+        return;
+    }
+
     engine_ = new QScriptEngine;
     connect(engine_, SIGNAL(signalHandlerException(const QScriptValue &)), SLOT(OnSignalHandlerException(const QScriptValue &)));
 //#ifndef QT_NO_SCRIPTTOOLS
@@ -482,7 +550,9 @@ void JavascriptInstance::DeleteEngine()
         return;
 
     program_ = "";
-    engine_->abortEvaluation();
+    // A shared engine may be evaluating another script.
+    if (!sharedEngine_)
+        engine_->abortEvaluation();
 
     // As a convention, we call a function 'OnScriptDestroyed' for each JS script
     // so that they can clean up their data before the script is removed from the object,
@@ -490,14 +560,30 @@ void JavascriptInstance::DeleteEngine()
     
     emit ScriptUnloading();
     
-    QScriptValue destructor = engine_->globalObject().property("OnScriptDestroyed");
+    QScriptValue destructor = GlobalObject().property("OnScriptDestroyed");
     if (!destructor.isUndefined())
     {
-        QScriptValue result = destructor.call();
+        QScriptValue result = destructor.call(sharedEngine_ ? scope_ : QScriptValue());
         CheckAndPrintException("In script destructor: ", result);
     }
     
-    SAFE_DELETE(engine_);
+    if (sharedEngine_)
+    {
+        // The engine lives on, so remove the handlers the script has connected to signals.
+        // Disconnecting a connection that the script has removed itself only fails.
+        for(size_t i = 0; i < signalConnections_.size(); ++i)
+        {
+            const SignalConnection &connection = signalConnections_[i];
+            connection.signal.property("disconnect").call(connection.signal, connection.arguments);
+        }
+        if (!signalConnections_.empty())
+            engine_->clearExceptions();
+        signalConnections_.clear();
+        scope_ = QScriptValue();
+        engine_ = 0;
+    }
+    else
+        SAFE_DELETE(engine_);
     //SAFE_DELETE(debugger_);
 }
 
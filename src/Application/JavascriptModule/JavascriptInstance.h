@@ -12,6 +12,8 @@
 #include "AssetFwd.h"
 #include "JavascriptFwd.h"
 
+#include <QScriptValue>
+
 //#include <QtScript>
 //#ifndef QT_NO_SCRIPTTOOLS
 //#include <QScriptEngineDebugger>
@@ -40,6 +42,15 @@ public:
         @param module Javascript module. */
     JavascriptInstance(const std::vector<ScriptAssetPtr>& scriptRefs, JavascriptModule *module);
 
+    /// Creates a scope for this script instance in a shared script engine and loads the script but doesn't run it yet.
+    /** The global variables and functions of the script are kept in its own scope object, while the engine's global object,
+        holding the bindings and the framework services, is shared by all the scripts of the engine.
+        @param scriptRefs Script asset references.
+        @param module Javascript module.
+        @param scene Scene whose shared engine is used, see JavascriptModule::AcquireSharedEngine. Released when this instance is destroyed.
+        @param trusted Whether all the scripts are trusted. */
+    JavascriptInstance(const std::vector<ScriptAssetPtr>& scriptRefs, JavascriptModule *module, Scene *scene, bool trusted);
+
     /// Destroys script engine created for this script instance.
     virtual ~JavascriptInstance();
 
@@ -59,6 +70,21 @@ public:
     //void SetPrototype(QScriptable *prototype, );
     QScriptEngine* Engine() const { return engine_; }
 
+    /// Returns whether the script runs in an engine shared with other script instances.
+    bool UsesSharedEngine() const { return sharedEngine_ != 0; }
+
+    /// Returns the object holding the global variables of the script.
+    /** This is the global object of the engine, or the scope of the script if it runs in a shared engine. */
+    QScriptValue GlobalObject() const;
+
+    /// Unloads the script from its shared engine and releases the engine. The script can not be run in the shared engine again.
+    void DetachSharedEngine();
+
+    /// Records a signal connection made by the script in a shared engine, so that it can be removed when the script is unloaded.
+    /** @param signal The signal function connected.
+        @param arguments Arguments given to connect(), given to disconnect() on unload. */
+    void AddSignalConnection(const QScriptValue &signal, const QScriptValueList &arguments);
+
     /// Sets owner (EC_Script) component.
     /** @param owner Owner component. */
     void SetOwner(const ComponentPtr &owner) { owner_ = owner; }
@@ -104,6 +130,16 @@ private:
         uint &boolCount, uint &stringCount, uint &arrayCount, uint &funcCount, uint &qobjCount, uint &qobjMethodCount);
         
     QScriptEngine *engine_; ///< Qt script engine.
+    QScriptEngine *sharedEngine_; ///< Shared engine used by this instance, or null if the instance has an engine of its own.
+    QScriptValue scope_; ///< Scope of the script in the shared engine.
+
+    /// Signal connection made by the script in the shared engine.
+    struct SignalConnection
+    {
+        QScriptValue signal;
+        QScriptValueList arguments;
+    };
+    std::vector<SignalConnection> signalConnections_; ///< Signal connections to remove when the script is unloaded from the shared engine.
 
     // The script content for a JavascriptInstance is loaded either using the Asset API or 
     // using an absolute path name from the local file system.
@@ -35,19 +35,25 @@
 #include <QtScript>
 #include <QDomElement>
 
+#include <algorithm>
+
 #include "StaticPluginRegistry.h"
 
 #include "MemoryLeakCheck.h"
 
 JavascriptModule::JavascriptModule() :
     IModule("Javascript"),
-    engine(new QScriptEngine(this))
+    engine(new QScriptEngine(this)),
+    useSharedEngines_(false)
 {
 }
 
 JavascriptModule::~JavascriptModule()
 {
     SAFE_DELETE(engine);
+    // Unload the scripts still using the shared engines. Releasing the last user of an engine deletes it.
+    while(!sharedEngines_.empty())
+        sharedEngines_.begin()->second.instances.back()->DetachSharedEngine();
 }
 
 void JavascriptModule::Load()
@@ -72,6 +78,8 @@ void JavascriptModule::Initialize()
 
     RegisterCoreMetaTypes();
 
+    useSharedEngines_ = framework_->HasCommandLineParameter("--jsSharedEngine");
+
     framework_->Console()->RegisterCommand(
         "jsExec", "Execute given code in the embedded Javascript interpreter. Usage: jsExec(mycodestring)",
         this, SLOT(RunString(const QString &)));
@@ -194,7 +202,16 @@ void JavascriptModule::ScriptAssetsChanged(const std::vector<ScriptAssetPtr>& ne
 
     if (newScripts[0]->Name().endsWith(".js")) // We're positively using QtScript.
     {
-        JavascriptInstance *jsInstance = new JavascriptInstance(newScripts, this);
+        JavascriptInstance *jsInstance = 0;
+        if (useSharedEngines_ && sender->ParentScene())
+        {
+            bool trusted = true;
+            for(size_t i = 0; i < newScripts.size(); ++i)
+                trusted = trusted && newScripts[i]->IsTrusted();
+            jsInstance = new JavascriptInstance(newScripts, this, sender->ParentScene(), trusted);
+        }
+        else
+            jsInstance = new JavascriptInstance(newScripts, this);
         ComponentPtr comp;
         try
         {
@@ -370,7 +387,7 @@ void JavascriptModule::CreateScriptObject(EC_Script* app, EC_Script* instance, c
         return;
     
     QScriptEngine* appEngine = jsInstance->Engine();
-    QScriptValue globalObject = appEngine->globalObject();
+    QScriptValue globalObject = jsInstance->GlobalObject();
    
     // Get the object container that holds the created script class instances from this application
     QScriptValue objectContainer = globalObject.property("scriptObjects");
@@ -384,7 +401,7 @@ void JavascriptModule::CreateScriptObject(EC_Script* app, EC_Script* instance, c
         return;
     
     const QString& appAndClassName = instance->className.Get();
-    QScriptValue constructor = appEngine->globalObject().property(className);
+    QScriptValue constructor = globalObject.property(className);
     QScriptValue object;
     if (constructor.isFunction())
     {
@@ -424,8 +441,7 @@ void JavascriptModule::RemoveScriptObject(EC_Script* instance)
     if (!jsInstance || !jsInstance->IsEvaluated())
         return;
     
-    QScriptEngine* appEngine = jsInstance->Engine();
-    QScriptValue globalObject = appEngine->globalObject();
+    QScriptValue globalObject = jsInstance->GlobalObject();
    
     // Get the object container that holds the created script class instances from this application
     QScriptValue objectContainer = globalObject.property("scriptObjects");
@@ -489,11 +505,10 @@ void JavascriptModule::CreateScriptObjects(EC_Script* app)
 
 void JavascriptModule::RemoveScriptObjects(JavascriptInstance* jsInstance)
 {
-    QScriptEngine* appEngine = jsInstance->Engine();
-    if (!appEngine)
+    if (!jsInstance->Engine())
         return;
     
-    QScriptValue globalObject = appEngine->globalObject();
+    QScriptValue globalObject = jsInstance->GlobalObject();
     
     // Get the object container that holds the created script class instances from this application
     QScriptValue objectContainer = globalObject.property("scriptObjects");
@@ -683,7 +698,19 @@ void JavascriptModule::UnloadStartupScripts()
 void JavascriptModule::PrepareScriptInstance(JavascriptInstance* instance, EC_Script *comp)
 {
     PROFILE(JSModule_PrepareScriptInstance);
-    static std::set<QObject*> checked;
+
+    // A shared engine has the framework services registered already by AcquireSharedEngine,
+    // so only the services specific to the instance are registered to its scope.
+    if (instance->UsesSharedEngine())
+    {
+        instance->RegisterService(instance, "engine");
+        if (comp)
+        {
+            instance->RegisterService(comp->ParentEntity(), "me");
+            instance->RegisterService(comp->ParentScene(), "scene");
+        }
+        return;
+    }
     
     // Register framework's dynamic properties (service objects) and the framework itself to the script engine
     QList<QByteArray> properties = framework_->dynamicPropertyNames();
@@ -692,17 +719,7 @@ void JavascriptModule::PrepareScriptInstance(JavascriptInstance* instance, EC_Sc
         QString name = properties[i];
         QObject* serviceobject = framework_->property(name.toStdString().c_str()).value<QObject*>();
         if (instance->RegisterService(serviceobject, name))
-        {
-            if (checked.find(serviceobject) == checked.end())
-            {
-                // Check if the service object has an OnScriptEngineCreated() slot, and give it a chance to perform further actions
-                const QMetaObject* meta = serviceobject->metaObject();
-                if (meta->indexOfSlot("OnScriptEngineCreated(QScriptEngine*)") != -1)
-                    QObject::connect(this, SIGNAL(ScriptEngineCreated(QScriptEngine*)), serviceobject, SLOT(OnScriptEngineCreated(QScriptEngine*)));
-                
-                checked.insert(serviceobject);
-            }
-        }
+            ConnectScriptEngineCreated(serviceobject);
     }
 
     instance->RegisterService(framework_, "framework");
@@ -721,6 +738,111 @@ void JavascriptModule::PrepareScriptInstance(JavascriptInstance* instance, EC_Sc
     emit ScriptEngineCreated(instance->Engine());
 }
 
+void JavascriptModule::ConnectScriptEngineCreated(QObject *serviceObject)
+{
+    static std::set<QObject*> checked;
+    if (checked.find(serviceObject) != checked.end())
+        return;
+
+    // Check if the service object has an OnScriptEngineCreated() slot, and give it a chance to perform further actions
+    const QMetaObject* meta = serviceObject->metaObject();
+    if (meta->indexOfSlot("OnScriptEngineCreated(QScriptEngine*)") != -1)
+        QObject::connect(this, SIGNAL(ScriptEngineCreated(QScriptEngine*)), serviceObject, SLOT(OnScriptEngineCreated(QScriptEngine*)));
+    
+    checked.insert(serviceObject);
+}
+
+/// Replaces Function.prototype.connect in the shared engines. Connects the signal with the original connect(), and records
+/// the connection to the script whose scope the calling code runs in, so that it can be removed when the script is unloaded.
+static QScriptValue SharedEngineConnect(QScriptContext *context, QScriptEngine *engine)
+{
+    QScriptValueList arguments;
+    for(int i = 0; i < context->argumentCount(); ++i)
+        arguments << context->argument(i);
+    QScriptValue result = context->callee().data().call(context->thisObject(), arguments);
+    if (engine->hasUncaughtException())
+        return result;
+
+    QScriptContext *caller = context->parentContext();
+    QScriptValueList scopeChain = caller ? caller->scopeChain() : QScriptValueList();
+    for(int i = 0; i < scopeChain.size(); ++i)
+    {
+        JavascriptInstance *instance = qobject_cast<JavascriptInstance *>(scopeChain[i].data().toQObject());
+        if (instance)
+        {
+            instance->AddSignalConnection(context->thisObject(), arguments);
+            break;
+        }
+    }
+    return result;
+}
+
+QScriptEngine *JavascriptModule::AcquireSharedEngine(JavascriptInstance *instance, Scene *scene, bool trusted)
+{
+    SharedEngine &shared = sharedEngines_[std::make_pair(scene, trusted)];
+    if (!shared.engine)
+    {
+        PROFILE(JSModule_CreateSharedEngine);
+        shared.engine = new QScriptEngine;
+        connect(shared.engine, SIGNAL(signalHandlerException(const QScriptValue &)), SLOT(OnSharedEngineException(const QScriptValue &)));
+
+        ExposeQtMetaTypes(shared.engine);
+        ExposeCoreTypes(shared.engine);
+        ExposeCoreApiMetaTypes(shared.engine);
+
+        QScriptValue globalObject = shared.engine->globalObject();
+        QList<QByteArray> properties = framework_->dynamicPropertyNames();
+        for(QList<QByteArray>::size_type i = 0; i < properties.size(); ++i)
+        {
+            QObject* serviceObject = framework_->property(properties[i]).value<QObject*>();
+            if (!serviceObject)
+                continue;
+            globalObject.setProperty(properties[i], shared.engine->newQObject(serviceObject));
+            ConnectScriptEngineCreated(serviceObject);
+        }
+        globalObject.setProperty("framework", shared.engine->newQObject(framework_));
+
+        // The engine outlives the scripts, so their signal connections are recorded to be removed when they are unloaded.
+        QScriptValue functionPrototype = globalObject.property("Function").property("prototype");
+        QScriptValue connectFunction = shared.engine->newFunction(SharedEngineConnect);
+        connectFunction.setData(functionPrototype.property("connect"));
+        functionPrototype.setProperty("connect", connectFunction, QScriptValue::SkipInEnumeration);
+
+        emit ScriptEngineCreated(shared.engine);
+    }
+    shared.instances.push_back(instance);
+    return shared.engine;
+}
+
+void JavascriptModule::ReleaseSharedEngine(JavascriptInstance *instance)
+{
+    for(SharedEngineMap::iterator iter = sharedEngines_.begin(); iter != sharedEngines_.end(); ++iter)
+    {
+        std::vector<JavascriptInstance *> &instances = iter->second.instances;
+        std::vector<JavascriptInstance *>::iterator found = std::find(instances.begin(), instances.end(), instance);
+        if (found == instances.end())
+            continue;
+        instances.erase(found);
+        if (instances.empty())
+        {
+            delete iter->second.engine;
+            sharedEngines_.erase(iter);
+        }
+        return;
+    }
+}
+
+void JavascriptModule::OnSharedEngineException(const QScriptValue& exception)
+{
+    QScriptEngine *sharedEngine = exception.engine();
+    LogError(exception.toString());
+    if (!sharedEngine)
+        return;
+    foreach(const QString &error, sharedEngine->uncaughtExceptionBacktrace())
+        LogError(error);
+    LogError("Line " + QString::number(sharedEngine->uncaughtExceptionLineNumber()) + ".");
+}
+
 extern "C"
 {
 #ifndef ANDROID
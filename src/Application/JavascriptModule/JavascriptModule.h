@@ -15,6 +15,8 @@
 
 #include <QVariant>
 
+#include <map>
+
 class JavascriptInstance;
 
 /// Enables Javascript execution and scripting by using QtScript.
@@ -36,6 +38,14 @@ public:
         @param comp Script component, null by default. */
     void PrepareScriptInstance(JavascriptInstance* instance, EC_Script *comp = 0);
 
+    /// Returns the shared script engine for the scripts of @c scene with the given trust level, and adds @c instance to its users.
+    /** The engine is created when first needed, with the bindings and the framework services exposed to it once.
+        Trusted and untrusted scripts never share an engine. Used when --jsSharedEngine is specified. */
+    QScriptEngine *AcquireSharedEngine(JavascriptInstance *instance, Scene *scene, bool trusted);
+
+    /// Removes @c instance from the users of its shared script engine, and deletes the engine when it has no users left.
+    void ReleaseSharedEngine(JavascriptInstance *instance);
+
 public slots:
     void DumpScriptInfo();
     
@@ -88,6 +98,22 @@ private:
     /// Engines for executing startup (possibly persistent) scripts
     std::vector<JavascriptInstance *> startupScripts_;
 
+    /// Checks once whether a service object has an OnScriptEngineCreated() slot, and connects ScriptEngineCreated to it.
+    void ConnectScriptEngineCreated(QObject *serviceObject);
+
+    /// Engine shared by the scripts of a scene.
+    struct SharedEngine
+    {
+        QScriptEngine *engine;
+        std::vector<JavascriptInstance *> instances; ///< Script instances using the engine.
+    };
+    typedef std::map<std::pair<Scene*, bool>, SharedEngine> SharedEngineMap;
+    /// Shared script engines by scene and trust level
+    SharedEngineMap sharedEngines_;
+
+    /// Whether the EC_Script instances use shared engines (--jsSharedEngine)
+    bool useSharedEngines_;
+
 private slots:
     /// (Re)loads and executes startup scripts.
     void LoadStartupScripts();
@@ -100,4 +126,5 @@ private slots:
     void ScriptAssetsChanged(const std::vector<ScriptAssetPtr>& newScripts);
     void ScriptAppNameChanged(const QString& newAppName);
     void ScriptClassNameChanged(const QString& newClassName);
+    void OnSharedEngineException(const QScriptValue& exception);
 };
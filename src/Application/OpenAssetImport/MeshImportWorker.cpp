@@ -0,0 +1,619 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "MeshImportWorker.h"
+
+#include "Math/MathFunc.h"
+
+#include <assimp/DefaultLogger.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <QThread>
+#include <QFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+#include <cfloat>
+#include <algorithm>
+
+/// Identifies a converted mesh in the asset cache.
+static const quint32 cCacheMagic = 0x4D494154; // "TAIM"
+/// Version of the cached format. Increase when the format or the conversion changes, to ignore the old conversions in the cache.
+static const quint32 cCacheVersion = 1;
+
+ImportedMaterial::ImportedMaterial() :
+    shininess(0.f),
+    hasDiffuse(false),
+    hasSpecular(false),
+    hasEmissive(false),
+    hasShininess(false),
+    twoSided(false)
+{
+    for(int i = 0; i < 4; ++i)
+        ambient[i] = diffuse[i] = specular[i] = emissive[i] = 1.f;
+}
+
+ImportedMesh::ImportedMesh()
+{
+    for(int i = 0; i < 3; ++i)
+    {
+        boundsMin[i] = FLT_MAX;
+        boundsMax[i] = -FLT_MAX;
+    }
+}
+
+template<typename T>
+static void WriteArray(QDataStream &s, const T *data, size_t count)
+{
+    if (count > 0)
+        s.writeRawData(reinterpret_cast<const char*>(data), (int)(count * sizeof(T)));
+}
+
+template<typename T>
+static void WriteVector(QDataStream &s, const std::vector<T> &v)
+{
+    s << (quint32)v.size();
+    WriteArray(s, v.empty() ? (const T*)0 : &v[0], v.size());
+}
+
+template<typename T>
+static bool ReadArray(QDataStream &s, T *data, size_t count)
+{
+    if (count == 0)
+        return true;
+    int numBytes = (int)(count * sizeof(T));
+    return s.readRawData(reinterpret_cast<char*>(data), numBytes) == numBytes;
+}
+
+template<typename T>
+static bool ReadVector(QDataStream &s, std::vector<T> &v)
+{
+    quint32 size = 0;
+    s >> size;
+    if (s.status() != QDataStream::Ok || (qint64)size > s.device()->bytesAvailable() / (qint64)sizeof(T))
+        return false;
+    v.resize(size);
+    return ReadArray(s, v.empty() ? (T*)0 : &v[0], v.size());
+}
+
+void ImportedMesh::Serialize(QByteArray &dest) const
+{
+    dest.clear();
+    QDataStream s(&dest, QIODevice::WriteOnly);
+    s << cCacheMagic << cCacheVersion;
+
+    s << (quint32)materials.size();
+    for(size_t i = 0; i < materials.size(); ++i)
+    {
+        const ImportedMaterial &mat = materials[i];
+        WriteArray(s, mat.ambient, 4);
+        WriteArray(s, mat.diffuse, 4);
+        WriteArray(s, mat.specular, 4);
+        WriteArray(s, mat.emissive, 4);
+        WriteArray(s, &mat.shininess, 1);
+        s << (quint8)mat.hasDiffuse << (quint8)mat.hasSpecular << (quint8)mat.hasEmissive << (quint8)mat.hasShininess << (quint8)mat.twoSided;
+        s << mat.texture;
+    }
+
+    WriteArray(s, boundsMin, 3);
+    WriteArray(s, boundsMax, 3);
+
+    s << (quint32)subMeshes.size();
+    for(size_t i = 0; i < subMeshes.size(); ++i)
+    {
+        const ImportedSubMesh &subMesh = subMeshes[i];
+        s << subMesh.name << (quint32)subMesh.materialIndex << (quint32)subMesh.numVertices;
+        WriteVector(s, subMesh.positionsNormals);
+        WriteVector(s, subMesh.uvComponents);
+        s << (quint8)subMesh.hasTangents;
+        WriteVector(s, subMesh.uvsTangents);
+        WriteVector(s, subMesh.colours);
+        WriteVector(s, subMesh.indices);
+    }
+}
+
+bool ImportedMesh::Deserialize(const QByteArray &data)
+{
+    QDataStream s(data);
+    quint32 magic = 0, version = 0;
+    s >> magic >> version;
+    if (magic != cCacheMagic || version != cCacheVersion)
+        return false;
+
+    quint32 numMaterials = 0;
+    s >> numMaterials;
+    if (s.status() != QDataStream::Ok || numMaterials > (quint32)data.size())
+        return false;
+    materials.resize(numMaterials);
+    for(size_t i = 0; i < materials.size(); ++i)
+    {
+        ImportedMaterial &mat = materials[i];
+        if (!ReadArray(s, mat.ambient, 4) || !ReadArray(s, mat.diffuse, 4) || !ReadArray(s, mat.specular, 4) ||
+            !ReadArray(s, mat.emissive, 4) || !ReadArray(s, &mat.shininess, 1))
+            return false;
+        quint8 hasDiffuse = 0, hasSpecular = 0, hasEmissive = 0, hasShininess = 0, twoSided = 0;
+        s >> hasDiffuse >> hasSpecular >> hasEmissive >> hasShininess >> twoSided;
+        s >> mat.texture;
+        mat.hasDiffuse = hasDiffuse != 0;
+        mat.hasSpecular = hasSpecular != 0;
+        mat.hasEmissive = hasEmissive != 0;
+        mat.hasShininess = hasShininess != 0;
+        mat.twoSided = twoSided != 0;
+    }
+
+    if (!ReadArray(s, boundsMin, 3) || !ReadArray(s, boundsMax, 3))
+        return false;
+
+    quint32 numSubMeshes = 0;
+    s >> numSubMeshes;
+    if (s.status() != QDataStream::Ok || numSubMeshes > (quint32)data.size())
+        return false;
+    subMeshes.resize(numSubMeshes);
+    for(size_t i = 0; i < subMeshes.size(); ++i)
+    {
+        ImportedSubMesh &subMesh = subMeshes[i];
+        quint32 materialIndex = 0, numVertices = 0;
+        quint8 hasTangents = 0;
+        s >> subMesh.name >> materialIndex >> numVertices;
+        if (!ReadVector(s, subMesh.positionsNormals) || !ReadVector(s, subMesh.uvComponents))
+            return false;
+        s >> hasTangents;
+        if (!ReadVector(s, subMesh.uvsTangents) || !ReadVector(s, subMesh.colours) || !ReadVector(s, subMesh.indices))
+            return false;
+        subMesh.materialIndex = materialIndex;
+        subMesh.numVertices = numVertices;
+        subMesh.hasTangents = hasTangents != 0;
+
+        // Check the sizes so that a corrupt file cannot make the vertex buffers read out of bounds.
+        size_t uvFloats = subMesh.hasTangents ? 6 : 0;
+        for(size_t j = 0; j < subMesh.uvComponents.size(); ++j)
+        {
+            if (subMesh.uvComponents[j] == 1 || subMesh.uvComponents[j] > 3)
+                return false;
+            uvFloats += subMesh.uvComponents[j];
+        }
+        if (numVertices == 0 || materialIndex >= materials.size() || subMesh.positionsNormals.size() != numVertices * 6 ||
+            (!subMesh.uvsTangents.empty() && subMesh.uvsTangents.size() != numVertices * uvFloats) ||
+            (!subMesh.colours.empty() && subMesh.colours.size() != numVertices * 4) ||
+            subMesh.indices.empty() || subMesh.indices.size() % 3 != 0)
+            return false;
+        for(size_t j = 0; j < subMesh.indices.size(); ++j)
+            if (subMesh.indices[j] >= numVertices)
+                return false;
+    }
+
+    return s.status() == QDataStream::Ok;
+}
+
+/// Replaces the vertex positions and normals of the skinned meshes with the ones of the bind pose.
+static void GetBasePose(const aiScene * sc, const aiNode * nd)
+{
+    unsigned int i;
+    unsigned int n=0, /*k = 0,*/ t;
+
+    //insert current mesh's bones into boneMatrices
+    for(n=0; n < nd->mNumMeshes; ++n)
+    {
+        const struct aiMesh* mesh = sc->mMeshes[nd->mMeshes[n]];
+
+        std::vector<aiMatrix4x4> boneMatrices(mesh->mNumBones);
+
+        // fill boneMatrices with current bone locations
+        for( size_t a = 0; a < mesh->mNumBones; ++a)
+        {
+            aiBone* bone = mesh->mBones[a];
+
+            // find the corresponding node by again looking recursively through the node hierarchy for the same name
+            aiNode* node = sc->mRootNode->FindNode(bone->mName);
+
+            // start with the mesh-to-bone matrix
+            boneMatrices[a] = bone->mOffsetMatrix;
+
+            // and now append all node transformations down the parent chain until we're back at mesh coordinates again
+            const aiNode* tempNode = node;
+
+            while(tempNode)
+            {
+                // check your matrix multiplication order here!!!
+                boneMatrices[a] = tempNode->mTransformation * boneMatrices[a];
+
+                tempNode = tempNode->mParent;
+            }
+        }
+
+        // all using the results from the previous code snippet
+        std::vector<aiVector3D> resultPos( mesh->mNumVertices);
+        std::vector<aiVector3D> resultNorm( mesh->mNumVertices);
+
+        // loop through all vertex weights of all bones
+        for(size_t a = 0; a < mesh->mNumBones; ++a)
+        {
+            const aiBone* bone = mesh->mBones[a];
+            const aiMatrix4x4& posTrafo = boneMatrices[a];
+
+            // 3x3 matrix, contains the bone matrix without the translation, only with rotation and possibly scaling
+            aiMatrix3x3 normTrafo = aiMatrix3x3( posTrafo);
+            for(size_t b = 0; b < bone->mNumWeights; ++b)
+            {
+                const aiVertexWeight& weight = bone->mWeights[b];
+
+                size_t vertexId = weight.mVertexId;
+                const aiVector3D& srcPos = mesh->mVertices[vertexId];
+                const aiVector3D& srcNorm = mesh->mNormals[vertexId];
+
+                resultPos[vertexId] += (posTrafo * srcPos) * weight.mWeight;
+                resultNorm[vertexId] += (normTrafo * srcNorm)* weight.mWeight;
+            }
+        }
+
+        for (t = 0; t < mesh->mNumFaces; ++t)
+        {
+            const struct aiFace* face = &mesh->mFaces[t];
+
+            for(i = 0; i < face->mNumIndices; i++)		// go through all vertices in face
+            {
+                int vertexIndex = face->mIndices[i];	// get group index for current index
+
+
+                mesh->mNormals[vertexIndex] = resultNorm[vertexIndex];
+                mesh->mVertices[vertexIndex] = resultPos[vertexIndex];
+            }
+
+        }
+    }
+
+    // draw all children
+    for (n = 0; n < nd->mNumChildren; n++)
+    {
+        GetBasePose(sc, nd->mChildren[n]);
+    }
+}
+
+static void CopyColour(const aiColor4D &clr, float *dest)
+{
+    dest[0] = clr.r;
+    dest[1] = clr.g;
+    dest[2] = clr.b;
+    dest[3] = clr.a;
+}
+
+static void ReadMaterial(const aiScene *scene, const aiMaterial *mat, ImportedMaterial &dest)
+{
+    aiString path;
+    bool hasTexture = (mat->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS);
+
+    // ambient
+    aiColor4D clr(1.0f, 1.0f, 1.0f, 1.0f);
+    //Ambient is usually way too low! FIX ME!
+    if (!hasTexture)
+        aiGetMaterialColor(mat, AI_MATKEY_COLOR_AMBIENT, &clr);
+    CopyColour(clr, dest.ambient);
+
+    clr = aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
+    dest.hasDiffuse = (AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_DIFFUSE, &clr));
+    CopyColour(clr, dest.diffuse);
+
+    clr = aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
+    dest.hasSpecular = (AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_SPECULAR, &clr));
+    CopyColour(clr, dest.specular);
+
+    clr = aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
+    dest.hasEmissive = (AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_EMISSIVE, &clr));
+    CopyColour(clr, dest.emissive);
+
+    dest.hasShininess = (AI_SUCCESS == aiGetMaterialFloat(mat, AI_MATKEY_SHININESS, &dest.shininess));
+
+    int twoSided = 0;
+    aiGetMaterialInteger(mat, AI_MATKEY_TWOSIDED, &twoSided);
+    dest.twoSided = (twoSided != 0);
+
+    // Textures embedded in the scene are not supported, only texture files are loaded.
+    if (hasTexture && !scene->HasTextures())
+        dest.texture = QString::fromStdString(path.data);
+}
+
+static void ReadSubMesh(const aiMesh *mesh, const aiMatrix4x4 &transform, ImportedSubMesh &dest, ImportedMesh &importedMesh)
+{
+    dest.materialIndex = mesh->mMaterialIndex;
+    dest.numVertices = mesh->mNumVertices;
+
+    dest.positionsNormals.resize(mesh->mNumVertices * 6);
+    float *out = &dest.positionsNormals[0];
+    aiVector3D vect;
+    for(unsigned int n = 0; n < mesh->mNumVertices; ++n)
+    {
+        vect = mesh->mVertices[n];
+        vect *= transform;
+        *out++ = vect.x;
+        *out++ = vect.y;
+        *out++ = vect.z;
+        for(int i = 0; i < 3; ++i)
+        {
+            importedMesh.boundsMin[i] = std::min(importedMesh.boundsMin[i], vect[i]);
+            importedMesh.boundsMax[i] = std::max(importedMesh.boundsMax[i], vect[i]);
+        }
+
+        if (mesh->mNormals)
+        {
+            vect = mesh->mNormals[n];
+            vect *= transform;
+        }
+        else
+            vect = aiVector3D(0.f, 0.f, 0.f);
+        *out++ = vect.x;
+        *out++ = vect.y;
+        *out++ = vect.z;
+    }
+
+    size_t uvFloats = 0;
+    for(unsigned int tn = 0; tn < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++tn)
+        if (mesh->mTextureCoords[tn])
+        {
+            dest.uvComponents.resize(tn + 1, 0);
+            dest.uvComponents[tn] = (mesh->mNumUVComponents[tn] == 3 ? 3 : 2);
+            uvFloats += dest.uvComponents[tn];
+        }
+    dest.hasTangents = mesh->HasTangentsAndBitangents();
+    if (dest.hasTangents)
+        uvFloats += 6;
+
+    if (mesh->HasTextureCoords(0))
+    {
+        dest.uvsTangents.resize(mesh->mNumVertices * uvFloats);
+        out = &dest.uvsTangents[0];
+        for(unsigned int n = 0; n < mesh->mNumVertices; ++n)
+        {
+            for(size_t tn = 0; tn < dest.uvComponents.size(); ++tn)
+            {
+                if (dest.uvComponents[tn] == 0)
+                    continue;
+                *out++ = mesh->mTextureCoords[tn][n].x;
+                *out++ = mesh->mTextureCoords[tn][n].y;
+                if (dest.uvComponents[tn] == 3)
+                    *out++ = mesh->mTextureCoords[tn][n].z;
+            }
+            if (dest.hasTangents)
+            {
+                *out++ = mesh->mTangents[n].x;
+                *out++ = mesh->mTangents[n].y;
+                *out++ = mesh->mTangents[n].z;
+
+                *out++ = mesh->mBitangents[n].x;
+                *out++ = mesh->mBitangents[n].y;
+                *out++ = mesh->mBitangents[n].z;
+            }
+        }
+    }
+
+    if (mesh->HasVertexColors(0))
+    {
+        dest.colours.resize(mesh->mNumVertices * 4);
+        for(unsigned int n = 0; n < mesh->mNumVertices; ++n)
+            CopyColour(mesh->mColors[0][n], &dest.colours[n * 4]);
+    }
+
+    // Lines and points have been removed and the faces triangulated, so there are three indices per face.
+    dest.indices.reserve(mesh->mNumFaces * 3);
+    for(unsigned int n = 0; n < mesh->mNumFaces; ++n)
+    {
+        const aiFace &face = mesh->mFaces[n];
+        if (face.mNumIndices != 3)
+            continue;
+        dest.indices.push_back((u16)face.mIndices[0]);
+        dest.indices.push_back((u16)face.mIndices[1]);
+        dest.indices.push_back((u16)face.mIndices[2]);
+    }
+}
+
+static void ReadNode(const aiScene *scene, const aiNode *node, const aiMatrix4x4 &transform, ImportedMesh &dest)
+{
+    for(unsigned int idx = 0; idx < node->mNumMeshes; ++idx)
+    {
+        const aiMesh *mesh = scene->mMeshes[node->mMeshes[idx]];
+        if (mesh->mNumVertices == 0 || mesh->mNumFaces == 0)
+            continue;
+        dest.subMeshes.push_back(ImportedSubMesh());
+        ImportedSubMesh &subMesh = dest.subMeshes.back();
+        subMesh.name = QString(node->mName.data) + QString::number(idx);
+        ReadSubMesh(mesh, transform, subMesh, dest);
+        if (subMesh.indices.empty())
+            dest.subMeshes.pop_back();
+    }
+
+    for(unsigned int childIdx = 0; childIdx < node->mNumChildren; ++childIdx)
+    {
+        const aiNode *child = node->mChildren[childIdx];
+        ReadNode(scene, child, transform * child->mTransformation, dest);
+    }
+}
+
+static bool ReadWithAssimp(const MeshImportWorker::Job &job, ImportedMesh &dest, QString &error)
+{
+    Assimp::DefaultLogger::create("asslogger.log",Assimp::Logger::VERBOSE);
+    Assimp::Importer importer;
+
+    /// NOTICE!!!
+    // Some converted mesh might show up pretty messed up, it's happening because some formats might
+    // contain unnecessary vertex information, lines and points. Uncomment the line below for fixing this issue.
+    // by default remove points and lines from the model, since these are usually
+    // degenerate structures from bad modelling or bad import/export.  if they
+    // are needed it can be turned on with IncludeLinesPoints
+
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
+    /// END OF NOTICE
+
+    // Limit triangles because for each mesh there's limited index memory (16bit)
+    // ...which should be easy to just change to 32 bit but it didn't seem to be the case
+    importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, 21845);
+
+    unsigned int pFlags = 0
+                          | aiProcess_SplitLargeMeshes
+                          | aiProcess_FindInvalidData
+                          | aiProcess_GenSmoothNormals
+                          | aiProcess_Triangulate
+                          | aiProcess_FlipUVs
+                          | aiProcess_JoinIdenticalVertices
+                          | aiProcess_OptimizeMeshes
+                          | aiProcess_RemoveRedundantMaterials
+                          | aiProcess_ImproveCacheLocality
+                          | aiProcess_LimitBoneWeights
+                          | aiProcess_SortByPType
+                          | aiProcess_PreTransformVertices;
+
+    //assimp importer looks for a loader to support the file extension specified by hint
+    const QString &fileName = job.fileName;
+    QString hint = fileName.right(fileName.length() - fileName.lastIndexOf('.')-1);
+    const aiScene *scene = 0;
+    if (job.data && !job.data->empty())
+        scene = importer.ReadFileFromMemory(reinterpret_cast<const void*>(&(*job.data)[0]), job.data->size(), pFlags, hint.toStdString().c_str());
+
+    // If the importer failed to read the file from memory, try to read the file again.
+    if (!scene && !job.diskSource.isEmpty())
+        scene = importer.ReadFile(job.diskSource.toStdString(), pFlags);
+
+    if (!scene)
+    {
+        error = "AssImp importer::convert: conversion failed, importer unable to load data from file:" + fileName + ": " + importer.GetErrorString();
+        Assimp::DefaultLogger::kill();
+        return false;
+    }
+
+    // The bind pose and the root transform are written to the scene in place.
+    if (scene->HasAnimations())
+        GetBasePose(scene, scene->mRootNode);
+
+    aiMatrix4x4 transform;
+    transform.FromEulerAnglesXYZ(DegToRad(90), 0, DegToRad(180));
+    scene->mRootNode->mTransformation = transform;
+
+    dest.materials.resize(scene->mNumMaterials);
+    for(unsigned int i = 0; i < scene->mNumMaterials; ++i)
+        ReadMaterial(scene, scene->mMaterials[i], dest.materials[i]);
+
+    ReadNode(scene, scene->mRootNode, transform, dest);
+
+    Assimp::DefaultLogger::kill();
+    return true;
+}
+
+/// Returns the name of the converted mesh in the asset cache, by the hash of the source file.
+static QString CacheName(const std::vector<u8> &data)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(reinterpret_cast<const char*>(&data[0]), (int)data.size());
+    return "assimp_" + QString(hash.result().toHex()) + ".importedmesh";
+}
+
+class MeshImportWorker::ImportThread : public QThread
+{
+public:
+    explicit ImportThread(MeshImportWorker *worker) : worker_(worker) {}
+
+protected:
+    void run() { worker_->ThreadMain(); }
+
+private:
+    MeshImportWorker *worker_;
+};
+
+MeshImportWorker::MeshImportWorker() :
+    numImporting_(0),
+    quit_(false)
+{
+    thread_ = new ImportThread(this);
+    thread_->start(QThread::LowPriority);
+}
+
+MeshImportWorker::~MeshImportWorker()
+{
+    {
+        QMutexLocker lock(&mutex_);
+        quit_ = true;
+        jobs_.clear();
+        jobAvailable_.wakeAll();
+    }
+    thread_->wait();
+    delete thread_;
+}
+
+void MeshImportWorker::Import(const Job &job)
+{
+    QMutexLocker lock(&mutex_);
+    jobs_.push_back(job);
+    jobAvailable_.wakeOne();
+}
+
+void MeshImportWorker::TakeFinished(std::vector<Result> &results)
+{
+    QMutexLocker lock(&mutex_);
+    results.insert(results.end(), finished_.begin(), finished_.end());
+    finished_.clear();
+}
+
+size_t MeshImportWorker::NumPending() const
+{
+    QMutexLocker lock(&mutex_);
+    return jobs_.size() + numImporting_ + finished_.size();
+}
+
+void MeshImportWorker::ThreadMain()
+{
+    for(;;)
+    {
+        Job job;
+        {
+            QMutexLocker lock(&mutex_);
+            while(!quit_ && jobs_.empty())
+                jobAvailable_.wait(&mutex_);
+            if (quit_)
+                return;
+            job = jobs_.front();
+            jobs_.pop_front();
+            ++numImporting_;
+        }
+
+        Result result;
+        ImportMesh(job, result);
+        job.data.reset(); // Release the source data in this thread.
+
+        QMutexLocker lock(&mutex_);
+        --numImporting_;
+        finished_.push_back(result);
+    }
+}
+
+void MeshImportWorker::ImportMesh(const Job &job, Result &result)
+{
+    result.id = job.id;
+
+    QString cacheName;
+    if (!job.cacheDirectory.isEmpty() && job.data && !job.data->empty())
+    {
+        cacheName = CacheName(*job.data);
+        QFile file(job.cacheDirectory + cacheName);
+        if (file.open(QIODevice::ReadOnly))
+        {
+            shared_ptr<ImportedMesh> mesh = MAKE_SHARED(ImportedMesh);
+            if (mesh->Deserialize(file.readAll()))
+            {
+                result.mesh = mesh;
+                result.fromCache = true;
+                return;
+            }
+        }
+    }
+
+    shared_ptr<ImportedMesh> mesh = MAKE_SHARED(ImportedMesh);
+    if (!ReadWithAssimp(job, *mesh, result.error))
+        return;
+    result.mesh = mesh;
+
+    if (!cacheName.isEmpty())
+    {
+        mesh->Serialize(result.cacheData);
+        result.cacheName = cacheName;
+    }
+}
@@ -0,0 +1,132 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <QString>
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <vector>
+#include <deque>
+
+/// Material of an imported mesh, as read from the Assimp material.
+struct ImportedMaterial
+{
+    ImportedMaterial();
+
+    float ambient[4];
+    float diffuse[4];
+    float specular[4];
+    float emissive[4];
+    float shininess;
+    bool hasDiffuse;
+    bool hasSpecular;
+    bool hasEmissive;
+    bool hasShininess;
+    bool twoSided;
+    QString texture; ///< Path of the diffuse texture as written in the source file, or empty if there is no texture file.
+};
+
+/// Submesh of an imported mesh, with the vertex data in the layout of the Ogre vertex buffers.
+struct ImportedSubMesh
+{
+    ImportedSubMesh() : materialIndex(0), numVertices(0), hasTangents(false) {}
+
+    QString name;
+    u32 materialIndex;
+    u32 numVertices;
+    std::vector<float> positionsNormals; ///< Vertex buffer 0: position and normal of each vertex.
+    std::vector<u8> uvComponents; ///< Number of components, 2 or 3, of each texture coordinate set, or 0 if the set is not used.
+    bool hasTangents;
+    std::vector<float> uvsTangents; ///< Vertex buffer 1: texture coordinates, tangent and binormal of each vertex. Empty if the first texture coordinate set is not used.
+    std::vector<float> colours; ///< RGBA diffuse colour of each vertex, or empty.
+    std::vector<u16> indices; ///< Three indices per triangle.
+};
+
+/// Mesh converted from a file read by Assimp.
+/** Unlike Ogre::Mesh, this can be built off the main thread, and stored to the asset cache. */
+struct ImportedMesh
+{
+    ImportedMesh();
+
+    std::vector<ImportedMaterial> materials;
+    std::vector<ImportedSubMesh> subMeshes;
+    float boundsMin[3];
+    float boundsMax[3];
+
+    /// Serializes the mesh to the binary format stored in the asset cache.
+    /** The format is in the byte order of the machine, as the asset cache is not shared between machines. */
+    void Serialize(QByteArray &dest) const;
+
+    /// Deserializes a mesh serialized by Serialize(). @return False if the data is corrupt or from another version of the format.
+    bool Deserialize(const QByteArray &data);
+};
+
+/// Background thread which reads the meshes with Assimp and converts them to ImportedMesh.
+/** The converted meshes are cached: each conversion is stored to the asset cache by the hash of the source file,
+    and a later import of the same file reads the conversion from the cache instead of running Assimp. */
+class MeshImportWorker
+{
+public:
+    struct Job
+    {
+        Job() : id(0) {}
+
+        u32 id;
+        QString fileName; ///< Name of the asset. Its suffix tells Assimp the file format.
+        QString diskSource; ///< File read by Assimp if reading the data from memory fails.
+        shared_ptr<std::vector<u8> > data;
+        QString cacheDirectory; ///< Asset cache directory to look for a cached conversion in, or empty if the asset cache is not used.
+    };
+
+    struct Result
+    {
+        Result() : id(0), fromCache(false) {}
+
+        u32 id;
+        shared_ptr<ImportedMesh> mesh; ///< Null if the conversion failed.
+        QString error;
+        bool fromCache;
+        QString cacheName; ///< If nonempty, the mesh was converted with Assimp, and cacheData should be stored to the asset cache with this name.
+        QByteArray cacheData;
+    };
+
+    /// Starts the import thread. Assimp has global state, its logger, so the imports are run one at a time.
+    MeshImportWorker();
+    /// Stops and joins the import thread. The jobs not yet started are dropped.
+    ~MeshImportWorker();
+
+    /// Queues a job to the import thread.
+    void Import(const Job &job);
+
+    /// Moves the results of the finished jobs to the end of @c results.
+    void TakeFinished(std::vector<Result> &results);
+
+    /// Returns the number of jobs queued, running, or finished but not taken.
+    size_t NumPending() const;
+
+    /// Runs a job on the calling thread.
+    static void ImportMesh(const Job &job, Result &result);
+
+private:
+    class ImportThread;
+    friend class ImportThread;
+
+    /// Import thread main loop.
+    void ThreadMain();
+
+    mutable QMutex mutex_;
+    QWaitCondition jobAvailable_;
+    std::deque<Job> jobs_;
+    std::vector<Result> finished_;
+    size_t numImporting_;
+    bool quit_;
+    ImportThread *thread_;
+
+    // Noncopyable
+    MeshImportWorker(const MeshImportWorker &);
+    void operator =(const MeshImportWorker &);
+};
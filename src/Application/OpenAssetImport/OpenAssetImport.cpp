@@ -13,25 +13,18 @@ Licensed under the MIT license:
 #include "OgreMeshAsset.h"
 #include "OgreMaterialAsset.h"
 #include "LoggingFunctions.h"
-#include "Math/MathFunc.h"
+#include "Profiler.h"
 #include "AssetAPI.h"
+#include "AssetCache.h"
 #include "IAssetTransfer.h"
 #include "IAsset.h"
 
 #include <Ogre.h>
 
-#include <assimp/DefaultLogger.hpp>
-#include <assimp/Importer.hpp>
-#include <assimp/cimport.h>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
-//#define SKELETON_ENABLED
-
-int OpenAssetConverter::msBoneCount = 0;
-
 OpenAssetImport::OpenAssetImport() :
-    IModule("OpenAssetImport")
+    IModule("OpenAssetImport"),
+    assetAPI(0),
+    nextImportId(1)
 {
 }
 
@@ -43,6 +36,33 @@ void OpenAssetImport::Initialize()
 {
     assetAPI = GetFramework()->Asset();
     connect(assetAPI, SIGNAL(AssetCreated(AssetPtr)), SLOT(OnAssetCreated(AssetPtr)), Qt::UniqueConnection);
+
+    if (!GetFramework()->HasCommandLineParameter("--noAsyncAssetLoad"))
+        importWorker = MAKE_SHARED(MeshImportWorker);
+}
+
+void OpenAssetImport::Uninitialize()
+{
+    importWorker.reset();
+    for(std::map<u32, PendingImport>::iterator i = pendingImports.begin(); i != pendingImports.end(); ++i)
+        delete i->second.converter;
+    pendingImports.clear();
+    finishedImports.clear();
+}
+
+void OpenAssetImport::Update(f64 /*frametime*/)
+{
+    if (!importWorker)
+        return;
+
+    importWorker->TakeFinished(finishedImports);
+    if (finishedImports.empty())
+        return;
+
+    PROFILE(OpenAssetImport_CompleteImports);
+    for(size_t i = 0; i < finishedImports.size(); ++i)
+        CompleteImport(finishedImports[i]);
+    finishedImports.clear();
 }
 
 void OpenAssetImport::OnAssetCreated(AssetPtr asset)
@@ -57,15 +77,70 @@ void OpenAssetImport::OnAssetCreated(AssetPtr asset)
 
 void OpenAssetImport::OnConversionRequest(OgreMeshAsset *asset, const u8 *data, size_t len)
 {
-    OpenAssetConverter *converter = new OpenAssetConverter(GetFramework());
-    connect(converter, SIGNAL(ConversionDone(bool)), asset, SLOT(OnAssimpConversionDone(bool)), Qt::UniqueConnection);
-    converter->Convert(data, len, asset->Name(), asset->DiskSource(), asset->ogreMesh);
+    LogInfo("AssImp importer: Converting file:" + asset->Name());
+
+    // The data is valid only during this call, so the job takes a copy of it.
+    MeshImportWorker::Job job;
+    job.id = nextImportId++;
+    job.fileName = asset->Name();
+    job.diskSource = asset->DiskSource();
+    job.data = shared_ptr<std::vector<u8> >(new std::vector<u8>(data, data + len));
+    job.cacheDirectory = assetAPI->Cache() ? assetAPI->Cache()->CacheDirectory() : QString();
+
+    PendingImport &pending = pendingImports[job.id];
+    pending.asset = asset;
+    pending.mesh = asset->ogreMesh;
+    pending.converter = new OpenAssetConverter(GetFramework());
+    connect(pending.converter, SIGNAL(ConversionDone(bool)), asset, SLOT(OnAssimpConversionDone(bool)), Qt::UniqueConnection);
+
+    if (importWorker)
+        importWorker->Import(job);
+    else
+    {
+        MeshImportWorker::Result result;
+        MeshImportWorker::ImportMesh(job, result);
+        CompleteImport(result);
+    }
+}
+
+void OpenAssetImport::CompleteImport(MeshImportWorker::Result &result)
+{
+    std::map<u32, PendingImport>::iterator iter = pendingImports.find(result.id);
+    if (iter == pendingImports.end())
+        return;
+    PendingImport pending = iter->second;
+    pendingImports.erase(iter);
+
+    AssetCache *cache = assetAPI->Cache();
+    if (cache && !result.cacheName.isEmpty() && !result.cacheData.isEmpty())
+    {
+        QString path = cache->StoreAsset(reinterpret_cast<const u8*>(result.cacheData.constData()), result.cacheData.size(), result.cacheName);
+        if (path.isEmpty())
+            LogWarning("OpenAssetImport: Failed to store the converted mesh to the asset cache as " + result.cacheName);
+    }
+
+    // The asset was forgotten or reloaded while the mesh was being imported.
+    if (!pending.asset || pending.asset->ogreMesh.get() != pending.mesh.get())
+    {
+        delete pending.converter;
+        return;
+    }
+
+    if (result.mesh)
+    {
+        if (result.fromCache)
+            LogDebug("AssImp importer: Using the conversion of " + pending.asset->Name() + " from the asset cache.");
+    }
+    else
+        LogError(result.error);
+
+    PROFILE(OpenAssetImport_CreateMesh);
+    pending.converter->Convert(result.mesh.get(), pending.asset->Name(), pending.asset->DiskSource(), pending.mesh);
 }
 
 OpenAssetConverter::OpenAssetConverter(Framework *fw) :
     assetAPI(fw->Asset()),
-    meshCreated(false),
-    texCount(0)
+    meshCreated(false)
 {
 }
 
@@ -228,642 +303,62 @@ bool OpenAssetConverter::PendingTextures()
 {
     return texMatMap.empty();
 }
-
-aiMatrix4x4 UpdateAnimationFunc(const aiScene * scene, aiNodeAnim * pchannel, Ogre::Real val, float & ticks, aiMatrix4x4 & mat)
-{
-
-    // walking animation is found from element 0
-    const aiAnimation* mAnim = scene->mAnimations[0];
-    double currentTime = val;
-    currentTime = fmod( (float)val * 1.f, (float)mAnim->mDuration);
-    ticks = fmod( (float)val * 1.f, (float)mAnim->mDuration);
-
-    // calculate the transformations for each animation channel
-
-    // get the bone/node which is affected by this animation channel
-    const aiNodeAnim* channel = pchannel;
-
-    // ******** Position *****
-    aiVector3D presentPosition( 0, 0, 0);
-    if(channel->mNumPositionKeys > 0)
-    {
-        // Look for present frame number. Search from last position if time is after the last time, else from beginning
-        // Should be much quicker than always looking from start for the average use case.
-        unsigned int frame = 0;
-        while(frame < channel->mNumPositionKeys - 1)
-        {
-            if(currentTime < channel->mPositionKeys[frame+1].mTime)
-                break;
-            frame++;
-        }
-
-        // interpolate between this frame's value and next frame's value
-        unsigned int nextFrame = (frame + 1) % channel->mNumPositionKeys;
-        const aiVectorKey& key = channel->mPositionKeys[frame];
-        const aiVectorKey& nextKey = channel->mPositionKeys[nextFrame];
-        double diffTime = nextKey.mTime - key.mTime;
-        if(diffTime < 0.0)
-            diffTime += mAnim->mDuration;
-        if(diffTime > 0)
-        {
-            float factor = float( (currentTime - key.mTime) / diffTime);
-            presentPosition = key.mValue + (nextKey.mValue - key.mValue) * factor;
-        }
-        else
-        {
-            presentPosition = key.mValue;
-        }
-    }
-
-    // ******** Rotation *********
-    aiQuaternion presentRotation( 1, 0, 0, 0);
-    if(channel->mNumRotationKeys > 0)
-    {
-        unsigned int frame = 0;
-        while(frame < channel->mNumRotationKeys - 1)
-        {
-            if(currentTime < channel->mRotationKeys[frame+1].mTime)
-                break;
-            frame++;
-        }
-
-        // interpolate between this frame's value and next frame's value
-        unsigned int nextFrame = (frame + 1) % channel->mNumRotationKeys;
-        const aiQuatKey& key = channel->mRotationKeys[frame];
-        const aiQuatKey& nextKey = channel->mRotationKeys[nextFrame];
-        double diffTime = nextKey.mTime - key.mTime;
-        if(diffTime < 0.0)
-            diffTime += mAnim->mDuration;
-        if(diffTime > 0)
-        {
-            float factor = float( (currentTime - key.mTime) / diffTime);
-            aiQuaternion::Interpolate( presentRotation, key.mValue, nextKey.mValue, factor);
-        } 
-        else
-        {
-            presentRotation = key.mValue;
-        }
-    }
-
-    // ******** Scaling **********
-    aiVector3D presentScaling( 1, 1, 1);
-    if(channel->mNumScalingKeys > 0)
-    {
-        unsigned int frame = 0;
-        while(frame < channel->mNumScalingKeys - 1)
-        {
-            if(currentTime < channel->mScalingKeys[frame+1].mTime)
-                break;
-            frame++;
-        }
-
-        presentScaling = channel->mScalingKeys[frame].mValue;
-    }
-
-    // build a transformation matrix from it
-    mat = aiMatrix4x4(presentRotation.GetMatrix());
-
-    mat.a1 *= presentScaling.x; mat.b1 *= presentScaling.x; mat.c1 *= presentScaling.x;
-    mat.a2 *= presentScaling.y; mat.b2 *= presentScaling.y; mat.c2 *= presentScaling.y;
-    mat.a3 *= presentScaling.z; mat.b3 *= presentScaling.z; mat.c3 *= presentScaling.z;
-    mat.a4 = presentPosition.x; mat.b4 = presentPosition.y; mat.c4 = presentPosition.z;
-
-    return mat;
-}
-
-void GetBasePose(const aiScene * sc, const aiNode * nd)
-{
-    unsigned int i;
-    unsigned int n=0, /*k = 0,*/ t;
-
-    //insert current mesh's bones into boneMatrices
-    for(n=0; n < nd->mNumMeshes; ++n)
-    {
-        const struct aiMesh* mesh = sc->mMeshes[nd->mMeshes[n]];
-
-        std::vector<aiMatrix4x4> boneMatrices(mesh->mNumBones);
-
-        // fill boneMatrices with current bone locations
-        for( size_t a = 0; a < mesh->mNumBones; ++a)
-        {
-            aiBone* bone = mesh->mBones[a];
-
-            // find the corresponding node by again looking recursively through the node hierarchy for the same name
-            aiNode* node = sc->mRootNode->FindNode(bone->mName);
-
-            // start with the mesh-to-bone matrix
-            boneMatrices[a] = bone->mOffsetMatrix;
-
-            // and now append all node transformations down the parent chain until we're back at mesh coordinates again
-            const aiNode* tempNode = node;
-
-            while(tempNode)
-            {
-                // check your matrix multiplication order here!!!
-                boneMatrices[a] = tempNode->mTransformation * boneMatrices[a];
-
-                tempNode = tempNode->mParent;
-            }
-        }
-
-        // all using the results from the previous code snippet
-        std::vector<aiVector3D> resultPos( mesh->mNumVertices);
-        std::vector<aiVector3D> resultNorm( mesh->mNumVertices);
-
-        // loop through all vertex weights of all bones
-        for(size_t a = 0; a < mesh->mNumBones; ++a)
-        {
-            const aiBone* bone = mesh->mBones[a];
-            const aiMatrix4x4& posTrafo = boneMatrices[a];
-
-            // 3x3 matrix, contains the bone matrix without the translation, only with rotation and possibly scaling
-            aiMatrix3x3 normTrafo = aiMatrix3x3( posTrafo);
-            for(size_t b = 0; b < bone->mNumWeights; ++b)
-            {
-                const aiVertexWeight& weight = bone->mWeights[b];
-
-                size_t vertexId = weight.mVertexId;
-                const aiVector3D& srcPos = mesh->mVertices[vertexId];
-                const aiVector3D& srcNorm = mesh->mNormals[vertexId];
-
-                resultPos[vertexId] += (posTrafo * srcPos) * weight.mWeight;
-                resultNorm[vertexId] += (normTrafo * srcNorm)* weight.mWeight;
-            }
-        }
-
-        for (t = 0; t < mesh->mNumFaces; ++t)
-        {
-            const struct aiFace* face = &mesh->mFaces[t];
-
-            for(i = 0; i < face->mNumIndices; i++)		// go through all vertices in face
-            {
-                int vertexIndex = face->mIndices[i];	// get group index for current index
-
-
-                mesh->mNormals[vertexIndex] = resultNorm[vertexIndex];
-                mesh->mVertices[vertexIndex] = resultPos[vertexIndex];
-            }
-
-        }
-    }
-
-    // draw all children
-    for (n = 0; n < nd->mNumChildren; n++)
-    {
-        GetBasePose(sc, nd->mChildren[n]);
-    }
-}
-
-void OpenAssetConverter::Convert(const u8 *data_, size_t numBytes, const QString &fileName, const QString &diskSource, Ogre::MeshPtr mesh)
+void OpenAssetConverter::Convert(const ImportedMesh *imported, const QString &fileName, const QString &diskSource, Ogre::MeshPtr mesh)
 {
     meshCreated = false;
-    LogInfo("AssImp importer: Converting file:" +fileName.toStdString());
-    Assimp::DefaultLogger::create("asslogger.log",Assimp::Logger::VERBOSE);
-    mAnimationSpeedModifier = 1.0f;
-    Assimp::Importer importer;
-//    bool searchFromIndex = false;
-
-    /// NOTICE!!!
-    // Some converted mesh might show up pretty messed up, it's happening because some formats might
-    // contain unnecessary vertex information, lines and points. Uncomment the line below for fixing this issue.
-    // by default remove points and lines from the model, since these are usually
-    // degenerate structures from bad modelling or bad import/export.  if they
-    // are needed it can be turned on with IncludeLinesPoints
-
-    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
-    /// END OF NOTICE
-
-    // Limit triangles because for each mesh there's limited index memory (16bit)
-    // ...which should be easy to just change to 32 bit but it didn't seem to be the case
-    importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, 21845);
-
-    //importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_CAMERAS|aiComponent_LIGHTS|aiComponent_TEXTURES|aiComponent_ANIMATIONS);
-    //importer.SetPropertyInteger(AI_CONFIG_FAVOUR_SPEED,1);
-    //importer.SetPropertyInteger(AI_CONFIG_GLOB_MEASURE_TIME,0);
-
-    // And have it read the given file with some example postprocessing
-    // Usually - if speed is not the most important aspect for you - you'll
-    // propably to request more postprocessing than we do in this example.
-
-    unsigned int pFlags = 0
-                          | aiProcess_SplitLargeMeshes
-                          | aiProcess_FindInvalidData
-                          | aiProcess_GenSmoothNormals
-                          | aiProcess_Triangulate
-                          | aiProcess_FlipUVs
-                          | aiProcess_JoinIdenticalVertices
-                          | aiProcess_OptimizeMeshes
-                          | aiProcess_RemoveRedundantMaterials
-                          | aiProcess_ImproveCacheLocality
-                          | aiProcess_LimitBoneWeights
-                          | aiProcess_SortByPType;
-
-#ifndef SKELETON_ENABLED
-    pFlags = pFlags | aiProcess_PreTransformVertices;
-#endif
-
-    //assimp importer looks for a loader to support the file extension specified by hint 
-    QString hint = fileName.right(fileName.length() - fileName.lastIndexOf('.')-1);
-    scene = importer.ReadFileFromMemory(reinterpret_cast<const void*>(data_), numBytes, pFlags, hint.toStdString().c_str());
-
-    if(!scene)
+    if (!imported)
     {
-        LogInfo("AssImp importer::convert: Failed to read file:" +fileName.toStdString()+ " from memory: ");
-        LogInfo(importer.GetErrorString());
-        LogInfo("AssImp importer::convert: Trying to load data from file:" +fileName.toStdString());
-		
-        // If the importer failed to read the file from memory,
-        // try to read the file again.
-        scene = importer.ReadFile(diskSource.toStdString(), pFlags);
-
-        if(!scene)
-        {
-            LogError("AssImp importer::convert: conversion failed, importer unable to load data from file:" +fileName.toStdString());
-            emit ConversionDone(false);
-            return;
-        }
+        emit ConversionDone(false);
+        return;
     }
 
-    if (scene->HasAnimations())
-        GetBasePose(scene, scene->mRootNode);
-
-    GrabNodeNamesFromNode(scene, scene->mRootNode);
-
-#ifdef SKELETON_ENABLED
-    GrabBoneNamesFromNode(scene, scene->mRootNode);
-#endif
-
-    aiMatrix4x4 transform;
-    transform.FromEulerAnglesXYZ(DegToRad(90), 0, DegToRad(180));
-    scene->mRootNode->mTransformation = transform;
-
-    ComputeNodesDerivedTransform(scene, scene->mRootNode, transform);
-
-#ifdef SKELETON_ENABLED
-    if(mBonesByName.size())
+    for(size_t i = 0; i < imported->subMeshes.size(); ++i)
     {
-        mSkeleton = Ogre::SkeletonManager::getSingleton().create("conversion", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+        const ImportedSubMesh &importedSubMesh = imported->subMeshes[i];
+        Ogre::MaterialPtr matptr;
 
-        msBoneCount = 0;
-        CreateBonesFromNode(scene, scene->mRootNode);
-        msBoneCount = 0;
-        CreateBoneHiearchy(scene, scene->mRootNode);
+        //generates material name
+        Ogre::String matName = Ogre::String(fileName.toStdString()+"_generatedMat" + Ogre::StringConverter::toString(importedSubMesh.materialIndex)+ ".material");
+        //checks if the material already exist, it might have been generated before to another submesh.
+        matptr = Ogre::MaterialManager::getSingleton().getByName(matName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
 
-        if(scene->HasAnimations())
+        if(matptr.isNull())
         {
-            for(int i = 0; i < scene->mNumAnimations; ++i)
-            {
-                ParseAnimation(scene, i, scene->mAnimations[i]);
-            }
-        }
-    }
-#endif
-
-    LoadDataFromNode(scene, scene->mRootNode, diskSource, fileName, mesh);
-
-    Ogre::LogManager::getSingleton().logMessage("*** Finished loading ass file ***");
-    Assimp::DefaultLogger::kill();
-
-#ifdef SKELETON_ENABLED
+            if(!importedSubMesh.colours.empty())
+                matptr = CreateVertexColorMaterial();
+            else
+               matptr = CreateMaterial(matName, imported->materials[importedSubMesh.materialIndex], diskSource, fileName);
 
-    if(!mSkeleton.isNull())
-    {
-        unsigned short numBones = mSkeleton->getNumBones();
-        unsigned short i;
-        for (i = 0; i < numBones; ++i)
-        {
-            Ogre::Bone* pBone = mSkeleton->getBone(i);
-            assert(pBone);
+            //we must create an OgreMaterialAsset through assetAPI and put the just created
+            //ogre material pointer to it
+            //GenerateTemporaryNonexistingAssetFilename() is used to prevent the "Asset Storage contains ambiguous assets in two different subdirectories!" warning 
+            QString matname = assetAPI->GenerateTemporaryNonexistingAssetFilename(QString::fromStdString(matptr->getName()));
+            AssetPtr assetPtr = assetAPI->CreateNewAsset("OgreMaterial", matname);
+            OgreMaterialAsset *mat = static_cast<OgreMaterialAsset *>(assetPtr.get());
+            mat->ogreMaterial = matptr;
         }
 
-        Ogre::SkeletonSerializer binSer;
-
-        //binSer.exportSkeleton(mSkeleton.getPointer(), "model.skeleton");
+        Ogre::SubMesh* submesh = mesh->createSubMesh(importedSubMesh.name.toStdString());
+        CreateVertexData(importedSubMesh, submesh);
+        submesh->setMaterialName(matptr->getName());
     }
 
-    Ogre::MeshSerializer meshSer;
-    for(MeshVector::iterator it = mMeshes.begin(); it != mMeshes.end(); ++it)
+    if (!imported->subMeshes.empty())
     {
-        Ogre::MeshPtr mMesh = *it;
-        if(mBonesByName.size())
-        {
-            mMesh->setSkeletonName(fileName.toStdString() + ".skeleton");
-        }
-
-        Ogre::Mesh::SubMeshIterator smIt = mMesh->getSubMeshIterator();
-        while (smIt.hasMoreElements())
-        {
-            Ogre::SubMesh* sm = smIt.getNext();
-            if (!sm->useSharedVertices)
-            {
-                // AutogreMaterialic
-#if OGRE_VERSION_MINOR >= 8 && OGRE_VERSION_MAJOR >= 1
-                Ogre::VertexDeclaration* newDcl =
-                        sm->vertexData->vertexDeclaration->getAutoOrganisedDeclaration(mMesh->hasSkeleton(), mMesh->hasVertexAnimation(), false);
-#else
-                Ogre::VertexDeclaration* newDcl =
-                        sm->vertexData->vertexDeclaration->getAutoOrganisedDeclaration(mMesh->hasSkeleton(), mMesh->hasVertexAnimation());
-#endif
-                if (*newDcl != *(sm->vertexData->vertexDeclaration))
-                {
-                    // Usages don't matter here since we're only exporting
-                    Ogre::BufferUsageList bufferUsages;
-                    for (size_t u = 0; u <= newDcl->getMaxSource(); ++u)
-                        bufferUsages.push_back(Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-                    sm->vertexData->reorganiseBuffers(newDcl, bufferUsages);
-                }
-            }
-        }
+        // We must indicate the bounding box
+        Ogre::AxisAlignedBox mAAB(imported->boundsMin[0], imported->boundsMin[1], imported->boundsMin[2],
+            imported->boundsMax[0], imported->boundsMax[1], imported->boundsMax[2]);
+        mesh->_setBounds(mAAB);
+        mesh->_setBoundingSphereRadius((mAAB.getMaximum()- mAAB.getMinimum()).length()/2.0);
     }
 
-#endif
-
-    mMeshes.clear();
-    mMaterialCode = "";
-    mBonesByName.clear();
-    mBoneNodesByName.clear();
-    boneMap.clear();
-    mSkeleton = Ogre::SkeletonPtr(NULL);
-    mCustomAnimationName = "";
-    // etc...
     meshCreated = true;
     Ogre::MeshManager::getSingleton().removeUnreferencedResources();
-    Ogre::SkeletonManager::getSingleton().removeUnreferencedResources();
-	
+
     if(meshCreated && PendingTextures())
         emit ConversionDone(true);
 }
 
-void OpenAssetConverter::ParseAnimation (const aiScene* mScene, int index, aiAnimation* anim)
-{
-    UNREFERENCED_PARAM(mScene);
-
-    // DefBonePose a matrix that represents the local bone transform (can build from Ogre bone components)
-    // PoseToKey a matrix representing the keyframe translation
-    // What assimp stores aiNodeAnim IS the decomposed form of the transform (DefBonePose * PoseToKey)
-    // To get PoseToKey which is what Ogre needs we'ed have to build the transform from components in
-    // aiNodeAnim and then DefBonePose.Inverse() * aiNodeAnim(generated transform) will be the right transform
-
-    Ogre::String animName;
-    if(mCustomAnimationName != "")
-    {
-        animName = mCustomAnimationName;
-        if(index >= 1)
-        {
-            animName += Ogre::StringConverter::toString(index);
-        }
-    }
-    else
-    {
-        animName = Ogre::String(anim->mName.data);
-    }
-    if(animName.length() < 1)
-    {
-        animName = "Animation" + Ogre::StringConverter::toString(index);
-    }
-
-    Ogre::LogManager::getSingleton().logMessage("Animation name = '" + animName + "'");
-    Ogre::LogManager::getSingleton().logMessage("duration = " + Ogre::StringConverter::toString(Ogre::Real(anim->mDuration)));
-    Ogre::LogManager::getSingleton().logMessage("tick/sec = " + Ogre::StringConverter::toString(Ogre::Real(anim->mTicksPerSecond)));
-    Ogre::LogManager::getSingleton().logMessage("channels = " + Ogre::StringConverter::toString(anim->mNumChannels));
-
-    Ogre::Animation* animation;
-    mTicksPerSecond = 1;
-    animation = mSkeleton->createAnimation(Ogre::String(animName), Ogre::Real(anim->mDuration/mTicksPerSecond));
-
-    for(int i = 0; i < (int)anim->mNumChannels; i++)
-    {
-        Ogre::TransformKeyFrame* keyframe;
-        aiNodeAnim* node_anim = anim->mChannels[i];
-        Ogre::String boneName = Ogre::String(node_anim->mNodeName.data);
-
-        if(mSkeleton->hasBone(boneName))
-        {
-            Ogre::Bone* bone = mSkeleton->getBone(boneName);
-
-            Ogre::Matrix4 defBonePoseInv;
-            defBonePoseInv.makeInverseTransform(bone->getPosition(), bone->getScale(), bone->getOrientation());
-            Ogre::NodeAnimationTrack* track = animation->createNodeTrack(i, bone);
-
-            for(int g = 0; g < 300; g++)
-            {
-                aiVector3D pos;
-                aiQuaternion rot;
-                aiMatrix4x4 mat;
-                float time;
-                UpdateAnimationFunc(scene, node_anim, g, time, mat);
-                mat.DecomposeNoScaling(rot, pos);
-                keyframe = track->createNodeKeyFrame(Ogre::Real(time));
-
-                Ogre::Vector3 trans(pos.x, pos.y, pos.z);
-                Ogre::Quaternion rotat(rot.w, rot.x, rot.y, rot.z);
-
-                Ogre::Vector3 scale(1,1,1); // ignore scale for now
-                Ogre::Matrix4 fullTransform;
-                fullTransform.makeTransform(trans, scale, rotat);
-
-                Ogre::Matrix4 poseTokey = defBonePoseInv * fullTransform;
-                poseTokey.decomposition(trans, scale, rotat);
-
-                keyframe->setTranslate(trans);
-                keyframe->setRotation(rotat);
-                keyframe->setScale(scale);
-
-            }
-        }
-    } // if bone exists
-
-    // loop through channels
-
-    mSkeleton->optimiseAllAnimations();
-}
-
-void OpenAssetConverter::MarkAllChildNodesAsNeeded(const aiNode *pNode)
-{
-    FlagNodeAsNeeded(pNode->mName.data);
-    // Traverse all child nodes of the current node instance
-    for (unsigned int childIdx=0; childIdx<pNode->mNumChildren; ++childIdx )
-    {
-        const aiNode *pChildNode = pNode->mChildren[ childIdx ];
-        MarkAllChildNodesAsNeeded(pChildNode);
-    }
-}
-
-void OpenAssetConverter::GrabNodeNamesFromNode(const aiScene* mScene, const aiNode* pNode)
-{
-    boneNode bNode;
-    bNode.node = const_cast<aiNode*>(pNode);
-    if(NULL != pNode->mParent)
-    {
-        bNode.parent = const_cast<aiNode*>(pNode->mParent);
-    }
-    bNode.isNeeded = false;
-    boneMap.insert(std::pair<Ogre::String, boneNode>(Ogre::String(pNode->mName.data), bNode));
-    mBoneNodesByName[pNode->mName.data] = pNode;
-
-    Ogre::LogManager::getSingleton().logMessage("Node " + Ogre::String(pNode->mName.data) + " found.");
-
-
-    // Traverse all child nodes of the current node instance
-    for (unsigned int childIdx=0; childIdx<pNode->mNumChildren; ++childIdx)
-    {
-        const aiNode *pChildNode = pNode->mChildren[childIdx];
-        GrabNodeNamesFromNode(mScene, pChildNode);
-    }
-}
-
-
-void OpenAssetConverter::ComputeNodesDerivedTransform(const aiScene* mScene,  const aiNode *pNode, const aiMatrix4x4 accTransform)
-{
-    if(mNodeDerivedTransformByName.find(pNode->mName.data) == mNodeDerivedTransformByName.end())
-    {
-        mNodeDerivedTransformByName[pNode->mName.data] = accTransform;
-    }
-    for (unsigned int childIdx=0; childIdx<pNode->mNumChildren; ++childIdx)
-    {
-        const aiNode *pChildNode = pNode->mChildren[ childIdx ];
-        ComputeNodesDerivedTransform(mScene, pChildNode, accTransform * pChildNode->mTransformation);
-    }
-}
-
-void OpenAssetConverter::CreateBonesFromNode(const aiScene* mScene,  const aiNode *pNode)
-{
-    if(IsNodeNeeded(pNode->mName.data))
-    {
-        Ogre::Bone* bone = mSkeleton->createBone(Ogre::String(pNode->mName.data), msBoneCount);
-
-        aiQuaternion rot;
-        aiVector3D pos;
-
-        aiMatrix4x4 aiM = pNode->mTransformation;
-
-        aiM.DecomposeNoScaling(rot, pos);
-
-        if (!aiM.IsIdentity())
-        {
-            bone->setPosition(pos.x, pos.y, pos.z);
-            bone->setOrientation(rot.w, rot.x, rot.y, rot.z);
-        }
-
-        Ogre::LogManager::getSingleton().logMessage(Ogre::StringConverter::toString(msBoneCount) + ") Creating bone '" + Ogre::String(pNode->mName.data) + "'");
-
-        msBoneCount++;
-    }
-    // Traverse all child nodes of the current node instance
-    for (unsigned int childIdx=0; childIdx<pNode->mNumChildren; ++childIdx)
-    {
-        const aiNode *pChildNode = pNode->mChildren[childIdx];
-        CreateBonesFromNode(mScene, pChildNode);
-    }
-}
-
-void OpenAssetConverter::CreateBoneHiearchy(const aiScene* mScene,  const aiNode *pNode)
-{
-    if(IsNodeNeeded(pNode->mName.data))
-    {
-        Ogre::Bone* parent = 0;
-        Ogre::Bone* child = 0;
-        if(pNode->mParent)
-        {
-            if(mSkeleton->hasBone(pNode->mParent->mName.data))
-            {
-                parent = mSkeleton->getBone(pNode->mParent->mName.data);
-            }
-        }
-        if(mSkeleton->hasBone(pNode->mName.data))
-        {
-            child = mSkeleton->getBone(pNode->mName.data);
-        }
-        if(parent && child)
-        {
-            parent->addChild(child);
-        }
-    }
-    // Traverse all child nodes of the current node instance
-    for (unsigned int childIdx=0; childIdx<pNode->mNumChildren; childIdx++)
-    {
-        const aiNode *pChildNode = pNode->mChildren[ childIdx ];
-        CreateBoneHiearchy(mScene, pChildNode);
-    }
-}
-
-void OpenAssetConverter::FlagNodeAsNeeded(const char* name)
-{
-    BoneMapType::iterator iter = boneMap.find(Ogre::String(name));
-    if(iter != boneMap.end())
-    {
-        iter->second.isNeeded = true;
-    }
-}
-
-bool OpenAssetConverter::IsNodeNeeded(const char* name)
-{
-    BoneMapType::iterator iter = boneMap.find(Ogre::String(name));
-    if(iter != boneMap.end())
-    {
-        return iter->second.isNeeded;
-    }
-    return false;
-}
-
-void OpenAssetConverter::GrabBoneNamesFromNode(const aiScene* mScene,  const aiNode *pNode)
-{
-
-    if(pNode->mNumMeshes > 0)
-    {
-        for(unsigned int idx=0; idx<pNode->mNumMeshes; ++idx)
-        {
-            aiMesh *pAIMesh = mScene->mMeshes[pNode->mMeshes[idx]];
-
-            if(pAIMesh->HasBones())
-            {
-                for(Ogre::uint32 i=0; i < pAIMesh->mNumBones; ++i)
-                {
-                    aiBone *pAIBone = pAIMesh->mBones[i];
-                    if (NULL != pAIBone)
-                    {
-                        mBonesByName[pAIBone->mName.data] = pAIBone;
-
-                        Ogre::LogManager::getSingleton().logMessage(Ogre::StringConverter::toString(i) + ") REAL BONE with name : " + Ogre::String(pAIBone->mName.data));
-
-                        // flag this node and all parents of this node as needed, until we reach the node holding the mesh, or the parent.
-                        aiNode* node = mScene->mRootNode->FindNode(pAIBone->mName.data);
-                        while(node)
-                        {
-                            if(node->mName.data == pNode->mName.data)
-                            {
-                                FlagNodeAsNeeded(node->mName.data);
-                                break;
-                            }
-                            if(node->mName.data == pNode->mParent->mName.data)
-                            {
-                                FlagNodeAsNeeded(node->mName.data);
-                                break;
-                            }
-
-                            // Not a root node, flag this as needed and continue to the parent
-                            FlagNodeAsNeeded(node->mName.data);
-                            node = node->mParent;
-                        }
-
-                        // Flag all children of this node as needed
-                        node = mScene->mRootNode->FindNode(pAIBone->mName.data);
-                        MarkAllChildNodesAsNeeded(node);
-
-                    } // if we have a valid bone
-                } // loop over bones
-            } // if this mesh has bones
-        } // loop over meshes
-    } // if this node has meshes
-
-    // Traverse all child nodes of the current node instance
-    for (unsigned int childIdx=0; childIdx<pNode->mNumChildren; childIdx++)
-    {
-        const aiNode *pChildNode = pNode->mChildren[childIdx];
-        GrabBoneNamesFromNode(mScene, pChildNode);
-    }
-}
-
 Ogre::MaterialPtr OpenAssetConverter::CreateVertexColorMaterial()
 {
     Ogre::MaterialManager* ogreMaterialMgr = Ogre::MaterialManager::getSingletonPtr();
@@ -884,80 +379,33 @@ Ogre::MaterialPtr OpenAssetConverter::CreateVertexColorMaterial()
     return ogreMaterial;
 }
 
-Ogre::MaterialPtr OpenAssetConverter::CreateMaterial(Ogre::String& matName, const aiMaterial* mat, const QString &meshFileDiskSource, const QString &meshFileName)
+Ogre::MaterialPtr OpenAssetConverter::CreateMaterial(Ogre::String& matName, const ImportedMaterial &mat, const QString &meshFileDiskSource, const QString &meshFileName)
 {
-    std::ostringstream matname;
     Ogre::MaterialManager* ogreMaterialMgr =  Ogre::MaterialManager::getSingletonPtr();
-    enum aiTextureType Type = aiTextureType_DIFFUSE;
-    aiString path;
-//    aiTextureMapping mapping = aiTextureMapping_UV;       // the mapping (should be uv for now)
-    unsigned int uvindex = 0;                             // the texture uv index channel
-//    float blend = 1.0f;                                   // blend
-//    aiTextureOp op = aiTextureOp_Multiply;                // op
-//    aiTextureMapMode mapmode[2] =  { aiTextureMapMode_Wrap, aiTextureMapMode_Wrap };    // mapmode
-    std::ostringstream texname;
-
-    aiString szPath;
-
-    if(AI_SUCCESS == aiGetMaterialString(mat, AI_MATKEY_TEXTURE_DIFFUSE(0), &szPath))
-    {
-	    Ogre::LogManager::getSingleton().logMessage("File: " + meshFileName.toStdString() + ". Texture " + Ogre::String(szPath.data) + " for channel " + Ogre::StringConverter::toString(uvindex));
-        //LogInfo("File: " + meshFileName.toStdString() + ". Texture " + Ogre::String(szPath.data) + " for channel " + Ogre::StringConverter::toString(uvindex));
-    }
-
-    Ogre::MaterialPtr ogreMaterial = ogreMaterialMgr->create(matName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, true);
-
-    // ambient
-    aiColor4D clr(1.0f, 1.0f, 1.0f, 1.0f);
-    //Ambient is usually way too low! FIX ME!
-    if (mat->GetTexture(Type, 0, &path) != AI_SUCCESS)
-        aiGetMaterialColor(mat, AI_MATKEY_COLOR_AMBIENT, &clr);
-
-    ogreMaterial->setAmbient(clr.r, clr.g, clr.b);
-
-    // diffuse
-    clr = aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
-    if(AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_DIFFUSE, &clr))
-    {
-        ogreMaterial->setDiffuse(clr.r, clr.g, clr.b, clr.a);
-    }
 
-    // specular
-    clr = aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
-    if(AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_SPECULAR, &clr))
-    {
-        ogreMaterial->setSpecular(clr.r, clr.g, clr.b, clr.a);
-    }
-
-    // emissive
-    clr = aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
-    if(AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_EMISSIVE, &clr))
-    {
-        ogreMaterial->setSelfIllumination(clr.r, clr.g, clr.b);
-    }
+    if(!mat.texture.isEmpty())
+        Ogre::LogManager::getSingleton().logMessage("File: " + meshFileName.toStdString() + ". Texture " + mat.texture.toStdString() + " for channel 0");
 
-    float fShininess;
-    if(AI_SUCCESS == aiGetMaterialFloat(mat, AI_MATKEY_SHININESS, &fShininess))
-    {
-        ogreMaterial->setShininess(Ogre::Real(fShininess));
-    }
-
-    int two_sided;
-    aiGetMaterialInteger(mat, AI_MATKEY_TWOSIDED, &two_sided);
+    Ogre::MaterialPtr ogreMaterial = ogreMaterialMgr->create(matName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, true);
 
-    if (two_sided != 0)
+    ogreMaterial->setAmbient(mat.ambient[0], mat.ambient[1], mat.ambient[2]);
+    if(mat.hasDiffuse)
+        ogreMaterial->setDiffuse(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2], mat.diffuse[3]);
+    if(mat.hasSpecular)
+        ogreMaterial->setSpecular(mat.specular[0], mat.specular[1], mat.specular[2], mat.specular[3]);
+    if(mat.hasEmissive)
+        ogreMaterial->setSelfIllumination(mat.emissive[0], mat.emissive[1], mat.emissive[2]);
+    if(mat.hasShininess)
+        ogreMaterial->setShininess(Ogre::Real(mat.shininess));
+    if(mat.twoSided)
         ogreMaterial->setCullingMode(Ogre::CULL_NONE);
 
-    if (mat->GetTexture(Type, 0, &path) == AI_SUCCESS)
+    if(!mat.texture.isEmpty())
     {
-        //If the assimp scene contains textures they are loaded into the Ogre resource system
-        if (!scene->HasTextures())
-        {
-            QString tex = QString::fromStdString(szPath.data);
-            QString texPath = GetPathToTexture(meshFileName, meshFileDiskSource, tex);
-            texMatMap.insert(TexMatPair(texPath, ogreMaterial));
-            LoadTextureFile(texPath);
-        }
+        QString tex = mat.texture;
+        QString texPath = GetPathToTexture(meshFileName, meshFileDiskSource, tex);
+        texMatMap.insert(TexMatPair(texPath, ogreMaterial));
+        LoadTextureFile(texPath);
     }
     else
         ogreMaterial->load();
@@ -965,23 +413,17 @@ Ogre::MaterialPtr OpenAssetConverter::CreateMaterial(Ogre::String& matName, cons
     return ogreMaterial;
 }
 
-bool OpenAssetConverter::CreateVertexData(const Ogre::String& name, const aiNode* pNode, const aiMesh *mesh, Ogre::SubMesh* submesh, Ogre::AxisAlignedBox& mAAB)
+void OpenAssetConverter::CreateVertexData(const ImportedSubMesh &imported, Ogre::SubMesh* submesh)
 {
-    // if animated all submeshes must have bone weights
-    if(mBonesByName.size() && !mesh->HasBones())
-    {
-        Ogre::LogManager::getSingleton().logMessage("Skipping Mesh " + Ogre::String(mesh->mName.data) + "with no bone weights");
-        return false;
-    }
-    
     // We must create the vertex data, indicating how many vertices there will be
     submesh->useSharedVertices = false;
 #include "DisableMemoryLeakCheck.h"
     submesh->vertexData = new Ogre::VertexData();
 #include "EnableMemoryLeakCheck.h"
     submesh->vertexData->vertexStart = 0;
-    submesh->vertexData->vertexCount = mesh->mNumVertices;
+    submesh->vertexData->vertexCount = imported.numVertices;
     Ogre::VertexData *data = submesh->vertexData;
+    Ogre::HardwareBufferManager &bufferMgr = Ogre::HardwareBufferManager::getSingleton();
 
     // Vertex declarations
     size_t offset = 0;
@@ -989,274 +431,83 @@ bool OpenAssetConverter::CreateVertexData(const Ogre::String& name, const aiNode
     offset += decl->addElement(0,offset,Ogre::VET_FLOAT3,Ogre::VES_POSITION).getSize();
     offset += decl->addElement(0,offset,Ogre::VET_FLOAT3,Ogre::VES_NORMAL).getSize();
 
-    offset = 0;
-    for(int tn=0 ; tn<AI_MAX_NUMBER_OF_TEXTURECOORDS ; ++tn)
-    {
-        if(mesh->mTextureCoords[tn])
-        {
-            if(mesh->mNumUVComponents[tn] == 3)
-            {
-                decl->addElement(1, offset, Ogre::VET_FLOAT3, Ogre::VES_TEXTURE_COORDINATES, tn);
-                offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-            } 
-            else
-            {
-                decl->addElement(1, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, tn);
-                offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
-            }
-        }
-    }
-
-    if (mesh->HasTangentsAndBitangents())
-    {
-        decl->addElement(1, offset, Ogre::VET_FLOAT3, Ogre::VES_TANGENT);
-        offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-        decl->addElement(1, offset, Ogre::VET_FLOAT3, Ogre::VES_BINORMAL);
-    }
-
-    offset = 0;
-    for(int vn=0 ; vn<AI_MAX_NUMBER_OF_COLOR_SETS; ++vn)
-    {
-        if (mesh->mColors[vn])
-        {
-            decl->addElement(2, offset, Ogre::VET_COLOUR, Ogre::VES_DIFFUSE);
-            offset += Ogre::VertexElement::getTypeSize(Ogre::VET_COLOUR);
-
-        }
-    }
-
-    // Write vertex data to buffer
-    Ogre::HardwareVertexBufferSharedPtr vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+    // The vertex data is already in the layout of the buffers, so it is written as is.
+    Ogre::HardwareVertexBufferSharedPtr vbuf = bufferMgr.createVertexBuffer(
             decl->getVertexSize(0), // This value is the size of a vertex in memory
             data->vertexCount, // The number of vertices you'll put into this buffer
             Ogre::HardwareBuffer::HBU_DYNAMIC // Properties
             );
-    Ogre::Real *vbData = static_cast<Ogre::Real*>(vbuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
-
-    aiMatrix4x4 aiM = mNodeDerivedTransformByName.find(pNode->mName.data)->second;
+    vbuf->writeData(0, vbuf->getSizeInBytes(), &imported.positionsNormals[0], true);
+    data->vertexBufferBinding->setBinding(0, vbuf);
 
-    offset = 0;
-    aiVector3D vect;
-    for (unsigned int n=0 ; n<data->vertexCount ; ++n)
+    if (!imported.uvsTangents.empty())
     {
-        if (mesh->mVertices != NULL)
+        offset = 0;
+        for(size_t tn = 0; tn < imported.uvComponents.size(); ++tn)
         {
-            vect.x = mesh->mVertices[n].x;
-            vect.y = mesh->mVertices[n].y;
-            vect.z = mesh->mVertices[n].z;
-#ifndef SKELETONS_ENABLED
-            vect *= aiM;
-#endif
-
-            Ogre::Vector3 position( vect.x, vect.y, vect.z );
-            vbData[offset++] = vect.x;
-            vbData[offset++] = vect.y;
-            vbData[offset++] = vect.z;
-
-            mAAB.merge(position);
+            if(imported.uvComponents[tn] == 3)
+            {
+                decl->addElement(1, offset, Ogre::VET_FLOAT3, Ogre::VES_TEXTURE_COORDINATES, (unsigned short)tn);
+                offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+            }
+            else if(imported.uvComponents[tn] == 2)
+            {
+                decl->addElement(1, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, (unsigned short)tn);
+                offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
+            }
         }
 
-        if (mesh->mNormals != NULL)
+        if (imported.hasTangents)
         {
-            vect.x = mesh->mNormals[n].x;
-            vect.y = mesh->mNormals[n].y;
-            vect.z = mesh->mNormals[n].z;
-#ifndef SKELETONS_ENABLED
-            vect *= aiM;
-#endif
-            vbData[offset++] = vect.x;
-            vbData[offset++] = vect.y;
-            vbData[offset++] = vect.z;
+            decl->addElement(1, offset, Ogre::VET_FLOAT3, Ogre::VES_TANGENT);
+            offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+            decl->addElement(1, offset, Ogre::VET_FLOAT3, Ogre::VES_BINORMAL);
         }
-    }
-
-    vbuf->unlock();
-    data->vertexBufferBinding->setBinding(0, vbuf);
 
-    if (mesh->HasTextureCoords(0))
-    {
-        vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+        vbuf = bufferMgr.createVertexBuffer(
                 decl->getVertexSize(1), // This value is the size of a vertex in memory
                 data->vertexCount, // The number of vertices you'll put into this buffer
                 Ogre::HardwareBuffer::HBU_DYNAMIC // Properties
                 );
-        vbData = static_cast<Ogre::Real*>(vbuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
-
-        offset = 0;
-        for (unsigned int n=0 ; n<data->vertexCount ; ++n)
-        {
-            for (int tn=0 ; tn<AI_MAX_NUMBER_OF_TEXTURECOORDS ; ++tn)
-            {
-                if (mesh->mTextureCoords[tn])
-                {
-                    if (mesh->mNumUVComponents[tn] == 3)
-                    {
-                        vbData[offset++] = mesh->mTextureCoords[tn][n].x;
-                        vbData[offset++] = mesh->mTextureCoords[tn][n].y;
-                        vbData[offset++] = mesh->mTextureCoords[tn][n].z;
-                    } 
-                    else
-                    {
-                        vbData[offset++] = mesh->mTextureCoords[tn][n].x;
-                        vbData[offset++] = mesh->mTextureCoords[tn][n].y;
-                    }
-                }
-            }
-            if (mesh->HasTangentsAndBitangents())
-            {
-                vbData[offset++] = mesh->mTangents[n].x;
-                vbData[offset++] = mesh->mTangents[n].y;
-                vbData[offset++] = mesh->mTangents[n].z;
-
-                vbData[offset++] = mesh->mBitangents[n].x;
-                vbData[offset++] = mesh->mBitangents[n].y;
-                vbData[offset++] = mesh->mBitangents[n].z;
-            }
-        }
-        vbuf->unlock();
+        vbuf->writeData(0, vbuf->getSizeInBytes(), &imported.uvsTangents[0], true);
         data->vertexBufferBinding->setBinding(1, vbuf);
     }
 
-    if(mesh->HasVertexColors(0))
+    if (!imported.colours.empty())
     {
-        Ogre::HardwareVertexBufferSharedPtr vbufColor= Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+        decl->addElement(2, 0, Ogre::VET_COLOUR, Ogre::VES_DIFFUSE);
+
+        Ogre::HardwareVertexBufferSharedPtr vbufColor = bufferMgr.createVertexBuffer(
                 decl->getVertexSize(2), // This value is the size of a vertex in memory
                 data->vertexCount, // The number of vertices you'll put into this buffer
                 Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY, // Properties
                 false
                 );
-        Ogre::RGBA* pVertexColor = static_cast<Ogre::RGBA*>(vbufColor->lock(Ogre::HardwareBuffer::HBL_NORMAL));
+        Ogre::RGBA* pVertexColor = static_cast<Ogre::RGBA*>(vbufColor->lock(Ogre::HardwareBuffer::HBL_DISCARD));
 
-        for (unsigned int n=0; n<data->vertexCount; ++n)
+        // The packed colour format depends on the render system.
+        Ogre::RenderSystem* rs = Ogre::Root::getSingleton().getRenderSystem();
+        if (rs)
         {
-            for (int vn=0; vn<AI_MAX_NUMBER_OF_COLOR_SETS; ++vn)
-            {
-                if (mesh->mColors[vn])
-                {
-				    Ogre::RenderSystem* rs = Ogre::Root::getSingleton().getRenderSystem();
-                    if (rs)
-                        rs->convertColourValue(Ogre::ColourValue(mesh->mColors[vn][n].r, mesh->mColors[vn][n].g, mesh->mColors[vn][n].b, mesh->mColors[vn][n].a), &pVertexColor[n]);
-                }
-            }
+            const float *colour = &imported.colours[0];
+            for (unsigned int n=0; n<data->vertexCount; ++n, colour += 4)
+                rs->convertColourValue(Ogre::ColourValue(colour[0], colour[1], colour[2], colour[3]), &pVertexColor[n]);
         }
         vbufColor->unlock();
         data->vertexBufferBinding->setBinding(2, vbufColor);
         data->closeGapsInBindings();
     }
 
-    size_t numIndices = mesh->mNumFaces * 3;            // support only triangles, so 3 indices per face
-
-    Ogre::HardwareIndexBufferSharedPtr ibuf = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
+    Ogre::HardwareIndexBufferSharedPtr ibuf = bufferMgr.createIndexBuffer(
             Ogre::HardwareIndexBuffer::IT_16BIT, // You can use several different value types here
-            numIndices, // The number of indices you'll put in that buffer
+            imported.indices.size(), // The number of indices you'll put in that buffer
             Ogre::HardwareBuffer::HBU_DYNAMIC // Properties
             );
-
-    Ogre::uint16 *idxData = static_cast<Ogre::uint16*>(ibuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
-    offset = 0;
-    for (unsigned int n=0 ; n<mesh->mNumFaces ; ++n)
-    {
-        idxData[offset++] = mesh->mFaces[n].mIndices[0];
-        idxData[offset++] = mesh->mFaces[n].mIndices[1];
-        idxData[offset++] = mesh->mFaces[n].mIndices[2];
-    }
-
-    ibuf->unlock();
+    ibuf->writeData(0, ibuf->getSizeInBytes(), &imported.indices[0], true);
 
     submesh->indexData->indexBuffer = ibuf; // The pointer to the index buffer
-    submesh->indexData->indexCount = numIndices; // The number of indices we'll use
+    submesh->indexData->indexCount = imported.indices.size(); // The number of indices we'll use
     submesh->indexData->indexStart = 0;
-
-    // set bone weigths
-    if(mesh->HasBones())
-    {
-        for(Ogre::uint32 i=0; i < mesh->mNumBones; i++ )
-        {
-            aiBone *pAIBone = mesh->mBones[ i ];
-            if (NULL != pAIBone)
-            {
-                Ogre::String bname = pAIBone->mName.data;
-                for (Ogre::uint32 weightIdx = 0; weightIdx < pAIBone->mNumWeights; weightIdx++)
-                {
-                    aiVertexWeight aiWeight = pAIBone->mWeights[weightIdx];
-
-                    Ogre::VertexBoneAssignment vba;
-                    vba.vertexIndex = aiWeight.mVertexId;
-                    vba.boneIndex = mSkeleton->getBone(bname)->getHandle();
-                    vba.weight= aiWeight.mWeight;
-
-                    submesh->addBoneAssignment(vba);
-                }
-            }
-        }
-    } // if mesh has bones
-
-    return true;
-}
-
-void OpenAssetConverter::LoadDataFromNode(const aiScene* mScene,  const aiNode *pNode, const QString &meshFileDiskSource, const QString &meshFileName,Ogre::MeshPtr mesh)
-{
-    if(pNode->mNumMeshes > 0)
-    {
-        Ogre::AxisAlignedBox mAAB;
-
-        if(mMeshes.size() == 0)
-        {
-            mMeshes.push_back(mesh);
-        }
-        else
-        {
-            mesh = mMeshes[0];
-            mAAB = mesh->getBounds();
-        }
-
-        for (unsigned int idx=0; idx<pNode->mNumMeshes; ++idx )
-        {
-            aiMesh *pAIMesh = mScene->mMeshes[ pNode->mMeshes[ idx ] ];
-            //if pAIMesh->
-            Ogre::LogManager::getSingleton().logMessage("SubMesh " + Ogre::StringConverter::toString(idx) + " for mesh '" + Ogre::String(pNode->mName.data) + "'");
-
-            const aiMaterial *pAIMaterial = mScene->mMaterials[ pAIMesh->mMaterialIndex ];
-            Ogre::MaterialPtr matptr;
-
-            //generates material name
-            Ogre::String matName = Ogre::String(meshFileName.toStdString()+"_generatedMat" + Ogre::StringConverter::toString(pAIMesh->mMaterialIndex)+ ".material");
-            //checks if the material already exist, it might have been generated before to another submesh.
-            matptr = Ogre::MaterialManager::getSingleton().getByName(matName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-
-            if(matptr.isNull())
-            {
-                if(pAIMesh->HasVertexColors(0))
-                    matptr = CreateVertexColorMaterial();
-                else
-                   matptr = CreateMaterial(matName, pAIMaterial, meshFileDiskSource, meshFileName);
-
-                //we must create an OgreMaterialAsset through assetAPI and put the just created
-                //ogre material pointer to it
-                //GenerateTemporaryNonexistingAssetFilename() is used to prevent the "Asset Storage contains ambiguous assets in two different subdirectories!" warning 
-                QString matname = assetAPI->GenerateTemporaryNonexistingAssetFilename(QString::fromStdString(matptr->getName()));
-                AssetPtr assetPtr = assetAPI->CreateNewAsset("OgreMaterial", matname);
-                OgreMaterialAsset *mat = static_cast<OgreMaterialAsset *>(assetPtr.get());
-                mat->ogreMaterial = matptr;
-            }
-
-            Ogre::SubMesh* submesh = mesh->createSubMesh(pNode->mName.data + Ogre::StringConverter::toString(idx));
-            CreateVertexData(Ogre::StringConverter::toString(pNode->mName.data), pNode, pAIMesh, submesh, mAAB);
-            submesh->setMaterialName(matptr->getName());
-        }
-
-        // We must indicate the bounding box
-        mesh->_setBounds(mAAB);
-        mesh->_setBoundingSphereRadius((mAAB.getMaximum()- mAAB.getMinimum()).length()/2.0);
-    }
-
-    // Traverse all child nodes of the current node instance
-
-    for (unsigned int childIdx=0; childIdx<pNode->mNumChildren; childIdx++)
-    {
-        const aiNode *pChildNode = pNode->mChildren[ childIdx ];
-        LoadDataFromNode(mScene, pChildNode, meshFileDiskSource, meshFileName, mesh);
-    }
 }
 
 extern "C"
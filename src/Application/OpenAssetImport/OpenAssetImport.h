@@ -13,36 +13,17 @@ Licensed under the MIT license:
 #include "AssetFwd.h"
 
 #include "OgreMeshAsset.h"
+#include "MeshImportWorker.h"
 
 #include <OgreMesh.h>
-#include <OgreMeshSerializer.h>
-
-#include <assimp/vector3.h>
-#include <assimp/matrix4x4.h>
 
 #include <map>
 #include <QString>
 #include <QObject>
+#include <QPointer>
 
-struct aiNode;
-struct aiBone;
-struct aiMesh;
-struct aiMaterial;
-struct aiScene;
-struct aiAnimation;
+class OpenAssetConverter;
 
-struct boneNode
-{
-    aiNode* node;
-    aiNode* parent;
-    bool isNeeded;
-};
-
-typedef std::map<Ogre::String, const aiBone*> BoneMap;
-typedef std::map<Ogre::String, boneNode> BoneMapType;
-typedef std::map<Ogre::String, const aiNode*> BoneNodeMap;
-typedef std::map<Ogre::String, aiMatrix4x4> NodeTransformMap;
-typedef std::vector<Ogre::MeshPtr> MeshVector;
 typedef std::map<QString, Ogre::MaterialPtr> TextureMaterialPointerMap;
 typedef std::pair<QString, Ogre::MaterialPtr> TexMatPair;
 
@@ -55,11 +36,33 @@ public:
     virtual ~OpenAssetImport();
 
     void Initialize(); ///< IModule override
+    void Uninitialize(); ///< IModule override
+    void Update(f64 frametime); ///< IModule override
+
 private slots:
     void OnAssetCreated(AssetPtr asset);
     void OnConversionRequest(OgreMeshAsset *asset, const u8 *data, size_t len);
+
 private:
+    /// A mesh asset waiting for its import job.
+    struct PendingImport
+    {
+        PendingImport() : converter(0) {}
+
+        QPointer<OgreMeshAsset> asset;
+        Ogre::MeshPtr mesh; ///< The mesh of the asset when the import was requested. If it has changed, the asset was reloaded and the import is stale.
+        OpenAssetConverter *converter;
+    };
+
+    /// Stores a finished import to the asset cache and creates the Ogre mesh of its asset.
+    void CompleteImport(MeshImportWorker::Result &result);
+
     AssetAPI *assetAPI;
+    /// Imports the meshes off the main thread. Null if threaded asset loading is disabled with --noAsyncAssetLoad.
+    shared_ptr<MeshImportWorker> importWorker;
+    std::map<u32, PendingImport> pendingImports;
+    std::vector<MeshImportWorker::Result> finishedImports;
+    u32 nextImportId;
 };
 
 class OpenAssetConverter : public QObject
@@ -68,8 +71,9 @@ class OpenAssetConverter : public QObject
 public:
     OpenAssetConverter(Framework *fw);
     ~OpenAssetConverter();
-    /// Converts collada files to ogre meshes, also parses and generates ogre materials.
-    void Convert(const u8 *data_, size_t numBytes, const QString &fileName, const QString &diskSource, Ogre::MeshPtr mesh);
+    /// Creates the ogre mesh from a mesh converted by MeshImportWorker, also generates the ogre materials.
+    /** If @c imported is null the conversion has failed, and ConversionDone(false) is emitted. */
+    void Convert(const ImportedMesh *imported, const QString &fileName, const QString &diskSource, Ogre::MeshPtr mesh);
 
 signals:
     /// This signal is emitted when the ogre mesh is created and generated materials are ready.
@@ -85,44 +89,16 @@ private:
     /// Loads texture files from disk or requests them from http asset server.
     void LoadTextureFile(QString &filename);
     /// Creates vertex data to submeshes.
-    bool CreateVertexData(const Ogre::String& name, const aiNode* pNode, const aiMesh *mesh, Ogre::SubMesh* submesh, Ogre::AxisAlignedBox& mAAB);
+    void CreateVertexData(const ImportedSubMesh &imported, Ogre::SubMesh* submesh);
     /// Generates the ogre materials.
-    Ogre::MaterialPtr CreateMaterial(Ogre::String& matName, const aiMaterial* mat, const QString &meshFileDiskSource, const QString &meshFileName);
+    Ogre::MaterialPtr CreateMaterial(Ogre::String& matName, const ImportedMaterial &mat, const QString &meshFileDiskSource, const QString &meshFileName);
     Ogre::MaterialPtr CreateVertexColorMaterial();
-    Ogre::MaterialPtr CreateMaterialByScript(int index, const aiMaterial* mat);
-    void GrabNodeNamesFromNode(const aiScene* mScene,  const aiNode* pNode);
-    void GrabBoneNamesFromNode(const aiScene* mScene,  const aiNode* pNode);
-    void ComputeNodesDerivedTransform(const aiScene* mScene,  const aiNode *pNode, const aiMatrix4x4 accTransform);
-    void CreateBonesFromNode(const aiScene* mScene,  const aiNode* pNode);
-    void CreateBoneHiearchy(const aiScene* mScene,  const aiNode *pNode);
-    void LoadDataFromNode(const aiScene* mScene,  const aiNode *pNode, const QString &meshFileDiskSource, const QString &meshFileName,Ogre::MeshPtr mesh);
-    void MarkAllChildNodesAsNeeded(const aiNode *pNode);
-    void FlagNodeAsNeeded(const char* name);
-    bool IsNodeNeeded(const char* name);
-    void ParseAnimation (const aiScene* mScene, int index, aiAnimation* anim);
-
-    const aiScene *scene;
-    int mLoaderParams;
-    int texCount;
-    Ogre::String mMaterialCode;
-    Ogre::String mCustomAnimationName;
-    Ogre::SkeletonPtr mSkeleton;
-    static int msBoneCount;
-
-    Ogre::Real mTicksPerSecond;
-    Ogre::Real mAnimationSpeedModifier;
 
     AssetAPI *assetAPI;
     bool meshCreated;
     ///Map that holds the corresponding texture name and the ogre material pointer whre the texture belongs.
     TextureMaterialPointerMap texMatMap;
 
-    BoneMapType boneMap;
-    BoneNodeMap mBoneNodesByName;
-    BoneMap mBonesByName;
-    NodeTransformMap mNodeDerivedTransformByName;
-    MeshVector mMeshes;
-
 private slots:
     void OnTextureLoaded(IAssetTransfer* assetTransfer);
     void OnTextureLoadFailed(IAssetTransfer* assetTransfer, QString reason);
@@ -0,0 +1,92 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include <QAtomicInt>
+
+#include <vector>
+#include <cassert>
+
+namespace WebSocket
+{
+    /// Bounded lock-free multi-producer single-consumer queue.
+    /** The slots are allocated once, and values are copied in and out of them, so that pushing does not allocate
+        if copying T does not. Each slot has a sequence number which tells whether it is free for the producers or
+        ready for the consumer. Push may be called from any thread, TryPop only from the one consumer thread.
+        @note The positions are 32-bit and wrap around, which is fine as long as the capacity is well below 2^31. */
+    template<typename T>
+    class BoundedMpscQueue
+    {
+    public:
+        /// @param capacity Number of slots, must be a power of two.
+        explicit BoundedMpscQueue(int capacity) :
+            mask_(capacity - 1),
+            cells_(capacity),
+            enqueuePos_(0),
+            dequeuePos_(0)
+        {
+            assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+            for(int i = 0; i < capacity; ++i)
+                cells_[i].sequence = i;
+        }
+
+        int Capacity() const { return mask_ + 1; }
+
+        /// Pushes a value. Returns false if the queue is full.
+        bool TryPush(const T &value)
+        {
+            int pos = enqueuePos_;
+            Cell *cell;
+            for(;;)
+            {
+                cell = &cells_[pos & mask_];
+                int seq = cell->sequence.fetchAndAddAcquire(0);
+                int dif = (int)((unsigned)seq - (unsigned)pos);
+                if (dif == 0)
+                {
+                    // The slot is free, try to claim it.
+                    if (enqueuePos_.testAndSetRelaxed(pos, (int)((unsigned)pos + 1)))
+                        break;
+                    pos = enqueuePos_;
+                }
+                else if (dif < 0)
+                    return false; // The consumer has not yet freed the slot, so the queue is full.
+                else
+                    pos = enqueuePos_; // Another producer claimed the slot.
+            }
+            cell->value = value;
+            cell->sequence.fetchAndStoreRelease((int)((unsigned)pos + 1));
+            return true;
+        }
+
+        /// Pops the oldest value to @c value. Returns false if the queue is empty. Must only be called from the consumer thread.
+        bool TryPop(T &value)
+        {
+            Cell &cell = cells_[dequeuePos_ & mask_];
+            int seq = cell.sequence.fetchAndAddAcquire(0);
+            if ((int)((unsigned)seq - (dequeuePos_ + 1)) != 0)
+                return false; // Empty, or the producer has not yet finished writing the slot.
+            value = cell.value;
+            cell.value = T(); // Release the references held by the slot.
+            cell.sequence.fetchAndStoreRelease((int)(dequeuePos_ + mask_ + 1));
+            ++dequeuePos_;
+            return true;
+        }
+
+    private:
+        struct Cell
+        {
+            QAtomicInt sequence;
+            T value;
+        };
+
+        const int mask_;
+        std::vector<Cell> cells_;
+        QAtomicInt enqueuePos_;
+        unsigned dequeuePos_; ///< Only accessed by the consumer.
+
+        // Noncopyable
+        BoundedMpscQueue(const BoundedMpscQueue &);
+        void operator =(const BoundedMpscQueue &);
+    };
+}
@@ -23,7 +23,6 @@
 #include "IAssetStorage.h"
 #include "IAsset.h"
 
-#include <QMutexLocker>
 #include <QByteArray>
 #include <QStringList>
 #include <QVariant>
@@ -80,10 +79,16 @@ void ServerThread::run()
 
 // Server
 
+/// Number of events that can be queued from the websocket thread before it has to wait for the main thread.
+static const int cEventQueueCapacity = 8192;
+
 Server::Server(Framework *framework) :
     LC("[WebSocketServer]: "),
     framework_(framework),
     port_(2345),
+    events_(cEventQueueCapacity),
+    stopping_(0),
+    pushWaiting_(0),
     updatePeriod_(1.0f / 20.0f),
     updateAcc_(0.0)
 {
@@ -142,15 +147,28 @@ void Server::Update(float frametime)
         }
     }
     
-    QMutexLocker lockEvents(&mutexEvents_);
-    if (events_.size() == 0)
+    PROFILE(WebSocketServer_ProcessEvents);
+
+    // Take all the events pushed from the websocket thread so far. The queue is lock-free,
+    // so the websocket thread can keep pushing while we process.
+    batch_.clear();
+    SocketEvent queued;
+    while(events_.TryPop(queued))
+        batch_.push_back(queued);
+    if (batch_.empty())
         return;
+    WakeWaitingPush();
+
+    // Messages from connections that disconnect in this batch need not be processed.
+    std::vector<ConnectionPtr> disconnecting;
+    for(size_t i = 0; i < batch_.size(); ++i)
+        if (batch_[i].type == SocketEvent::Disconnected)
+            disconnecting.push_back(batch_[i].connection);
 
-    // Process events pushed from the websocket thread(s)
-    for (int i=0; i<events_.size(); ++i)
+    for(size_t i = 0; i < batch_.size(); ++i)
     {
-        SocketEvent *event = events_[i];
-        if (!event)
+        SocketEvent *event = &batch_[i];
+        if (event->type == SocketEvent::Data && std::find(disconnecting.begin(), disconnecting.end(), event->connection) != disconnecting.end())
             continue;
 
         // User connected
@@ -200,12 +218,13 @@ void Server::Update(float frametime)
             }
         }
         // Data message
-        else if (event->type == SocketEvent::Data && event->data.get())
+        else if (event->type == SocketEvent::Data && event->message)
         {
             WebSocket::UserConnection *userConnection = UserConnection(event->connection);
             if (userConnection)
             {
-                kNet::DataDeserializer dd(event->data->GetData(), event->data->BytesFilled());
+                const std::string &payload = event->message->get_payload();
+                kNet::DataDeserializer dd(payload.data(), payload.size());
                 u16 messageId = dd.Read<u16>();
 
                 // LoginMessage
@@ -342,15 +361,10 @@ void Server::Update(float frametime)
             }
             else
                 LogError(LC + "Received message from unauthorized connection, ignoring.");
-
-            event->data.reset();
         }
-        else
-            event->data.reset();
-        
-        SAFE_DELETE(event);
     }
-    events_.clear();
+    // Release the connections and messages.
+    batch_.clear();
 }
 
 void Server::OnUserDisconnected(WebSocket::UserConnection *userConnection)
@@ -497,6 +511,8 @@ void Server::Stop()
     {
         if (server_)
         {
+            stopping_.fetchAndStoreRelease(1);
+            WakeWaitingPush();
             server_->stop();
             thread_.wait();
             emit ServerStopped();
@@ -519,78 +535,49 @@ void Server::Reset()
         SAFE_DELETE(connection);
     connections_.clear();
 
+    // Drop the events that were not processed.
+    SocketEvent event;
+    while(events_.TryPop(event)) {}
+    batch_.clear();
+
     server_.reset();
+    stopping_.fetchAndStoreRelease(0);
 }
 
-void Server::OnConnected(ConnectionHandle connection)
+void Server::PushEvent(const SocketEvent &event)
 {
-    QMutexLocker lock(&mutexEvents_);
+    // Apply backpressure to the websocket thread rather than dropping events, which would break the protocol.
+    if (events_.TryPush(event))
+        return;
 
-    ConnectionPtr connectionPtr = server_->get_con_from_hdl(connection);
+    QMutexLocker lock(&eventsTakenMutex_);
+    pushWaiting_.fetchAndAddOrdered(1);
+    // Retry after announcing the wait, so that room made before the main thread saw the announcement is not missed.
+    while(!events_.TryPush(event) && !stopping_.fetchAndAddAcquire(0))
+        eventsTaken_.wait(&eventsTakenMutex_);
+    pushWaiting_.fetchAndAddOrdered(-1);
+}
 
-    // Find existing events and remove them if we got duplicates 
-    // that were not synced to main thread yet.
-    QList<SocketEvent*> removeItems;
-    for (int i=0; i<events_.size(); ++i)
-    {
-        // Remove any and all messages from this connection, 
-        // if there are any data messages for this connection.
-        // Which is not possible in theory.
-        SocketEvent *existing = events_[i];
-        if (existing->connection == connectionPtr)
-            removeItems << existing;
-    }
-    if (!removeItems.isEmpty())
-    {
-        foreach(SocketEvent *existing, removeItems)
-        {
-            events_.removeAll(existing);
-            SAFE_DELETE(existing);
-        }
-        removeItems.clear();
-    }
+void Server::WakeWaitingPush()
+{
+    if (!pushWaiting_.fetchAndAddOrdered(0))
+        return;
+    QMutexLocker lock(&eventsTakenMutex_);
+    eventsTaken_.wakeAll();
+}
 
-    events_ << new SocketEvent(connectionPtr, SocketEvent::Connected);
-        
-    mutexEvents_.unlock();
+void Server::OnConnected(ConnectionHandle connection)
+{
+    PushEvent(SocketEvent(server_->get_con_from_hdl(connection), SocketEvent::Connected));
 }
 
 void Server::OnDisconnected(ConnectionHandle connection)
 {
-    QMutexLocker lock(&mutexEvents_);
-
-    ConnectionPtr connectionPtr = server_->get_con_from_hdl(connection);
-
-    // Find existing events and remove them if we got duplicates 
-    // that were not synced to main thread yet.
-    QList<SocketEvent*> removeItems;
-    for (int i=0; i<events_.size(); ++i)
-    {
-        // Remove any and all messages from this connection, 
-        // no need to process he is disconnecting
-        SocketEvent *existing = events_[i];
-        if (existing->connection == connectionPtr)
-            removeItems << existing;
-    }
-    if (!removeItems.isEmpty())
-    {
-        foreach(SocketEvent *existing, removeItems)
-        {
-            events_.removeAll(existing);
-            SAFE_DELETE(existing);
-        }
-        removeItems.clear();
-    }
-
-    events_ << new SocketEvent(connectionPtr, SocketEvent::Disconnected);
+    PushEvent(SocketEvent(server_->get_con_from_hdl(connection), SocketEvent::Disconnected));
 }
 
 void Server::OnMessage(ConnectionHandle connection, MessagePtr data)
 {   
-    QMutexLocker lock(&mutexEvents_);
-
-    ConnectionPtr connectionPtr = server_->get_con_from_hdl(connection);
-
     if (data->get_opcode() == websocketpp::frame::opcode::TEXT)
     {
         QByteArray buffer = QString::fromStdString(data->get_payload()).toUtf8();
@@ -598,17 +585,15 @@ void Server::OnMessage(ConnectionHandle connection, MessagePtr data)
     }
     else if (data->get_opcode() == websocketpp::frame::opcode::BINARY)
     {
-        const std::string &payload = data->get_payload();
-        if (payload.size() == 0)
+        if (data->get_payload().size() == 0)
         {
             LogError("[WebSocketServer]: Received 0 sized payload, ignoring");
             return;
         }
-        SocketEvent *event = new SocketEvent(connectionPtr, SocketEvent::Data);
-        event->data = DataSerializerPtr(new kNet::DataSerializer(payload.size()));
-        event->data->AddAlignedByteArray(&payload[0], payload.size());
-
-        events_ << event;
+        // Hand the message over to the main thread as is, instead of copying the payload.
+        SocketEvent event(server_->get_con_from_hdl(connection), SocketEvent::Data);
+        event.message = data;
+        PushEvent(event);
     }
 }
 
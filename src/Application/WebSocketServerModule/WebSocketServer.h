@@ -13,6 +13,7 @@
 #include "SyncState.h"
 #include "MsgEntityAction.h"
 #include "EntityAction.h"
+#include "WebSocketEventQueue.h"
 
 #include <QObject>
 #include <QThread>
@@ -20,7 +21,9 @@
 #include <QStringList>
 #include <QFileInfo>
 #include <QDateTime>
+#include <QAtomicInt>
 #include <QMutex>
+#include <QWaitCondition>
 
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
@@ -48,7 +51,7 @@ namespace WebSocket
         };
 
         WebSocket::ConnectionPtr connection;
-        DataSerializerPtr data;
+        WebSocket::MessagePtr message; ///< Received message for Data events. The payload is read in place, without copying.
         EventType type;
 
         SocketEvent() : type(None) {}
@@ -136,6 +139,12 @@ namespace WebSocket
         /// @note Does not lock the requestedConnections mutex
         uint NextFreeConnectionId() const;
 
+        /// Queues an event from the websocket thread to the main thread.
+        /** If the queue is full, waits for the main thread to make room, unless the server is stopping. */
+        void PushEvent(const SocketEvent &event);
+        /// Wakes up PushEvent if it is waiting for room in the event queue.
+        void WakeWaitingPush();
+
         QString LC;
         ushort port_;
         
@@ -147,8 +156,17 @@ namespace WebSocket
 
         ServerThread thread_;
 
-        QMutex mutexEvents_;
-        QList<SocketEvent*> events_;
+        /// Events from the websocket thread, consumed by the main thread in Update.
+        BoundedMpscQueue<SocketEvent> events_;
+        /// Events taken from the queue for processing, reused between updates.
+        std::vector<SocketEvent> batch_;
+        /// Set while the server is being stopped, so that the websocket thread does not wait for room in the event queue.
+        QAtomicInt stopping_;
+        /// Number of PushEvent calls waiting for room in the event queue.
+        QAtomicInt pushWaiting_;
+        /// Woken by the main thread when it has taken events from the queue while a push is waiting, or when stopping.
+        QWaitCondition eventsTaken_;
+        QMutex eventsTakenMutex_;
 
         /// Time period for update, default 20 time a sec
         float updatePeriod_;
@@ -21,7 +21,7 @@
 #include "LoggingFunctions.h"
 #include "Profiler.h"
 #include "EC_Placeable.h"
-//#include "EC_RigidBody.h" // needed when cRigidBodyUpdateMessage is implemented
+#include "EC_RigidBody.h"
 #include "SceneAPI.h"
 
 #include <kNet.h>
@@ -43,7 +43,7 @@ void SyncManager::QueueMessage(UserConnection* connection, kNet::message_id_t id
     data.Add<u16>(static_cast<u16>(id));
     data.AddAlignedByteArray(ds.GetData(), ds.BytesFilled());
     
-    connection->Send(data);
+    connection->Queue(data);
 }
 
 void SyncManager::WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPtr comp)
@@ -138,6 +138,8 @@ void SyncManager::RegisterToScene(ScenePtr scene)
     
     connect(sceneptr, SIGNAL( AttributeChanged(IComponent*, IAttribute*, AttributeChange::Type) ),
         SLOT( OnAttributeChanged(IComponent*, IAttribute*, AttributeChange::Type) ));
+    connect(sceneptr, SIGNAL( AttributeChangesDispatched(const DeferredAttributeChangeList &) ),
+        SLOT( OnAttributeChangesDispatched(const DeferredAttributeChangeList &) ));
     connect(sceneptr, SIGNAL( AttributeAdded(IComponent*, IAttribute*, AttributeChange::Type) ),
         SLOT( OnAttributeAdded(IComponent*, IAttribute*, AttributeChange::Type) ));
     connect(sceneptr, SIGNAL( AttributeRemoved(IComponent*, IAttribute*, AttributeChange::Type) ),
@@ -246,7 +248,27 @@ void SyncManager::OnAttributeChanged(IComponent* comp, IAttribute* attr, Attribu
         return;
     if (!owner_->IsServer())
         return;
+    // The deferred changes were already handled in OnAttributeChangesDispatched.
+    Scene *scene = comp->ParentScene();
+    if (scene && scene->IsDispatchingAttributeChanges())
+        return;
+
+    MarkAttributeDirty(owner_->GetServer()->UserConnections(), comp, attr, change);
+}
 
+void SyncManager::OnAttributeChangesDispatched(const DeferredAttributeChangeList &changes)
+{
+    if (!owner_->IsServer())
+        return;
+
+    PROFILE(WebSocketSyncManager_OnAttributeChangesDispatched);
+    UserConnectionList &users = owner_->GetServer()->UserConnections();
+    for(size_t i = 0; i < changes.size(); ++i)
+        MarkAttributeDirty(users, changes[i].component, changes[i].attribute, changes[i].change);
+}
+
+void SyncManager::MarkAttributeDirty(UserConnectionList &users, IComponent* comp, IAttribute* attr, AttributeChange::Type change)
+{
     // Is this change even supposed to go to the network?
     if (change != AttributeChange::Replicate || comp->IsLocal())
         return;
@@ -257,7 +279,6 @@ void SyncManager::OnAttributeChanged(IComponent* comp, IAttribute* attr, Attribu
     
     // For each client connected to this server, mark this attribute dirty, so it will be updated to the
     // clients on the next network sync iteration.
-    UserConnectionList &users = owner_->GetServer()->UserConnections();
     for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
         if ((*i)->syncState)
             (*i)->syncState->MarkAttributeDirty(entity->Id(), comp->Id(), attr->Index());
@@ -469,18 +490,25 @@ void SyncManager::Update(f64 frametime)
     for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
     {
         if (!(*i)->syncState)
+        {
+            // Messages may have been queued to a user that has no scene sync state.
+            (*i)->Flush();
             continue;
+        }
         
-        // First send out all changes to rigid bodies.
+        // First send out all changes to rigid bodies, if the client can read them.
         // After processing this function, the bits related to rigid body states have been cleared,
         // so the generic sync will not double-replicate the rigid body positions and velocities.
-        //ReplicateRigidBodyChanges((*i), (*i)->syncState.get());
+        if ((*i)->properties.value("client-rigid-body-updates", false).toBool())
+            ReplicateRigidBodyChanges((*i), (*i)->syncState.get());
 
         ProcessSyncState((*i), (*i)->syncState.get());
+
+        // Send all the messages of this tick to the client in one frame.
+        (*i)->Flush();
     }
 }
 
-/*
 void SyncManager::ReplicateRigidBodyChanges(UserConnection* destination, SceneSyncState* state)
 {
     PROFILE(WebSocketSyncManager_ReplicateRigidBodyChanges);
@@ -489,24 +517,19 @@ void SyncManager::ReplicateRigidBodyChanges(UserConnection* destination, SceneSy
     if (!scene)
         return;
 
-    const int maxMessageSizeBytes = 1400;
-    kNet::NetworkMessage *msg = destination->StartNewMessage(cRigidBodyUpdateMessage, maxMessageSizeBytes);
-    msg->contentID = 0;
-    msg->inOrder = true;
-    msg->reliable = false;
-    kNet::DataSerializer ds(msg->data, maxMessageSizeBytes);
+    const int maxMessageSizeBytes = sizeof(rigidBodyBuffer_);
+    kNet::DataSerializer ds(rigidBodyBuffer_, maxMessageSizeBytes);
 
-    for(std::list<EntitySyncState*>::iterator iter = state->dirtyQueue.begin(); iter != state->dirtyQueue.end(); ++iter)
+    for(EntitySyncState *iter = state->dirtyQueue.Front(); iter; iter = iter->nextDirty)
     {
         const int maxRigidBodyMessageSizeBits = 350; // An update for a single rigid body can take at most this many bits. (conservative bound)
         // If we filled up this message, send it out and start crafting anothero one.
         if (maxMessageSizeBytes * 8 - (int)ds.BitsFilled() <= maxRigidBodyMessageSizeBits)
         {
-            destination->EndAndQueueMessage(msg, ds.BytesFilled());
-            msg = destination->StartNewMessage(cRigidBodyUpdateMessage, maxMessageSizeBytes);
-            ds = kNet::DataSerializer(msg->data, maxMessageSizeBytes);
+            QueueMessage(destination, cRigidBodyUpdateMessage, false, true, ds);
+            ds = kNet::DataSerializer(rigidBodyBuffer_, maxMessageSizeBytes);
         }
-        EntitySyncState &ess = **iter;
+        EntitySyncState &ess = *iter;
 
         if (ess.isNew || ess.removed)
             continue; // Newly created and removed entities are handled through the traditional sync mechanism.
@@ -516,12 +539,12 @@ void SyncManager::ReplicateRigidBodyChanges(UserConnection* destination, SceneSy
         if (!placeable.get())
             continue;
 
-        std::map<component_id_t, ComponentSyncState>::iterator placeableComp = ess.components.find(placeable->Id());
+        ComponentSyncState *placeableComp = ess.components.Find(placeable->Id());
 
         bool transformDirty = false;
-        if (placeableComp != ess.components.end())
+        if (placeableComp)
         {
-            ComponentSyncState &pss = placeableComp->second;
+            ComponentSyncState &pss = *placeableComp;
             if (!pss.isNew && !pss.removed) // Newly created and deleted components are handled through the traditional sync mechanism.
             {
                 transformDirty = (pss.dirtyAttributes[0] & 1) != 0; // The Transform of an EC_Placeable is the first attibute in the component.
@@ -534,10 +557,10 @@ void SyncManager::ReplicateRigidBodyChanges(UserConnection* destination, SceneSy
         shared_ptr<EC_RigidBody> rigidBody = e->GetComponent<EC_RigidBody>();
         if (rigidBody)
         {
-            std::map<component_id_t, ComponentSyncState>::iterator rigidBodyComp = ess.components.find(rigidBody->Id());
-            if (rigidBodyComp != ess.components.end())
+            ComponentSyncState *rigidBodyComp = ess.components.Find(rigidBody->Id());
+            if (rigidBodyComp)
             {
-                ComponentSyncState &rss = rigidBodyComp->second;
+                ComponentSyncState &rss = *rigidBodyComp;
                 if (!rss.isNew && !rss.removed) // Newly created and deleted components are handled through the traditional sync mechanism.
                 {
                     velocityDirty = (rss.dirtyAttributes[1] & (1 << 5)) != 0;
@@ -549,18 +572,12 @@ void SyncManager::ReplicateRigidBodyChanges(UserConnection* destination, SceneSy
                     velocityDirty = velocityDirty && (rigidBody->linearVelocity.Get().DistanceSq(ess.linearVelocity) >= 1e-2f);
                     angularVelocityDirty = angularVelocityDirty && (rigidBody->angularVelocity.Get().DistanceSq(ess.angularVelocity) >= 1e-1f);
 
-                    // If the object enters rest, force an update, and force the update to be sent as reliable, so that the client
-                    // is guaranteed to receive the message, and will put the object to rest, instead of extrapolating it away indefinitely.
+                    // If the object enters rest, force an update, so that the client will put the object to rest,
+                    // instead of extrapolating it away indefinitely. WebSocket messages are always reliable.
                     if (rigidBody->linearVelocity.Get().IsZero(1e-4f) && !ess.linearVelocity.IsZero(1e-4f))
-                    {
                         velocityDirty = true;
-                        msg->reliable = true;
-                    }
                     if (rigidBody->angularVelocity.Get().IsZero(1e-4f) && !ess.angularVelocity.IsZero(1e-4f))
-                    {
                         angularVelocityDirty = true;
-                        msg->reliable = true;
-                    }
                 }
             }
         }
@@ -728,11 +745,8 @@ void SyncManager::ReplicateRigidBodyChanges(UserConnection* destination, SceneSy
         ess.lastNetworkSendTime = kNet::Clock::Tick();
     }
     if (ds.BytesFilled() > 0)
-        destination->EndAndQueueMessage(msg, ds.BytesFilled());
-    else
-        destination->FreeMessage(msg);
+        QueueMessage(destination, cRigidBodyUpdateMessage, false, true, ds);
 }
-*/
 
 void SyncManager::ProcessSyncState(UserConnection* destination, SceneSyncState* state)
 {
@@ -747,10 +761,10 @@ void SyncManager::ProcessSyncState(UserConnection* destination, SceneSyncState*
     
     // Process the state's dirty entity queue.
     /// \todo Limit and prioritize the data sent. For now the whole queue is processed, regardless of whether the connection is being saturated.
-    while (!state->dirtyQueue.empty())
+    while (!state->dirtyQueue.Empty())
     {
-        EntitySyncState& entityState = *state->dirtyQueue.front();
-        state->dirtyQueue.pop_front();
+        EntitySyncState& entityState = *state->dirtyQueue.Front();
+        state->dirtyQueue.PopFront();
         entityState.isInQueue = false;
         
         EntityPtr entity = scene->GetEntity(entityState.id);
@@ -779,7 +793,7 @@ void SyncManager::ProcessSyncState(UserConnection* destination, SceneSyncState*
                 // The delete has been processed. Do not remember it anymore, but requeue the state for creation
                 entityState.removed = false;
                 removeState = false;
-                state->dirtyQueue.push_back(&entityState);
+                state->dirtyQueue.PushBack(&entityState);
                 entityState.isInQueue = true;
             }
             else
@@ -838,10 +852,12 @@ void SyncManager::ProcessSyncState(UserConnection* destination, SceneSyncState*
             kNet::DataSerializer createAttrsDs(createAttrsBuffer_, 16 * 1024);
             kNet::DataSerializer editAttrsDs(editAttrsBuffer_, 64 * 1024);
             
-            while (!entityState.dirtyQueue.empty())
+            removedComponents_.clear();
+            for (size_t compIndex = 0; compIndex < entityState.components.Size(); ++compIndex)
             {
-                ComponentSyncState& compState = *entityState.dirtyQueue.front();
-                entityState.dirtyQueue.pop_front();
+                ComponentSyncState& compState = entityState.components.At(compIndex);
+                if (!compState.isInQueue)
+                    continue;
                 compState.isInQueue = false;
                 
                 ComponentPtr comp = entity->GetComponentById(compState.id);
@@ -893,13 +909,18 @@ void SyncManager::ProcessSyncState(UserConnection* destination, SceneSyncState*
                 {
                     const AttributeVector& attrs = comp->Attributes();
                     
-                    for (std::map<u8, bool>::iterator i = compState.newAndRemovedAttributes.begin(); i != compState.newAndRemovedAttributes.end(); ++i)
+                    const bool hasCreatedOrRemovedAttributes = compState.HasCreatedOrRemovedAttributes();
+                    for (unsigned i = 0; hasCreatedOrRemovedAttributes && i < 256; ++i)
                     {
-                        u8 attrIndex = i->first;
+                        u8 attrIndex = (u8)i;
+                        if (!compState.IsAttributeCreated(attrIndex) && !compState.IsAttributeRemoved(attrIndex))
+                            continue;
+                        const bool created = compState.IsAttributeCreated(attrIndex);
+                        compState.ClearAttributeCreatedOrRemoved(attrIndex);
                         // Clear the corresponding dirty flags, so that we don't redundantly send attribute edited data.
                         compState.dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
                         
-                        if (i->second)
+                        if (created)
                         {
                             // Create attribute. Make sure it exists and is dynamic.
                             if (attrIndex >= attrs.size() || !attrs[attrIndex])
@@ -936,7 +957,6 @@ void SyncManager::ProcessSyncState(UserConnection* destination, SceneSyncState*
                             removeAttrsDs.Add<u8>(attrIndex);
                         }
                     }
-                    compState.newAndRemovedAttributes.clear();
                     
                     // Now, if remaining dirty bits exist, they must be sent in the edit attributes message. These are the majority of our network data.
                     changedAttributes_.clear();
@@ -1040,8 +1060,11 @@ void SyncManager::ProcessSyncState(UserConnection* destination, SceneSyncState*
                 }
                 
                 if (removeCompState)
-                    entityState.components.erase(compState.id);
+                    removedComponents_.push_back(compState.id);
             }
+            // Erase the removed component states only now, as erasing moves the other states
+            for (size_t i = 0; i < removedComponents_.size(); ++i)
+                entityState.components.Erase(removedComponents_[i]);
             
             // Send the messages which have data
             if (removeCompsDs.BytesFilled())
@@ -1075,7 +1098,7 @@ void SyncManager::ProcessSyncState(UserConnection* destination, SceneSyncState*
         }
         
         if (removeState)
-            state->entities.erase(entityState.id);
+            state->entities.Erase(entityState.id);
     }
     //if (numMessagesSent)
     //    std::cout << "Sent " << numMessagesSent << " scenesync messages" << std::endl;
@@ -1234,6 +1257,8 @@ void SyncManager::HandleCreateEntity(UserConnection* source, const char* data, s
         replyDs.AddVLE<kNet::VLE8_16_32>(componentIdRewrites[i].second & UniqueIdGenerator::LAST_REPLICATED_ID);
     }
     QueueMessage(source, cCreateEntityReplyMessage, true, true, replyDs);
+    // The reply is handled outside the sync tick, so send it now rather than with the next tick's bundle.
+    source->Flush();
     
     // Mark the entity processed (undirty) in the sender's syncstate so that create is not echoed back
     state->MarkEntityProcessed(entityID);
@@ -1356,6 +1381,8 @@ void SyncManager::HandleCreateComponents(UserConnection* source, const char* dat
         replyDs.AddVLE<kNet::VLE8_16_32>(componentIdRewrites[i].second & UniqueIdGenerator::LAST_REPLICATED_ID);
     }
     QueueMessage(source, cCreateComponentsReplyMessage, true, true, replyDs);
+    // The reply is handled outside the sync tick, so send it now rather than with the next tick's bundle.
+    source->Flush();
     
     // Emit the component changes last, to signal only a coherent state of the whole entity
     for (unsigned i = 0; i < addedComponents.size(); ++i)
@@ -1406,7 +1433,7 @@ void SyncManager::HandleRemoveEntity(UserConnection* source, const char* data, s
     
     // Delete from the sender's syncstate so that we don't echo the delete back needlessly
     state->RemoveFromQueue(entityID); // Be sure to erase from dirty queue so that we don't invoke UDB
-    state->entities.erase(entityID);
+    state->entities.Erase(entityID);
 }
 
 void SyncManager::HandleRemoveComponents(UserConnection* source, const char* data, size_t numBytes)
@@ -1460,11 +1487,9 @@ void SyncManager::HandleRemoveComponents(UserConnection* source, const char* dat
         }
         entity->RemoveComponent(comp, change);
         // Delete from the sender's syncstate, so that we don't echo the delete back needlessly
-        if (state->entities.find(entityID) != state->entities.end())
-        {
-            state->entities[entityID].RemoveFromQueue(compID); // Be sure to erase from dirty queue so that we don't invoke UDB
-            state->entities[entityID].components.erase(compID);
-        }
+        EntitySyncState *entityState = state->entities.Find(entityID);
+        if (entityState)
+            entityState->components.Erase(compID); // Also erases from the dirty queue so that we don't invoke UDB
     }
 }
 
@@ -1548,10 +1573,12 @@ void SyncManager::HandleCreateAttributes(UserConnection* source, const char* dat
         }
         
         // Remove the corresponding add command from the sender's syncstate, so that the attribute add is not echoed back
-        state->entities[entityID].components[compID].newAndRemovedAttributes.erase(attrIndex);
+        state->entities[entityID].components[compID].ClearAttributeCreatedOrRemoved(attrIndex);
     }
     
-    // Signal attribute changes after creating and reading all
+    // Signal attribute changes after creating and reading all. Signal them immediately even if the scene defers
+    // the attribute changes, so that the dirty bits set by them can be removed. The other changes of the frame stay deferred.
+    scene->SuspendAttributeChangeDeferral();
     for (unsigned i = 0; i < addedAttrs.size(); ++i)
     {
         IComponent* owner = addedAttrs[i]->Owner();
@@ -1560,6 +1587,7 @@ void SyncManager::HandleCreateAttributes(UserConnection* source, const char* dat
         // Remove the dirty bit from sender's syncstate so that we do not echo the change back
         state->entities[entityID].components[owner->Id()].dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
     }
+    scene->ResumeAttributeChangeDeferral();
 }
 
 void SyncManager::HandleRemoveAttributes(UserConnection* source, const char* data, size_t numBytes)
@@ -1616,7 +1644,7 @@ void SyncManager::HandleRemoveAttributes(UserConnection* source, const char* dat
         
         comp->RemoveAttribute(attrIndex, change);
         // Remove the corresponding remove command from the sender's syncstate, so that the attribute remove is not echoed back
-        state->entities[entityID].components[compID].newAndRemovedAttributes.erase(attrIndex);
+        state->entities[entityID].components[compID].ClearAttributeCreatedOrRemoved(attrIndex);
     }
 }
 
@@ -1661,12 +1689,12 @@ void SyncManager::HandleEditAttributes(UserConnection* source, const char* data,
         
     // Record the update time for calculating the update interval
     float updateInterval = updatePeriod_; // Default update interval if state not found or interval not measured yet
-    std::map<entity_id_t, EntitySyncState>::iterator it = state->entities.find(entityID);
-    if (it != state->entities.end())
+    EntitySyncState *entityState = state->entities.Find(entityID);
+    if (entityState)
     {
-        it->second.UpdateReceived();
-        if (it->second.avgUpdateInterval > 0.0f)
-            updateInterval = it->second.avgUpdateInterval;
+        entityState->UpdateReceived();
+        if (entityState->avgUpdateInterval > 0.0f)
+            updateInterval = entityState->avgUpdateInterval;
     }
     // Add a fudge factor in case there is jitter in packet receipt or the server is too taxed
     updateInterval *= 1.25f;
@@ -1733,7 +1761,9 @@ void SyncManager::HandleEditAttributes(UserConnection* source, const char* data,
         }
     }
     
-    // Signal attribute changes after reading all
+    // Signal attribute changes after reading all. Signal them immediately even if the scene defers
+    // the attribute changes, so that the dirty bits set by them can be removed. The other changes of the frame stay deferred.
+    scene->SuspendAttributeChangeDeferral();
     for (unsigned i = 0; i < changedAttrs.size(); ++i)
     {
         IComponent* owner = changedAttrs[i]->Owner();
@@ -1742,6 +1772,7 @@ void SyncManager::HandleEditAttributes(UserConnection* source, const char* data,
         // Remove the dirty bit from sender's syncstate so that we do not echo the change back
         state->entities[entityID].components[owner->Id()].dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
     }
+    scene->ResumeAttributeChangeDeferral();
 }
 
 void SyncManager::HandleEntityAction(UserConnection* source, MsgEntityAction& msg)
@@ -69,6 +69,9 @@ private slots:
     /// Trigger EC sync because of component attributes changing
     void OnAttributeChanged(IComponent* comp, IAttribute* attr, AttributeChange::Type change);
 
+    /// Trigger EC sync because of the deferred attribute changes of a frame being dispatched
+    void OnAttributeChangesDispatched(const DeferredAttributeChangeList &changes);
+
     /// Trigger EC sync because of component attribute added
     void OnAttributeAdded(IComponent* comp, IAttribute* attr, AttributeChange::Type change);
 
@@ -103,6 +106,9 @@ private:
     /// Craft a component full update, with all static and dynamic attributes.
     void WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPtr comp);
     
+    /// Marks a changed attribute dirty in the sync states of the users, if the change is replicated.
+    void MarkAttributeDirty(UserConnectionList &users, IComponent* comp, IAttribute* attr, AttributeChange::Type change);
+
     /// Handle entity action message.
     void HandleEntityAction(UserConnection* source, MsgEntityAction& msg);
     /// Handle create entity message.
@@ -120,8 +126,9 @@ private:
     /// Handle remove entities message.
     void HandleRemoveEntity(UserConnection* source, const char* data, size_t numBytes);
 
-    // @todo Implement for websocket
-    //void ReplicateRigidBodyChanges(UserConnection* destination, SceneSyncState* state);
+    /// Sends the changed transforms and velocities of the entities in the quantized format of cRigidBodyUpdateMessage.
+    /** Used for the clients that set the "client-rigid-body-updates" login property. */
+    void ReplicateRigidBodyChanges(UserConnection* destination, SceneSyncState* state);
 
     /// Process one sync state for changes in the scene
     /** \todo For now, sends all changed entities/components. In the future, this shall be subject to interest management
@@ -165,7 +172,9 @@ private:
     char removeCompsBuffer_[1024];
     char removeEntityBuffer_[1024];
     char removeAttrsBuffer_[1024];
+    char rigidBodyBuffer_[1400];
     std::vector<u8> changedAttributes_;
+    std::vector<component_id_t> removedComponents_;
 };
 
 }
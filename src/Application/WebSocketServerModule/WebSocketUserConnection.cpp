@@ -1,6 +1,7 @@
 
 #include "WebSocketUserConnection.h"
 #include "LoggingFunctions.h"
+#include "TundraMessages.h"
 
 #include "kNet/DataDeserializer.h"
 #include "kNet/DataSerializer.h"
@@ -8,10 +9,16 @@
 #include <websocketpp/frame.hpp>
 
 #include <QTimer>
+#include <QByteArray>
 
 namespace WebSocket
 {
 
+/// Size of the queued messages in bytes after which the bundle is sent without waiting for Flush().
+static const size_t cMaxBundleSize = 256 * 1024;
+/// Size of the queued messages in bytes below which the bundle is not worth compressing.
+static const size_t cMinDeflateSize = 128;
+
 UserConnection::UserConnection(uint connectionId_, ConnectionPtr connection_) :
     connectionId(connectionId_)
 {
@@ -40,10 +47,59 @@ void UserConnection::Send(const kNet::DataSerializer &data)
         return;
     if (data.BytesFilled() == 0)
         return;
+
+    // Keep the order of the messages. Flush() empties the bundle before sending it, so this does not recurse further.
+    Flush();
     
     connection.lock()->send(static_cast<void*>(data.GetData()), static_cast<uint64_t>(data.BytesFilled()));
 }
 
+void UserConnection::Queue(const kNet::DataSerializer &data)
+{
+    if (!properties.value("client-message-bundles", false).toBool())
+    {
+        Send(data);
+        return;
+    }
+    if (connection.expired() || data.BytesFilled() == 0)
+        return;
+
+    const u32 size = (u32)data.BytesFilled();
+    const char sizeBytes[4] = { (char)(size & 0xFF), (char)((size >> 8) & 0xFF), (char)((size >> 16) & 0xFF), (char)((size >> 24) & 0xFF) };
+    bundle_.insert(bundle_.end(), sizeBytes, sizeBytes + 4);
+    bundle_.insert(bundle_.end(), data.GetData(), data.GetData() + size);
+    if (bundle_.size() >= cMaxBundleSize)
+        Flush();
+}
+
+void UserConnection::Flush()
+{
+    if (bundle_.empty())
+        return;
+
+    u8 flags = 0;
+    const char *body = &bundle_[0];
+    size_t bodySize = bundle_.size();
+    QByteArray compressed;
+    if (bundle_.size() >= cMinDeflateSize && properties.value("client-message-deflate", false).toBool())
+    {
+        compressed = qCompress((const uchar*)&bundle_[0], (int)bundle_.size());
+        if ((size_t)compressed.size() < bundle_.size())
+        {
+            flags |= 1;
+            body = compressed.constData();
+            bodySize = compressed.size();
+        }
+    }
+
+    kNet::DataSerializer frame(bodySize + 3);
+    frame.Add<u16>(static_cast<u16>(cMessageBundle));
+    frame.Add<u8>(flags);
+    frame.AddAlignedByteArray(body, (u32)bodySize);
+    bundle_.clear();
+    Send(frame);
+}
+
 void UserConnection::Exec(Entity *entity, const QString &action, const QStringList &params)
 {
     if (entity)
@@ -16,6 +16,8 @@
 #include <QString>
 #include <QVariant>
 
+#include <vector>
+
 namespace WebSocket
 {
     class WEBSOCKET_SERVER_MODULE_API UserConnection : public QObject, public enable_shared_from_this<UserConnection>
@@ -32,8 +34,21 @@ namespace WebSocket
         uint ConnectionId();
         ConnectionPtr Connection() const;
 
+        /// Sends a message immediately. Messages queued with Queue() are flushed first, so that they are not overtaken.
         void Send(const kNet::DataSerializer &data);
 
+        /// Sends a message, or adds it to the bundle sent with Flush() if the client accepts message bundles.
+        /** The client accepts bundles if it sets the "client-message-bundles" login property to true. A bundle is one binary
+            frame with the u16 message ID cMessageBundle and a u8 flags byte, followed by the bundled messages, each as a u32
+            byte count and the message as it would have been sent with Send(). If the client also sets "client-message-deflate",
+            the bundled messages are compressed when that makes them smaller, which is flagged with bit 0 of the flags byte.
+            The compressed data is zlib data prefixed with the big-endian u32 size of the uncompressed data (qCompress).
+            @param data Message ID and data, as given to Send(). */
+        void Queue(const kNet::DataSerializer &data);
+
+        /// Sends the messages queued with Queue() as one frame.
+        void Flush();
+
         uint connectionId;
 
         ConnectionWeakPtr connection;
@@ -57,5 +72,9 @@ namespace WebSocket
     signals:
         /// Emitted when action has been triggered for this specific user connection.
         void ActionTriggered(WebSocket::UserConnection* connection, Entity* entity, const QString& action, const QStringList& params);
+
+    private:
+        /// Messages queued for the next bundle, each prefixed with its size.
+        std::vector<char> bundle_;
     };
 }
@@ -10,6 +10,7 @@
 #include "Profiler.h"
 #include "CoreException.h"
 #include "AssetAPI.h"
+#include "AssetDependencyGraph.h"
 #include "LocalAssetStorage.h"
 #include "ConsoleAPI.h"
 #include "Application.h"
@@ -88,6 +89,11 @@ void AssetModule::Initialize()
     framework_->Console()->RegisterCommand(
         "dumpAssets", "Lists all assets known to the Asset API", 
         this, SLOT(ConsoleDumpAssets()));
+
+    framework_->Console()->RegisterCommand(
+        "benchmarkAssetDependencies", "Measures the asset dependency tracking for a synthetic load of many assets with dependencies. "
+        "Usage: benchmarkAssetDependencies(numAssets=40000,numDependencies=4)",
+        this, SLOT(ConsoleBenchmarkAssetDependencies(int, int)), SLOT(ConsoleBenchmarkAssetDependencies()));
     
     ProcessCommandLineOptions();
 
@@ -447,6 +453,77 @@ void AssetModule::ConsoleDumpAssets()
     }
 }
 
+void AssetModule::ConsoleBenchmarkAssetDependencies(int numAssets, int numDependencies)
+{
+    if (numAssets <= 0)
+        numAssets = 40000;
+    if (numDependencies < 0)
+        numDependencies = 4;
+
+    // Asset i depends on random assets with larger indices, like meshes depend on materials which depend on textures.
+    // The dependencies are spelled in upper case, as the refs are compared case-insensitively.
+    std::vector<QString> names(numAssets);
+    for(int i = 0; i < numAssets; ++i)
+        names[i] = QString("local://benchmark/asset%1.bin").arg(i);
+    std::vector<QStringList> dependees(numAssets);
+    u32 seed = 12345;
+    size_t numEdges = 0;
+    for(int i = 0; i + 1 < numAssets; ++i)
+        for(int j = 0; j < numDependencies; ++j)
+        {
+            seed = seed * 1103515245 + 12345;
+            dependees[i] << names[i + 1 + (int)((seed >> 8) % (u32)(numAssets - i - 1))].toUpper();
+            ++numEdges;
+        }
+
+    // Each asset registers its dependencies when it has loaded, and the dependencies are then loaded in reverse order,
+    // each one notifying its dependents.
+    AssetDependencyGraph graph;
+    size_t numNotified = 0;
+    tick_t start = GetCurrentClockTime();
+    for(int i = 0; i < numAssets; ++i)
+        graph.SetDependencies(names[i], dependees[i]);
+    for(int i = numAssets - 1; i >= 0; --i)
+    {
+        if (graph.NumIncompleteDependees(names[i]) == 0)
+            graph.SetComplete(names[i]);
+        numNotified += graph.Dependents(names[i]).size();
+    }
+    double loadMsecs = (double)(GetCurrentClockTime() - start) * 1000.0 / (double)GetCurrentClockFreq();
+
+    // Unloading the last asset invalidates every asset depending on it, directly or indirectly.
+    start = GetCurrentClockTime();
+    graph.Invalidate(names[numAssets - 1]);
+    double invalidateMsecs = (double)(GetCurrentClockTime() - start) * 1000.0 / (double)GetCurrentClockFreq();
+    int numInvalidated = 0;
+    for(int i = 0; i < numAssets; ++i)
+        if (!graph.IsComplete(names[i]))
+            ++numInvalidated;
+
+    LogInfo(QString("AssetModule::BenchmarkAssetDependencies: %1 assets, %2 dependencies, %3 dependent notifications").arg(numAssets).arg(graph.NumEdges()).arg(numNotified));
+    LogInfo(QString("Dependency graph: load %1 ms, invalidation of %2 assets %3 ms").arg(loadMsecs, 0, 'f', 3).arg(numInvalidated).arg(invalidateMsecs, 0, 'f', 3));
+
+    // The earlier flat list of (dependent, dependee) pairs, which is scanned for the dependents of each loaded asset.
+    // Quadratic, so only run for small loads.
+    if ((double)numAssets * (double)numEdges > 1e9)
+    {
+        LogInfo("Flat dependency list: skipped, too many assets.");
+        return;
+    }
+    std::vector<std::pair<QString, QString> > flatDependencies;
+    numNotified = 0;
+    start = GetCurrentClockTime();
+    for(int i = 0; i < numAssets; ++i)
+        for(int j = 0; j < dependees[i].size(); ++j)
+            flatDependencies.push_back(std::make_pair(names[i], dependees[i][j]));
+    for(int i = numAssets - 1; i >= 0; --i)
+        for(size_t j = 0; j < flatDependencies.size(); ++j)
+            if (QString::compare(flatDependencies[j].second, names[i], Qt::CaseInsensitive) == 0)
+                ++numNotified;
+    double flatMsecs = (double)(GetCurrentClockTime() - start) * 1000.0 / (double)GetCurrentClockFreq();
+    LogInfo(QString("Flat dependency list: load %1 ms, %2 dependent notifications").arg(flatMsecs, 0, 'f', 3).arg(numNotified));
+}
+
 bool AssetModule::ShouldReplicateAssetDiscovery(const QString& assetRef)
 {
     QString protocol;
@@ -36,6 +36,11 @@ public slots:
 
     void ConsoleDumpAssets();
 
+    /// Measures the asset dependency bookkeeping for a synthetic load of many assets with dependencies.
+    /** Each asset depends on @c numDependencies assets with larger indices, which are loaded in reverse order,
+        as is the case when the dependencies are requested when their dependent has loaded. */
+    void ConsoleBenchmarkAssetDependencies(int numAssets = 40000, int numDependencies = 4);
+
     /// Loads from all the registered local storages all assets that have the given suffix.
     /// Type can also be optionally specified
     /// \todo Will be replaced with AssetStorage's GetAllAssetsRefs / GetAllAssets functionality
@@ -28,11 +28,33 @@
 
 #include "MemoryLeakCheck.h"
 
+namespace
+{
+    /// Default number of I/O threads reading local asset files.
+    const int cDefaultReadThreads = 2;
+    /// Maximum number of reads in progress at a time.
+    const size_t cMaxPendingReads = 64;
+}
+
 LocalAssetProvider::LocalAssetProvider(Framework* framework_) :
     framework(framework_)
 {
     enableRequestsOutsideStorages = (framework_->HasCommandLineParameter("--acceptUnknownLocalSources") ||
         framework_->HasCommandLineParameter("--accept_unknown_local_sources"));  /**< @todo Remove support for the deprecated underscore version at some point. */
+
+    int numReadThreads = cDefaultReadThreads;
+    QStringList readThreadsParam = framework_->CommandLineParameters("--localAssetThreads");
+    if (readThreadsParam.size() > 0)
+    {
+        bool ok = false;
+        int numThreads = readThreadsParam.first().toInt(&ok);
+        if (ok && numThreads >= 0)
+            numReadThreads = numThreads;
+        else
+            LogError("LocalAssetProvider: Invalid value for --localAssetThreads: " + readThreadsParam.first());
+    }
+    if (numReadThreads > 0)
+        readPool = MAKE_SHARED(LocalAssetReadPool, numReadThreads);
 }
 
 LocalAssetProvider::~LocalAssetProvider()
@@ -106,6 +128,17 @@ bool LocalAssetProvider::AbortTransfer(IAssetTransfer *transfer)
             return true;
         }
     }
+    // The result of an aborted read is discarded when it finishes.
+    for(std::map<u32, PendingRead>::iterator iter = pendingReads.begin(); iter != pendingReads.end(); ++iter)
+    {
+        if (iter->second.transfer.get() == transfer)
+        {
+            AssetTransferPtr ongoingTransfer = iter->second.transfer;
+            pendingReads.erase(iter);
+            framework->Asset()->AssetTransferAborted(transfer);
+            return true;
+        }
+    }
     return false;
 }
 
@@ -171,6 +204,7 @@ void LocalAssetProvider::Update(f64 /*frametime*/)
     /// request would fail on missing file, and the entity would erroneously get an "asset not found" result.
     CompletePendingFileUploads();
     CompletePendingFileDownloads();
+    CompleteFinishedReads();
     CheckForPendingFileSystemChanges();
 }
 
@@ -316,63 +350,40 @@ void LocalAssetProvider::CompletePendingFileDownloads()
     {
         PROFILE(LocalAssetProvider_ProcessPendingDownload);
 
+        // Bound the amount of file data that is read ahead of the main thread.
+        if (readPool && pendingReads.size() >= cMaxPendingReads)
+            break;
+
         AssetTransferPtr transfer = pendingDownloads.back();
         pendingDownloads.pop_back();
-            
-        QString ref = transfer->source.ref;
-
-        QString path_filename;
-        AssetAPI::AssetRefType refType = AssetAPI::ParseAssetRef(ref.trimmed(), 0, 0, 0, 0, &path_filename);
 
         LocalAssetStoragePtr storage;
+        QString absoluteFilename = ResolveDownloadFilename(transfer, storage);
+        if (absoluteFilename.isEmpty())
+            continue;
 
-        QFileInfo file;
-
-        if (refType == AssetAPI::AssetRefLocalPath)
-        {
-            file = QFileInfo(path_filename);
-        }
-        else // Using a local relative path, like "local://asset.ref" or "asset.ref".
+        if (readPool)
         {
-            AssetAPI::AssetRefType urlRefType = AssetAPI::ParseAssetRef(path_filename);
-            if (urlRefType == AssetAPI::AssetRefLocalPath)
-                file = QFileInfo(path_filename); // 'file://C:/path/to/asset/asset.png'.
-            else // The ref is of form 'file://relativePath/asset.png'.
-            {
-                QString path = GetPathForAsset(path_filename, &storage);
-                if (path.isEmpty())
-                {
-                    QString reason = "Failed to find local asset with filename \"" + ref + "\"!";
-                    framework->Asset()->AssetTransferFailed(transfer.get(), reason);
-                    // Also throttle asset loading here. This is needed in the case we have a lot of failed refs.
-                    //if (GetCurrentClockTime() - startTime >= GetCurrentClockFreq() * maxLoadMSecs / 1000)
-                    //    break;
-                    continue;
-                }
-            
-                file = QFileInfo(GuaranteeTrailingSlash(path) + path_filename);
-            }
+            PendingRead read;
+            read.transfer = transfer;
+            read.absoluteFilename = absoluteFilename;
+            read.storage = storage;
+            pendingReads[readPool->Read(absoluteFilename)] = read;
+            continue;
         }
-        QString absoluteFilename = file.absoluteFilePath();
 
         bool success = LoadFileToVector(absoluteFilename, transfer->rawAssetData);
         if (!success)
         {
-            QString reason = "Failed to read asset data for asset \"" + ref + "\" from file \"" + absoluteFilename + "\"";
+            QString reason = "Failed to read asset data for asset \"" + transfer->source.ref + "\" from file \"" + absoluteFilename + "\"";
             framework->Asset()->AssetTransferFailed(transfer.get(), reason);
             // Also throttle asset loading here. This is needed in the case we have a lot of failed refs.
             if (GetCurrentClockTime() - startTime >= GetCurrentClockFreq() * maxLoadMSecs / 1000)
                 break;
             continue;
         }
-        
-        // Tell the Asset API that this asset should not be cached into the asset cache, and instead the original filename should be used
-        // as a disk source, rather than generating a cache file for it.
-        transfer->SetCachingBehavior(false, absoluteFilename);
-        transfer->storage = storage;
 
-        // Signal the Asset API that this asset is now successfully downloaded.
-        framework->Asset()->AssetTransferCompleted(transfer.get());
+        CompleteDownload(transfer, absoluteFilename, storage);
 
         // Throttle asset loading to at most 16 msecs/frame.
         if (GetCurrentClockTime() - startTime >= GetCurrentClockFreq() * maxLoadMSecs / 1000)
@@ -380,6 +391,91 @@ void LocalAssetProvider::CompletePendingFileDownloads()
     }
 }
 
+void LocalAssetProvider::CompleteFinishedReads()
+{
+    if (!readPool)
+        return;
+
+    readPool->TakeFinished(finishedReads);
+
+    const int maxLoadMSecs = 16;
+    tick_t startTime = GetCurrentClockTime();
+
+    size_t numProcessed = 0;
+    while(numProcessed < finishedReads.size())
+    {
+        PROFILE(LocalAssetProvider_CompleteFinishedRead);
+
+        LocalAssetReadPool::Result &result = finishedReads[numProcessed++];
+        std::map<u32, PendingRead>::iterator iter = pendingReads.find(result.id);
+        if (iter == pendingReads.end())
+            continue; // The transfer was aborted.
+        PendingRead read = iter->second;
+        pendingReads.erase(iter);
+
+        if (!result.success)
+        {
+            QString reason = "Failed to read asset data for asset \"" + read.transfer->source.ref + "\" from file \"" + read.absoluteFilename + "\": " + result.error;
+            framework->Asset()->AssetTransferFailed(read.transfer.get(), reason);
+        }
+        else
+        {
+            read.transfer->rawAssetData.swap(result.data);
+            CompleteDownload(read.transfer, read.absoluteFilename, read.storage);
+        }
+
+        // Throttle asset loading to at most 16 msecs/frame.
+        if (GetCurrentClockTime() - startTime >= GetCurrentClockFreq() * maxLoadMSecs / 1000)
+            break;
+    }
+    finishedReads.erase(finishedReads.begin(), finishedReads.begin() + numProcessed);
+}
+
+QString LocalAssetProvider::ResolveDownloadFilename(const AssetTransferPtr &transfer, LocalAssetStoragePtr &storage)
+{
+    QString ref = transfer->source.ref;
+
+    QString path_filename;
+    AssetAPI::AssetRefType refType = AssetAPI::ParseAssetRef(ref.trimmed(), 0, 0, 0, 0, &path_filename);
+
+    QFileInfo file;
+
+    if (refType == AssetAPI::AssetRefLocalPath)
+    {
+        file = QFileInfo(path_filename);
+    }
+    else // Using a local relative path, like "local://asset.ref" or "asset.ref".
+    {
+        AssetAPI::AssetRefType urlRefType = AssetAPI::ParseAssetRef(path_filename);
+        if (urlRefType == AssetAPI::AssetRefLocalPath)
+            file = QFileInfo(path_filename); // 'file://C:/path/to/asset/asset.png'.
+        else // The ref is of form 'file://relativePath/asset.png'.
+        {
+            QString path = GetPathForAsset(path_filename, &storage);
+            if (path.isEmpty())
+            {
+                QString reason = "Failed to find local asset with filename \"" + ref + "\"!";
+                framework->Asset()->AssetTransferFailed(transfer.get(), reason);
+                return "";
+            }
+
+            file = QFileInfo(GuaranteeTrailingSlash(path) + path_filename);
+        }
+    }
+    return file.absoluteFilePath();
+}
+
+void LocalAssetProvider::CompleteDownload(const AssetTransferPtr &transfer, const QString &absoluteFilename, const LocalAssetStoragePtr &storage)
+{
+    // Tell the Asset API that this asset should not be cached into the asset cache, and instead the original filename should be used
+    // as a disk source, rather than generating a cache file for it.
+    transfer->SetCachingBehavior(false, absoluteFilename);
+    transfer->storage = storage;
+
+    // Signal the Asset API that this asset is now successfully downloaded.
+    framework->Asset()->AssetTransferCompleted(transfer.get());
+}
+
 AssetStoragePtr LocalAssetProvider::TryDeserializeStorageFromString(const QString &storage, bool /*fromNetwork*/)
 {
     QMap<QString, QString> s = AssetAPI::ParseAssetStorageString(storage);
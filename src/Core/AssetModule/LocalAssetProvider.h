@@ -5,9 +5,12 @@
 #include "AssetModuleApi.h"
 #include "IAssetProvider.h"
 #include "AssetFwd.h"
+#include "LocalAssetReadPool.h"
 
 #include <QSet>
 
+#include <map>
+
 class LocalAssetStorage;
 
 typedef shared_ptr<LocalAssetStorage> LocalAssetStoragePtr;
@@ -75,9 +78,20 @@ private:
     /// @param storage [out] Receives the local storage that contains the asset.
     QString GetPathForAsset(const QString &localFilename, LocalAssetStoragePtr *storage) const;
 
-    /// Takes all the pending file download transfers and finishes them.
+    /// Takes all the pending file download transfers and finishes them, or starts reading them on the I/O threads.
     void CompletePendingFileDownloads();
 
+    /// Finishes the download transfers whose files have been read by the I/O threads.
+    void CompleteFinishedReads();
+
+    /// Finds the file of a download transfer. Fails the transfer if the file is not found.
+    /** @param storage [out] Receives the local storage that contains the asset.
+        @return Absolute filename, or empty if not found. */
+    QString ResolveDownloadFilename(const AssetTransferPtr &transfer, LocalAssetStoragePtr &storage);
+
+    /// Completes a download transfer whose file has been read to transfer->rawAssetData.
+    void CompleteDownload(const AssetTransferPtr &transfer, const QString &absoluteFilename, const LocalAssetStoragePtr &storage);
+
     /// Takes all the pending file upload transfers and finishes them.
     void CompletePendingFileUploads();
 
@@ -88,6 +102,16 @@ private:
     std::vector<LocalAssetStoragePtr> storages; ///< Asset directories to search, may be recursive or not
     std::vector<AssetUploadTransferPtr> pendingUploads; ///< The following asset uploads are pending to be completed by this provider.
     std::vector<AssetTransferPtr> pendingDownloads; ///< The following asset downloads are pending to be completed by this provider.
+    /// A download transfer whose file is being read by the I/O threads.
+    struct PendingRead
+    {
+        AssetTransferPtr transfer;
+        QString absoluteFilename;
+        LocalAssetStoragePtr storage;
+    };
+    shared_ptr<LocalAssetReadPool> readPool; ///< I/O threads, or null if the files are read synchronously in the main thread.
+    std::map<u32, PendingRead> pendingReads; ///< Reads in progress, keyed by read id.
+    std::vector<LocalAssetReadPool::Result> finishedReads; ///< Finished reads whose transfers have not yet been completed.
     QSet<QString> changedFiles; ///< Pending file changes.
     QSet<QString> changedDirectories; ///< Pending directory changes.
 
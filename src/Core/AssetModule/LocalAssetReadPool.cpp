@@ -0,0 +1,147 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "LocalAssetReadPool.h"
+
+#include <QThread>
+#include <QFile>
+
+#include "MemoryLeakCheck.h"
+
+class LocalAssetReadPool::ReadThread : public QThread
+{
+public:
+    explicit ReadThread(LocalAssetReadPool *pool) : pool_(pool) {}
+
+protected:
+    void run() { pool_->ThreadMain(); }
+
+private:
+    LocalAssetReadPool *pool_;
+};
+
+LocalAssetReadPool::LocalAssetReadPool(size_t numThreads) :
+    numReading_(0),
+    nextId_(1),
+    quit_(false)
+{
+    if (numThreads < 1)
+        numThreads = 1;
+    for(size_t i = 0; i < numThreads; ++i)
+    {
+        ReadThread *thread = new ReadThread(this);
+        threads_.push_back(thread);
+        thread->start(QThread::LowPriority);
+    }
+}
+
+LocalAssetReadPool::~LocalAssetReadPool()
+{
+    {
+        QMutexLocker lock(&mutex_);
+        quit_ = true;
+        jobs_.clear();
+        jobAvailable_.wakeAll();
+    }
+    for(size_t i = 0; i < threads_.size(); ++i)
+    {
+        threads_[i]->wait();
+        delete threads_[i];
+    }
+}
+
+u32 LocalAssetReadPool::Read(const QString &filename)
+{
+    QMutexLocker lock(&mutex_);
+    Job job;
+    job.id = nextId_++;
+    if (nextId_ == 0)
+        nextId_ = 1;
+    job.filename = filename;
+    jobs_.push_back(job);
+    jobAvailable_.wakeOne();
+    return job.id;
+}
+
+void LocalAssetReadPool::TakeFinished(std::vector<Result> &results)
+{
+    QMutexLocker lock(&mutex_);
+    if (finished_.empty())
+        return;
+    // Swap the data vectors instead of copying them.
+    size_t first = results.size();
+    results.resize(first + finished_.size());
+    for(size_t i = 0; i < finished_.size(); ++i)
+    {
+        Result &dst = results[first + i];
+        dst.id = finished_[i].id;
+        dst.success = finished_[i].success;
+        dst.error = finished_[i].error;
+        dst.data.swap(finished_[i].data);
+    }
+    finished_.clear();
+}
+
+size_t LocalAssetReadPool::NumPending() const
+{
+    QMutexLocker lock(&mutex_);
+    return jobs_.size() + numReading_ + finished_.size();
+}
+
+void LocalAssetReadPool::ThreadMain()
+{
+    for(;;)
+    {
+        Job job;
+        {
+            QMutexLocker lock(&mutex_);
+            while(!quit_ && jobs_.empty())
+                jobAvailable_.wait(&mutex_);
+            if (quit_)
+                return;
+            job = jobs_.front();
+            jobs_.pop_front();
+            ++numReading_;
+        }
+
+        Result result;
+        result.id = job.id;
+        ReadFile(job.filename, result);
+
+        QMutexLocker lock(&mutex_);
+        --numReading_;
+        finished_.push_back(Result());
+        Result &dst = finished_.back();
+        dst.id = result.id;
+        dst.success = result.success;
+        dst.error = result.error;
+        dst.data.swap(result.data);
+    }
+}
+
+void LocalAssetReadPool::ReadFile(const QString &filename, Result &result)
+{
+    result.success = false;
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        result.error = "Failed to open file '" + filename + "' for reading.";
+        return;
+    }
+    qint64 fileSize = file.size();
+    if (fileSize > 0)
+    {
+        // One read of the whole file lets the OS read ahead sequentially.
+        result.data.resize((size_t)fileSize);
+        qint64 numRead = file.read((char*)&result.data[0], fileSize);
+        if (numRead < fileSize)
+        {
+            result.error = QString("Failed to read full %1 bytes from file '%2', instead read %3 bytes.").arg(fileSize).arg(filename).arg(numRead);
+            result.data.clear();
+            return;
+        }
+    }
+    result.success = true;
+}
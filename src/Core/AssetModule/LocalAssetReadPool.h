@@ -0,0 +1,76 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "AssetModuleApi.h"
+#include "CoreTypes.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+
+#include <vector>
+#include <deque>
+
+/// Fixed-size thread pool which reads local asset files in the background for LocalAssetProvider.
+/** Reads are queued from the main thread with Read(), and their results are collected with TakeFinished().
+    The worker threads only do file I/O: they never log or touch the asset API, so that the transfers can be
+    completed on the main thread. */
+class ASSET_MODULE_API LocalAssetReadPool
+{
+public:
+    /// Result of a finished read.
+    struct Result
+    {
+        u32 id; ///< Id returned by Read().
+        bool success;
+        QString error; ///< Reason of the failure if !success.
+        std::vector<u8> data; ///< File contents.
+    };
+
+    /// Starts the worker threads.
+    /** @param numThreads Number of I/O threads, at least one thread is started. */
+    explicit LocalAssetReadPool(size_t numThreads);
+    /// Stops and joins the worker threads. Unfinished reads are discarded.
+    ~LocalAssetReadPool();
+
+    /// Returns number of I/O threads.
+    size_t NumThreads() const { return threads_.size(); }
+
+    /// Queues a read of the whole file. @return Id of the read, which identifies its Result.
+    u32 Read(const QString &filename);
+
+    /// Appends the results of the reads finished so far to @c results, and forgets them.
+    void TakeFinished(std::vector<Result> &results);
+
+    /// Returns number of reads that are queued or in progress, or finished but not yet taken.
+    size_t NumPending() const;
+
+private:
+    class ReadThread;
+    friend class ReadThread;
+
+    struct Job
+    {
+        u32 id;
+        QString filename;
+    };
+
+    /// Worker thread main loop.
+    void ThreadMain();
+    /// Reads a file to @c result.
+    static void ReadFile(const QString &filename, Result &result);
+
+    mutable QMutex mutex_;
+    QWaitCondition jobAvailable_;
+    std::deque<Job> jobs_;
+    std::vector<Result> finished_;
+    size_t numReading_; ///< Number of jobs taken by the threads but not yet finished.
+    u32 nextId_;
+    bool quit_;
+    std::vector<ReadThread*> threads_;
+
+    // Noncopyable
+    LocalAssetReadPool(const LocalAssetReadPool &);
+    void operator =(const LocalAssetReadPool &);
+};
@@ -15,178 +15,61 @@
 /** @file TriangleMesh.cpp
 	@author Jukka Jylnki
 	@brief Implementation for the TriangleMesh geometry object. */
-#ifdef WIN32
 #include "TriangleMesh.h"
-#include <malloc.h>
+#include <stdlib.h>
 #include <string.h>
+#if defined(_MSC_VER) || defined(ANDROID)
+#include <malloc.h>
+#endif
 #include "Math/float3.h"
 #include "Geometry/Triangle.h"
 #include "Geometry/Ray.h"
 #include "Math/MathFwd.h"
 #include "Math/MathConstants.h"
+#include "Math/SIMDDispatch.h"
 #include "myassert.h"
 
-#ifdef MATH_SSE
-#include <intrin.h>
-#include <emmintrin.h>
-#include <smmintrin.h>
-#include <xmmintrin.h>
-#endif
-
-// If defined, we preprocess our TriangleMesh data structure to contain (v0, v1-v0, v2-v0)
-// instead of (v0, v1, v2) triplets for faster ray-triangle mesh intersection.
-#define SOA_HAS_EDGES
-
 MATH_BEGIN_NAMESPACE
 
-enum SIMDCapability
+TriangleMesh::TriangleMesh()
+:data(0), vertexDataLayout(0), numTriangles(0)
 {
-	SIMD_NONE,
-	SIMD_SSE,
-	SIMD_SSE2,
-//	SIMD_SSE3,
-//	SIMD_SSSE3,
-//	SIMD_SSE4,
-	SIMD_SSE41,
-//	SIMD_SSE42,
-	SIMD_AVX
-};
+}
 
-SIMDCapability DetectSIMDCapability()
+TriangleMesh::~TriangleMesh()
 {
-#ifdef MATH_SSE
-	int CPUInfo[4] = {-1};
-
-	unsigned    nIds;//, nExIds, i;
-	int nFeatureInfo = 0;
-//	bool    bSSE3Instructions = false;
-//	bool    bSupplementalSSE3 = false;
-//	bool    bCMPXCHG16B = false;
-#ifdef MATH_SSE41
-	bool    bSSE41Extensions = false;
-#endif
-//	bool    bSSE42Extensions = false;
-//	bool    bPOPCNT = false;
-
-//	bool    bLAHF_SAHFAvailable = false;
-//	bool    bCmpLegacy = false;
-//	bool    bLZCNT = false;
-//	bool    bSSE4A = false;
-//	bool    bMisalignedSSE = false;
-//	bool    bPREFETCH = false;
-//	bool    bMMXExtensions = false;
-//	bool    b3DNowExt = false;
-//	bool    b3DNow = false;
-//	bool    bFP128 = false;
-#ifdef MATH_AVX
-	bool    hasAVX = false;
-#endif
-//	bool    bMOVOptimization = false;
-
-	__cpuid(CPUInfo, 0);
-	nIds = CPUInfo[0];
-
-	// Get the information associated with each valid Id
-//	for (i=0; i<=nIds; ++i)
-	if (nIds >= 1)
-	{
-	//	__cpuid(CPUInfo, i);
-
-		__cpuid(CPUInfo, 1);
-		// Interpret CPU feature information.
-//		if  (i == 1)
-		{
-//			bSSE3Instructions = (CPUInfo[2] & 0x1) || false;
-//			bSupplementalSSE3 = (CPUInfo[2] & 0x200) || false;
-//			bCMPXCHG16B= (CPUInfo[2] & 0x2000) || false;
-//			bSSE41Extensions = (CPUInfo[2] & 0x80000) || false;
-//			bSSE42Extensions = (CPUInfo[2] & 0x100000) || false;
-//			bPOPCNT= (CPUInfo[2] & 0x800000) || false;
-#ifdef MATH_AVX
-			hasAVX = (CPUInfo[2] & 0x10000000) || false;
-#endif
-			nFeatureInfo = CPUInfo[3];
-		}
-	}
-
-//	const bool hasMMX = (nFeatureInfo & (1 << 23)) != 0;
-
-	// Calling __cpuid with 0x80000000 as the InfoType argument
-	// gets the number of valid extended IDs.
-//	__cpuid(CPUInfo, 0x80000000);
-//	nExIds = CPUInfo[0];
-/*
-	// Get the information associated with each extended ID.
-	for (i=0x80000000; i<=nExIds; ++i)
-	{
-		__cpuid(CPUInfo, i);
-
-		if  (i == 0x80000001)
-		{
-			bLAHF_SAHFAvailable = (CPUInfo[2] & 0x1) || false;
-			bCmpLegacy = (CPUInfo[2] & 0x2) || false;
-			bLZCNT = (CPUInfo[2] & 0x20) || false;
-			bSSE4A = (CPUInfo[2] & 0x40) || false;
-			bMisalignedSSE = (CPUInfo[2] & 0x80) || false;
-			bPREFETCH = (CPUInfo[2] & 0x100) || false;
-			bMMXExtensions = (CPUInfo[3] & 0x40000) || false;
-			b3DNowExt = (CPUInfo[3] & 0x40000000) || false;
-			b3DNow = (CPUInfo[3] & 0x80000000) || false;
-		}
-
-		if  (i == 0x8000001A)
-		{
-			bFP128 = (CPUInfo[0] & 0x1) || false;
-			bMOVOptimization = (CPUInfo[0] & 0x2) || false;
-		}
-	}
-*/
-#ifdef MATH_AVX
-	if (hasAVX)
-		return SIMD_AVX;
-#endif
-#ifdef MATH_SSE41
-	if (bSSE41Extensions)
-		return SIMD_SSE41;
-#endif
-#ifdef MATH_SSE2
-	const bool hasSSE2 = (nFeatureInfo & (1 << 26)) != 0;
-	if (hasSSE2)
-		return SIMD_SSE2;
-#endif
-#ifdef MATH_SSE
-	const bool hasSSE = (nFeatureInfo & (1 << 25)) != 0;
-	if (hasSSE)
-		return SIMD_SSE;
+#ifdef _MSC_VER
+	_aligned_free(data);
+#else
+	free(data);
 #endif
-
-#endif // ~ MATH_SSE not defined.
-	return SIMD_NONE;
 }
 
-const int simdCapability = DetectSIMDCapability();
 void TriangleMesh::Set(const float *triangleMesh, int numTriangles)
 {
+	const SIMDCapability simdCapability = ActiveSIMDCapability();
 	if (simdCapability == SIMD_AVX)
 		SetSoA8(triangleMesh, numTriangles);
-	if (simdCapability == SIMD_SSE41 || simdCapability == SIMD_SSE2)
+	else if (simdCapability == SIMD_SSE41 || simdCapability == SIMD_SSE2)
 		SetSoA4(triangleMesh, numTriangles);
 	else
 		SetAoS(triangleMesh, numTriangles);
 }
 
+// The kernel is chosen by the layout the mesh was Set() with, so that the mesh stays usable if the active SIMD level is changed.
+
 float TriangleMesh::IntersectRay(const Ray &ray) const
 {
-#ifdef MATH_AVX
-	if (simdCapability == SIMD_AVX)
+#if defined(MATH_AVX) || defined(MATH_SIMD_DISPATCH_AVX)
+	if (vertexDataLayout == 2)
 		return IntersectRay_AVX(ray);
 #endif
-#ifdef MATH_SSE41
-	if (simdCapability == SIMD_SSE41)
+#if defined(MATH_SSE41) || defined(MATH_SIMD_DISPATCH)
+	if (vertexDataLayout == 1 && ActiveSIMDCapability() >= SIMD_SSE41)
 		return IntersectRay_SSE41(ray);
 #endif
-#ifdef MATH_SSE2
-	if (simdCapability == SIMD_SSE2)
+#if defined(MATH_SSE2) || defined(MATH_SIMD_DISPATCH)
+	if (vertexDataLayout == 1)
 		return IntersectRay_SSE2(ray);
 #endif
 
@@ -197,16 +80,16 @@ float TriangleMesh::IntersectRay(const Ray &ray) const
 
 float TriangleMesh::IntersectRay_TriangleIndex(const Ray &ray, int &outTriangleIndex) const
 {
-#ifdef MATH_AVX
-	if (simdCapability == SIMD_AVX)
+#if defined(MATH_AVX) || defined(MATH_SIMD_DISPATCH_AVX)
+	if (vertexDataLayout == 2)
 		return IntersectRay_TriangleIndex_AVX(ray, outTriangleIndex);
 #endif
-#ifdef MATH_SSE41
-	if (simdCapability == SIMD_SSE41)
+#if defined(MATH_SSE41) || defined(MATH_SIMD_DISPATCH)
+	if (vertexDataLayout == 1 && ActiveSIMDCapability() >= SIMD_SSE41)
 		return IntersectRay_TriangleIndex_SSE41(ray, outTriangleIndex);
 #endif
-#ifdef MATH_SSE2
-	if (simdCapability == SIMD_SSE2)
+#if defined(MATH_SSE2) || defined(MATH_SIMD_DISPATCH)
+	if (vertexDataLayout == 1)
 		return IntersectRay_TriangleIndex_SSE2(ray, outTriangleIndex);
 #endif
 
@@ -216,16 +99,16 @@ float TriangleMesh::IntersectRay_TriangleIndex(const Ray &ray, int &outTriangleI
 
 float TriangleMesh::IntersectRay_TriangleIndex_UV(const Ray &ray, int &outTriangleIndex, float &outU, float &outV) const
 {
-#ifdef MATH_AVX
-	if (simdCapability == SIMD_AVX)
+#if defined(MATH_AVX) || defined(MATH_SIMD_DISPATCH_AVX)
+	if (vertexDataLayout == 2)
 		return IntersectRay_TriangleIndex_UV_AVX(ray, outTriangleIndex, outU, outV);
 #endif
-#ifdef MATH_SSE41
-	if (simdCapability == SIMD_SSE41)
+#if defined(MATH_SSE41) || defined(MATH_SIMD_DISPATCH)
+	if (vertexDataLayout == 1 && ActiveSIMDCapability() >= SIMD_SSE41)
 		return IntersectRay_TriangleIndex_UV_SSE41(ray, outTriangleIndex, outU, outV);
 #endif
-#ifdef MATH_SSE2
-	if (simdCapability == SIMD_SSE2)
+#if defined(MATH_SSE2) || defined(MATH_SIMD_DISPATCH)
+	if (vertexDataLayout == 1)
 		return IntersectRay_TriangleIndex_UV_SSE2(ray, outTriangleIndex, outU, outV);
 #endif
 
@@ -234,12 +117,19 @@ float TriangleMesh::IntersectRay_TriangleIndex_UV(const Ray &ray, int &outTriang
 
 void TriangleMesh::ReallocVertexBuffer(int numTris)
 {
-#if defined(_MSC_VER) || defined(MATH_SSE)
+	// The SoA layouts are read with aligned SSE and AVX loads, so align to 32 bytes.
+#ifdef _MSC_VER
 	_aligned_free(data);
 	data = (float*)_aligned_malloc(numTris*3*3*4, 32); // http://msdn.microsoft.com/en-us/library/8z34s9c6.aspx
+#elif defined(ANDROID)
+	free(data);
+	data = (float*)memalign(32, numTris*3*3*4);
 #else
 	free(data);
-	data = (float*)malloc(numTris*3*3*4); // http://msdn.microsoft.com/en-us/library/8z34s9c6.aspx
+	void *ptr = 0;
+	if (posix_memalign(&ptr, 32, numTris*3*3*4) != 0)
+		ptr = 0;
+	data = (float*)ptr;
 #endif
 	numTriangles = numTris;
 }
@@ -247,87 +137,50 @@ void TriangleMesh::ReallocVertexBuffer(int numTris)
 void TriangleMesh::SetAoS(const float *vertexData, int numTriangles)
 {
 	ReallocVertexBuffer(numTriangles);
-#ifdef _DEBUG
 	vertexDataLayout = 0; // AoS
-#endif
 
 	memcpy(data, vertexData, numTriangles*3*3*4);
 }
 
 void TriangleMesh::SetSoA4(const float *vertexData, int numTriangles)
 {
-	ReallocVertexBuffer(numTriangles);
-#ifdef _DEBUG
-	vertexDataLayout = 1; // SoA4
-#endif
-
 	// From (xyz xyz xyz) (xyz xyz xyz) (xyz xyz xyz) (xyz xyz xyz)
 	// To xxxx yyyy zzzz xxxx yyyy zzzz xxxx yyyy zzzz
-
-	float *o = data;
-	for(int i = 0; i + 4 <= numTriangles; i += 4)
-	{
-		for(int j = 0; j < 9; ++j)
-		{
-			*o++ = vertexData[0];
-			*o++ = vertexData[9];
-			*o++ = vertexData[18];
-			*o++ = vertexData[27];
-			++vertexData;
-		}
-		vertexData += 9 * 3;
-	}
-
-#ifdef SOA_HAS_EDGES
-	o = data;
-	for(int i = 0; i + 4 <= numTriangles; i += 4)
-	{
-		for(int j = 12; j < 24; ++j)
-			o[j] -= o[j-12];
-		for(int j = 24; j < 36; ++j)
-			o[j] -= o[j-24];
-		o += 36;
-	}
-#endif
+	SetSoA(vertexData, numTriangles, 4);
+	vertexDataLayout = 1; // SoA4
 }
 
 void TriangleMesh::SetSoA8(const float *vertexData, int numTriangles)
 {
-	ReallocVertexBuffer(numTriangles);
-#ifdef _DEBUG
-	vertexDataLayout = 2; // SoA8
-#endif
-
 	// From (xyz xyz xyz) (xyz xyz xyz) (xyz xyz xyz) (xyz xyz xyz)
 	// To xxxxxxxx yyyyyyyy zzzzzzzz xxxxxxxx yyyyyyyy zzzzzzzz xxxxxxxx yyyyyyyy zzzzzzzz
+	SetSoA(vertexData, numTriangles, 8);
+	vertexDataLayout = 2; // SoA8
+}
+
+void TriangleMesh::SetSoA(const float *vertexData, int numTris, int width)
+{
+	// The kernels process whole groups of 'width' triangles, so pad the last group with degenerate all-zero triangles.
+	// Their determinant is zero, so the kernels never report a hit on them.
+	const int numPadded = (numTris + width - 1) / width * width;
+	ReallocVertexBuffer(numPadded);
 
 	float *o = data;
-	for(int i = 0; i + 8 <= numTriangles; i += 8)
-	{
+	for(int i = 0; i < numPadded; i += width)
 		for(int j = 0; j < 9; ++j)
-		{
-			*o++ = vertexData[0];
-			*o++ = vertexData[9];
-			*o++ = vertexData[18];
-			*o++ = vertexData[27];
-			*o++ = vertexData[36];
-			*o++ = vertexData[45];
-			*o++ = vertexData[54];
-			*o++ = vertexData[63];
-			++vertexData;
-		}
-		vertexData += 9 * 7;
-	}
+			for(int k = 0; k < width; ++k)
+				*o++ = (i + k < numTris) ? vertexData[(i + k) * 9 + j] : 0.f;
 
 #ifdef SOA_HAS_EDGES
+	const int stride = 3 * width; // Floats in one vertex of a group.
 	o = data;
-	for(int i = 0; i + 8 <= numTriangles; i += 8)
+	for(int i = 0; i < numPadded; i += width)
 	{
-		for(int j = 24; j < 48; ++j)
-			o[j] -= o[j-24];
-		for(int j = 48; j < 72; ++j)
-			o[j] -= o[j-48];
-		o += 72;
+		for(int j = stride; j < 2*stride; ++j)
+			o[j] -= o[j-stride];
+		for(int j = 2*stride; j < 3*stride; ++j)
+			o[j] -= o[j-2*stride];
+		o += 3 * stride;
 	}
 #endif
 }
@@ -336,9 +189,7 @@ float TriangleMesh::IntersectRay_TriangleIndex_UV_CPP(const Ray &ray, int &outTr
 {
 	assert(sizeof(float3) == 3*sizeof(float));
 	assert(sizeof(Triangle) == 3*sizeof(float3));
-#ifdef _DEBUG
 	assert(vertexDataLayout == 0); // Must be AoS structured!
-#endif
 
 	float nearestD = FLOAT_INF;
 	float u, v, d;
@@ -361,47 +212,3 @@ float TriangleMesh::IntersectRay_TriangleIndex_UV_CPP(const Ray &ray, int &outTr
 }
 
 MATH_END_NAMESPACE
-
-#ifdef MATH_SSE2
-#define MATH_GEN_SSE2
-#include "TriangleMesh_IntersectRay_SSE.inl"
-
-#define MATH_GEN_SSE2
-#define MATH_GEN_TRIANGLEINDEX
-#include "TriangleMesh_IntersectRay_SSE.inl"
-
-#define MATH_GEN_SSE2
-#define MATH_GEN_TRIANGLEINDEX
-#define MATH_GEN_UV
-#include "TriangleMesh_IntersectRay_SSE.inl"
-#endif
-
-#ifdef MATH_SSE41
-#define MATH_GEN_SSE41
-#include "TriangleMesh_IntersectRay_SSE.inl"
-
-#define MATH_GEN_SSE41
-#define MATH_GEN_TRIANGLEINDEX
-#include "TriangleMesh_IntersectRay_SSE.inl"
-
-#define MATH_GEN_SSE41
-#define MATH_GEN_TRIANGLEINDEX
-#define MATH_GEN_UV
-#include "TriangleMesh_IntersectRay_SSE.inl"
-#endif
-
-#ifdef MATH_AVX
-#define MATH_GEN_AVX
-#include "TriangleMesh_IntersectRay_AVX.inl"
-
-#define MATH_GEN_AVX
-#define MATH_GEN_TRIANGLEINDEX
-#include "TriangleMesh_IntersectRay_AVX.inl"
-
-#define MATH_GEN_AVX
-#define MATH_GEN_TRIANGLEINDEX
-#define MATH_GEN_UV
-#include "TriangleMesh_IntersectRay_AVX.inl"
-#endif
-
-#endif
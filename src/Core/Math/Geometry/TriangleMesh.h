@@ -19,6 +19,10 @@
 
 #include "Math/MathFwd.h"
 
+// If defined, we preprocess our TriangleMesh data structure to contain (v0, v1-v0, v2-v0)
+// instead of (v0, v1, v2) triplets for faster ray-triangle mesh intersection.
+#define SOA_HAS_EDGES
+
 MATH_BEGIN_NAMESPACE
 
 /// Represents an unindiced triangle mesh.
@@ -26,6 +30,9 @@ MATH_BEGIN_NAMESPACE
 class TriangleMesh
 {
 public:
+	TriangleMesh();
+	~TriangleMesh();
+
 	/// Specifies the vertex data of this triangle mesh. Replaces any old
 	/// specified geometry.
 	void Set(const float *triangleMesh, int numTriangles);
@@ -42,19 +49,19 @@ public:
 
 	float IntersectRay_TriangleIndex_UV_CPP(const Ray &ray, int &outTriangleIndex, float &outU, float &outV) const;
 
-#ifdef MATH_SSE2
+#if defined(MATH_SSE2) || defined(MATH_SIMD_DISPATCH)
 	float IntersectRay_SSE2(const Ray &ray) const;
 	float IntersectRay_TriangleIndex_SSE2(const Ray &ray, int &outTriangleIndex) const;
 	float IntersectRay_TriangleIndex_UV_SSE2(const Ray &ray, int &outTriangleIndex, float &outU, float &outV) const;
 #endif
 
-#ifdef MATH_SSE41
+#if defined(MATH_SSE41) || defined(MATH_SIMD_DISPATCH)
 	float IntersectRay_SSE41(const Ray &ray) const;
 	float IntersectRay_TriangleIndex_SSE41(const Ray &ray, int &outTriangleIndex) const;
 	float IntersectRay_TriangleIndex_UV_SSE41(const Ray &ray, int &outTriangleIndex, float &outU, float &outV) const;
 #endif
 
-#ifdef MATH_AVX
+#if defined(MATH_AVX) || defined(MATH_SIMD_DISPATCH)
 	float IntersectRay_AVX(const Ray &ray) const;
 	float IntersectRay_TriangleIndex_AVX(const Ray &ray, int &outTriangleIndex) const;
 	float IntersectRay_TriangleIndex_UV_AVX(const Ray &ray, int &outTriangleIndex, float &outU, float &outV) const;
@@ -62,11 +69,14 @@ public:
 
 private:
 	float *data;
-#ifdef _DEBUG
 	int vertexDataLayout; // 0 - AoS, 1 - SoA4, 2 - SoA8
-#endif
-	int numTriangles;
+	int numTriangles; // In the SoA layouts, padded to a multiple of 4 or 8 with degenerate triangles.
 	void ReallocVertexBuffer(int numTriangles);
+	void SetSoA(const float *vertexData, int numTriangles, int width);
+
+	// Noncopyable
+	TriangleMesh(const TriangleMesh &);
+	void operator =(const TriangleMesh &);
 };
 
 MATH_END_NAMESPACE
@@ -0,0 +1,38 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   TriangleMesh_AVX.cpp
+    @brief  AVX ray intersection kernels of TriangleMesh, generated from TriangleMesh_IntersectRay_AVX.inl.
+    @note   Compiled with the AVX instruction set enabled. The kernels use only intrinsics and plain member access, so
+            no inline function of the included headers gets emitted here with AVX instructions. */
+
+#include "TriangleMesh.h"
+#include "Math/MathBuildConfig.h"
+
+#if defined(MATH_AVX) || defined(MATH_SIMD_DISPATCH_AVX)
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <stddef.h>
+#else
+#include <stdint.h>
+#endif
+#include "Math/float3.h"
+#include "Geometry/Triangle.h"
+#include "Geometry/Ray.h"
+#include "Math/MathConstants.h"
+#include "myassert.h"
+
+#define MATH_GEN_AVX
+#include "TriangleMesh_IntersectRay_AVX.inl"
+
+#define MATH_GEN_AVX
+#define MATH_GEN_TRIANGLEINDEX
+#include "TriangleMesh_IntersectRay_AVX.inl"
+
+#define MATH_GEN_AVX
+#define MATH_GEN_TRIANGLEINDEX
+#define MATH_GEN_UV
+#include "TriangleMesh_IntersectRay_AVX.inl"
+
+#endif
@@ -0,0 +1,38 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   TriangleMesh_SSE41.cpp
+    @brief  SSE4.1 ray intersection kernels of TriangleMesh, generated from TriangleMesh_IntersectRay_SSE.inl.
+    @note   Compiled with the SSE4.1 instruction set enabled. The kernels use only intrinsics and plain member access, so
+            no inline function of the included headers gets emitted here with SSE4.1 instructions. */
+
+#include "TriangleMesh.h"
+#include "Math/MathBuildConfig.h"
+
+#if defined(MATH_SSE41) || defined(MATH_SIMD_DISPATCH)
+
+#include <smmintrin.h>
+#ifdef _MSC_VER
+#include <stddef.h>
+#else
+#include <stdint.h>
+#endif
+#include "Math/float3.h"
+#include "Geometry/Triangle.h"
+#include "Geometry/Ray.h"
+#include "Math/MathConstants.h"
+#include "myassert.h"
+
+#define MATH_GEN_SSE41
+#include "TriangleMesh_IntersectRay_SSE.inl"
+
+#define MATH_GEN_SSE41
+#define MATH_GEN_TRIANGLEINDEX
+#include "TriangleMesh_IntersectRay_SSE.inl"
+
+#define MATH_GEN_SSE41
+#define MATH_GEN_TRIANGLEINDEX
+#define MATH_GEN_UV
+#include "TriangleMesh_IntersectRay_SSE.inl"
+
+#endif
@@ -102,6 +102,13 @@
 //#define MATH_SSE2
 //#define MATH_SSE // SSE1.
 
+// If MATH_SIMD_DISPATCH is defined, SSE2, SSE4.1 and AVX kernels of the hot paths (matrix and quaternion products,
+// TriangleMesh ray intersections) are built in, and the fastest one the CPU supports is chosen at startup, see SIMDDispatch.h.
+// Unlike the flags above, this does not change the layout of the types, so the library still runs on any CPU.
+// Set by the ENABLE_MATH_SIMD_DISPATCH option in CMakeBuildConfig.txt, which also defines MATH_SIMD_DISPATCH_AVX
+// for the Math library if the compiler supports AVX.
+//#define MATH_SIMD_DISPATCH
+
 #ifdef ANDROID
 //#define MATH_NEON
 //#include <arm_neon.h>
@@ -25,6 +25,7 @@
 #include "Algorithm/Random/LCG.h"
 #include "assume.h"
 #include "Math/MathFunc.h"
+#include "Math/SIMDDispatch.h"
 
 #ifdef MATH_ENABLE_STL_SUPPORT
 #include <iostream>
@@ -632,6 +633,14 @@ Quat Quat::operator /(float scalar) const
 
 Quat Quat::operator *(const Quat &r) const
 {
+#ifdef MATH_SIMD_DISPATCH
+	if (simdKernels.quatMul)
+	{
+		Quat q;
+		simdKernels.quatMul(q.ptr(), ptr(), r.ptr());
+		return q;
+	}
+#endif
 	return Quat(w*r.x + x*r.w + y*r.z - z*r.y,
 	            w*r.y - x*r.z + y*r.w + z*r.x,
 	            w*r.z + x*r.y - y*r.x + z*r.w,
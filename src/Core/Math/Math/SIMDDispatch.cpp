@@ -0,0 +1,159 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   SIMDDispatch.cpp
+    @brief  Detection of the SIMD instruction sets of the CPU, and the SIMD kernels chosen at startup for the hot paths of the library. */
+
+#include "Math/SIMDDispatch.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define MATH_HAS_CPUID
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#define MATH_HAS_CPUID
+#endif
+
+MATH_BEGIN_NAMESPACE
+
+#ifdef MATH_HAS_CPUID
+
+static void CpuId(int function, unsigned int info[4])
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, function);
+    for(int i = 0; i < 4; ++i)
+        info[i] = (unsigned int)regs[i];
+#else
+    __cpuid(function, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+/// Returns true if the OS saves the SSE and AVX registers on context switches. Call only if the CPU supports OSXSAVE.
+static bool OSSavesAVXState()
+{
+    unsigned int xcr0 = 0;
+#ifdef _MSC_VER
+#if _MSC_FULL_VER >= 160040219 // _xgetbv is available starting from VS2010 SP1.
+    xcr0 = (unsigned int)_xgetbv(0);
+#endif
+#else
+    unsigned int edx;
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(xcr0), "=d"(edx) : "c"(0)); // xgetbv, not known to older assemblers.
+#endif
+    return (xcr0 & 0x6) == 0x6;
+}
+
+#endif
+
+SIMDCapability DetectSIMDCapability()
+{
+#ifdef MATH_HAS_CPUID
+    unsigned int info[4] = {};
+    CpuId(0, info);
+    if (info[0] < 1)
+        return SIMD_NONE;
+
+    CpuId(1, info);
+    const unsigned int ecx = info[2];
+    const unsigned int edx = info[3];
+
+    const bool hasOSXSAVE = (ecx & (1 << 27)) != 0;
+    if (hasOSXSAVE && (ecx & (1 << 28)) != 0 && OSSavesAVXState())
+        return SIMD_AVX;
+    if ((ecx & (1 << 19)) != 0)
+        return SIMD_SSE41;
+    if ((edx & (1 << 26)) != 0)
+        return SIMD_SSE2;
+    if ((edx & (1 << 25)) != 0)
+        return SIMD_SSE;
+#endif
+    return SIMD_NONE;
+}
+
+/// Returns the highest SIMD instruction set level the library has been built with.
+static SIMDCapability BuildSIMDCapability()
+{
+#if defined(MATH_AVX) || defined(MATH_SIMD_DISPATCH_AVX)
+    return SIMD_AVX;
+#elif defined(MATH_SSE41) || defined(MATH_SIMD_DISPATCH)
+    return SIMD_SSE41;
+#elif defined(MATH_SSE2)
+    return SIMD_SSE2;
+#elif defined(MATH_SSE)
+    return SIMD_SSE;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+static SIMDCapability SupportedSIMDCapability()
+{
+    const SIMDCapability detected = DetectSIMDCapability();
+    const SIMDCapability built = BuildSIMDCapability();
+    return detected < built ? detected : built;
+}
+
+#ifdef MATH_SIMD_DISPATCH
+SIMDKernels simdKernels;
+#endif
+
+static void SelectKernels(SIMDCapability capability)
+{
+#ifdef MATH_SIMD_DISPATCH
+    SIMDKernels kernels = {};
+    if (capability >= SIMD_SSE2)
+    {
+        kernels.mat4x4Mul = Mat4x4Mul_SSE2;
+        kernels.mat3x4Mul = Mat3x4Mul_SSE2;
+        kernels.quatMul = QuatMul_SSE2;
+    }
+#ifdef MATH_SIMD_DISPATCH_AVX
+    if (capability >= SIMD_AVX)
+        kernels.mat4x4Mul = Mat4x4Mul_AVX;
+#endif
+    simdKernels = kernels;
+#else
+    (void)capability;
+#endif
+}
+
+static SIMDCapability InitSIMDCapability()
+{
+    const SIMDCapability capability = SupportedSIMDCapability();
+    SelectKernels(capability);
+    return capability;
+}
+
+/// Dynamically initialized, so before the static initialization of this file is done this is SIMD_NONE and the scalar path is used.
+static SIMDCapability activeSIMDCapability = InitSIMDCapability();
+
+SIMDCapability ActiveSIMDCapability()
+{
+    return activeSIMDCapability;
+}
+
+bool SetActiveSIMDCapability(SIMDCapability capability)
+{
+    if (capability > SupportedSIMDCapability())
+        return false;
+    activeSIMDCapability = capability;
+    SelectKernels(capability);
+    return true;
+}
+
+const char *SIMDCapabilityToString(SIMDCapability capability)
+{
+    switch(capability)
+    {
+    case SIMD_NONE: return "None";
+    case SIMD_SSE: return "SSE";
+    case SIMD_SSE2: return "SSE2";
+    case SIMD_SSE41: return "SSE4.1";
+    case SIMD_AVX: return "AVX";
+    default: return "Unknown";
+    }
+}
+
+MATH_END_NAMESPACE
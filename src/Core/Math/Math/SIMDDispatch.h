@@ -0,0 +1,70 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   SIMDDispatch.h
+    @brief  Detection of the SIMD instruction sets of the CPU, and the SIMD kernels chosen at startup for the hot paths of the library. */
+
+#pragma once
+
+#include "Math/MathNamespace.h"
+
+MATH_BEGIN_NAMESPACE
+
+/// SIMD instruction set levels, in increasing order.
+enum SIMDCapability
+{
+    SIMD_NONE,
+    SIMD_SSE,
+    SIMD_SSE2,
+    SIMD_SSE41,
+    SIMD_AVX
+};
+
+/// Returns the highest SIMD instruction set level the CPU and the OS support.
+/** AVX is reported only if the OS saves the AVX registers on context switches. */
+SIMDCapability DetectSIMDCapability();
+
+/// Returns the SIMD instruction set level the library uses.
+/** This is the level detected at startup, capped to the highest level the library was built with. */
+SIMDCapability ActiveSIMDCapability();
+
+/// Changes the SIMD instruction set level the library uses, f.ex. to compare the kernels against the scalar path.
+/** Not thread-safe, call only when no other thread is using the library.
+    A TriangleMesh must be Set() again after this, as its vertex data layout depends on the level.
+    @return False, and the level is not changed, if the CPU or the build does not support @c capability. */
+bool SetActiveSIMDCapability(SIMDCapability capability);
+
+/// Returns the name of a SIMD instruction set level, f.ex. "SSE4.1".
+const char *SIMDCapabilityToString(SIMDCapability capability);
+
+#ifdef MATH_SIMD_DISPATCH
+
+/// The SIMD kernels of the hot paths chosen for the active SIMD instruction set level.
+/** The matrices are passed as row-major floats and the quaternions as xyzw. The output may alias either of the inputs.
+    A null kernel means that the scalar path is used. */
+struct SIMDKernels
+{
+    /// out = lhs * rhs for 4x4 matrices.
+    void (*mat4x4Mul)(float *out, const float *lhs, const float *rhs);
+    /// out = lhs * rhs for 3x4 affine matrices, the fourth row of which is implicitly (0, 0, 0, 1).
+    void (*mat3x4Mul)(float *out, const float *lhs, const float *rhs);
+    /// out = lhs * rhs for quaternions.
+    void (*quatMul)(float *out, const float *lhs, const float *rhs);
+};
+
+/// The kernels of the active SIMD instruction set level. Filled in during static initialization, all null before that.
+extern SIMDKernels simdKernels;
+
+// Implemented in SIMDKernels_SSE2.cpp
+void Mat4x4Mul_SSE2(float *out, const float *lhs, const float *rhs);
+void Mat3x4Mul_SSE2(float *out, const float *lhs, const float *rhs);
+void QuatMul_SSE2(float *out, const float *lhs, const float *rhs);
+
+#ifdef MATH_SIMD_DISPATCH_AVX
+// Implemented in SIMDKernels_AVX.cpp
+void Mat4x4Mul_AVX(float *out, const float *lhs, const float *rhs);
+#endif
+
+#endif
+
+MATH_END_NAMESPACE
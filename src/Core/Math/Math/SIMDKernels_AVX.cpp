@@ -0,0 +1,45 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   SIMDKernels_AVX.cpp
+    @brief  AVX kernels of the hot paths, chosen at startup if the CPU and the OS support AVX. See SIMDDispatch.h.
+    @note   Compiled with the AVX instruction set enabled, so include only what the kernels need: an inline function
+            emitted in this file could be picked by the linker for the rest of the library, and crash on older CPUs. */
+
+#include "Math/SIMDDispatch.h"
+
+#ifdef MATH_SIMD_DISPATCH_AVX
+
+#include <immintrin.h>
+
+MATH_BEGIN_NAMESPACE
+
+void Mat4x4Mul_AVX(float *out, const float *lhs, const float *rhs)
+{
+    // Each row of rhs in both 128-bit lanes, so that two rows of the result are computed at once.
+    const __m256 r0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(rhs));
+    const __m256 r1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(rhs + 4));
+    const __m256 r2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(rhs + 8));
+    const __m256 r3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(rhs + 12));
+
+    __m256 rows[2];
+    for(int i = 0; i < 2; ++i)
+    {
+        const __m256 l = _mm256_loadu_ps(lhs + 8*i); // Rows 2i and 2i+1 of lhs.
+        __m256 row = _mm256_mul_ps(_mm256_permute_ps(l, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+        row = _mm256_add_ps(row, _mm256_mul_ps(_mm256_permute_ps(l, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+        row = _mm256_add_ps(row, _mm256_mul_ps(_mm256_permute_ps(l, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+        rows[i] = _mm256_add_ps(row, _mm256_mul_ps(_mm256_permute_ps(l, _MM_SHUFFLE(3, 3, 3, 3)), r3));
+    }
+
+    // Store only after all the inputs have been read, as out may alias them.
+    _mm256_storeu_ps(out, rows[0]);
+    _mm256_storeu_ps(out + 8, rows[1]);
+
+    // Avoid the penalty of mixing AVX and legacy SSE code in the caller.
+    _mm256_zeroupper();
+}
+
+MATH_END_NAMESPACE
+
+#endif
@@ -0,0 +1,80 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   SIMDKernels_SSE2.cpp
+    @brief  SSE2 kernels of the hot paths, chosen at startup if the CPU supports SSE2. See SIMDDispatch.h.
+    @note   Compiled with the SSE2 instruction set enabled, so include only what the kernels need: an inline function
+            emitted in this file could be picked by the linker for the rest of the library. */
+
+#include "Math/SIMDDispatch.h"
+
+#ifdef MATH_SIMD_DISPATCH
+
+#include <emmintrin.h>
+
+MATH_BEGIN_NAMESPACE
+
+void Mat4x4Mul_SSE2(float *out, const float *lhs, const float *rhs)
+{
+    const __m128 r0 = _mm_loadu_ps(rhs);
+    const __m128 r1 = _mm_loadu_ps(rhs + 4);
+    const __m128 r2 = _mm_loadu_ps(rhs + 8);
+    const __m128 r3 = _mm_loadu_ps(rhs + 12);
+
+    __m128 rows[4];
+    for(int i = 0; i < 4; ++i)
+    {
+        const float *l = lhs + 4*i;
+        __m128 row = _mm_mul_ps(_mm_set1_ps(l[0]), r0);
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(l[1]), r1));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(l[2]), r2));
+        rows[i] = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(l[3]), r3));
+    }
+
+    // Store only after all the inputs have been read, as out may alias them.
+    for(int i = 0; i < 4; ++i)
+        _mm_storeu_ps(out + 4*i, rows[i]);
+}
+
+void Mat3x4Mul_SSE2(float *out, const float *lhs, const float *rhs)
+{
+    const __m128 r0 = _mm_loadu_ps(rhs);
+    const __m128 r1 = _mm_loadu_ps(rhs + 4);
+    const __m128 r2 = _mm_loadu_ps(rhs + 8);
+
+    __m128 rows[3];
+    for(int i = 0; i < 3; ++i)
+    {
+        const float *l = lhs + 4*i;
+        __m128 row = _mm_mul_ps(_mm_set1_ps(l[0]), r0);
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(l[1]), r1));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(l[2]), r2));
+        rows[i] = _mm_add_ps(row, _mm_set_ps(l[3], 0.f, 0.f, 0.f)); // The fourth row of rhs is (0, 0, 0, 1).
+    }
+
+    for(int i = 0; i < 3; ++i)
+        _mm_storeu_ps(out + 4*i, rows[i]);
+}
+
+void QuatMul_SSE2(float *out, const float *lhs, const float *rhs)
+{
+    const __m128 r = _mm_loadu_ps(rhs); // (x, y, z, w)
+
+    // (w*r.x + x*r.w + y*r.z - z*r.y,
+    //  w*r.y - x*r.z + y*r.w + z*r.x,
+    //  w*r.z + x*r.y - y*r.x + z*r.w,
+    //  w*r.w - x*r.x - y*r.y - z*r.z)
+    const __m128 rWZYX = _mm_xor_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(0, 1, 2, 3)), _mm_set_ps(-0.f, 0.f, -0.f, 0.f));
+    const __m128 rZWXY = _mm_xor_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 0, 3, 2)), _mm_set_ps(-0.f, -0.f, 0.f, 0.f));
+    const __m128 rYXWZ = _mm_xor_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 3, 0, 1)), _mm_set_ps(-0.f, 0.f, 0.f, -0.f));
+
+    __m128 q = _mm_mul_ps(_mm_set1_ps(lhs[3]), r);
+    q = _mm_add_ps(q, _mm_mul_ps(_mm_set1_ps(lhs[0]), rWZYX));
+    q = _mm_add_ps(q, _mm_mul_ps(_mm_set1_ps(lhs[1]), rZWXY));
+    q = _mm_add_ps(q, _mm_mul_ps(_mm_set1_ps(lhs[2]), rYXWZ));
+    _mm_storeu_ps(out, q);
+}
+
+MATH_END_NAMESPACE
+
+#endif
@@ -29,6 +29,7 @@
 #include "Geometry/Plane.h"
 #include "TransformOps.h"
 #include "SSEMath.h"
+#include "SIMDDispatch.h"
 
 #ifdef MATH_ENABLE_STL_SUPPORT
 #include <iostream>
@@ -1230,6 +1231,13 @@ float3x4 float3x4::operator *(const float3x4 &rhs) const
 #ifdef MATH_SSE
 	_mm_mat3x4_mul_ps(r.row, row, rhs.row);
 #else
+#ifdef MATH_SIMD_DISPATCH
+	if (simdKernels.mat3x4Mul)
+	{
+		simdKernels.mat3x4Mul(r.ptr(), ptr(), rhs.ptr());
+		return r;
+	}
+#endif
 	const float *c0 = rhs.ptr();
 	const float *c1 = rhs.ptr() + 1;
 	const float *c2 = rhs.ptr() + 2;
@@ -29,6 +29,7 @@
 #include "Geometry/Plane.h"
 #include "Algorithm/Random/LCG.h"
 #include "SSEMath.h"
+#include "SIMDDispatch.h"
 
 #ifdef MATH_ENABLE_STL_SUPPORT
 #include <iostream>
@@ -1626,6 +1627,13 @@ float4x4 float4x4::operator *(const float4x4 &rhs) const
 #ifdef MATH_AUTOMATIC_SSE
 	_mm_mat4x4_mul_ps(r.row, this->row, rhs.row);
 #else
+#ifdef MATH_SIMD_DISPATCH
+	if (simdKernels.mat4x4Mul)
+	{
+		simdKernels.mat4x4Mul(r.ptr(), ptr(), rhs.ptr());
+		return r;
+	}
+#endif
 	const float *c0 = rhs.ptr();
 	const float *c1 = rhs.ptr() + 1;
 	const float *c2 = rhs.ptr() + 2;
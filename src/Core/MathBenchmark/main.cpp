@@ -0,0 +1,234 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   main.cpp
+    @brief  Micro-benchmark of the MathGeoLib hot paths. Runs each benchmark with the scalar path and with the SIMD kernels
+            of each instruction set level the CPU supports, and checks that they all compute the same results. */
+
+#include "Math/float3.h"
+#include "Math/float3x4.h"
+#include "Math/float4x4.h"
+#include "Math/Quat.h"
+#include "Math/MathFunc.h"
+#include "Math/SIMDDispatch.h"
+#include "Geometry/Ray.h"
+#include "Geometry/Triangle.h"
+#include "Geometry/TriangleMesh.h"
+#include "Algorithm/Random/LCG.h"
+#include "Time/Clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+
+const int cNumElements = 1024; ///< Number of operations in one round of the matrix and quaternion benchmarks.
+const int cNumTriangles = 1000;
+const int cNumRays = 64; ///< Number of ray intersections in one round of the ray benchmark.
+const int cRayRoundDivisor = 16; ///< The ray benchmark is run for 1/cRayRoundDivisor of the rounds, as one ray tests all the triangles.
+
+std::vector<float4x4> mat4x4s; ///< cNumElements left-hand operands followed by cNumElements right-hand operands.
+std::vector<float3x4> mat3x4s; ///< cNumElements left-hand operands followed by cNumElements right-hand operands.
+std::vector<Quat> quats; ///< cNumElements left-hand operands followed by cNumElements right-hand operands.
+std::vector<float3> positions;
+std::vector<float3> scales;
+std::vector<Triangle> triangles;
+std::vector<Ray> rays;
+
+void GenerateData()
+{
+    LCG lcg(1234);
+    for(int i = 0; i < 2 * cNumElements; ++i)
+    {
+        mat4x4s.push_back(float4x4::RandomGeneral(lcg, -1.f, 1.f));
+        mat3x4s.push_back(float3x4::RandomGeneral(lcg, -1.f, 1.f));
+        quats.push_back(Quat::RandomRotation(lcg));
+    }
+    for(int i = 0; i < cNumElements; ++i)
+    {
+        positions.push_back(float3::RandomBox(lcg, -10.f, 10.f, -10.f, 10.f, -10.f, 10.f));
+        scales.push_back(float3::RandomBox(lcg, 0.5f, 2.f, 0.5f, 2.f, 0.5f, 2.f));
+    }
+    for(int i = 0; i < cNumTriangles; ++i)
+    {
+        const float3 center = float3::RandomBox(lcg, -10.f, 10.f, -10.f, 10.f, -10.f, 10.f);
+        triangles.push_back(Triangle(center + float3::RandomDir(lcg), center + float3::RandomDir(lcg), center + float3::RandomDir(lcg)));
+    }
+    // Aim the rays at the triangles, so that most of them hit something.
+    for(int i = 0; i < cNumRays; ++i)
+    {
+        const Triangle &target = triangles[lcg.Int(0, cNumTriangles - 1)];
+        const float3 pos = float3::RandomBox(lcg, -20.f, 20.f, -20.f, 20.f, -20.f, 20.f);
+        rays.push_back(Ray(pos, ((target.a + target.b + target.c) / 3.f - pos).Normalized()));
+    }
+}
+
+/// Runs a benchmark. @return The elapsed time in milliseconds. @param checksum [out] Sum of the results, to compare the SIMD levels.
+typedef double (*BenchmarkFunc)(int rounds, float &checksum);
+
+double Mat4x4Mul(int rounds, float &checksum)
+{
+    std::vector<float4x4> out(cNumElements);
+    const tick_t start = Clock::Tick();
+    for(int r = 0; r < rounds; ++r)
+        for(int i = 0; i < cNumElements; ++i)
+            out[i] = mat4x4s[i] * mat4x4s[cNumElements + i];
+    const double elapsed = Clock::MillisecondsSinceD(start);
+
+    checksum = 0.f;
+    for(int i = 0; i < cNumElements; ++i)
+        for(int j = 0; j < 16; ++j)
+            checksum += out[i].ptr()[j];
+    return elapsed;
+}
+
+double Mat3x4Mul(int rounds, float &checksum)
+{
+    std::vector<float3x4> out(cNumElements);
+    const tick_t start = Clock::Tick();
+    for(int r = 0; r < rounds; ++r)
+        for(int i = 0; i < cNumElements; ++i)
+            out[i] = mat3x4s[i] * mat3x4s[cNumElements + i];
+    const double elapsed = Clock::MillisecondsSinceD(start);
+
+    checksum = 0.f;
+    for(int i = 0; i < cNumElements; ++i)
+        for(int j = 0; j < 12; ++j)
+            checksum += out[i].ptr()[j];
+    return elapsed;
+}
+
+double QuatMul(int rounds, float &checksum)
+{
+    std::vector<Quat> out(cNumElements);
+    const tick_t start = Clock::Tick();
+    for(int r = 0; r < rounds; ++r)
+        for(int i = 0; i < cNumElements; ++i)
+            out[i] = quats[i] * quats[cNumElements + i];
+    const double elapsed = Clock::MillisecondsSinceD(start);
+
+    checksum = 0.f;
+    for(int i = 0; i < cNumElements; ++i)
+        checksum += out[i].x + out[i].y + out[i].z + out[i].w;
+    return elapsed;
+}
+
+/// Composes the world transform of a child from the parent's world transform and the child's local position, rotation and scale.
+double TransformCompose(int rounds, float &checksum)
+{
+    std::vector<float3x4> out(cNumElements);
+    const tick_t start = Clock::Tick();
+    for(int r = 0; r < rounds; ++r)
+        for(int i = 0; i < cNumElements; ++i)
+            out[i] = mat3x4s[i] * float3x4::FromTRS(positions[i], quats[i], scales[i]);
+    const double elapsed = Clock::MillisecondsSinceD(start);
+
+    checksum = 0.f;
+    for(int i = 0; i < cNumElements; ++i)
+        for(int j = 0; j < 12; ++j)
+            checksum += out[i].ptr()[j];
+    return elapsed;
+}
+
+double RayTriangleMesh(int rounds, float &checksum)
+{
+    // The vertex data layout of the mesh depends on the active SIMD level.
+    TriangleMesh mesh;
+    mesh.Set(&triangles[0], cNumTriangles);
+
+    std::vector<float> distances(cNumRays);
+    const tick_t start = Clock::Tick();
+    for(int r = 0; r < rounds / cRayRoundDivisor; ++r)
+        for(int i = 0; i < cNumRays; ++i)
+        {
+            int triangleIndex;
+            float u, v;
+            distances[i] = mesh.IntersectRay_TriangleIndex_UV(rays[i], triangleIndex, u, v);
+        }
+    const double elapsed = Clock::MillisecondsSinceD(start);
+
+    checksum = 0.f;
+    for(int i = 0; i < cNumRays; ++i)
+        if (IsFinite(distances[i]))
+            checksum += distances[i];
+    return elapsed;
+}
+
+struct Benchmark
+{
+    const char *name;
+    BenchmarkFunc func;
+    int opsPerRound;
+    int roundDivisor;
+};
+
+const Benchmark benchmarks[] =
+{
+    { "float4x4 * float4x4", Mat4x4Mul, cNumElements, 1 },
+    { "float3x4 * float3x4", Mat3x4Mul, cNumElements, 1 },
+    { "Quat * Quat", QuatMul, cNumElements, 1 },
+    { "float3x4 * FromTRS", TransformCompose, cNumElements, 1 },
+    { "Ray vs. 1000 triangles", RayTriangleMesh, cNumRays, cRayRoundDivisor }
+};
+const int cNumBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+const SIMDCapability levels[] = { SIMD_NONE, SIMD_SSE2, SIMD_SSE41, SIMD_AVX };
+const int cNumLevels = sizeof(levels) / sizeof(levels[0]);
+
+}
+
+int main(int argc, char **argv)
+{
+    const int rounds = (argc > 1 ? atoi(argv[1]) : 1000);
+    if (rounds < cRayRoundDivisor)
+    {
+        printf("Usage: MathBenchmark [rounds]\nThe number of rounds must be at least %d, default 1000.\n", cRayRoundDivisor);
+        return 1;
+    }
+
+    GenerateData();
+
+    const SIMDCapability startupLevel = ActiveSIMDCapability();
+    printf("CPU supports %s, using %s by default. %d rounds.\n\n", SIMDCapabilityToString(DetectSIMDCapability()),
+        SIMDCapabilityToString(startupLevel), rounds);
+    printf("%-24s", "ns/op");
+    for(int l = 0; l < cNumLevels; ++l)
+        printf("%10s", SIMDCapabilityToString(levels[l]));
+    printf("\n");
+
+    int numMismatches = 0;
+    for(int b = 0; b < cNumBenchmarks; ++b)
+    {
+        const Benchmark &benchmark = benchmarks[b];
+        printf("%-24s", benchmark.name);
+        float scalarChecksum = 0.f;
+        for(int l = 0; l < cNumLevels; ++l)
+        {
+            if (!SetActiveSIMDCapability(levels[l]))
+            {
+                printf("%10s", "-");
+                continue;
+            }
+
+            float checksum = 0.f;
+            const double elapsed = benchmark.func(rounds, checksum);
+            const double numOps = (double)(rounds / benchmark.roundDivisor) * benchmark.opsPerRound;
+            printf("%10.2f", elapsed * 1e6 / numOps);
+
+            // The SIMD kernels sum in a different order, and the ray kernels use an approximate reciprocal.
+            if (levels[l] == SIMD_NONE)
+                scalarChecksum = checksum;
+            else if (!EqualRel(checksum, scalarChecksum, 1e-3f))
+            {
+                printf(" (mismatch: %f vs. %f)", checksum, scalarChecksum);
+                ++numMismatches;
+            }
+        }
+        printf("\n");
+    }
+
+    SetActiveSIMDCapability(startupLevel);
+    return numMismatches == 0 ? 0 : 1;
+}
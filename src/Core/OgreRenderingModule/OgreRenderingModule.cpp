@@ -80,7 +80,7 @@ void Profiler_EndBlock()
     {
         ProfilerNodeTree *treeNode = p->CurrentNode();
         if (treeNode)
-            p->EndBlock(treeNode->Name());
+            p->EndBlock(treeNode->BlockId());
     }
 #endif
 }
@@ -375,10 +375,10 @@ uint OgreWorld::MeshInstanceCount(const QString &meshRef)
         return 64;
 
     uint count = 0;
-    Entity::ComponentVector components = scene_.lock()->Components(EC_Mesh::TypeIdStatic());
-    for (Entity::ComponentVector::const_iterator iter = components.begin(); iter != components.end(); ++iter)
+    const std::vector<IComponent*> &components = scene_.lock()->ComponentsOfType(EC_Mesh::TypeIdStatic());
+    for (std::vector<IComponent*>::const_iterator iter = components.begin(); iter != components.end(); ++iter)
     {
-        EC_Mesh *mesh = dynamic_cast<EC_Mesh*>((*iter).get());
+        EC_Mesh *mesh = dynamic_cast<EC_Mesh*>(*iter);
         if (!mesh)
             continue;
         // Check self resolved/sanitated mesh ref. If we were to use mesh->OgreEntity()->getMesh()->getName()
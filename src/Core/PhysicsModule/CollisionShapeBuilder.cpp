@@ -0,0 +1,156 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#define MATH_BULLET_INTEROP
+#include "DebugOperatorNew.h"
+
+#include "CollisionShapeBuilder.h"
+#include "CollisionShapeUtils.h"
+#include "ConvexHull.h"
+
+// Disable unreferenced formal parameter coming from Bullet
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#endif
+#include <btBulletDynamicsCommon.h>
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#include <QThread>
+#include <QFile>
+
+#include "MemoryLeakCheck.h"
+
+using namespace Physics;
+
+class CollisionShapeBuilder::BuildThread : public QThread
+{
+public:
+    explicit BuildThread(CollisionShapeBuilder *builder) : builder_(builder) {}
+
+protected:
+    void run() { builder_->ThreadMain(); }
+
+private:
+    CollisionShapeBuilder *builder_;
+};
+
+CollisionShapeBuilder::CollisionShapeBuilder(size_t numThreads) :
+    numBuilding_(0),
+    quit_(false)
+{
+    if (numThreads < 1)
+        numThreads = 1;
+    for(size_t i = 0; i < numThreads; ++i)
+    {
+        BuildThread *thread = new BuildThread(this);
+        threads_.push_back(thread);
+        thread->start(QThread::LowPriority);
+    }
+}
+
+CollisionShapeBuilder::~CollisionShapeBuilder()
+{
+    {
+        QMutexLocker lock(&mutex_);
+        quit_ = true;
+        jobs_.clear();
+        jobAvailable_.wakeAll();
+    }
+    for(size_t i = 0; i < threads_.size(); ++i)
+    {
+        threads_[i]->wait();
+        delete threads_[i];
+    }
+}
+
+void CollisionShapeBuilder::Build(const Job &job)
+{
+    QMutexLocker lock(&mutex_);
+    jobs_.push_back(job);
+    jobAvailable_.wakeOne();
+}
+
+void CollisionShapeBuilder::TakeFinished(std::vector<Result> &results)
+{
+    QMutexLocker lock(&mutex_);
+    if (finished_.empty())
+        return;
+    size_t first = results.size();
+    results.resize(first + finished_.size());
+    for(size_t i = 0; i < finished_.size(); ++i)
+        results[first + i].Swap(finished_[i]);
+    finished_.clear();
+}
+
+size_t CollisionShapeBuilder::NumPending() const
+{
+    QMutexLocker lock(&mutex_);
+    return jobs_.size() + numBuilding_ + finished_.size();
+}
+
+void CollisionShapeBuilder::ThreadMain()
+{
+    for(;;)
+    {
+        Job job;
+        {
+            QMutexLocker lock(&mutex_);
+            while(!quit_ && jobs_.empty())
+                jobAvailable_.wait(&mutex_);
+            if (quit_)
+                return;
+            job = jobs_.front();
+            jobs_.pop_front();
+            ++numBuilding_;
+        }
+
+        Result result;
+        BuildShape(job, result);
+        job.triangles.reset(); // Release the triangles in this thread if this was the last job of the mesh.
+
+        QMutexLocker lock(&mutex_);
+        --numBuilding_;
+        finished_.push_back(Result());
+        finished_.back().Swap(result);
+    }
+}
+
+void CollisionShapeBuilder::BuildShape(const Job &job, Result &result)
+{
+    result.meshName = job.meshName;
+    result.kind = job.kind;
+
+    if (job.kind == ConvexHullSetShape)
+    {
+        result.convexHullSet = MAKE_SHARED(ConvexHullSet);
+        const char *error = GenerateConvexHullSet(*job.triangles, result.convexHullSet.get());
+        if (error)
+            result.error = error;
+        return;
+    }
+
+#include "DisableMemoryLeakCheck.h"
+    result.triangleMesh = MAKE_SHARED(btTriangleMesh);
+#include "EnableMemoryLeakCheck.h"
+    GenerateTriangleMesh(*job.triangles, result.triangleMesh.get());
+
+    // An empty mesh has nothing worth caching.
+    QString cacheName;
+    if (!job.bvhCacheDirectory.isEmpty() && result.triangleMesh->getNumTriangles() > 0)
+    {
+        cacheName = BvhCacheName(result.triangleMesh.get());
+        QFile file(job.bvhCacheDirectory + cacheName);
+        if (file.open(QIODevice::ReadOnly))
+            result.bvhShape = shared_ptr<btBvhTriangleMeshShape>(DeserializeBvhTriangleMeshShape(result.triangleMesh, file.readAll()));
+    }
+
+    if (!result.bvhShape)
+    {
+        result.bvhShape = shared_ptr<btBvhTriangleMeshShape>(CreateBvhTriangleMeshShape(result.triangleMesh));
+        if (!cacheName.isEmpty() && SerializeBvh(result.bvhShape.get(), result.bvhCacheData))
+            result.bvhCacheName = cacheName;
+    }
+}
@@ -0,0 +1,108 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "PhysicsModuleApi.h"
+#include "PhysicsModuleFwd.h"
+#include "Math/float3.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+
+/// Fixed-size thread pool which builds the collision shapes of meshes in the background for PhysicsModule.
+/** Builds are queued from the main thread with Build(), and their results are collected with TakeFinished().
+    The triangles are extracted from the Ogre mesh in the main thread before queuing: the worker threads only
+    run Bullet and StanHull on them and read cached BVHs from disk. They never log, or touch Ogre or the asset API. */
+class PHYSICS_MODULE_API CollisionShapeBuilder
+{
+public:
+    /// Kind of collision shape built from a mesh.
+    enum ShapeKind
+    {
+        TriangleMeshShape, ///< btTriangleMesh and a BVH triangle mesh shape for it.
+        ConvexHullSetShape
+    };
+
+    /// A collision shape to build.
+    struct Job
+    {
+        std::string meshName;
+        ShapeKind kind;
+        shared_ptr<const std::vector<float3> > triangles; ///< Triangle list as returned by GetTrianglesFromMesh. Shared by the jobs of the same mesh.
+        QString bvhCacheDirectory; ///< Asset cache directory to look for a cached BVH in, or empty if the asset cache is not used.
+    };
+
+    /// A built collision shape.
+    struct Result
+    {
+        Result() : kind(TriangleMeshShape) {}
+
+        /// Exchanges the contents with @c rhs, so that results are handed over without copying the BVH data.
+        void Swap(Result &rhs)
+        {
+            meshName.swap(rhs.meshName);
+            std::swap(kind, rhs.kind);
+            triangleMesh.swap(rhs.triangleMesh);
+            bvhShape.swap(rhs.bvhShape);
+            convexHullSet.swap(rhs.convexHullSet);
+            std::swap(error, rhs.error);
+            std::swap(bvhCacheName, rhs.bvhCacheName);
+            bvhCacheData.swap(rhs.bvhCacheData);
+        }
+
+        std::string meshName;
+        ShapeKind kind;
+        shared_ptr<btTriangleMesh> triangleMesh; ///< Set for TriangleMeshShape.
+        shared_ptr<btBvhTriangleMeshShape> bvhShape; ///< Set for TriangleMeshShape.
+        shared_ptr<ConvexHullSet> convexHullSet; ///< Set for ConvexHullSetShape, may be empty if building failed.
+        QString error; ///< Reason of the failure, if building failed.
+        QString bvhCacheName; ///< If nonempty, the BVH was built, and bvhCacheData should be stored to the asset cache with this name.
+        std::vector<u8> bvhCacheData;
+    };
+
+    /// Starts the worker threads.
+    /** @param numThreads Number of worker threads, at least one thread is started. */
+    explicit CollisionShapeBuilder(size_t numThreads);
+    /// Stops and joins the worker threads. Unfinished builds are discarded.
+    ~CollisionShapeBuilder();
+
+    /// Returns number of worker threads.
+    size_t NumThreads() const { return threads_.size(); }
+
+    /// Queues a build.
+    void Build(const Job &job);
+
+    /// Appends the results of the builds finished so far to @c results, and forgets them.
+    void TakeFinished(std::vector<Result> &results);
+
+    /// Returns number of builds that are queued or in progress, or finished but not yet taken.
+    size_t NumPending() const;
+
+    /// Builds the shape of @c job in the calling thread.
+    static void BuildShape(const Job &job, Result &result);
+
+private:
+    class BuildThread;
+    friend class BuildThread;
+
+    /// Worker thread main loop.
+    void ThreadMain();
+
+    mutable QMutex mutex_;
+    QWaitCondition jobAvailable_;
+    std::deque<Job> jobs_;
+    std::deque<Result> finished_; ///< A deque, so that pushing does not copy the results already in it.
+    size_t numBuilding_; ///< Number of jobs taken by the threads but not yet finished.
+    bool quit_;
+    std::vector<BuildThread*> threads_;
+
+    // Noncopyable
+    CollisionShapeBuilder(const CollisionShapeBuilder &);
+    void operator =(const CollisionShapeBuilder &);
+};
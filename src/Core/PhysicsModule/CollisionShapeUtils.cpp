@@ -11,6 +11,11 @@
 
 #include <Ogre.h>
 
+#include <QCryptographicHash>
+#include <QMutex>
+
+#include <cstring>
+
 // Disable unreferenced formal parameter coming from Bullet
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -26,24 +31,84 @@
 namespace Physics
 {
 
+namespace
+{
+
+/// BVH triangle mesh shape which keeps its triangle mesh alive, and owns the buffer of a deserialized BVH.
+class SharedBvhTriangleMeshShape : public btBvhTriangleMeshShape
+{
+public:
+    /// Builds the BVH.
+    explicit SharedBvhTriangleMeshShape(const shared_ptr<btTriangleMesh> &mesh) :
+        btBvhTriangleMeshShape(mesh.get(), true, true),
+        triangleMesh(mesh),
+        bvhBuffer(0)
+    {
+    }
+
+    /// Uses a BVH deserialized in place to @c buffer. Takes ownership of the buffer, which must have been allocated with btAlignedAlloc.
+    SharedBvhTriangleMeshShape(const shared_ptr<btTriangleMesh> &mesh, btOptimizedBvh *bvh, void *buffer) :
+        btBvhTriangleMeshShape(mesh.get(), true, false),
+        triangleMesh(mesh),
+        bvhBuffer(buffer)
+    {
+        setOptimizedBvh(bvh);
+    }
+
+    ~SharedBvhTriangleMeshShape()
+    {
+        // The shape does not own a BVH set with setOptimizedBvh, and the deserialized BVH does not own its arrays.
+        if (bvhBuffer)
+            btAlignedFree(bvhBuffer);
+    }
+
+private:
+    shared_ptr<btTriangleMesh> triangleMesh;
+    void *bvhBuffer;
+};
+
+/// Header of a serialized BVH. The in-place serialized BVH follows it.
+struct BvhHeader
+{
+    u32 magic;
+    u32 bulletVersion;
+    u32 pointerSize; ///< The BVH is serialized with its vtable pointer, so it can only be read by a build of the same architecture.
+    u32 bvhSize;
+};
+
+const u32 cBvhMagic = 0x48564254; // "TBVH"
+
+/// StanHull keeps its working state in globals, so only one hull can be generated at a time.
+QMutex stanHullMutex;
+
+}
+
 void GenerateTriangleMesh(Ogre::Mesh* mesh, btTriangleMesh* ptr)
 {
     std::vector<float3> triangles;
     GetTrianglesFromMesh(mesh, triangles);
-    
-    for(uint i = 0; i < triangles.size(); i += 3)
-        ptr->addTriangle(triangles[i], triangles[i+1], triangles[i+2]);
+    GenerateTriangleMesh(triangles, ptr);
 }
 
 void GenerateConvexHullSet(Ogre::Mesh* mesh, ConvexHullSet* ptr)
 {
     std::vector<float3> vertices;
     GetTrianglesFromMesh(mesh, vertices);
+    const char *error = GenerateConvexHullSet(vertices, ptr);
+    if (error)
+        LogError(error);
+}
+
+void GenerateTriangleMesh(const std::vector<float3>& triangles, btTriangleMesh* ptr)
+{
+    for(uint i = 0; i < triangles.size(); i += 3)
+        ptr->addTriangle(triangles[i], triangles[i+1], triangles[i+2]);
+}
+
+const char *GenerateConvexHullSet(const std::vector<float3>& vertices, ConvexHullSet* ptr)
+{
     if (!vertices.size())
-    {
-        LogError("Mesh had no triangles; aborting convex hull generation");
-        return;
-    }
+        return "Mesh had no triangles; aborting convex hull generation";
     
     StanHull::HullDesc desc;
     desc.SetHullFlag(StanHull::QF_TRIANGLES);
@@ -52,15 +117,13 @@ void GenerateConvexHullSet(Ogre::Mesh* mesh, ConvexHullSet* ptr)
     desc.mVertexStride = sizeof(float3);
     desc.mSkinWidth = 0.01f; // Hardcoded skin width
     
+    QMutexLocker lock(&stanHullMutex);
     StanHull::HullLibrary lib;
     StanHull::HullResult result;
     lib.CreateConvexHull(desc, result);
 
     if (!result.mNumOutputVertices)
-    {
-        LogError("No vertices were generated; aborting convex hull generation");
-        return;
-    }
+        return "No vertices were generated; aborting convex hull generation";
     
     ConvexHull hull;
     hull.position_ = float3(0,0,0);
@@ -71,6 +134,78 @@ void GenerateConvexHullSet(Ogre::Mesh* mesh, ConvexHullSet* ptr)
     ptr->hulls_.push_back(hull);
     
     lib.ReleaseResult(result);
+    return 0;
+}
+
+btBvhTriangleMeshShape *CreateBvhTriangleMeshShape(const shared_ptr<btTriangleMesh>& mesh)
+{
+#include "DisableMemoryLeakCheck.h"
+    btBvhTriangleMeshShape *shape = new SharedBvhTriangleMeshShape(mesh);
+#include "EnableMemoryLeakCheck.h"
+    return shape;
+}
+
+btBvhTriangleMeshShape *DeserializeBvhTriangleMeshShape(const shared_ptr<btTriangleMesh>& mesh, const QByteArray& data)
+{
+    BvhHeader header;
+    if (data.size() < (int)sizeof(header))
+        return 0;
+    memcpy(&header, data.constData(), sizeof(header));
+    if (header.magic != cBvhMagic || header.bulletVersion != BT_BULLET_VERSION || header.pointerSize != sizeof(void*) ||
+        (size_t)data.size() != sizeof(header) + header.bvhSize)
+        return 0;
+
+    // The BVH is used in place from the buffer, which needs the alignment of a heap-allocated BVH.
+    void *buffer = btAlignedAlloc(header.bvhSize, 16);
+    memcpy(buffer, data.constData() + sizeof(header), header.bvhSize);
+    btOptimizedBvh *bvh = btOptimizedBvh::deSerializeInPlace(buffer, header.bvhSize, false);
+    if (!bvh)
+    {
+        btAlignedFree(buffer);
+        return 0;
+    }
+
+#include "DisableMemoryLeakCheck.h"
+    btBvhTriangleMeshShape *shape = new SharedBvhTriangleMeshShape(mesh, bvh, buffer);
+#include "EnableMemoryLeakCheck.h"
+    return shape;
+}
+
+bool SerializeBvh(btBvhTriangleMeshShape* shape, std::vector<u8>& dest)
+{
+    btOptimizedBvh *bvh = shape->getOptimizedBvh();
+    if (!bvh)
+        return false;
+
+    BvhHeader header;
+    header.magic = cBvhMagic;
+    header.bulletVersion = BT_BULLET_VERSION;
+    header.pointerSize = sizeof(void*);
+    header.bvhSize = bvh->calculateSerializeBufferSize();
+
+    void *buffer = btAlignedAlloc(header.bvhSize, 16);
+    bool success = bvh->serializeInPlace(buffer, header.bvhSize, false);
+    if (success)
+    {
+        dest.resize(sizeof(header) + header.bvhSize);
+        memcpy(&dest[0], &header, sizeof(header));
+        memcpy(&dest[sizeof(header)], buffer, header.bvhSize);
+    }
+    btAlignedFree(buffer);
+    return success;
+}
+
+QString BvhCacheName(btTriangleMesh* mesh)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const IndexedMeshArray &parts = mesh->getIndexedMeshArray();
+    for(int i = 0; i < parts.size(); ++i)
+    {
+        const btIndexedMesh &part = parts[i];
+        hash.addData(reinterpret_cast<const char*>(part.m_vertexBase), part.m_numVertices * part.m_vertexStride);
+        hash.addData(reinterpret_cast<const char*>(part.m_triangleIndexBase), part.m_numTriangles * part.m_triangleIndexStride);
+    }
+    return "bvh_" + QString(hash.result().toHex()) + ".bullet";
 }
 
 void GetTrianglesFromMesh(Ogre::Mesh* mesh, std::vector<float3>& dest)
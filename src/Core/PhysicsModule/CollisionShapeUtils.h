@@ -7,6 +7,10 @@
 #include "PhysicsModuleFwd.h"
 #include "Math/float3.h"
 
+#include <QString>
+#include <QByteArray>
+#include <vector>
+
 namespace Ogre { class Mesh; };
 
 namespace Physics
@@ -14,4 +18,24 @@ namespace Physics
     void PHYSICS_MODULE_API GenerateTriangleMesh(Ogre::Mesh* mesh, btTriangleMesh* ptr);
     void PHYSICS_MODULE_API GetTrianglesFromMesh(Ogre::Mesh* mesh, std::vector<float3>& dest);
     void PHYSICS_MODULE_API GenerateConvexHullSet(Ogre::Mesh* mesh, ConvexHullSet* ptr);
+
+    // The functions below do not touch Ogre or log, so they can be called from any thread.
+
+    /// Fills a triangle mesh from a triangle list returned by GetTrianglesFromMesh.
+    void PHYSICS_MODULE_API GenerateTriangleMesh(const std::vector<float3>& triangles, btTriangleMesh* ptr);
+    /// Generates a convex hull set from a triangle list returned by GetTrianglesFromMesh.
+    /** StanHull is not reentrant, so concurrent calls are serialized.
+        @return Null if succeeded, otherwise the reason of the failure. */
+    PHYSICS_MODULE_API const char *GenerateConvexHullSet(const std::vector<float3>& triangles, ConvexHullSet* ptr);
+
+    /// Creates a BVH triangle mesh shape for @c mesh and builds its BVH. The shape keeps the mesh alive.
+    PHYSICS_MODULE_API btBvhTriangleMeshShape *CreateBvhTriangleMeshShape(const shared_ptr<btTriangleMesh>& mesh);
+    /// Creates a BVH triangle mesh shape for @c mesh using a BVH serialized with SerializeBvh, instead of building the BVH.
+    /** @return Null if @c data is not a BVH usable by this build. */
+    PHYSICS_MODULE_API btBvhTriangleMeshShape *DeserializeBvhTriangleMeshShape(const shared_ptr<btTriangleMesh>& mesh, const QByteArray& data);
+    /// Serializes the BVH of @c shape for DeserializeBvhTriangleMeshShape. @return False if the shape has no BVH.
+    bool PHYSICS_MODULE_API SerializeBvh(btBvhTriangleMeshShape* shape, std::vector<u8>& dest);
+    /// Returns the asset cache name for the BVH of a triangle mesh.
+    /** The name is a hash of the triangles, so a changed mesh never uses a stale BVH. */
+    QString PHYSICS_MODULE_API BvhCacheName(btTriangleMesh* mesh);
 }
@@ -44,7 +44,6 @@ struct EC_RigidBody::Impl : public btMotionState
         body(0),
         world(0),
         shape(0),
-        childShape(0),
         heightField(0),
         disconnected(false),
         cachedShapeType(-1),
@@ -177,8 +176,8 @@ struct EC_RigidBody::Impl : public btMotionState
     btRigidBody* body;
     /// Bullet collision shape
     btCollisionShape* shape;
-    /// Bullet collision child shape. This is needed to use btScaledBvhTriangleMeshShape
-    btCollisionShape* childShape;
+    /// Bullet BVH triangle mesh shape, shared between all rigid bodies using the same mesh. Wrapped in a btScaledBvhTriangleMeshShape (impl->shape) for individual scaling.
+    shared_ptr<btBvhTriangleMeshShape> bvhShape;
     /// Physics world. May be 0 if the scene does not have a physics world. In that case most of EC_RigidBody's functionality is a no-op
     PhysicsWorld* world;
     /// PhysicsModule pointer
@@ -187,10 +186,10 @@ struct EC_RigidBody::Impl : public btMotionState
     int cachedShapeType;
     /// Cached shapesize (last created)
     float3 cachedSize;
-    /// Bullet triangle mesh
-    shared_ptr<btTriangleMesh> triangleMesh;
     /// Convex hull set
     shared_ptr<ConvexHullSet> convexHullSet;
+    /// Name of the Ogre mesh whose shape has been requested last
+    std::string meshName;
     /// Bullet heightfield shape. Note: this is always put inside a compound shape (impl->shape)
     btHeightfieldTerrainShape* heightField;
     /// Heightfield values, for the case the shape is a heightfield.
@@ -471,11 +470,10 @@ void EC_RigidBody::CreateCollisionShape()
         impl->shape = new btCapsuleShape(sizeVec.x * 0.5f, sizeVec.y * 0.5f);
         break;
     case Shape_TriMesh:
-        if (impl->triangleMesh)
+        if (impl->bvhShape)
         {
-            // Need to first create a bvhTriangleMeshShape, then a scaled version of it to allow for individual scaling.
-            impl->childShape = new btBvhTriangleMeshShape(impl->triangleMesh.get(), true, true);
-            impl->shape = new btScaledBvhTriangleMeshShape(static_cast<btBvhTriangleMeshShape*>(impl->childShape), btVector3(1.0f, 1.0f, 1.0f));
+            // The BVH shape is shared, so create a scaled version of it to allow for individual scaling.
+            impl->shape = new btScaledBvhTriangleMeshShape(impl->bvhShape.get(), btVector3(1.0f, 1.0f, 1.0f));
         }
         break;
     case Shape_HeightField:
@@ -503,7 +501,6 @@ void EC_RigidBody::RemoveCollisionShape()
             impl->body->setCollisionShape(0);
         SAFE_DELETE(impl->shape);
     }
-    SAFE_DELETE(impl->childShape);
     SAFE_DELETE(impl->heightField);
 }
 
@@ -596,22 +593,35 @@ void EC_RigidBody::OnCollisionMeshAssetLoaded(AssetPtr asset)
 
     if (mesh)
     {
+        // The shape is built in the background, unless it already exists. SetMeshShape is called when it is ready.
+        impl->meshName = mesh->getName();
         if (shapeType.Get() == Shape_TriMesh)
-        {
-            impl->triangleMesh = impl->owner->GetTriangleMeshFromOgreMesh(mesh);
-            CreateCollisionShape();
-        }
+            impl->owner->RequestShapeFromOgreMesh(mesh, CollisionShapeBuilder::TriangleMeshShape, this);
         if (shapeType.Get() == Shape_ConvexHull)
-        {
-            impl->convexHullSet = impl->owner->GetConvexHullSetFromOgreMesh(mesh);
-            CreateCollisionShape();
-        }
+            impl->owner->RequestShapeFromOgreMesh(mesh, CollisionShapeBuilder::ConvexHullSetShape, this);
 
         impl->cachedShapeType = shapeType.Get();
         impl->cachedSize = size.Get();
     }
 }
 
+void EC_RigidBody::SetMeshShape(const std::string &meshName, const shared_ptr<btBvhTriangleMeshShape> &bvhShape, const shared_ptr<ConvexHullSet> &convexHullSet)
+{
+    if (meshName != impl->meshName)
+        return;
+
+    if (shapeType.Get() == Shape_TriMesh && bvhShape)
+    {
+        impl->bvhShape = bvhShape;
+        CreateCollisionShape();
+    }
+    if (shapeType.Get() == Shape_ConvexHull && convexHullSet)
+    {
+        impl->convexHullSet = convexHullSet;
+        CreateCollisionShape();
+    }
+}
+
 void EC_RigidBody::AttributesChanged()
 {
     if (impl->disconnected)
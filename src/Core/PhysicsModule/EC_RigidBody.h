@@ -102,6 +102,7 @@ class PHYSICS_MODULE_API EC_RigidBody : public IComponent
     Q_ENUMS(ShapeType)
 
     friend class PhysicsWorld;
+    friend class PhysicsModule;
 
 public:
     /// @cond PRIVATE
@@ -366,6 +367,10 @@ private:
     /// Request mesh resource (for trimesh & convexhull shapes)
     void RequestMesh();
 
+    /// Sets the shape built from the collision mesh. Called from PhysicsModule
+    /** Ignored if @c meshName is no longer the collision mesh, or the shape type has changed. */
+    void SetMeshShape(const std::string &meshName, const shared_ptr<btBvhTriangleMeshShape> &bvhShape, const shared_ptr<ConvexHullSet> &convexHullSet);
+
     /// Emit a physics collision. Called from PhysicsWorld
     void EmitPhysicsCollision(Entity* otherEntity, const float3& position, const float3& normal, float distance, float impulse, bool newCollision);
 
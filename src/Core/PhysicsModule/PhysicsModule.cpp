@@ -27,6 +27,8 @@
 #include "QScriptEngineHelpers.h"
 #include "LoggingFunctions.h"
 #include "StaticPluginRegistry.h"
+#include "AssetAPI.h"
+#include "AssetCache.h"
 
 // Disable unreferenced formal parameter coming from Bullet
 #ifdef _MSC_VER
@@ -101,10 +103,27 @@ void PhysicsModule::Initialize()
         if (ok && steps > 0)
             SetDefaultMaxSubSteps(steps);
     }
+
+    int numShapeThreads = 2;
+    QStringList shapeThreadsParam = framework_->CommandLineParameters("--physicsShapeThreads");
+    if (shapeThreadsParam.size() > 0)
+    {
+        bool ok = false;
+        int numThreads = shapeThreadsParam.first().toInt(&ok);
+        if (ok && numThreads >= 0)
+            numShapeThreads = numThreads;
+        else
+            LogError("PhysicsModule: Invalid value for --physicsShapeThreads: " + shapeThreadsParam.first());
+    }
+    if (numShapeThreads > 0)
+        shapeBuilder_ = MAKE_SHARED(CollisionShapeBuilder, numShapeThreads);
 }
 
 void PhysicsModule::Uninitialize()
 {
+    // Joins the worker threads.
+    shapeBuilder_.reset();
+    pendingShapes_.clear();
 }
 
 void PhysicsModule::ToggleDebugGeometry()
@@ -170,6 +189,7 @@ void PhysicsModule::AutoCollisionMesh()
 void PhysicsModule::Update(f64 frametime)
 {
     PROFILE(PhysicsModule_Update);
+    ProcessFinishedShapes();
     // Loop all the physics worlds and update them.
     PhysicsWorldMap::iterator i = physicsWorlds_.begin();
     while(i != physicsWorlds_.end())
@@ -254,6 +274,149 @@ shared_ptr<ConvexHullSet> PhysicsModule::GetConvexHullSetFromOgreMesh(Ogre::Mesh
     return ptr;
 }
 
+shared_ptr<btBvhTriangleMeshShape> PhysicsModule::GetBvhTriangleMeshShapeFromOgreMesh(Ogre::Mesh* mesh)
+{
+    shared_ptr<btBvhTriangleMeshShape> ptr;
+    if (!mesh)
+        return ptr;
+
+    // Check if has already been generated
+    BvhTriangleMeshShapeMap::const_iterator iter = bvhTriangleMeshShapes_.find(mesh->getName());
+    if (iter != bvhTriangleMeshShapes_.end())
+        return iter->second;
+
+    CollisionShapeBuilder::Result result;
+    CollisionShapeBuilder::BuildShape(ShapeJob(mesh, CollisionShapeBuilder::TriangleMeshShape), result);
+    StoreShape(result);
+
+    return result.bvhShape;
+}
+
+void PhysicsModule::RequestShapeFromOgreMesh(Ogre::Mesh* mesh, CollisionShapeBuilder::ShapeKind kind, EC_RigidBody* requester)
+{
+    if (!mesh || !requester)
+        return;
+
+    const std::string &name = mesh->getName();
+    if (kind == CollisionShapeBuilder::TriangleMeshShape)
+    {
+        BvhTriangleMeshShapeMap::const_iterator iter = bvhTriangleMeshShapes_.find(name);
+        if (iter != bvhTriangleMeshShapes_.end() || !shapeBuilder_)
+        {
+            requester->SetMeshShape(name, iter != bvhTriangleMeshShapes_.end() ? iter->second : GetBvhTriangleMeshShapeFromOgreMesh(mesh),
+                shared_ptr<ConvexHullSet>());
+            return;
+        }
+    }
+    else
+    {
+        ConvexHullSetMap::const_iterator iter = convexHullSets_.find(name);
+        if (iter != convexHullSets_.end() || !shapeBuilder_)
+        {
+            requester->SetMeshShape(name, shared_ptr<btBvhTriangleMeshShape>(),
+                iter != convexHullSets_.end() ? iter->second : GetConvexHullSetFromOgreMesh(mesh));
+            return;
+        }
+    }
+
+    // Join the build in progress
+    std::pair<std::string, CollisionShapeBuilder::ShapeKind> key(name, kind);
+    PendingShapeMap::iterator pending = pendingShapes_.find(key);
+    if (pending != pendingShapes_.end())
+    {
+        pending->second.requesters.push_back(requester);
+        return;
+    }
+
+    CollisionShapeBuilder::Job job;
+    // If the other kind of shape is being built from the same mesh, use the triangles already extracted for it.
+    std::pair<std::string, CollisionShapeBuilder::ShapeKind> otherKey(name, kind == CollisionShapeBuilder::TriangleMeshShape ?
+        CollisionShapeBuilder::ConvexHullSetShape : CollisionShapeBuilder::TriangleMeshShape);
+    PendingShapeMap::const_iterator other = pendingShapes_.find(otherKey);
+    if (other != pendingShapes_.end())
+    {
+        job.meshName = name;
+        job.kind = kind;
+        job.triangles = other->second.triangles;
+        job.bvhCacheDirectory = framework_->Asset()->Cache() ? framework_->Asset()->Cache()->CacheDirectory() : QString();
+    }
+    else
+        job = ShapeJob(mesh, kind);
+
+    PendingShape &shape = pendingShapes_[key];
+    shape.triangles = job.triangles;
+    shape.requesters.push_back(requester);
+    shapeBuilder_->Build(job);
+}
+
+CollisionShapeBuilder::Job PhysicsModule::ShapeJob(Ogre::Mesh* mesh, CollisionShapeBuilder::ShapeKind kind) const
+{
+    PROFILE(PhysicsModule_ExtractMeshTriangles);
+    shared_ptr<std::vector<float3> > triangles = MAKE_SHARED(std::vector<float3>);
+    GetTrianglesFromMesh(mesh, *triangles);
+
+    CollisionShapeBuilder::Job job;
+    job.meshName = mesh->getName();
+    job.kind = kind;
+    job.triangles = triangles;
+    job.bvhCacheDirectory = framework_->Asset()->Cache() ? framework_->Asset()->Cache()->CacheDirectory() : QString();
+    return job;
+}
+
+void PhysicsModule::StoreShape(CollisionShapeBuilder::Result &result)
+{
+    if (!result.error.isEmpty())
+        LogError(result.error);
+
+    if (result.kind == CollisionShapeBuilder::TriangleMeshShape)
+    {
+        // Keep a triangle mesh that has already been handed out.
+        triangleMeshes_.insert(std::make_pair(result.meshName, result.triangleMesh));
+        bvhTriangleMeshShapes_[result.meshName] = result.bvhShape;
+    }
+    else
+        convexHullSets_[result.meshName] = result.convexHullSet;
+
+    AssetCache *cache = framework_->Asset()->Cache();
+    if (cache && !result.bvhCacheName.isEmpty() && !result.bvhCacheData.empty())
+    {
+        QString path = cache->StoreAsset(&result.bvhCacheData[0], result.bvhCacheData.size(), result.bvhCacheName);
+        if (path.isEmpty())
+            LogWarning("PhysicsModule: Failed to store BVH to the asset cache as " + result.bvhCacheName);
+    }
+}
+
+void PhysicsModule::ProcessFinishedShapes()
+{
+    if (!shapeBuilder_)
+        return;
+
+    shapeBuilder_->TakeFinished(finishedShapes_);
+    if (finishedShapes_.empty())
+        return;
+
+    PROFILE(PhysicsModule_ProcessFinishedShapes);
+    for(size_t i = 0; i < finishedShapes_.size(); ++i)
+    {
+        CollisionShapeBuilder::Result &result = finishedShapes_[i];
+        StoreShape(result);
+
+        std::vector<QPointer<EC_RigidBody> > requesters;
+        PendingShapeMap::iterator pending = pendingShapes_.find(std::make_pair(result.meshName, result.kind));
+        if (pending != pendingShapes_.end())
+        {
+            requesters.swap(pending->second.requesters);
+            pendingShapes_.erase(pending);
+        }
+
+        // Rigid bodies which have been removed meanwhile have been nulled by QPointer.
+        for(size_t j = 0; j < requesters.size(); ++j)
+            if (requesters[j])
+                requesters[j]->SetMeshShape(result.meshName, result.bvhShape, result.convexHullSet);
+    }
+    finishedShapes_.clear();
+}
+
 #ifdef PROFILING
 static QTreeWidgetItem *FindItemByName(QTreeWidgetItem *parent, const char *name)
 {
@@ -6,10 +6,12 @@
 #include "PhysicsModuleFwd.h"
 #include "IModule.h"
 #include "SceneFwd.h"
+#include "CollisionShapeBuilder.h"
 
 #include <set>
 #include <QObject>
 #include <QMetaType>
+#include <QPointer>
 
 namespace Ogre
 {
@@ -46,6 +48,18 @@ public:
     /** If already has been generated, returns the previously created one */
     shared_ptr<ConvexHullSet> GetConvexHullSetFromOgreMesh(Ogre::Mesh* mesh);
 
+    /// Get a Bullet BVH triangle mesh shape corresponding to an Ogre mesh.
+    /** The shape is shared by all users of the mesh, so it must not be scaled directly: wrap it in a btScaledBvhTriangleMeshShape instead.
+        If already has been generated, returns the previously created one. Otherwise the BVH is read from the asset cache if it has
+        been built for the same triangles before, or built and then written to the asset cache. */
+    shared_ptr<btBvhTriangleMeshShape> GetBvhTriangleMeshShapeFromOgreMesh(Ogre::Mesh* mesh);
+
+    /// Requests the BVH triangle mesh shape or the convex hull set of an Ogre mesh for a rigid body.
+    /** If the shape has already been generated, it is given to @c requester immediately. Otherwise the triangles are extracted from
+        the mesh now, the shape is built on a worker thread, and it is given to @c requester in a later Update(). Requests for a shape
+        which is already being built join the build in progress. */
+    void RequestShapeFromOgreMesh(Ogre::Mesh* mesh, CollisionShapeBuilder::ShapeKind kind, EC_RigidBody* requester);
+
     /// Set default physics update rate for new physics worlds
     void SetDefaultPhysicsUpdatePeriod(float updatePeriod);
 
@@ -95,6 +109,32 @@ private:
     typedef std::map<std::string, shared_ptr<ConvexHullSet> > ConvexHullSetMap;
     /// Bullet convex hull sets generated from Ogre meshes
     ConvexHullSetMap convexHullSets_;
+
+    typedef std::map<std::string, shared_ptr<btBvhTriangleMeshShape> > BvhTriangleMeshShapeMap;
+    /// Bullet BVH triangle mesh shapes generated from Ogre meshes
+    BvhTriangleMeshShapeMap bvhTriangleMeshShapes_;
+
+    /// Collision shape being built, and the rigid bodies waiting for it.
+    struct PendingShape
+    {
+        shared_ptr<const std::vector<float3> > triangles;
+        std::vector<QPointer<EC_RigidBody> > requesters;
+    };
+    typedef std::map<std::pair<std::string, CollisionShapeBuilder::ShapeKind>, PendingShape> PendingShapeMap;
+    /// Collision shapes being built by shapeBuilder_
+    PendingShapeMap pendingShapes_;
+
+    /// Builds the mesh collision shapes in the background, or null if they are built in the main thread.
+    shared_ptr<CollisionShapeBuilder> shapeBuilder_;
+    /// Finished builds, reused between frames.
+    std::vector<CollisionShapeBuilder::Result> finishedShapes_;
+
+    /// Returns a build job for a shape of @c mesh, extracting its triangles.
+    CollisionShapeBuilder::Job ShapeJob(Ogre::Mesh* mesh, CollisionShapeBuilder::ShapeKind kind) const;
+    /// Stores a built shape to the shape maps, and its BVH to the asset cache.
+    void StoreShape(CollisionShapeBuilder::Result &result);
+    /// Gives the shapes built by shapeBuilder_ to the rigid bodies waiting for them.
+    void ProcessFinishedShapes();
     
     float defaultPhysicsUpdatePeriod_;
     int defaultMaxSubSteps_;
@@ -29,6 +29,7 @@ typedef weak_ptr<PhysicsWorld> PhysicsWorldWeakPtr;
 
 // From Bullet:
 class btTriangleMesh;
+class btBvhTriangleMeshShape;
 class btCollisionConfiguration;
 class btBroadphaseInterface;
 class btConstraintSolver;
@@ -30,6 +30,8 @@
 #include <QList>
 #include <QMap>
 
+#include <algorithm>
+
 #include "MemoryLeakCheck.h"
 
 AssetAPI::AssetAPI(Framework *framework, bool headless) :
@@ -492,6 +494,7 @@ bool AssetAPI::ForgetAsset(AssetPtr asset, bool removeDiskSource)
     if (diskSourceChangeWatcher && !asset->DiskSource().isEmpty())
         diskSourceChangeWatcher->removePath(asset->DiskSource());
     assets.erase(iter);
+    RemoveAssetDependencies(asset->Name());
     return true;
 }
 
@@ -726,7 +729,7 @@ void AssetAPI::Reset()
     defaultStorage.reset();
     readyTransfers.clear();
     readySubTransfers.clear();
-    assetDependencies.clear();
+    assetDependencies.Clear();
     currentUploadTransfers.clear();
     currentTransfers.clear();
     providers.clear();
@@ -1257,6 +1260,7 @@ AssetPtr AssetAPI::CreateNewAsset(QString type, QString name, AssetStoragePtr st
 
     // Remember this asset in the global AssetAPI storage.
     assets[name] = asset;
+    connect(asset.get(), SIGNAL(Unloaded(IAsset*)), this, SLOT(OnAssetUnloaded(IAsset*)), Qt::UniqueConnection);
 
     ///\bug DiskSource and DiskSourceType are not set yet.
     {
@@ -1759,6 +1763,9 @@ void AssetAPI::AssetLoadCompleted(const QString assetRef)
 {
     PROFILE(AssetAPI_AssetLoadCompleted);
 
+    // The references of a (re)loaded asset may have changed.
+    assetDependencies.Invalidate(assetRef);
+
     AssetPtr asset;
     AssetTransferMap::const_iterator iter = FindTransferIterator(assetRef);
     AssetMap::iterator iter2 = assets.find(assetRef);
@@ -1830,6 +1837,7 @@ void AssetAPI::AssetLoadCompleted(const QString assetRef)
 
 void AssetAPI::AssetLoadFailed(const QString assetRef)
 {
+    assetDependencies.Invalidate(assetRef);
     AssetTransferMap::iterator iter = FindTransferIterator(assetRef);
     AssetMap::const_iterator iter2 = assets.find(assetRef);
 
@@ -1943,20 +1951,14 @@ void AssetAPI::NotifyAssetDependenciesChanged(AssetPtr asset)
 {
     PROFILE(AssetAPI_NotifyAssetDependenciesChanged);
 
-    /// Delete all old stored asset dependencies for this asset.
-    RemoveAssetDependencies(asset->Name());
-
+    QStringList dependees;
     std::vector<AssetReference> refs = asset->FindReferences();
     for(size_t i = 0; i < refs.size(); ++i)
-    {
-        // Turn named storage (and default storage) specifiers to absolute specifiers.
-        QString ref = refs[i].ref;
-        if (ref.isEmpty())
-            continue;
+        dependees << refs[i].ref;
 
-        // Remember this assetref for future lookup.
-        assetDependencies.push_back(std::make_pair(asset->Name(), ref));
-    }
+    // Replace the old stored asset dependencies for this asset. If they did not change, the graph keeps
+    // the knowledge of whether the asset has pending dependencies.
+    assetDependencies.SetDependencies(asset->Name(), dependees);
 }
 
 void AssetAPI::RequestAssetDependencies(AssetPtr asset)
@@ -1984,12 +1986,7 @@ void AssetAPI::RequestAssetDependencies(AssetPtr asset)
 void AssetAPI::RemoveAssetDependencies(QString asset)
 {
     PROFILE(AssetAPI_RemoveAssetDependencies);
-    for(size_t i = 0; i < assetDependencies.size(); ++i)
-        if (QString::compare(assetDependencies[i].first, asset, Qt::CaseInsensitive) == 0)
-        {
-            assetDependencies.erase(assetDependencies.begin() + i);
-            --i;
-        }
+    assetDependencies.RemoveDependencies(asset);
 }
 
 std::vector<AssetPtr> AssetAPI::FindDependents(QString dependee)
@@ -1997,14 +1994,12 @@ std::vector<AssetPtr> AssetAPI::FindDependents(QString dependee)
     PROFILE(AssetAPI_FindDependents);
 
     std::vector<AssetPtr> dependents;
-    for(size_t i = 0; i < assetDependencies.size(); ++i)
+    QStringList names = assetDependencies.Dependents(dependee);
+    for(int i = 0; i < names.size(); ++i)
     {
-        if (QString::compare(assetDependencies[i].second, dependee, Qt::CaseInsensitive) == 0)
-        {
-            AssetMap::iterator iter = assets.find(assetDependencies[i].first);
-            if (iter != assets.end())
-                dependents.push_back(iter->second);
-        }
+        AssetMap::iterator iter = assets.find(names[i]);
+        if (iter != assets.end())
+            dependents.push_back(iter->second);
     }
     return dependents;
 }
@@ -2012,80 +2007,73 @@ std::vector<AssetPtr> AssetAPI::FindDependents(QString dependee)
 int AssetAPI::NumPendingDependencies(AssetPtr asset) const
 {
     PROFILE(AssetAPI_NumPendingDependencies);
-    int numDependencies = 0;
 
-    std::vector<AssetReference> refs = asset->FindReferences();
-    for(size_t i = 0; i < refs.size(); ++i)
-    {
-        QString ref = refs[i].ref;
-        if (ref.isEmpty())
-            continue;
-
-        // We silently ignore this dependency if the asset type in question is disabled.
-        if (dynamic_cast<NullAssetFactory*>(AssetTypeFactory(GetResourceTypeFromAssetRef(refs[i])).get()))
-            continue;
+    // Brings the completion flags of the dependencies up to date, so that the count kept by the graph can be used.
+    if (!HasPendingDependencies(asset))
+        return 0;
 
-        AssetPtr existing = GetAsset(refs[i].ref);
-        if (!existing)
-        {
-            // Not loaded, just mark the single one
-            ++numDependencies;
-        }
-        else
-        {
-            // If asset is empty, count it as an unloaded dependency
-            if (existing->IsEmpty())
-                ++numDependencies;
-            else
-            {
-                if (!existing->IsLoaded())
-                    ++numDependencies;
-                // Ask the dependencies of the dependency, we want all of the asset
-                // down the chain to be loaded before we load the base asset
-                // Note: if the dependency is unloaded, it may or may not be able to tell the dependencies correctly
-                numDependencies += NumPendingDependencies(existing);
-            }
-        }
-    }
-
-    return numDependencies;
+    // The dependencies may not have been stored to the graph yet, but at least one of them is pending.
+    return std::max(1, (int)assetDependencies.NumIncompleteDependees(asset->Name()));
 }
 
 bool AssetAPI::HasPendingDependencies(AssetPtr asset) const
 {
     PROFILE(AssetAPI_HasPendingDependencies);
 
+    std::vector<IAsset*> path;
+    return HasPendingDependencies(asset, path);
+}
+
+bool AssetAPI::HasPendingDependencies(const AssetPtr &asset, std::vector<IAsset*> &path) const
+{
+    // A circular dependency can never be satisfied.
+    if (std::find(path.begin(), path.end(), asset.get()) != path.end())
+        return true;
+
+    QStringList dependees;
     std::vector<AssetReference> refs = asset->FindReferences();
     for(size_t i = 0; i < refs.size(); ++i)
     {
-        if (refs[i].ref.isEmpty())
+        const QString &ref = refs[i].ref;
+        if (ref.isEmpty())
+            continue;
+        dependees << ref;
+
+        // The dependency is known to be loaded with all of its own dependencies.
+        if (assetDependencies.IsComplete(ref))
             continue;
 
         // We silently ignore this dependency if the asset type in question is disabled.
         if (dynamic_cast<NullAssetFactory*>(AssetTypeFactory(ResourceTypeForAssetRef(refs[i])).get()))
+        {
+            assetDependencies.SetComplete(ref);
             continue;
+        }
 
-        AssetPtr existing = GetAsset(refs[i].ref);
+        AssetPtr existing = GetAsset(ref);
         if (!existing) // Not loaded, just mark the single one
             return true;
-        else
-        {            
-            if (existing->IsEmpty())
-                return true; // If asset is empty, count it as an unloaded dependency
-            else
-            {
-                if (!existing->IsLoaded())
-                    return true;
-                // Ask the dependencies of the dependency, we want all of the asset
-                // down the chain to be loaded before we load the base asset
-                // Note: if the dependency is unloaded, it may or may not be able to tell the dependencies correctly
-                bool dependencyHasDependencies = HasPendingDependencies(existing);
-                if (dependencyHasDependencies)
-                    return true;
-            }
-        }
+        if (existing->IsEmpty())
+            return true; // If asset is empty, count it as an unloaded dependency
+        if (!existing->IsLoaded())
+            return true;
+
+        // Ask the dependencies of the dependency, we want all of the asset
+        // down the chain to be loaded before we load the base asset
+        path.push_back(asset.get());
+        bool dependencyHasDependencies = HasPendingDependencies(existing, path);
+        path.pop_back();
+        if (dependencyHasDependencies)
+            return true;
     }
 
+    // Remember that the asset is complete, so that the assets depending on it need not walk its dependencies again.
+    // Only done if the stored dependencies are up to date and known to be complete, so that unloading any asset down
+    // the chain invalidates this.
+    if (asset->IsLoaded() && assetDependencies.HasDependencies(asset->Name(), dependees) &&
+        assetDependencies.NumIncompleteDependees(asset->Name()) == 0)
+        assetDependencies.SetComplete(asset->Name());
+
     return false;
 }
 
@@ -2187,6 +2175,11 @@ void AssetAPI::OnAssetLoaded(AssetPtr asset)
     }
 }
 
+void AssetAPI::OnAssetUnloaded(IAsset *asset)
+{
+    assetDependencies.Invalidate(asset->Name());
+}
+
 void AssetAPI::OnAssetDiskSourceChanged(const QString &path_)
 {
     QDir path(path_);
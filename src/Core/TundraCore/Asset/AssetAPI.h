@@ -7,6 +7,7 @@
 #include "CoreStringUtils.h"
 #include "AssetFwd.h"
 #include "IAssetStorage.h"
+#include "AssetDependencyGraph.h"
 
 #include <QObject>
 #include <vector>
@@ -395,7 +396,7 @@ public slots:
     /// Starts an asset transfer for each dependency the given asset has.
     void RequestAssetDependencies(AssetPtr transfer);
 
-    /// A utility function that counts the number of dependencies the given asset has to other assets that have not been loaded in.
+    /// A utility function that counts the direct dependencies of the given asset which have not been loaded in with all of their own dependencies.
     int NumPendingDependencies(AssetPtr asset) const;
 
     /// A utility function that returns true if the given asset still has some unloaded dependencies left to process.
@@ -421,8 +422,8 @@ public slots:
     /// A utility function that counts the number of current asset transfers.
     size_t NumCurrentTransfers() const { return currentTransfers.size(); }
     
-    /// Return the current asset dependency map (debugging)
-    const AssetDependenciesMap& DebugGetAssetDependencies() const { return assetDependencies; }
+    /// Return the current asset dependencies as (dependent, dependee) pairs (debugging)
+    AssetDependenciesMap DebugGetAssetDependencies() const { return assetDependencies.Edges(); }
     
     /// Return ready asset transfers (debugging)
     const std::vector<AssetTransferPtr>& DebugGetReadyTransfers() const { return readyTransfers; }
@@ -482,6 +483,9 @@ private slots:
     /// The Asset API listens on each asset when they get loaded, to track the completion of the dependencies of other loaded assets.
     void OnAssetLoaded(AssetPtr asset);
 
+    /// Marks the asset, and the assets depending on it, as possibly having pending dependencies again.
+    void OnAssetUnloaded(IAsset *asset);
+
     /// The Asset API reloads all assets from file when their disk source contents change.
     void OnAssetDiskSourceChanged(const QString &path);
 
@@ -505,9 +509,12 @@ private:
     AssetTransferMap::iterator FindTransferIterator(IAssetTransfer *transfer);
     AssetTransferMap::const_iterator FindTransferIterator(IAssetTransfer *transfer) const;
 
-    /// Removes from AssetDependenciesMap all dependencies the given asset has.
+    /// Removes from the dependency graph all dependencies the given asset has.
     void RemoveAssetDependencies(QString asset);
 
+    /// Implements HasPendingDependencies. @c path holds the assets being checked, to detect circular dependencies.
+    bool HasPendingDependencies(const AssetPtr &asset, std::vector<IAsset*> &path) const;
+
     /// Handle discovery of a new asset, when the storage is already known. This is used internally for optimization, so that providers don't need to be queried
     void HandleAssetDiscovery(const QString &assetRef, const QString &assetType, AssetStoragePtr storage);
     
@@ -533,8 +540,8 @@ private:
     AssetUploadTransferMap currentUploadTransfers;
 
     /// Keeps track of all the dependencies each asset has to each other asset.
-    /// \todo Find a more effective data structure for this. Needs something like boost::bimap but for multi-indices.
-    AssetDependenciesMap assetDependencies;
+    /// Mutable, as HasPendingDependencies caches the assets found to have no pending dependencies.
+    mutable AssetDependencyGraph assetDependencies;
 
     /// Stores a list of asset requests to assets that have already been downloaded into the system. These requests don't go to the asset providers
     /// to process, but are internally filled by the Asset API. This member vector is needed to be able to delay the requests and virtual completions
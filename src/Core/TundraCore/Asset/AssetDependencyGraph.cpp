@@ -0,0 +1,232 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "AssetDependencyGraph.h"
+
+#include <algorithm>
+
+#include "MemoryLeakCheck.h"
+
+AssetDependencyGraph::AssetDependencyGraph() :
+    numEdges_(0)
+{
+}
+
+AssetDependencyGraph::NodeId AssetDependencyGraph::Intern(const QString &ref)
+{
+    QString key = NormalizedRef(ref);
+    QHash<QString, NodeId>::const_iterator iter = ids_.find(key);
+    if (iter != ids_.end())
+        return iter.value();
+
+    NodeId id = (NodeId)nodes_.size();
+    nodes_.push_back(Node());
+    Node &node = nodes_.back();
+    node.name = ref;
+    node.numIncomplete = 0;
+    node.complete = false;
+    node.hasDependencies = false;
+    ids_.insert(key, id);
+    return id;
+}
+
+bool AssetDependencyGraph::Find(const QString &ref, NodeId &id) const
+{
+    QHash<QString, NodeId>::const_iterator iter = ids_.find(NormalizedRef(ref));
+    if (iter == ids_.end())
+        return false;
+    id = iter.value();
+    return true;
+}
+
+void AssetDependencyGraph::InternDependees(const QStringList &dependees, std::vector<NodeId> &ids)
+{
+    ids.clear();
+    ids.reserve(dependees.size());
+    for(int i = 0; i < dependees.size(); ++i)
+        if (!dependees[i].isEmpty())
+            ids.push_back(Intern(dependees[i]));
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+bool AssetDependencyGraph::SetDependencies(const QString &dependent, const QStringList &dependees)
+{
+    NodeId id = Intern(dependent);
+    std::vector<NodeId> ids;
+    InternDependees(dependees, ids);
+
+    if (nodes_[id].hasDependencies && nodes_[id].dependees == ids)
+        return false;
+
+    InvalidateNode(id);
+    RemoveEdges(id);
+
+    // Note: the node vector may not be reallocated below, as all the dependees have been interned already.
+    Node &node = nodes_[id];
+    node.dependees.swap(ids);
+    node.hasDependencies = true;
+    for(size_t i = 0; i < node.dependees.size(); ++i)
+    {
+        Node &dependee = nodes_[node.dependees[i]];
+        dependee.dependents.push_back(id);
+        if (!dependee.complete)
+            ++node.numIncomplete;
+    }
+    numEdges_ += node.dependees.size();
+    return true;
+}
+
+void AssetDependencyGraph::RemoveDependencies(const QString &dependent)
+{
+    NodeId id;
+    if (!Find(dependent, id))
+        return;
+    InvalidateNode(id);
+    RemoveEdges(id);
+}
+
+void AssetDependencyGraph::RemoveEdges(NodeId id)
+{
+    Node &node = nodes_[id];
+    for(size_t i = 0; i < node.dependees.size(); ++i)
+    {
+        std::vector<NodeId> &dependents = nodes_[node.dependees[i]].dependents;
+        std::vector<NodeId>::iterator iter = std::find(dependents.begin(), dependents.end(), id);
+        if (iter != dependents.end())
+        {
+            *iter = dependents.back();
+            dependents.pop_back();
+        }
+    }
+    numEdges_ -= node.dependees.size();
+    node.dependees.clear();
+    node.numIncomplete = 0;
+    node.hasDependencies = false;
+}
+
+bool AssetDependencyGraph::HasDependencies(const QString &dependent, const QStringList &dependees) const
+{
+    NodeId id;
+    if (!Find(dependent, id) || !nodes_[id].hasDependencies)
+        return false;
+
+    std::vector<NodeId> ids;
+    ids.reserve(dependees.size());
+    for(int i = 0; i < dependees.size(); ++i)
+    {
+        if (dependees[i].isEmpty())
+            continue;
+        NodeId dependeeId;
+        if (!Find(dependees[i], dependeeId))
+            return false; // Never seen, so can not be a dependee.
+        ids.push_back(dependeeId);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return nodes_[id].dependees == ids;
+}
+
+QStringList AssetDependencyGraph::Dependents(const QString &dependee) const
+{
+    QStringList names;
+    NodeId id;
+    if (Find(dependee, id))
+    {
+        const std::vector<NodeId> &dependents = nodes_[id].dependents;
+        for(size_t i = 0; i < dependents.size(); ++i)
+            names << nodes_[dependents[i]].name;
+    }
+    return names;
+}
+
+QStringList AssetDependencyGraph::Dependees(const QString &dependent) const
+{
+    QStringList names;
+    NodeId id;
+    if (Find(dependent, id))
+    {
+        const std::vector<NodeId> &dependees = nodes_[id].dependees;
+        for(size_t i = 0; i < dependees.size(); ++i)
+            names << nodes_[dependees[i]].name;
+    }
+    return names;
+}
+
+bool AssetDependencyGraph::IsComplete(const QString &ref) const
+{
+    NodeId id;
+    return Find(ref, id) && nodes_[id].complete;
+}
+
+void AssetDependencyGraph::SetComplete(const QString &ref)
+{
+    NodeId id = Intern(ref);
+    Node &node = nodes_[id];
+    if (node.complete)
+        return;
+    node.complete = true;
+    for(size_t i = 0; i < node.dependents.size(); ++i)
+    {
+        Node &dependent = nodes_[node.dependents[i]];
+        assert(dependent.numIncomplete > 0);
+        --dependent.numIncomplete;
+    }
+}
+
+void AssetDependencyGraph::Invalidate(const QString &ref)
+{
+    NodeId id;
+    if (Find(ref, id))
+        InvalidateNode(id);
+}
+
+void AssetDependencyGraph::InvalidateNode(NodeId id)
+{
+    // As complete nodes only have complete dependees, the traversal can stop at the nodes that are already incomplete.
+    if (!nodes_[id].complete)
+        return;
+    stack_.clear();
+    stack_.push_back(id);
+    while(!stack_.empty())
+    {
+        Node &node = nodes_[stack_.back()];
+        stack_.pop_back();
+        if (!node.complete)
+            continue;
+        node.complete = false;
+        for(size_t i = 0; i < node.dependents.size(); ++i)
+        {
+            Node &dependent = nodes_[node.dependents[i]];
+            ++dependent.numIncomplete;
+            if (dependent.complete)
+                stack_.push_back(node.dependents[i]);
+        }
+    }
+}
+
+uint AssetDependencyGraph::NumIncompleteDependees(const QString &dependent) const
+{
+    NodeId id;
+    return Find(dependent, id) ? nodes_[id].numIncomplete : 0;
+}
+
+std::vector<std::pair<QString, QString> > AssetDependencyGraph::Edges() const
+{
+    std::vector<std::pair<QString, QString> > edges;
+    edges.reserve(numEdges_);
+    for(size_t i = 0; i < nodes_.size(); ++i)
+        for(size_t j = 0; j < nodes_[i].dependees.size(); ++j)
+            edges.push_back(std::make_pair(nodes_[i].name, nodes_[nodes_[i].dependees[j]].name));
+    return edges;
+}
+
+void AssetDependencyGraph::Clear()
+{
+    ids_.clear();
+    nodes_.clear();
+    stack_.clear();
+    numEdges_ = 0;
+}
@@ -0,0 +1,96 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraCoreApi.h"
+#include "CoreTypes.h"
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+#include <vector>
+#include <utility>
+
+/// Bidirectional graph of the dependencies between assets, used by AssetAPI.
+/** The asset refs are compared case-insensitively. Each ref is case-folded and interned to an integer node id once,
+    after which both the dependees of an asset and the dependents of an asset are found with a hash lookup.
+
+    Each node also has a completion flag, which AssetAPI uses to cache that an asset is loaded and has no pending
+    dependencies, recursively. The graph keeps count of the incomplete dependees of each node, so that a node whose
+    every dependee is complete is known without walking its dependencies. Marking a node incomplete also marks incomplete
+    all of its direct and indirect dependents, so the invariant "a complete node has only complete dependees" holds. */
+class TUNDRACORE_API AssetDependencyGraph
+{
+public:
+    AssetDependencyGraph();
+
+    /// Replaces the dependees of an asset. Empty refs and duplicates are ignored.
+    /** If the dependees changed, the asset is marked incomplete.
+        @return True if the dependees changed. */
+    bool SetDependencies(const QString &dependent, const QStringList &dependees);
+
+    /// Removes all the dependees of an asset, and marks it incomplete.
+    void RemoveDependencies(const QString &dependent);
+
+    /// Returns true if the dependees of an asset have been set, and they are exactly @c dependees.
+    bool HasDependencies(const QString &dependent, const QStringList &dependees) const;
+
+    /// Returns the assets which depend directly on @c dependee, with the names they were stored with.
+    QStringList Dependents(const QString &dependee) const;
+
+    /// Returns the direct dependees of an asset, with the refs they were stored with.
+    QStringList Dependees(const QString &dependent) const;
+
+    /// Returns whether an asset has been marked complete.
+    bool IsComplete(const QString &ref) const;
+
+    /// Marks an asset complete. The caller is responsible for checking that all its dependees are complete.
+    void SetComplete(const QString &ref);
+
+    /// Marks an asset and all the assets which depend on it, directly or indirectly, incomplete.
+    void Invalidate(const QString &ref);
+
+    /// Returns number of direct dependees of an asset which are not marked complete.
+    uint NumIncompleteDependees(const QString &dependent) const;
+
+    /// Returns the (dependent, dependee) pairs of all the edges.
+    std::vector<std::pair<QString, QString> > Edges() const;
+
+    /// Returns number of edges.
+    size_t NumEdges() const { return numEdges_; }
+
+    /// Forgets all nodes and edges.
+    void Clear();
+
+    /// Returns the case-folded form of a ref, which is used as the key of the node.
+    static QString NormalizedRef(const QString &ref) { return ref.toCaseFolded(); }
+
+private:
+    typedef uint NodeId;
+
+    struct Node
+    {
+        QString name; ///< The ref as it was first stored.
+        std::vector<NodeId> dependees; ///< Unique.
+        std::vector<NodeId> dependents; ///< Unique.
+        uint numIncomplete; ///< Number of dependees that are not complete.
+        bool complete;
+        bool hasDependencies; ///< SetDependencies has been called after the last RemoveDependencies.
+    };
+
+    /// Returns the id of a ref, and creates a node for it if it does not exist yet.
+    NodeId Intern(const QString &ref);
+    /// Finds the id of a ref. Returns false if there is no node for it.
+    bool Find(const QString &ref, NodeId &id) const;
+    /// Resolves @c dependees to a sorted list of unique ids, interning them.
+    void InternDependees(const QStringList &dependees, std::vector<NodeId> &ids);
+    /// Removes the edges from a node to its dependees.
+    void RemoveEdges(NodeId id);
+    void InvalidateNode(NodeId id);
+
+    QHash<QString, NodeId> ids_; ///< Normalized ref -> node id.
+    std::vector<Node> nodes_;
+    size_t numEdges_;
+    std::vector<NodeId> stack_; ///< Scratch space for the traversals.
+};
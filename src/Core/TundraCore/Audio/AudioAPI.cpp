@@ -7,6 +7,7 @@
 #include "AudioAPI.h"
 #include "AudioAsset.h"
 #include "SoundChannel.h"
+#include "AudioStreamDecoder.h"
 
 #include "CoreDefines.h"
 #include "CoreTypes.h"
@@ -48,7 +49,9 @@ public:
         captureDevice(0),
         captureSampleSize(0),
         nextChannelId(0),
-        masterGain(0.0f)
+        masterGain(0.0f),
+        streamThreshold(0),
+        streamDecoder(0)
     {
     }
 
@@ -76,6 +79,11 @@ public:
     float masterGain;
     /// Master gain for individual sound types
     std::map<SoundChannel::SoundType, float> soundMasterGain;
+
+    /// Size of decoded PCM data above which Ogg Vorbis assets are streamed, 0 if streaming is disabled
+    size_t streamThreshold;
+    /// Decoder thread of the streams played by the channels, null if streaming is disabled
+    AudioStreamDecoder *streamDecoder;
 };
 
 AudioAPI::AudioAPI(Framework *fw, AssetAPI *assetAPI_)
@@ -102,6 +110,25 @@ assetAPI(assetAPI_)
     Initialize(!devices.isEmpty() ? devices.last() : "");    
     LoadSoundSettingsFromConfig();
 
+    int streamThresholdKb = 1024;
+    QStringList streamThresholdParam = fw->CommandLineParameters("--audioStreamThreshold");
+    if (streamThresholdParam.size() > 0)
+    {
+        bool ok = false;
+        int threshold = streamThresholdParam.first().toInt(&ok);
+        if (ok && threshold >= 0)
+            streamThresholdKb = threshold;
+        else
+            LogError("AudioAPI: Invalid value for --audioStreamThreshold: " + streamThresholdParam.first());
+    }
+#ifndef TUNDRA_NO_AUDIO
+    if (streamThresholdKb > 0 && !fw->IsHeadless())
+    {
+        impl->streamThreshold = (size_t)streamThresholdKb * 1024;
+        impl->streamDecoder = new AudioStreamDecoder();
+    }
+#endif
+
     QStringList audioTypeExtensions(QStringList() << ".wav" << ".ogg");
     if (!fw->IsHeadless())
         assetAPI->RegisterAssetTypeFactory(MAKE_SHARED(GenericAssetFactory<AudioAsset>, "Audio", audioTypeExtensions));
@@ -116,6 +143,8 @@ AudioAPI::~AudioAPI()
 void AudioAPI::Reset()
 {
     Uninitialize();
+    if (impl)
+        SAFE_DELETE(impl->streamDecoder); // Joins the decoder thread.
     SAFE_DELETE(impl);
 }
 
@@ -270,6 +299,11 @@ bool AudioAPI::IsInitialized() const
     return impl && impl->initialized;
 }
 
+size_t AudioAPI::StreamThreshold() const
+{
+    return impl ? impl->streamThreshold : 0;
+}
+
 void AudioAPI::SaveSoundSettingsToConfig()
 {
     if (IsInitialized())
@@ -336,7 +370,7 @@ SoundChannelPtr AudioAPI::PlaySound(const AssetPtr &audioAsset, SoundChannel::So
     if (!channel)
     {
         sound_id_t newId = NextSoundChannelID();
-        channel = MAKE_SHARED(SoundChannel, newId, type);
+        channel = MAKE_SHARED(SoundChannel, newId, type, impl->streamDecoder);
         impl->channels.insert(make_pair(newId, channel));
     }
 
@@ -355,7 +389,7 @@ SoundChannelPtr AudioAPI::PlaySound3D(const float3 &position, const AssetPtr &au
     if (!channel)
     {
         sound_id_t newId = NextSoundChannelID();
-        channel = MAKE_SHARED(SoundChannel, newId, type);
+        channel = MAKE_SHARED(SoundChannel, newId, type, impl->streamDecoder);
         impl->channels.insert(make_pair(newId, channel));
     }
 
@@ -375,7 +409,7 @@ SoundChannelPtr AudioAPI::PlaySoundBuffer(const SoundBuffer &buffer, SoundChanne
     if (!channel)
     {
         sound_id_t newId = NextSoundChannelID();
-        channel = MAKE_SHARED(SoundChannel, newId, type);
+        channel = MAKE_SHARED(SoundChannel, newId, type, impl->streamDecoder);
         impl->channels.insert(make_pair(newId, channel));
     }
 
@@ -396,7 +430,7 @@ SoundChannelPtr AudioAPI::PlaySoundBuffer3D(const SoundBuffer &buffer, SoundChan
     if (!channel)
     {
         sound_id_t newId = NextSoundChannelID();
-        channel = MAKE_SHARED(SoundChannel, newId, type);
+        channel = MAKE_SHARED(SoundChannel, newId, type, impl->streamDecoder);
         impl->channels.insert(make_pair(newId, channel));
     }
 
@@ -61,6 +61,10 @@ public:
     /// Returns initialized status
     bool IsInitialized() const;
 
+    /// Returns the size of decoded PCM data, in bytes, above which Ogg Vorbis assets are streamed. 0 if streaming is disabled.
+    /** Set with the --audioStreamThreshold command line parameter, in kilobytes. */
+    size_t StreamThreshold() const;
+
     /// Saves sound settings to config.
     void SaveSoundSettingsToConfig();
 
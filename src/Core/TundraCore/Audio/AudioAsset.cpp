@@ -4,7 +4,10 @@
 #include "DebugOperatorNew.h"
 
 #include "AudioAsset.h"
+#include "AudioAPI.h"
+#include "AudioStreamDecoder.h"
 #include "AssetAPI.h"
+#include "Framework.h"
 #include "LoggingFunctions.h"
 #include "WavLoader.h"
 #include "OggVorbisLoader.h"
@@ -42,6 +45,7 @@ void AudioAsset::DoUnload()
         handle = 0;
     }
 #endif
+    streamData.reset();
 }
 
 bool AudioAsset::DeserializeFromData(const u8 *data, size_t numBytes, bool /*allowAsynchronous*/)
@@ -57,7 +61,13 @@ bool AudioAsset::DeserializeFromData(const u8 *data, size_t numBytes, bool /*all
     }
     else if (this->Name().endsWith(".ogg", Qt::CaseInsensitive))
     {
-        loadResult = LoadFromOggVorbisFileInMemory(data, numBytes);
+        // Long sounds are streamed, so that they are not decoded whole here, and do not take memory as PCM data.
+        AudioAPI *audio = assetAPI->GetFramework()->Audio();
+        size_t threshold = audio ? audio->StreamThreshold() : 0;
+        if (threshold > 0 && OggVorbisLoader::DecodedOggVorbisSize(data, numBytes) > threshold)
+            loadResult = LoadStreamFromOggVorbisFileInMemory(data, numBytes);
+        else
+            loadResult = LoadFromOggVorbisFileInMemory(data, numBytes);
         if (loadResult)
             assetAPI->AssetLoadCompleted(Name());
     }
@@ -88,6 +98,37 @@ bool AudioAsset::LoadFromOggVorbisFileInMemory(const u8 *data, size_t numBytes)
     return LoadFromRawPCMWavData(&buf.data[0], buf.data.size(), buf.stereo, buf.is16Bit, buf.frequency);
 }
 
+bool AudioAsset::LoadStreamFromOggVorbisFileInMemory(const u8 *data, size_t numBytes)
+{
+    DoUnload();
+
+    if (!data || numBytes == 0)
+    {
+        LogError("AudioAsset::LoadStreamFromOggVorbisFileInMemory: Null data passed in!");
+        return false;
+    }
+
+    shared_ptr<std::vector<u8> > oggData = MAKE_SHARED(std::vector<u8>, data, data + numBytes);
+    // Check that the data can be decoded, so that a broken file fails to load instead of failing to play.
+    OggVorbisStream stream;
+    if (!stream.Open(oggData))
+        return false;
+
+    streamData = oggData;
+    return true;
+}
+
+AudioStreamPtr AudioAsset::OpenStream(bool looped) const
+{
+    if (!streamData)
+        return AudioStreamPtr();
+
+    AudioStreamPtr stream = MAKE_SHARED(AudioStream);
+    if (!stream->Open(streamData, looped))
+        return AudioStreamPtr();
+    return stream;
+}
+
 bool AudioAsset::LoadFromRawPCMWavData(const u8 *data, size_t numBytes, bool stereo, bool is16Bit, int frequency)
 {
     // Clean up the previous OpenAL audio buffer handle, if old data existed.
@@ -158,5 +199,5 @@ bool AudioAsset::CreateBuffer()
 
 bool AudioAsset::IsLoaded() const
 {
-    return handle != 0;
+    return handle != 0 || IsStreaming();
 }
@@ -8,6 +8,8 @@
 #include "SoundBuffer.h"
 
 /// Stores raw decoded audio data ready for playback.
+/** Ogg Vorbis sounds which decode to more PCM data than AudioAPI::StreamThreshold() are not decoded when loaded.
+    Instead, the asset keeps the .ogg file in memory and is streamed: each playback decodes it while playing, see OpenStream. */
 class TUNDRACORE_API AudioAsset : public IAsset
 {
     Q_OBJECT
@@ -25,6 +27,9 @@ public:
     /// Loads this audio asset from the given .ogg file in memory.
     bool LoadFromOggVorbisFileInMemory(const u8 *data, size_t numBytes);
 
+    /// Loads this audio asset as a streamed asset from the given .ogg file in memory. The data is copied, but not decoded.
+    bool LoadStreamFromOggVorbisFileInMemory(const u8 *data, size_t numBytes);
+
     /// Loads this audio asset from the given raw PCM WAV data.
     /// @param data Contains the source data. This data is copied to internal AudioAsset memory, and does not need
     ///    to be stored in memory afterwards.
@@ -41,15 +46,27 @@ public:
     /// Returns true on success, false otherwise.
     bool CreateBuffer();
 
+    /// Returns the OpenAL buffer of the sound data, or 0 if the asset is unloaded or streamed.
     ALuint GetHandle() const { return handle; }
 
     bool IsLoaded() const;
 
+    /// Returns true if the asset is streamed, in which case it has no OpenAL buffer, and is played with OpenStream.
+    bool IsStreaming() const { return streamData.get() != 0; }
+
+    /// Opens a new stream for playing this asset. The stream keeps the .ogg data alive, even if the asset is unloaded.
+    /// @param looped Whether the stream continues from the start when it ends.
+    /// @return The stream, or null if the asset is not streamed or the stream could not be opened.
+    AudioStreamPtr OpenStream(bool looped) const;
+
 private:
     virtual void DoUnload();
 
     /// The actual sound data is stored in an OpenAL internal audio buffer. This handle specifies the buffer.
-    /// If == 0, then this AudioAsset is unloaded.
+    /// If == 0, then this AudioAsset is unloaded or streamed.
     ALuint handle;
+
+    /// The .ogg file of a streamed asset. Shared with the streams playing it.
+    shared_ptr<const std::vector<u8> > streamData;
 };
 
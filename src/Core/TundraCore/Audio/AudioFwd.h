@@ -21,6 +21,10 @@ class AudioAsset;
 typedef shared_ptr<AudioAsset> AudioAssetPtr;
 typedef weak_ptr<AudioAsset> AudioAssetWeakPtr;
 
+class AudioStream;
+typedef shared_ptr<AudioStream> AudioStreamPtr;
+class AudioStreamDecoder;
+
 // We don't want to include the OpenAL headers here directly (<AL/al.h>, <AL/alc.h>). Pulled the necessary declarations here directly.
 /** unsigned 32-bit integer */
 typedef unsigned int ALuint;
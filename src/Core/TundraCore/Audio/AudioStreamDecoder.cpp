@@ -0,0 +1,211 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "AudioStreamDecoder.h"
+
+#include <QThread>
+
+#include "MemoryLeakCheck.h"
+
+/// Size of a decoded chunk, in bytes. 64 KB is about 0.37 seconds of 44.1 kHz 16-bit stereo sound.
+static const size_t cChunkSize = 65536;
+/// Number of decoded chunks kept ready for the sound channel, in addition to the chunks queued to OpenAL.
+static const size_t cMaxChunksAhead = 2;
+/// Interval in milliseconds in which the decoder thread checks the streams even if it is not woken up.
+static const unsigned long cPollIntervalMs = 100;
+
+AudioStream::AudioStream() :
+    stereo_(false),
+    frequency_(0),
+    looped_(false),
+    endOfStream_(false),
+    closed_(false)
+{
+}
+
+bool AudioStream::Open(const shared_ptr<const std::vector<u8> > &oggData, bool looped)
+{
+    if (!ogg_.Open(oggData))
+        return false;
+    stereo_ = ogg_.IsStereo();
+    frequency_ = ogg_.Frequency();
+
+    QMutexLocker lock(&mutex_);
+    chunks_.clear();
+    looped_ = looped;
+    endOfStream_ = false;
+    closed_ = false;
+    return true;
+}
+
+void AudioStream::DecodeAhead()
+{
+    for(;;)
+    {
+        bool looped;
+        {
+            QMutexLocker lock(&mutex_);
+            if (closed_ || chunks_.size() >= cMaxChunksAhead)
+                return;
+            if (endOfStream_)
+            {
+                // Continue from the start if looping was enabled after the end was reached.
+                if (!looped_ || !ogg_.Rewind())
+                    return;
+                endOfStream_ = false;
+            }
+            looped = looped_;
+        }
+
+        std::vector<u8> chunk(cChunkSize);
+        size_t size = ogg_.Read(&chunk[0], chunk.size());
+        bool end = false;
+        while(size < chunk.size())
+        {
+            if (!looped || !ogg_.Rewind())
+            {
+                end = true;
+                break;
+            }
+            size_t read = ogg_.Read(&chunk[size], chunk.size() - size);
+            if (read == 0)
+            {
+                end = true; // Nothing to decode after rewinding, do not loop forever.
+                break;
+            }
+            size += read;
+        }
+        chunk.resize(size);
+
+        QMutexLocker lock(&mutex_);
+        if (closed_)
+            return;
+        if (size > 0)
+        {
+            chunks_.push_back(std::vector<u8>());
+            chunks_.back().swap(chunk);
+        }
+        if (end)
+        {
+            endOfStream_ = true;
+            return;
+        }
+    }
+}
+
+bool AudioStream::TakeChunk(std::vector<u8> &pcm)
+{
+    QMutexLocker lock(&mutex_);
+    if (chunks_.empty())
+        return false;
+    pcm.swap(chunks_.front());
+    chunks_.pop_front();
+    return true;
+}
+
+void AudioStream::SetLooped(bool looped)
+{
+    QMutexLocker lock(&mutex_);
+    looped_ = looped;
+}
+
+bool AudioStream::IsFinished() const
+{
+    QMutexLocker lock(&mutex_);
+    return endOfStream_ && chunks_.empty();
+}
+
+void AudioStream::Close()
+{
+    QMutexLocker lock(&mutex_);
+    closed_ = true;
+    chunks_.clear();
+}
+
+bool AudioStream::IsClosed() const
+{
+    QMutexLocker lock(&mutex_);
+    return closed_;
+}
+
+class AudioStreamDecoder::DecoderThread : public QThread
+{
+public:
+    explicit DecoderThread(AudioStreamDecoder *decoder) : decoder_(decoder) {}
+
+protected:
+    void run() { decoder_->ThreadMain(); }
+
+private:
+    AudioStreamDecoder *decoder_;
+};
+
+AudioStreamDecoder::AudioStreamDecoder() :
+    woken_(false),
+    quit_(false)
+{
+    thread_ = new DecoderThread(this);
+    thread_->start();
+}
+
+AudioStreamDecoder::~AudioStreamDecoder()
+{
+    {
+        QMutexLocker lock(&mutex_);
+        quit_ = true;
+        wake_.wakeAll();
+    }
+    thread_->wait();
+    delete thread_;
+}
+
+void AudioStreamDecoder::Add(const AudioStreamPtr &stream)
+{
+    if (!stream)
+        return;
+    QMutexLocker lock(&mutex_);
+    streams_.push_back(stream);
+    woken_ = true;
+    wake_.wakeOne();
+}
+
+void AudioStreamDecoder::Wake()
+{
+    QMutexLocker lock(&mutex_);
+    woken_ = true;
+    wake_.wakeOne();
+}
+
+void AudioStreamDecoder::ThreadMain()
+{
+    std::vector<AudioStreamPtr> streams;
+    for(;;)
+    {
+        {
+            QMutexLocker lock(&mutex_);
+            if (!quit_ && !woken_)
+                wake_.wait(&mutex_, cPollIntervalMs);
+            if (quit_)
+                return;
+            woken_ = false;
+
+            for(size_t i = 0; i < streams_.size();)
+            {
+                if (streams_[i]->IsClosed())
+                {
+                    streams_[i] = streams_.back();
+                    streams_.pop_back();
+                }
+                else
+                    ++i;
+            }
+            streams = streams_;
+        }
+
+        for(size_t i = 0; i < streams.size(); ++i)
+            streams[i]->DecodeAhead();
+        streams.clear(); // Do not keep the streams alive while waiting.
+    }
+}
@@ -0,0 +1,96 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraCoreApi.h"
+#include "CoreTypes.h"
+#include "AudioFwd.h"
+#include "OggVorbisLoader.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <vector>
+#include <deque>
+
+/// The decoding state of one playback of a streamed audio asset.
+/** The decoder side, DecodeAhead(), decodes the .ogg data into 64 KB chunks of PCM data a couple of chunks ahead of the
+    playback, and the SoundChannel playing the sound takes the chunks with TakeChunk() to fill its OpenAL buffers.
+    DecodeAhead() is called either from the AudioStreamDecoder thread or, if there is none, from the main thread,
+    but never from two threads at once. The rest of the functions may be called from any thread. */
+class TUNDRACORE_API AudioStream
+{
+public:
+    AudioStream();
+
+    /// Opens the stream. @return True on success.
+    bool Open(const shared_ptr<const std::vector<u8> > &oggData, bool looped);
+
+    /// Decodes chunks until enough of them are ready, or the end of the stream is reached.
+    void DecodeAhead();
+
+    /// Moves the oldest decoded chunk to @c pcm. @return False if no chunk is ready.
+    bool TakeChunk(std::vector<u8> &pcm);
+
+    /// Sets whether the stream continues from the start when it ends.
+    void SetLooped(bool looped);
+
+    /// Returns true if the end of the stream has been reached and all the chunks have been taken.
+    bool IsFinished() const;
+
+    /// Stops decoding and frees the decoded chunks. The decoder thread forgets closed streams.
+    void Close();
+
+    bool IsClosed() const;
+
+    /// Returns whether the decoded data is stereo (true) or mono (false). Always 16 bits per sample.
+    bool IsStereo() const { return stereo_; }
+
+    /// Returns the sample frequency of the decoded data.
+    int Frequency() const { return frequency_; }
+
+private:
+    OggVorbisStream ogg_; ///< Used only in DecodeAhead(), and therefore not guarded by the mutex.
+    bool stereo_;
+    int frequency_;
+
+    mutable QMutex mutex_;
+    std::deque<std::vector<u8> > chunks_;
+    bool looped_;
+    bool endOfStream_;
+    bool closed_;
+};
+
+/// Background thread which decodes the streams played by the sound channels of AudioAPI.
+class TUNDRACORE_API AudioStreamDecoder
+{
+public:
+    /// Starts the decoder thread.
+    AudioStreamDecoder();
+    /// Stops and joins the decoder thread.
+    ~AudioStreamDecoder();
+
+    /// Starts decoding @c stream. The stream is decoded until it is closed.
+    void Add(const AudioStreamPtr &stream);
+
+    /// Wakes up the decoder thread to top up the streams, after chunks have been taken.
+    void Wake();
+
+private:
+    class DecoderThread;
+    friend class DecoderThread;
+
+    /// Decoder thread main loop.
+    void ThreadMain();
+
+    QMutex mutex_;
+    QWaitCondition wake_;
+    std::vector<AudioStreamPtr> streams_;
+    bool woken_;
+    bool quit_;
+    DecoderThread *thread_;
+
+    // Noncopyable
+    AudioStreamDecoder(const AudioStreamDecoder &);
+    void operator =(const AudioStreamDecoder &);
+};
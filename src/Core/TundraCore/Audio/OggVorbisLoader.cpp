@@ -20,6 +20,13 @@ namespace
 class OggMemDataSource
 {
 public:
+    OggMemDataSource() :
+        data_(0),
+        size_(0),
+        position_(0)
+    {
+    }
+
     OggMemDataSource(const u8* data, size_t size) :
         data_(data),
         size_(size),
@@ -91,6 +98,16 @@ long OggTellCallback(void* datasource)
     return source->Tell();
 }
 
+ov_callbacks OggMemCallbacks()
+{
+    ov_callbacks cb;
+    cb.read_func = &OggReadCallback;
+    cb.seek_func = &OggSeekCallback;
+    cb.tell_func = &OggTellCallback;
+    cb.close_func = 0;
+    return cb;
+}
+
 } // ~unnamed namespace
 #endif
 
@@ -115,13 +132,7 @@ bool LoadOggVorbisFromFileInMemory(const u8 *fileData, size_t numBytes, std::vec
     OggVorbis_File vf;
     OggMemDataSource src(fileData, numBytes);
     
-    ov_callbacks cb;
-    cb.read_func = &OggReadCallback;
-    cb.seek_func = &OggSeekCallback;
-    cb.tell_func = &OggTellCallback;
-    cb.close_func = 0;
-    
-    int ret = ov_open_callbacks(&src, &vf, 0, 0, cb);
+    int ret = ov_open_callbacks(&src, &vf, 0, 0, OggMemCallbacks());
     if (ret < 0)
     {
         LogError("LoadOggVorbisFromFileInMemory: Not ogg vorbis format");
@@ -177,4 +188,148 @@ bool LoadOggVorbisFromFileInMemory(const u8 *fileData, size_t numBytes, std::vec
 #endif
 }
 
+size_t DecodedOggVorbisSize(const u8 *fileData, size_t numBytes)
+{
+    if (!fileData || numBytes == 0)
+        return 0;
+
+#ifndef TUNDRA_NO_AUDIO
+    OggVorbis_File vf;
+    OggMemDataSource src(fileData, numBytes);
+    if (ov_open_callbacks(&src, &vf, 0, 0, OggMemCallbacks()) < 0)
+    {
+        ov_clear(&vf);
+        return 0;
+    }
+
+    size_t size = 0;
+    vorbis_info* vi = ov_info(&vf, -1);
+    ogg_int64_t numSamples = ov_pcm_total(&vf, -1);
+    if (vi && numSamples > 0)
+        size = (size_t)numSamples * vi->channels * 2;
+    ov_clear(&vf);
+    return size;
+#else
+    return 0;
+#endif
+}
+
 } // ~OggVorbisLoader
+
+struct OggVorbisStream::Impl
+{
+    Impl() : open(false), stereo(false), frequency(0) {}
+
+    shared_ptr<const std::vector<u8> > data;
+#ifndef TUNDRA_NO_AUDIO
+    OggMemDataSource src;
+    OggVorbis_File vf;
+#endif
+    bool open;
+    bool stereo;
+    int frequency;
+};
+
+OggVorbisStream::OggVorbisStream() :
+    impl_(new Impl)
+{
+}
+
+OggVorbisStream::~OggVorbisStream()
+{
+    Close();
+    delete impl_;
+}
+
+bool OggVorbisStream::Open(const shared_ptr<const std::vector<u8> > &data)
+{
+    Close();
+    if (!data || data->empty())
+    {
+        LogError("OggVorbisStream::Open: Null input data passed in");
+        return false;
+    }
+
+#ifndef TUNDRA_NO_AUDIO
+    impl_->data = data;
+    impl_->src = OggMemDataSource(&(*data)[0], data->size());
+    if (ov_open_callbacks(&impl_->src, &impl_->vf, 0, 0, OggMemCallbacks()) < 0)
+    {
+        LogError("OggVorbisStream::Open: Not ogg vorbis format");
+        ov_clear(&impl_->vf);
+        impl_->data.reset();
+        return false;
+    }
+
+    vorbis_info* vi = ov_info(&impl_->vf, -1);
+    if (!vi)
+    {
+        LogError("OggVorbisStream::Open: No ogg vorbis stream info");
+        ov_clear(&impl_->vf);
+        impl_->data.reset();
+        return false;
+    }
+
+    impl_->stereo = (vi->channels > 1);
+    impl_->frequency = vi->rate;
+    impl_->open = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void OggVorbisStream::Close()
+{
+#ifndef TUNDRA_NO_AUDIO
+    if (impl_->open)
+        ov_clear(&impl_->vf);
+#endif
+    impl_->open = false;
+    impl_->data.reset();
+}
+
+bool OggVorbisStream::IsOpen() const
+{
+    return impl_->open;
+}
+
+size_t OggVorbisStream::Read(u8 *dst, size_t numBytes)
+{
+    size_t decodedBytes = 0;
+#ifndef TUNDRA_NO_AUDIO
+    if (!impl_->open)
+        return 0;
+
+    while(decodedBytes < numBytes)
+    {
+        int bitstream;
+        long ret = ov_read(&impl_->vf, (char*)dst + decodedBytes, (int)(numBytes - decodedBytes), 0, 2, 1, &bitstream);
+        if (ret == OV_HOLE)
+            continue; // Interruption in the data, decoding can continue after it.
+        if (ret <= 0)
+            break;
+        decodedBytes += ret;
+    }
+#endif
+    return decodedBytes;
+}
+
+bool OggVorbisStream::Rewind()
+{
+#ifndef TUNDRA_NO_AUDIO
+    return impl_->open && ov_raw_seek(&impl_->vf, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+bool OggVorbisStream::IsStereo() const
+{
+    return impl_->stereo;
+}
+
+int OggVorbisStream::Frequency() const
+{
+    return impl_->frequency;
+}
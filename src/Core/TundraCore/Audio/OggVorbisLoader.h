@@ -1,5 +1,7 @@
 // For conditions of distribution and use, see copyright notice in LICENSE
 
+#pragma once
+
 #include <vector>
 #include "CoreTypes.h"
 #include "SoundBuffer.h"
@@ -26,7 +28,50 @@ inline bool TUNDRACORE_API LoadOggVorbisFileToSoundBuffer(const u8 *data, size_t
     return LoadOggVorbisFromFileInMemory(data, numBytes, dst.data, &dst.stereo, &dst.is16Bit, &dst.frequency);
 }
 
+/// Returns the size of the 16-bit PCM data the given .ogg file in memory decodes to, without decoding it.
+/// @return The size in bytes, or 0 if the data is not a valid Ogg Vorbis file.
+size_t TUNDRACORE_API DecodedOggVorbisSize(const u8 *fileData, size_t numBytes);
+
 /// Returns true the header of the given file in memory matches a .ogg file. \todo Implement this.
 /// bool TUNDRACORE_API IdentifyOggVorbisFileInMemory(const u8 *fileData, size_t numBytes);
 
 } // ~OggVorbisLoader
+
+/// Decodes a .ogg file in memory incrementally, for playing long sounds without decoding them whole.
+/** Not thread-safe, but an instance may be used from any one thread at a time. */
+class TUNDRACORE_API OggVorbisStream
+{
+public:
+    OggVorbisStream();
+    ~OggVorbisStream();
+
+    /// Opens the stream, closing any previously opened one.
+    /// @param data The .ogg file contents. Shared, so that the stream stays valid after the asset it came from is unloaded.
+    /// @return True on success, false if the data is not a valid Ogg Vorbis file.
+    bool Open(const shared_ptr<const std::vector<u8> > &data);
+
+    void Close();
+
+    bool IsOpen() const;
+
+    /// Decodes up to numBytes of 16-bit PCM data to dst.
+    /// @return Number of bytes decoded. Less than numBytes only at the end of the stream, or on a decode error.
+    size_t Read(u8 *dst, size_t numBytes);
+
+    /// Seeks back to the start of the stream. @return True on success.
+    bool Rewind();
+
+    /// Returns whether the decoded data is stereo (true) or mono (false).
+    bool IsStereo() const;
+
+    /// Returns the sample frequency of the decoded data.
+    int Frequency() const;
+
+private:
+    struct Impl;
+    Impl *impl_;
+
+    // Noncopyable
+    OggVorbisStream(const OggVorbisStream &);
+    void operator =(const OggVorbisStream &);
+};
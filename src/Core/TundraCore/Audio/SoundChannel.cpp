@@ -4,6 +4,7 @@
 #include "DebugOperatorNew.h"
 
 #include "SoundChannel.h"
+#include "AudioStreamDecoder.h"
 #include "LoggingFunctions.h"
 #include "Math/MathFunc.h"
 
@@ -18,6 +19,7 @@
 #endif
 
 #include <cfloat>
+#include <algorithm>
 
 #include "MemoryLeakCheck.h"
 
@@ -25,10 +27,13 @@ static const float cMinimumRollOff = 0.1f;
 static const float cDefaultRollOff = 2.0f;
 static const float cDefaultInnerRadius = 1.0f;
 static const float cDefaultOuterRadius = 50.0f;
+/// Number of OpenAL buffers a streamed sound is played through. Each holds one decoded chunk of the stream.
+static const int cNumStreamBuffers = 4;
 
-SoundChannel::SoundChannel(sound_id_t channelId_, SoundType type) :
+SoundChannel::SoundChannel(sound_id_t channelId_, SoundType type, AudioStreamDecoder *streamDecoder) :
     type_(type),
     handle_(0),
+    stream_decoder_(streamDecoder),
     pitch_(1.0f),
     gain_(1.0f),
     master_gain_(1.0f),
@@ -57,6 +62,7 @@ void SoundChannel::Update(const float3& listener_pos)
     SetAttenuatedGain();
     QueueBuffers();
     UnqueueBuffers();
+    UpdateStream();
     
     if (state_ == Playing)
     {
@@ -67,8 +73,8 @@ void SoundChannel::Update(const float3& listener_pos)
             if (playing != AL_PLAYING)
             {
                 // Stopped state may trigger removal of audio channel, so don't
-                // do that in buffered mode
-                if (buffered_mode_)
+                // do that in buffered mode, or when a stream ran out of decoded data
+                if (buffered_mode_ || stream_)
                 {
                     state_ = Pending;
                 }
@@ -161,6 +167,7 @@ void SoundChannel::Stop()
         alSourcei(handle_, AL_BUFFER, 0);
     }
     
+    ReleaseStream();
     pending_sounds_.clear();
     playing_sounds_.clear();
     
@@ -202,8 +209,11 @@ void SoundChannel::SetLooped(bool enable)
         enable = false;
 
     looped_ = enable;
+    // A stream loops by decoding from the start again, OpenAL must not loop the queued buffers.
+    if (stream_)
+        stream_->SetLooped(looped_);
     if (handle_)
-        alSourcei(handle_, AL_LOOPING, looped_ ? AL_TRUE : AL_FALSE);
+        alSourcei(handle_, AL_LOOPING, looped_ && !stream_ ? AL_TRUE : AL_FALSE);
 #endif
 }
 
@@ -319,6 +329,14 @@ void SoundChannel::QueueBuffers()
             pending_sounds_.pop_front();
             continue;
         }
+        if (sound->IsStreaming())
+        {
+            // The buffers of a stream are queued in UpdateStream once the first chunks have been decoded.
+            pending_sounds_.pop_front();
+            if (StartStream(sound))
+                playing_sounds_.push_back(sound);
+            continue;
+        }
         ALuint buffer = sound->GetHandle();
         // If no valid handle yet, cannot play this one, break out
         if (!buffer)
@@ -375,7 +393,9 @@ void SoundChannel::UnqueueBuffers()
         {
             ALuint buffer = 0;
             alSourceUnqueueBuffers(handle_, 1, &buffer);
-            if (buffer)
+            if (buffer && std::find(stream_buffers_.begin(), stream_buffers_.end(), buffer) != stream_buffers_.end())
+                free_stream_buffers_.push_back(buffer);
+            else if (buffer)
             {
                 // See if we find matching buffer from the sounds vector.
                 // If found, erase so that the sound may be freed if not used elsewhere
@@ -392,3 +412,99 @@ void SoundChannel::UnqueueBuffers()
     }
 #endif
 }
+
+bool SoundChannel::StartStream(const AudioAssetPtr &sound)
+{
+#ifndef TUNDRA_NO_AUDIO
+    ReleaseStream();
+
+    stream_ = sound->OpenStream(looped_);
+    if (!stream_)
+    {
+        LogError("Could not open stream of sound " + sound->Name());
+        return false;
+    }
+
+    stream_buffers_.resize(cNumStreamBuffers);
+    alGetError();
+    alGenBuffers(cNumStreamBuffers, &stream_buffers_[0]);
+    if (alGetError() != AL_NONE)
+    {
+        LogError("Could not create OpenAL sound buffers for streaming");
+        stream_buffers_.clear();
+        stream_->Close();
+        stream_.reset();
+        return false;
+    }
+    free_stream_buffers_ = stream_buffers_;
+
+    // A stream loops by decoding from the start again, OpenAL must not loop the queued buffers.
+    alSourcei(handle_, AL_LOOPING, AL_FALSE);
+
+    if (stream_decoder_)
+        stream_decoder_->Add(stream_);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SoundChannel::UpdateStream()
+{
+#ifndef TUNDRA_NO_AUDIO
+    if (!stream_ || !handle_)
+        return;
+
+    if (!stream_decoder_)
+        stream_->DecodeAhead();
+
+    ALenum format = stream_->IsStereo() ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
+    bool queued = false;
+    while(!free_stream_buffers_.empty() && stream_->TakeChunk(stream_chunk_))
+    {
+        ALuint buffer = free_stream_buffers_.back();
+        alBufferData(buffer, format, (const ALvoid*)&stream_chunk_[0], (ALsizei)stream_chunk_.size(), stream_->Frequency());
+        alSourceQueueBuffers(handle_, 1, &buffer);
+        free_stream_buffers_.pop_back();
+        queued = true;
+    }
+
+    if (queued)
+    {
+        if (stream_decoder_)
+            stream_decoder_->Wake();
+        // Starts the playback, or restarts it if the source ran out of data before the decoder caught up.
+        ALint playing;
+        alGetSourcei(handle_, AL_SOURCE_STATE, &playing);
+        if (playing != AL_PLAYING)
+            alSourcePlay(handle_);
+        state_ = Playing;
+    }
+    else if (free_stream_buffers_.size() == stream_buffers_.size() && stream_->IsFinished())
+        Stop(); // All of the stream has been played.
+#endif
+}
+
+void SoundChannel::ReleaseStream()
+{
+#ifndef TUNDRA_NO_AUDIO
+    if (!stream_)
+        return;
+
+    stream_->Close();
+    stream_.reset();
+
+    // The buffers can only be deleted when they are not queued.
+    if (handle_)
+    {
+        alSourceStop(handle_);
+        alSourcei(handle_, AL_BUFFER, 0);
+        alSourcei(handle_, AL_LOOPING, looped_ ? AL_TRUE : AL_FALSE);
+    }
+    if (!stream_buffers_.empty())
+        alDeleteBuffers((ALsizei)stream_buffers_.size(), &stream_buffers_[0]);
+    stream_buffers_.clear();
+    free_stream_buffers_.clear();
+    stream_chunk_.clear();
+#endif
+}
@@ -45,7 +45,8 @@ public:
         Voice
     };
 
-    SoundChannel(sound_id_t channelId, SoundType type);
+    /// @param streamDecoder Decoder thread for the streamed sounds played on the channel. If null, they are decoded in Update.
+    SoundChannel(sound_id_t channelId, SoundType type, AudioStreamDecoder *streamDecoder = 0);
     ~SoundChannel();
     
 public slots:
@@ -133,6 +134,12 @@ private:
     void QueueBuffers();
     /// Remove processed buffers
     void UnqueueBuffers();
+    /// Start playing a streamed sound. Create the source before calling.
+    bool StartStream(const AudioAssetPtr &sound);
+    /// Refill the processed stream buffers from the stream, and stop when the stream has been played
+    void UpdateStream();
+    /// Close the stream and delete its buffers, if streaming
+    void ReleaseStream();
     /// Create OpenAL source if one does not exist yet
     bool CreateSource();
     /// Delete OpenAL source
@@ -152,6 +159,16 @@ private:
     std::list<AudioAssetPtr> pending_sounds_;
     /// Currently playing sound buffers
     std::vector<AudioAssetPtr> playing_sounds_;
+    /// Decoder thread of the streamed sounds, null to decode them in Update
+    AudioStreamDecoder *stream_decoder_;
+    /// Stream of the streamed sound being played, null if not streaming
+    AudioStreamPtr stream_;
+    /// Ring of OpenAL buffers which the stream is played through
+    std::vector<ALuint> stream_buffers_;
+    /// Stream buffers which are not queued to the source
+    std::vector<ALuint> free_stream_buffers_;
+    /// Decoded stream data being copied to a buffer
+    std::vector<u8> stream_chunk_;
     /// Pitch
     float pitch_;
     /// Gain
@@ -18,11 +18,14 @@
 #include "UiGraphicsView.h"
 #include "LoggingFunctions.h"
 #include "FunctionInvoker.h"
+#include "LogWriter.h"
+#include "Win.h"
 
 #include <stdlib.h>
 
 #include <QFile>
 #include <QTextStream>
+#include <QThread>
 
 #ifdef ANDROID
 #include <android/log.h>
@@ -42,16 +45,23 @@ ConsoleAPI::ConsoleAPI(Framework *fw) :
 ConsoleAPI::~ConsoleAPI()
 {
     Reset();
+    logWriter.reset();
 }
 
 void ConsoleAPI::Reset()
 {
+    // Write out the queued messages before closing the outputs. Other threads may still call Write(), so the writer is
+    // only stopped here, after which it writes synchronously, and released in the destructor.
+    if (logWriter)
+        logWriter->Stop();
     commands.clear();
     inputContext.reset();
     SAFE_DELETE(consoleWidget);
     shellInputThread.reset();
+    QMutexLocker lock(&outputMutex);
     SAFE_DELETE(logFileText);
     SAFE_DELETE(logFile);
+    widgetQueue.clear();
 }
 
 QVariant ConsoleCommand::Invoke(const QStringList &params)
@@ -184,44 +194,78 @@ void ConsoleAPI::ExecuteCommand(const QString &command)
 
 void ConsoleAPI::Print(const QString &message)
 {
-    if (consoleWidget)
-        consoleWidget->PrintToConsole(message);
-    else if (!framework->IsHeadless())
-        backBuffer << message; // ConsoleWidget not created yet, but will be - store message to back buffer.
+    Write(LogChannelInfo, message);
+}
 
-    ///\todo Temporary hack which appends line ending in case it's not there (output of console commands in headless mode)
-    if (!message.endsWith("\n"))
+void ConsoleAPI::Write(u32 logChannel, const QString &message)
+{
+    if (logWriter)
+        logWriter->Push(logChannel, message);
+    else
     {
-#ifndef ANDROID
-        printf("%s\n", message.toStdString().c_str());
-#else
-        __android_log_print(ANDROID_LOG_INFO, "Tundra", "%s\n", message.toStdString().c_str());
-#endif
-        if (logFileText)
-        {
-            (*logFileText) << message << "\n";
-            /// \note If we want to guarantee that each message gets to the log even in the presence of a crash, we must flush()
-            /// after each write. Tested that on Windows 7, if you kill the process using Ctrl-C on command line, or from 
-            /// task manager, the log will not contain all the text, so this is required for correctness.
-            /// But this flush() after each message also causes a *serious* performance drawback.
-            /// One way to try avoiding this issue is to move to using C API for file writing, and at atexit() and other crash
-            /// handlers, close the file handle gracefully.
-            logFileText->flush(); 
-        }
+        std::vector<LogMessage> messages(1);
+        messages[0].channel = logChannel;
+        messages[0].text = message;
+        WriteOutput(messages);
     }
-    else
+}
+
+void ConsoleAPI::WriteOutput(const std::vector<LogMessage> &messages)
+{
+    const bool mainThread = (QThread::currentThread() == thread());
     {
+        QMutexLocker lock(&outputMutex);
+        for(size_t i = 0; i < messages.size(); ++i)
+        {
+            const u32 logChannel = messages[i].channel;
+            ///\todo Temporary hack which appends line ending in case it's not there (output of console commands in headless mode)
+            const QString &message = messages[i].text;
+            const char *lineEnd = (message.endsWith("\n") ? "" : "\n");
+
+            // On Windows, highlight errors and warnings.
+#ifdef WIN32
+            if ((logChannel & LogChannelError) != 0) SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_INTENSITY);
+            else if ((logChannel & LogChannelWarning) != 0) SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY);
+#endif
 #ifndef ANDROID
-        printf("%s", message.toStdString().c_str());
+            printf("%s%s", message.toStdString().c_str(), lineEnd);
 #else
-        __android_log_print(ANDROID_LOG_INFO, "Tundra", "%s", message.toStdString().c_str());
+            __android_log_print(ANDROID_LOG_INFO, "Tundra", "%s%s", message.toStdString().c_str(), lineEnd);
 #endif
-        if (logFileText)
-        {
-            (*logFileText) << message;
-            logFileText->flush(); // See comment about flush() above.
+            // Restore the text color to normal.
+#ifdef WIN32
+            if ((logChannel & (LogChannelError | LogChannelWarning)) != 0)
+                SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+#else
+            UNREFERENCED_PARAM(logChannel);
+#endif
+            if (logFileText)
+                (*logFileText) << message << lineEnd;
+
+            if (!mainThread && !framework->IsHeadless())
+                widgetQueue << message;
         }
+
+        /// \note If we want to guarantee that each message gets to the log even in the presence of a crash, we must flush()
+        /// after each write. Tested that on Windows 7, if you kill the process using Ctrl-C on command line, or from 
+        /// task manager, the log will not contain all the text. The log writer thread flushes once per batch of messages,
+        /// so at most the messages of the last --logFlushInterval milliseconds can be lost. Use --logFlushInterval 0
+        /// to write and flush each message immediately.
+        if (logFileText)
+            logFileText->flush();
     }
+
+    if (mainThread)
+        for(size_t i = 0; i < messages.size(); ++i)
+            PrintToWidget(messages[i].text);
+}
+
+void ConsoleAPI::PrintToWidget(const QString &message)
+{
+    if (consoleWidget)
+        consoleWidget->PrintToConsole(message);
+    else if (!framework->IsHeadless())
+        backBuffer << message; // ConsoleWidget not created yet, but will be - store message to back buffer.
 }
 
 void ConsoleAPI::ListCommands()
@@ -262,23 +306,26 @@ void ConsoleAPI::SetLogFile(const QString &wildCardFilename)
 {
     QString filename = Application::ParseWildCardFilename(wildCardFilename);
     
+    QFile *newLogFile = 0;
     // An empty log file closes the log output writing.
-    if (filename.isEmpty())
+    if (!filename.isEmpty())
     {
-        SAFE_DELETE(logFileText);
-        SAFE_DELETE(logFile);
-        return;
-    }
-    logFile = new QFile(filename);
-    bool isOpen = logFile->open(QIODevice::WriteOnly | QIODevice::Text);
-    if (!isOpen)
-    {
-        LogError("Failed to open file \"" + filename + "\" for logging! (parsed from string \"" + wildCardFilename + "\")");
-        SAFE_DELETE(logFile);
+        newLogFile = new QFile(filename);
+        if (!newLogFile->open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            LogError("Failed to open file \"" + filename + "\" for logging! (parsed from string \"" + wildCardFilename + "\")");
+            SAFE_DELETE(newLogFile);
+        }
     }
-    else
+
+    // The log writer thread may be writing to the old file.
+    QMutexLocker lock(&outputMutex);
+    SAFE_DELETE(logFileText);
+    SAFE_DELETE(logFile);
+    if (newLogFile)
     {
         printf("Opened logging file \"%s\".\n", filename.toStdString().c_str());
+        logFile = newLogFile;
         logFileText = new QTextStream(logFile);
     }
 }
@@ -287,6 +334,14 @@ void ConsoleAPI::Update(f64 /*frametime*/)
 {
     PROFILE(ConsoleAPI_Update);
 
+    QStringList queued;
+    {
+        QMutexLocker lock(&outputMutex);
+        queued.swap(widgetQueue);
+    }
+    foreach(const QString &message, queued)
+        PrintToWidget(message);
+
     std::string input = shellInputThread->GetLine();
     if (input.length() > 0)
         ExecuteCommand(input.c_str());
@@ -312,6 +367,21 @@ void ConsoleAPI::Initialize()
     if (logFile.size() > 1)
         LogWarning("Ignoring multiple --logFile command line parameters!");
 
+    uint flushIntervalMs = 100;
+    const QStringList logFlushInterval = framework->CommandLineParameters("--logFlushInterval");
+    if (logFlushInterval.size() >= 1)
+    {
+        bool ok = false;
+        flushIntervalMs = logFlushInterval[logFlushInterval.size()-1].toUInt(&ok);
+        if (!ok)
+        {
+            LogWarning("Invalid --logFlushInterval \"" + logFlushInterval[logFlushInterval.size()-1] + "\", using the default 100 milliseconds.");
+            flushIntervalMs = 100;
+        }
+    }
+    if (flushIntervalMs > 0)
+        logWriter = MAKE_SHARED(LogWriter, this, flushIntervalMs);
+
     if (!framework->IsHeadless())
     {
        consoleWidget = new ConsoleWidget(framework);
@@ -381,7 +451,7 @@ void ConsoleAPI::LogDebug(const QString &message)
 void ConsoleAPI::Log(u32 logChannel, const QString &message)
 {
     if (IsLogChannelEnabled(logChannel))
-        Print(message);
+        Write(logChannel, message);
 }
 
 void ConsoleAPI::SetEnabledLogChannels(u32 newChannels)
@@ -14,6 +14,9 @@
 #include <QPointer>
 #include <QObject>
 #include <QMap>
+#include <QMutex>
+
+#include <vector>
 
 class QFile;
 class QTextStream;
@@ -22,6 +25,8 @@ class Framework;
 class ConsoleWidget;
 class ShellInputThread;
 class ConsoleCommand;
+class LogWriter;
+struct LogMessage;
 
 /// Console core API.
 /** Allows printing text to console, executing console commands programmatically and registering new console commands.
@@ -57,6 +62,11 @@ public:
         @see UnregisterCommand */
     void RegisterCommand(const QString &name, const QString &desc, QObject *receiver, const char *memberSlot, const char *memberSlotDefaultArgs = 0);
 
+    /// Writes a message to the console widget's log, stdout and the log file. Can be called from any thread.
+    /** The message is queued to the log writer thread, or written immediately if the log writer is disabled with --logFlushInterval 0.
+        @note This does not check if @c logChannel is enabled, use Log for that. */
+    void Write(u32 logChannel, const QString &message);
+
 public slots:
     /// Registers a new console command which triggers a signal when executed.
     /** Use this function from QtScript to implement custom console commands from a script.
@@ -130,8 +140,16 @@ public slots:
 
 private:
     friend class Framework;
+    friend class LogWriter;
     void Initialize(); ///< Called by Framework when Input and UI APIs are initialized.
 
+    /// Writes messages to stdout and the log file, and the console widget.
+    /** Called by the log writer thread, or by Write if the log writer is disabled. The widget can be used only in the main thread,
+        so the messages written in other threads are queued to widgetQueue, and printed to the widget in Update. */
+    void WriteOutput(const std::vector<LogMessage> &messages);
+    /// Prints a message to the console widget, or to the back buffer if the widget is not yet created. Called only in the main thread.
+    void PrintToWidget(const QString &message);
+
     Framework *framework;
     CommandMap commands; ///< Stores all the registered console commands.
     InputContextPtr inputContext;
@@ -141,6 +159,9 @@ private:
     QFile *logFile; ///< Points to the currently open text file for logging.
     QTextStream *logFileText;
     QStringList backBuffer; ///< Back buffer of unprinted log prints before ConsoleWidget is created.
+    shared_ptr<LogWriter> logWriter; ///< Writes the log messages in a background thread. Null if disabled with --logFlushInterval 0.
+    QMutex outputMutex; ///< Guards stdout, logFile, logFileText and widgetQueue.
+    QStringList widgetQueue; ///< Messages written in other threads than the main thread, to be printed to the console widget in Update.
 
 private slots:
     void HandleKeyEvent(KeyEvent *e);
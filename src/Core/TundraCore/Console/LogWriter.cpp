@@ -0,0 +1,248 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "LogWriter.h"
+#include "ConsoleAPI.h"
+#include "LoggingFunctions.h"
+
+#include <QThread>
+#include <QTime>
+
+#include <algorithm>
+
+#include "MemoryLeakCheck.h"
+
+/// Number of messages a ring can hold. When a ring gets half full, the writer thread is woken up before its interval.
+static const int cRingSize = 4096;
+/// Interval in milliseconds in which the number of repeats of a message that keeps repeating is written.
+static const int cRepeatNoteIntervalMs = 1000;
+
+/// Ring buffer of the messages of one thread. The thread pushes and the writer thread pops, without locking.
+class LogWriter::Ring
+{
+public:
+    Ring() : head_(0), tail_(0), numDropped_(0), messages_(cRingSize) {}
+
+    /// Called only by the thread owning the ring. @return True if the ring became half full.
+    bool Push(const LogMessage &message)
+    {
+        const int head = head_;
+        const int next = (head + 1) % cRingSize;
+        const int tail = tail_.fetchAndAddAcquire(0);
+        if (next == tail)
+        {
+            numDropped_.fetchAndAddRelaxed(1);
+            return false;
+        }
+        messages_[head] = message;
+        head_.fetchAndStoreRelease(next);
+        return (next - tail + cRingSize) % cRingSize == cRingSize / 2;
+    }
+
+    /// Called only by the writer thread. @return False if the ring is empty.
+    bool Pop(LogMessage &message)
+    {
+        const int tail = tail_;
+        if (tail == head_.fetchAndAddAcquire(0))
+            return false;
+        message = messages_[tail];
+        messages_[tail] = LogMessage(); // Free the text in the writer thread.
+        tail_.fetchAndStoreRelease((tail + 1) % cRingSize);
+        return true;
+    }
+
+    bool IsEmpty() { return tail_.fetchAndAddAcquire(0) == head_.fetchAndAddAcquire(0); }
+
+    /// Returns the number of messages dropped since the last call.
+    int TakeNumDropped() { return numDropped_.fetchAndStoreRelaxed(0); }
+
+private:
+    QAtomicInt head_; ///< Index of the next message to push, written only by the owner thread.
+    QAtomicInt tail_; ///< Index of the next message to pop, written only by the writer thread.
+    QAtomicInt numDropped_;
+    std::vector<LogMessage> messages_;
+};
+
+class LogWriter::WriterThread : public QThread
+{
+public:
+    explicit WriterThread(LogWriter *writer) : writer_(writer) {}
+
+protected:
+    void run() { writer_->ThreadMain(); }
+
+private:
+    LogWriter *writer_;
+};
+
+/// Orders the log messages by their sequence number, which may have wrapped around.
+struct LogMessageOrder
+{
+    bool operator()(const LogMessage &a, const LogMessage &b) const { return (int)(a.sequence - b.sequence) < 0; }
+};
+
+LogWriter::LogWriter(ConsoleAPI *console, unsigned long flushIntervalMs) :
+    console_(console),
+    flushIntervalMs_(flushIntervalMs),
+    sequence_(0),
+    stopped_(0),
+    woken_(false),
+    quit_(false),
+    numRepeats_(0)
+{
+    thread_ = new WriterThread(this);
+    thread_->start();
+}
+
+LogWriter::~LogWriter()
+{
+    Stop();
+}
+
+void LogWriter::Stop()
+{
+    if (!thread_)
+        return;
+
+    stopped_.fetchAndStoreOrdered(1);
+    {
+        QMutexLocker lock(&mutex_);
+        quit_ = true;
+        wake_.wakeAll();
+    }
+    thread_->wait();
+    delete thread_;
+    thread_ = 0;
+
+    // Write the messages pushed by the threads that did not yet see the stopped flag while the writer thread was quitting.
+    WriteQueued(true);
+}
+
+void LogWriter::Push(u32 logChannel, const QString &text)
+{
+    LogMessage message;
+    message.channel = logChannel;
+    message.text = text;
+    if (stopped_.fetchAndAddAcquire(0))
+    {
+        console_->WriteOutput(std::vector<LogMessage>(1, message));
+        return;
+    }
+    message.sequence = (u32)sequence_.fetchAndAddRelaxed(1);
+    if (RingOfThisThread()->Push(message))
+    {
+        QMutexLocker lock(&mutex_);
+        woken_ = true;
+        wake_.wakeOne();
+    }
+}
+
+LogWriter::Ring *LogWriter::RingOfThisThread()
+{
+    RingRef *ref = threadRing_.localData();
+    if (!ref)
+    {
+        ref = new RingRef;
+        ref->ring = MAKE_SHARED(Ring);
+        threadRing_.setLocalData(ref);
+        QMutexLocker lock(&mutex_);
+        rings_.push_back(ref->ring);
+    }
+    return ref->ring.get();
+}
+
+void LogWriter::ThreadMain()
+{
+    for(;;)
+    {
+        bool quit;
+        {
+            QMutexLocker lock(&mutex_);
+            if (!quit_ && !woken_)
+                wake_.wait(&mutex_, flushIntervalMs_);
+            woken_ = false;
+            quit = quit_;
+        }
+
+        WriteQueued(quit);
+        if (quit)
+            return;
+    }
+}
+
+void LogWriter::WriteQueued(bool final)
+{
+    std::vector<shared_ptr<Ring> > rings;
+    {
+        QMutexLocker lock(&mutex_);
+        // Forget the rings of the threads that have exited, once they have been emptied.
+        for(size_t i = 0; i < rings_.size();)
+        {
+            if (rings_[i].unique() && rings_[i]->IsEmpty())
+            {
+                rings_[i] = rings_.back();
+                rings_.pop_back();
+            }
+            else
+                ++i;
+        }
+        rings = rings_;
+    }
+
+    std::vector<LogMessage> messages;
+    int numDropped = 0;
+    LogMessage message;
+    for(size_t i = 0; i < rings.size(); ++i)
+    {
+        while(rings[i]->Pop(message))
+            messages.push_back(message);
+        numDropped += rings[i]->TakeNumDropped();
+    }
+    rings.clear();
+
+    if (messages.empty() && numDropped == 0 && numRepeats_ == 0)
+        return;
+
+    std::sort(messages.begin(), messages.end(), LogMessageOrder());
+
+    std::vector<LogMessage> batch;
+    batch.reserve(messages.size() + 2);
+    for(size_t i = 0; i < messages.size(); ++i)
+    {
+        if (messages[i].channel == lastMessage_.channel && messages[i].text == lastMessage_.text)
+        {
+            if (numRepeats_++ == 0)
+                firstRepeat_.start();
+            continue;
+        }
+        AddRepeatNote(batch);
+        lastMessage_ = messages[i];
+        batch.push_back(messages[i]);
+    }
+    if (numRepeats_ > 0 && (final || firstRepeat_.elapsed() >= cRepeatNoteIntervalMs))
+        AddRepeatNote(batch);
+
+    if (numDropped > 0)
+    {
+        LogMessage dropped;
+        dropped.channel = LogChannelWarning;
+        dropped.text = "Warning: " + QString::number(numDropped) + " log messages were dropped, as they were logged faster than they could be written.\n";
+        batch.push_back(dropped);
+    }
+
+    if (!batch.empty())
+        console_->WriteOutput(batch);
+}
+
+void LogWriter::AddRepeatNote(std::vector<LogMessage> &batch)
+{
+    if (numRepeats_ == 0)
+        return;
+    LogMessage note;
+    note.channel = lastMessage_.channel;
+    note.text = "(Last message repeated " + QString::number(numRepeats_) + " times.)\n";
+    batch.push_back(note);
+    numRepeats_ = 0;
+}
@@ -0,0 +1,93 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraCoreApi.h"
+#include "CoreTypes.h"
+
+#include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QThreadStorage>
+#include <QTime>
+
+#include <vector>
+
+class ConsoleAPI;
+
+/// A log message queued to LogWriter.
+struct LogMessage
+{
+    LogMessage() : channel(0), sequence(0) {}
+
+    u32 channel;
+    QString text;
+    u32 sequence; ///< Order in which the messages were logged by all threads.
+};
+
+/// Background thread which writes the log messages of all threads to the outputs of ConsoleAPI.
+/** Each thread that logs pushes its messages to a ring buffer of its own, without locking. The writer thread wakes up
+    periodically, collects the messages of all the rings, puts them back in the order they were logged, and hands them
+    to ConsoleAPI::WriteOutput() in one batch, so the log file is flushed once per batch and not once per message.
+    A message repeated several times in a row is written once, followed by the number of repeats. */
+class TUNDRACORE_API LogWriter
+{
+public:
+    /// Starts the writer thread.
+    /** @param flushIntervalMs Interval in milliseconds in which the queued messages are written. */
+    LogWriter(ConsoleAPI *console, unsigned long flushIntervalMs);
+    /// Stops the writer thread, see Stop().
+    ~LogWriter();
+
+    /// Writes the remaining messages, and stops and joins the writer thread. Does nothing if already stopped.
+    /** The messages pushed after this are written synchronously by the pushing thread, so Push() stays safe to call. */
+    void Stop();
+
+    /// Queues a message to be written. Can be called from any thread.
+    /** Lock-free, except for the first message of each thread. If the ring of the calling thread is full the message is
+        dropped, and the number of the dropped messages is written later. */
+    void Push(u32 logChannel, const QString &text);
+
+private:
+    class Ring;
+    class WriterThread;
+    friend class WriterThread;
+    /// Owns a reference to the ring of a thread in its thread storage, so that the ring outlives the thread if it has unwritten messages.
+    struct RingRef { shared_ptr<Ring> ring; };
+
+    /// Returns the ring of the calling thread, creating it if necessary.
+    Ring *RingOfThisThread();
+
+    /// Writer thread main loop.
+    void ThreadMain();
+
+    /// Writes the messages of all the rings.
+    /** @param final If true, the repeats of the last message are written even if the repeat note interval has not elapsed. */
+    void WriteQueued(bool final);
+
+    /// Adds the note of the repeats of the last message to @c batch, if it was repeated.
+    void AddRepeatNote(std::vector<LogMessage> &batch);
+
+    ConsoleAPI *console_;
+    const unsigned long flushIntervalMs_;
+    QAtomicInt sequence_;
+    QAtomicInt stopped_; ///< Set by Stop(), after which Push() writes synchronously.
+    QThreadStorage<RingRef*> threadRing_;
+
+    QMutex mutex_; ///< Guards rings_, woken_ and quit_.
+    QWaitCondition wake_;
+    std::vector<shared_ptr<Ring> > rings_;
+    bool woken_;
+    bool quit_;
+    WriterThread *thread_;
+
+    // Used only in the writer thread.
+    LogMessage lastMessage_;
+    u32 numRepeats_;
+    QTime firstRepeat_;
+
+    // Noncopyable
+    LogWriter(const LogWriter &);
+    void operator =(const LogWriter &);
+};
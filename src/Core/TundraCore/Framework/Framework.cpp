@@ -177,6 +177,8 @@ Framework::Framework(int argc_, char** argv_, Application *app) :
         cmdLineDescs.commands["--run"] = "Runs script on startup"; // JavaScriptModule
         cmdLineDescs.commands["--plugin"] = "Specifies a shared library (a 'plugin') to be loaded, relative to 'TUNDRA_DIRECTORY/plugins' path. Multiple plugin parameters are supported, f.ex. '--plugin MyPlugin --plugin MyOtherPlugin', or multiple parameters per --plugin, separated with semicolon (;) and enclosed in quotation marks, f.ex. --plugin \"MyPlugin;OtherPlugin;Etc\""; // Framework
         cmdLineDescs.commands["--jsplugin"] = "Specifies a javascript file to be loaded at startup, relative to 'TUNDRA_DIRECTORY/jsplugins' path. Multiple jsplugin parameters are supported, f.ex. '--jsplugin MyPlugin.js --jsplugin MyOtherPlugin.js', or multiple parameters per --jsplugin, separated with semicolon (;) and enclosed in quotation marks, f.ex. --jsplugin \"MyPlugin.js;MyOtherPlugin.js;Etc.js\". If JavascriptModule is not loaded, this parameter has no effect."; // JavascriptModule
+        cmdLineDescs.commands["--jsSharedEngine"] = "Runs the EC_Script scripts of a scene in one shared script engine, each script in its own global scope, which cuts the script startup time and memory use. "
+            "The signal handlers a script has connected stay connected after the script is unloaded, unless it disconnects them in OnScriptDestroyed."; // JavascriptModule
         cmdLineDescs.commands["--file"] = "Specifies a startup scene file. Multiple files supported. Accepts absolute and relative paths, local:// and http:// are accepted and fetched via the AssetAPI."; // TundraLogicModule & AssetModule
         cmdLineDescs.commands["--storage"] = "Adds the given directory as a local storage directory on startup."; // AssetModule
         cmdLineDescs.commands["--config"] = "Specifies a startup configuration file to use. Multiple config files are supported, f.ex. '--config tundra.json --config MyCustomAddons.xml'. XML and JSON Tundra startup configs are supported."; // Framework & PluginAPI
@@ -188,15 +190,18 @@ Framework::Framework(int argc_, char** argv_, Application *app) :
         cmdLineDescs.commands["--clearAssetCache"] = "At the start of Tundra, remove all data and metadata files from asset cache."; // AssetCache
         cmdLineDescs.commands["--logLevel"] = "Sets the current log level: 'error', 'warning', 'info', 'debug'."; // ConsoleAPI
         cmdLineDescs.commands["--logFile"] = "Sets logging file. Usage example: '--logfile TundraLogFile.txt'."; // ConsoleAPI
+        cmdLineDescs.commands["--logFlushInterval"] = "Interval in milliseconds in which the log messages are written to the outputs by a background thread, 100 by default. "
+            "Specify 0 to write and flush each message immediately in the thread that logged it."; // ConsoleAPI
         cmdLineDescs.commands["--physicsRate"] = "Specifies the number of physics simulation steps per second. Default: 60."; // PhysicsModule
         cmdLineDescs.commands["--physicsMaxSteps"] = "Specifies the maximum number of physics simulation steps in one frame to limit CPU usage. If the limit would be exceeded, physics will appear to slow down. Default: 6."; // PhysicsModule
+        cmdLineDescs.commands["--physicsShapeThreads"] = "Number of threads building mesh collision shapes in the background. Default 2, 0 builds them in the main thread."; // PhysicsModule
         cmdLineDescs.commands["--splash"] = "Shows splash screen during the startup."; // Framework
         cmdLineDescs.commands["--fullscreen"] = "Starts application in fullscreen mode."; // OgreRenderingModule
         cmdLineDescs.commands["--vsync"] = "Synchronizes buffer swaps to monitor vsync, eliminating tearing at the expense of a fixed frame rate."; // OgreRenderingModule
         cmdLineDescs.commands["--vsyncFrequency"] = "Sets display frequency rate for vsync, applicable only if fullscreen is set. Usage: '--vsyncFrequency <number>'."; // OgreRenderingModule
         cmdLineDescs.commands["--antialias"] = "Sets full screen antialiasing factor. Usage '--antialias <number>'."; // OgreRenderingModule
         cmdLineDescs.commands["--hideBenignOgreMessages"] = "Sets some uninformative Ogre log messages to be ignored from the log output."; // OgreRenderingModule
-        cmdLineDescs.commands["--noAsyncAssetLoad"] = "Disables threaded loading of Ogre assets."; // OgreRenderingModule
+        cmdLineDescs.commands["--noAsyncAssetLoad"] = "Disables threaded loading of Ogre assets, and of the meshes imported with Assimp."; // OgreRenderingModule, OpenAssetImport
         cmdLineDescs.commands["--autoDxtCompress"] = "Compress uncompressed texture assets to DXT1/DXT5 format on load to save memory."; // OgreRenderingModule
         cmdLineDescs.commands["--maxTextureSize"] = "Resize texture assets that are larger than this. Default: no resizing."; // OgreRenderingModule
         cmdLineDescs.commands["--variablePhysicsStep"] = "Use variable physics timestep to avoid taking multiple physics substeps during one frame."; // PhysicsModule
@@ -210,7 +215,15 @@ Framework::Framework(int argc_, char** argv_, Application *app) :
         cmdLineDescs.commands["--noMenuBar"] = "Disables showing of the application menu bar automatically."; // Framework
         cmdLineDescs.commands["--clientExtrapolationTime"] = "Rigid body extrapolation time on client in milliseconds. Default 66."; // TundraProtocolModule
         cmdLineDescs.commands["--noClientPhysics"] = "Disables rigid body handoff to client simulation after no movement packets received from server."; // TundraProtocolModule
+        cmdLineDescs.commands["--syncEncodeOnce"] = "Serializes each changed attribute only once per network update on the server and shares the data between all client connections."; // TundraProtocolModule
+        cmdLineDescs.commands["--syncThreads"] = "Number of worker threads used to process the client connections' scene sync on the server, in addition to the main thread. Default 0, negative uses one thread less than the number of CPU cores."; // TundraProtocolModule
+        cmdLineDescs.commands["--syncBudget"] = "Limits the scene sync data sent to each connection on each network update to a budget adapted to the measured throughput and round-trip time of the connection, and sends the most important changes first."; // TundraProtocolModule
+        cmdLineDescs.commands["--syncSnapshot"] = "Sends the scene to joining clients as a compressed snapshot, which the server keeps up to date incrementally, instead of one entity at a time."; // TundraProtocolModule
+        cmdLineDescs.commands["--deferAttributeChanges"] = "Signals the attribute changes of the scenes once per frame at the end of the frame, coalescing several changes of an attribute into one, instead of signaling each change immediately."; // Scene
+        cmdLineDescs.commands["--asyncSceneLoad"] = "Loads binary (.tbin) scene files given with --file over several frames, indexing the file in a worker thread, instead of blocking until the whole scene is loaded."; // TundraProtocolModule
         cmdLineDescs.commands["--dumpProfiler"] = "Dump profiling blocks to console every 5 seconds."; // DebugStatsModule
+        cmdLineDescs.commands["--localAssetThreads"] = "Number of threads reading local asset files in the background. Default 2, 0 reads the files in the main thread."; // AssetModule
+        cmdLineDescs.commands["--audioStreamThreshold"] = "Size in kilobytes of decoded sound data above which Ogg Vorbis sounds are decoded in the background while they play, instead of when they are loaded. Default 1024, 0 decodes all sounds when loaded."; // AudioAPI
         cmdLineDescs.commands["--acceptUnknownLocalSources"] = "If specified, assets outside any known local storages are allowed. Otherwise, requests to them will fail."; // AssetModule
         cmdLineDescs.commands["--acceptUnknownHttpSources"] = "If specified, asset requests outside any registered HTTP storages are also accepted, and will appear as assets with no storage. "
             "Otherwise, all requests to assets outside any registered storage will fail."; // AssetModule
@@ -313,6 +326,11 @@ Framework::Framework(int argc_, char** argv_, Application *app) :
     console->RegisterCommand("inputContexts", "Prints all currently registered input contexts in InputAPI.", input, SLOT(DumpInputContexts()));
     console->RegisterCommand("dynamicObjects", "Prints all currently registered dynamic objets in Framework.", this, SLOT(PrintDynamicObjects()));
     console->RegisterCommand("plugins", "Prints all currently loaded plugins.", plugin, SLOT(ListPlugins()));
+#ifdef PROFILING
+    console->RegisterCommand("startProfilerTrace", "Starts recording a timeline of the profiling blocks of all threads.", profilerQObj, SLOT(StartTrace()));
+    console->RegisterCommand("stopProfilerTrace", "Stops recording the profiler timeline and writes it to a file in the Chrome trace format. "
+        "Usage: stopProfilerTrace(filename). The default filename is profilertrace.json.", profilerQObj, SLOT(StopTrace(const QString &)), SLOT(StopTrace()));
+#endif
 
     RegisterDynamicObject("ui", ui);
     RegisterDynamicObject("frame", frame);
@@ -6,15 +6,37 @@
 #include "CoreDefines.h"
 #include "CoreStringUtils.h"
 #include "HighPerfClock.h"
+#include "LoggingFunctions.h"
 #include "MemoryLeakCheck.h"
 #include "Math/MathFunc.h"
 
 #include <QThread>
+#include <QFile>
+#include <QTextStream>
 
 #include <iostream>
 #include <utility>
 
-Profiler::Profiler() : root_("Root"), current_node_(0)
+/// Trace event buffer of one thread.
+struct ProfilerThreadTrace
+{
+    ProfilerThreadTrace() : session(0), index(0) {}
+
+    std::vector<ProfilerTraceEvent> events; ///< Preallocated to the maximum size, only the first numEvents are valid.
+    QAtomicInt numEvents; ///< Published with release semantics after the event has been written.
+    int session; ///< The trace session the events belong to.
+    int index; ///< Registration order, used as the thread ID in the exported trace.
+    QString name;
+};
+
+Profiler::Profiler() :
+    root_("Root"),
+    current_node_(0),
+    mainThread_(QThread::currentThread()),
+    tracing_(0),
+    traceSession_(0),
+    maxTraceEvents_(0),
+    traceStartTime_(0)
 {
     // Check timer availability
     ProfilerBlock::QueryCapability();
@@ -22,6 +44,26 @@ Profiler::Profiler() : root_("Root"), current_node_(0)
     
 Profiler::~Profiler()
 {
+    for(size_t i = 0; i < threadTraces_.size(); ++i)
+        delete threadTraces_[i];
+}
+
+u32 Profiler::BlockId(const std::string &name)
+{
+    QMutexLocker lock(&mutex_);
+    std::map<std::string, u32>::const_iterator iter = blockIds_.find(name);
+    if (iter != blockIds_.end())
+        return iter->second;
+    u32 id = (u32)blockNames_.size();
+    blockNames_.push_back(name);
+    blockIds_[name] = id;
+    return id;
+}
+
+std::string Profiler::BlockName(u32 blockId)
+{
+    QMutexLocker lock(&mutex_);
+    return blockId < blockNames_.size() ? blockNames_[blockId] : std::string();
 }
 
 bool ProfilerBlock::QueryCapability()
@@ -38,23 +80,30 @@ bool ProfilerBlock::QueryCapability()
 #endif
 }
 
-void Profiler::StartBlock(const std::string &name)
+void Profiler::StartBlock(u32 blockId)
 {
 #ifdef PROFILING
+    if (tracing_)
+        RecordTraceEvent(blockId, 0);
+
+    // The profiling tree is not thread-safe, so it only records the main thread.
+    if (QThread::currentThread() != mainThread_)
+        return;
+
     // Get the current topmost profiling node in the stack.
     // This will be the parent node of the new block we're starting.
     ProfilerNodeTree *parent = current_node_ ? current_node_ : &root_;
 
-    // If parent name == new block name, we assume that we're
+    // If parent block == new block, we assume that we're
     // recursively re-entering the same function (with a single
     // profiling block).
-    ProfilerNodeTree *node = (name != parent->Name()) ? parent->GetChild(name) : parent;
+    ProfilerNodeTree *node = (blockId != parent->BlockId()) ? parent->GetChild(blockId) : parent;
 
     // We're entering this PROFILE() block for the first time,
     // need to allocate the memory for it.
     if (!node)
     {
-        node = new ProfilerNode(name);
+        node = new ProfilerNode(BlockName(blockId), blockId);
         parent->AddChild(shared_ptr<ProfilerNodeTree>(node));
     }
 
@@ -74,16 +123,22 @@ void Profiler::StartBlock(const std::string &name)
 #endif
 }
 
-void Profiler::EndBlock(const std::string &name)
+void Profiler::EndBlock(u32 blockId)
 {
 #ifdef PROFILING
     using namespace std;
 
+    if (tracing_)
+        RecordTraceEvent(blockId, 1);
+
+    if (QThread::currentThread() != mainThread_)
+        return;
+
     ProfilerNodeTree *treeNode = current_node_;
     if (!treeNode)
         return;
-    assert (treeNode->Name() == name && "New profiling block started before old one ended!");
-    UNREFERENCED_PARAM(name)
+    assert (treeNode->BlockId() == blockId && "New profiling block started before old one ended!");
+    UNREFERENCED_PARAM(blockId)
     ProfilerNode* node = checked_static_cast<ProfilerNode*>(treeNode);
     node->block_.Stop();
     node->num_called_total_++;
@@ -111,6 +166,141 @@ void Profiler::EndBlock(const std::string &name)
 #endif
 }
 
+ProfilerThreadTrace *Profiler::LocalThreadTrace()
+{
+    if (localTraces_.hasLocalData())
+        return *localTraces_.localData();
+
+    ProfilerThreadTrace *trace = new ProfilerThreadTrace;
+    QThread *thread = QThread::currentThread();
+    {
+        QMutexLocker lock(&mutex_);
+        trace->index = (int)threadTraces_.size();
+        threadTraces_.push_back(trace);
+    }
+    trace->name = thread ? thread->objectName() : QString();
+    if (trace->name.isEmpty())
+        trace->name = (thread == mainThread_ ? QString("Main thread") : QString("Thread %1").arg(trace->index));
+    localTraces_.setLocalData(new ProfilerThreadTrace*(trace)); // QThreadStorage deletes only the pointer to the trace at thread exit.
+    return trace;
+}
+
+void Profiler::RecordTraceEvent(u32 blockId, u32 end)
+{
+    ProfilerThreadTrace *trace = LocalThreadTrace();
+
+    // Only this thread writes to its buffer, so a new session can be started here without locking.
+    int session = traceSession_;
+    if (trace->session != session)
+    {
+        const size_t maxEvents = (size_t)(int)maxTraceEvents_;
+        if (trace->events.size() != maxEvents)
+            trace->events.resize(maxEvents);
+        trace->numEvents = 0;
+        trace->session = session;
+    }
+
+    int numEvents = trace->numEvents;
+    if ((size_t)numEvents >= trace->events.size())
+        return; // Buffer full, drop the event.
+
+    ProfilerTraceEvent &event = trace->events[numEvents];
+    event.time = GetCurrentClockTime();
+    event.blockId = blockId;
+    event.end = end;
+    trace->numEvents.fetchAndStoreRelease(numEvents + 1);
+}
+
+void Profiler::StartTrace(size_t maxEventsPerThread)
+{
+#ifdef PROFILING
+    tracing_ = 0;
+    maxTraceEvents_.fetchAndStoreOrdered((int)maxEventsPerThread);
+    traceStartTime_ = GetCurrentClockTime();
+    traceSession_.fetchAndAddOrdered(1);
+    tracing_.fetchAndStoreOrdered(1);
+#else
+    UNREFERENCED_PARAM(maxEventsPerThread)
+#endif
+}
+
+void Profiler::StopTrace()
+{
+    tracing_.fetchAndStoreOrdered(0);
+}
+
+/// Escapes a string for a JSON string literal.
+static QString JsonEscaped(const QString &str)
+{
+    QString escaped;
+    escaped.reserve(str.length());
+    for(int i = 0; i < str.length(); ++i)
+    {
+        QChar c = str[i];
+        if (c == '"' || c == '\\')
+            escaped += QChar('\\');
+        if (c.unicode() < 0x20)
+            escaped += QString("\\u%1").arg((int)c.unicode(), 4, 16, QChar('0'));
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+bool Profiler::ExportTrace(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    std::vector<ProfilerThreadTrace*> traces;
+    std::vector<std::string> names;
+    {
+        QMutexLocker lock(&mutex_);
+        traces = threadTraces_;
+        names = blockNames_;
+    }
+
+    QTextStream out(&file);
+    out << "{\"traceEvents\":[\n";
+    const int session = traceSession_;
+    const double ticksToMicroseconds = 1000000.0 / (double)GetCurrentClockFreq();
+    bool first = true;
+    for(size_t i = 0; i < traces.size(); ++i)
+    {
+        ProfilerThreadTrace *trace = traces[i];
+        int numEvents = trace->numEvents.fetchAndAddAcquire(0);
+        if (trace->session != session || numEvents == 0)
+            continue;
+
+        out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << trace->index <<
+            ",\"args\":{\"name\":\"" << JsonEscaped(trace->name) << "\"}}";
+        first = false;
+
+        // Skip end events whose begin event was recorded before the trace was started.
+        int depth = 0;
+        for(int j = 0; j < numEvents; ++j)
+        {
+            const ProfilerTraceEvent &event = trace->events[j];
+            if (event.end)
+            {
+                if (depth == 0)
+                    continue;
+                --depth;
+            }
+            else
+                ++depth;
+
+            QString name = event.blockId < names.size() ? QString::fromStdString(names[event.blockId]) : QString("Unknown");
+            double timestamp = (double)(s64)(event.time - traceStartTime_) * ticksToMicroseconds;
+            out << ",\n{\"name\":\"" << JsonEscaped(name) << "\",\"ph\":\"" << (event.end ? "E" : "B") << "\",\"ts\":" <<
+                QString::number(timestamp, 'f', 3) << ",\"pid\":0,\"tid\":" << trace->index << "}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out.status() == QTextStream::Ok;
+}
+
 void ProfilerQObj::BeginBlock(const QString &name)
 {
 #ifdef PROFILING
@@ -131,11 +321,42 @@ void ProfilerQObj::EndBlock()
         ProfilerNodeTree *treeNode = p->current_node_;
         if (!treeNode)
             return;
-        p->EndBlock(treeNode->Name());
+        p->EndBlock(treeNode->BlockId());
+    }
+#endif
+}
+
+void ProfilerQObj::StartTrace()
+{
+#ifdef PROFILING
+    Framework *fw = Framework::Instance();
+    Profiler *p = fw ? fw->GetProfiler() : 0;
+    if (p)
+    {
+        p->StartTrace();
+        LogInfo("Profiler trace started.");
     }
 #endif
 }
 
+void ProfilerQObj::StopTrace(const QString &filename)
+{
+#ifdef PROFILING
+    Framework *fw = Framework::Instance();
+    Profiler *p = fw ? fw->GetProfiler() : 0;
+    if (!p)
+        return;
+    p->StopTrace();
+    QString path = filename.trimmed().isEmpty() ? QString("profilertrace.json") : filename.trimmed();
+    if (p->ExportTrace(path))
+        LogInfo("Profiler trace written to " + path);
+    else
+        LogError("Failed to write profiler trace to " + path);
+#else
+    UNREFERENCED_PARAM(filename)
+#endif
+}
+
 ProfilerNodeTree *FindBlockByName(ProfilerNodeTree *parent, const char *name)
 {
     if (!parent)
@@ -8,6 +8,14 @@
 #include "Framework.h"
 #include "HighPerfClock.h"
 
+#include <QMutex>
+#include <QAtomicInt>
+#include <QThreadStorage>
+
+#include <map>
+
+class QThread;
+
 // Allows short-timed block tracing
 #define TRACESTART(x) kNet::PolledTimer polledTimer_##x;
 #define TRACEEND(x) std::cout << #x << " finished in " << polledTimer_##x.MSecsElapsed() << " msecs." << std::endl;
@@ -18,8 +26,14 @@
 /** Name of the profiling block must be unique in the scope, so do not use the name of the function
     as the name of the profiling block!
 
+    The name is interned to a block ID once per call site, so the per-call cost is that of reading the clock.
+    The ID is cached in a statically initialized atomic rather than a function-local static object, because
+    MSVC 2008 and 2010 do not initialize function-local statics thread-safely.
+    Can be used from any thread: the profiling tree only records the main thread, but all threads are recorded
+    to the trace when tracing is enabled (Profiler::StartTrace).
+
     @param x Unique name for the profiling block, use without quotes, f.ex. PROFILE(name_of_the_block) */
-#define PROFILE(x) ProfilerSection x ## __profiler__(#x);
+#define PROFILE(x) static QBasicAtomicInt x ## __profiler_id__ = Q_BASIC_ATOMIC_INITIALIZER(0); ProfilerSection x ## __profiler__(ProfilerSection::GetProfiler()->BlockId(x ## __profiler_id__, #x));
 
 /// Optionally ends the current profiling block
 /** Use when you wish to end a profiling block before it goes out of scope. */
@@ -105,7 +119,7 @@ public:
     typedef std::list<shared_ptr<ProfilerNodeTree> > NodeList;
 
     /// constructor that takes a name for the node
-    explicit ProfilerNodeTree(const std::string &name) : name_(name), parent_(0), recursion_(0) {}
+    explicit ProfilerNodeTree(const std::string &name, u32 blockId = 0xFFFFFFFF) : name_(name), blockId_(blockId), parent_(0), recursion_(0) {}
 
     /// destructor
     virtual ~ProfilerNodeTree()
@@ -150,9 +164,23 @@ public:
         return 0;
     }
 
+    /// Returns a child node
+    /** @param blockId Interned block ID of the child node, see Profiler::BlockId.
+        @return Child node or 0 if the node was not child */
+    ProfilerNodeTree* GetChild(u32 blockId)
+    {
+        for(NodeList::iterator it = children_.begin() ; it != children_.end() ; ++it)
+            if ((*it)->blockId_ == blockId)
+                return (*it).get();
+        return 0;
+    }
+
     /// Returns the name of this node
     const std::string &Name() const { return name_; }
 
+    /// Returns the interned block ID of this node
+    u32 BlockId() const { return blockId_; }
+
     /// Returns the parent of this node
     ProfilerNodeTree *Parent() { return parent_; }
 
@@ -169,6 +197,8 @@ private:
     ProfilerNodeTree *parent_;
     /// Name of this node
     const std::string name_;
+    /// Interned block ID of this node
+    const u32 blockId_;
 
     /// helper counter for recursion
     int recursion_;
@@ -180,8 +210,8 @@ class TUNDRACORE_API ProfilerNode : public ProfilerNodeTree
 {
 public:
     /// constructor that takes a name for the node
-    explicit ProfilerNode(const std::string &name) : 
-    ProfilerNodeTree(name),
+    explicit ProfilerNode(const std::string &name, u32 blockId = 0xFFFFFFFF) : 
+    ProfilerNodeTree(name, blockId),
         num_called_total_(0),
         num_called_(0),
         num_called_current_(0),
@@ -273,13 +303,39 @@ public slots:
     /// Ends profiling block.
     /** @see BeginBlock() */
     void EndBlock();
+
+    /// Starts recording a trace of all threads. @see Profiler::StartTrace
+    void StartTrace();
+
+    /// Stops recording the trace and writes it to a file in the Chrome trace event format.
+    /** @param filename Output file, "profilertrace.json" in the working directory if empty.
+        @see Profiler::ExportTrace */
+    void StopTrace(const QString &filename = "");
 };
 
+/// One begin or end of a profiling block, recorded in the trace mode of Profiler.
+struct ProfilerTraceEvent
+{
+    tick_t time;
+    u32 blockId;
+    u32 end; ///< 0 for begin, 1 for end.
+};
+
+struct ProfilerThreadTrace;
+
 /// Profiler can be used to measure execution time of a block of code.
 /** Do not use this class directly for profiling, use instead PROFILE
     and ELIFORP macros.
 
-    Threadsafety: Can *only* be used from the main thread.
+    The profiler has two modes which can be used at the same time:
+    - The profiling tree accumulates per-frame timing statistics of the main thread, shown by TimeProfilerWindow.
+    - The trace records the begin and end times of every profiling block of every thread to a timeline,
+      which can be exported to the Chrome trace event format (chrome://tracing). Tracing is off by default,
+      see StartTrace() and the "startProfilerTrace" and "stopProfilerTrace" console commands.
+
+    Threadsafety: StartBlock() and EndBlock() can be used from any thread, but only the main thread is recorded
+    to the profiling tree. The trace events go to per-thread buffers which are only written by their own thread,
+    so recording does not lock. The rest of the functions can *only* be used from the main thread.
 
  */
 class TUNDRACORE_API Profiler
@@ -288,6 +344,27 @@ public:
     Profiler();
 
     ~Profiler();
+
+    /// Returns the interned ID of a profiling block name, registering the name if necessary.
+    /** Thread-safe. The PROFILE macro calls this once per call site. */
+    u32 BlockId(const std::string &name);
+
+    /// Returns the interned ID of a profiling block name, using a per-call-site cache. Thread-safe.
+    /** The PROFILE macro calls this at every pass of a call site.
+        @param cache Zero-initialized cache of the call site, holds the block ID plus one once interned. */
+    u32 BlockId(QBasicAtomicInt &cache, const char *name)
+    {
+        int cached = cache;
+        if (cached)
+            return (u32)(cached - 1);
+        // Threads racing here intern the same name, and so store the same ID.
+        u32 id = BlockId(std::string(name));
+        cache.fetchAndStoreRelease((int)id + 1);
+        return id;
+    }
+
+    /// Returns the name of an interned profiling block ID. Thread-safe.
+    std::string BlockName(u32 blockId);
     
     /// Start a profiling block.
     /** Normally you don't use this directly, instead you use the macro PROFILE.
@@ -298,12 +375,28 @@ public:
         recursion support.
 
         Re-entrant. */
-    void StartBlock(const std::string &name);
+    void StartBlock(u32 blockId);
+    void StartBlock(const std::string &name) { StartBlock(BlockId(name)); } ///< @overload
 
     /// End the profiling block
     /** Each StartBlock() should have a matching EndBlock(). Recursion is supported.
         Re-entrant. */
-    void EndBlock(const std::string &name);
+    void EndBlock(u32 blockId);
+    void EndBlock(const std::string &name) { EndBlock(BlockId(name)); } ///< @overload
+
+    /// Starts recording a new trace, discarding the previous one.
+    /** @param maxEventsPerThread Size of the per-thread event buffers. Events beyond this are dropped. */
+    void StartTrace(size_t maxEventsPerThread = 1 << 17);
+
+    /// Stops recording the trace. The recorded trace stays available for ExportTrace() until the next StartTrace().
+    void StopTrace();
+
+    /// Returns whether a trace is being recorded.
+    bool IsTracing() const { return tracing_ != 0; }
+
+    /// Writes the recorded trace to a file in the Chrome trace event format (JSON).
+    /** Stop the trace before exporting. @return True if the file was written. */
+    bool ExportTrace(const QString &filename);
 
     /// Reset profiling data for the current frame. Don't call directly, use RESETPROFILER macro instead.
     void ResetValues();
@@ -329,12 +422,36 @@ public:
     /// Only used internally, *NOT* for public use.
     ProfilerNodeTree *CurrentNode() { return current_node_; }
 private:
+    /// Appends a trace event to the calling thread's buffer.
+    void RecordTraceEvent(u32 blockId, u32 end);
+
+    /// Returns the trace buffer of the calling thread, creating it if necessary.
+    ProfilerThreadTrace *LocalThreadTrace();
+
     /// The single global root node object.
     ProfilerNodeTree root_;
 
     /// Points to the current topmost profile block in the stack.
     ProfilerNodeTree *current_node_;
 
+    /// The thread which created the profiler. Only this thread is recorded to the profiling tree.
+    QThread *mainThread_;
+
+    /// Protects the block name registry and the list of thread traces.
+    QMutex mutex_;
+    std::map<std::string, u32> blockIds_;
+    std::vector<std::string> blockNames_;
+
+    /// Trace buffers of all threads that have recorded events. Owned by the profiler, so that traces of exited threads can still be exported.
+    std::vector<ProfilerThreadTrace*> threadTraces_;
+    /// Points to the trace buffer of each thread. The pointed-to object does not own the buffer.
+    QThreadStorage<ProfilerThreadTrace**> localTraces_;
+
+    QAtomicInt tracing_; ///< Nonzero when recording a trace.
+    QAtomicInt traceSession_; ///< Incremented by each StartTrace. Thread buffers from earlier sessions are reset lazily by their own threads.
+    QAtomicInt maxTraceEvents_; ///< Set by StartTrace before traceSession_ is incremented, read by the recording threads.
+    tick_t traceStartTime_;
+
     friend class ProfilerQObj;
 };
 
@@ -342,10 +459,17 @@ private:
 class TUNDRACORE_API ProfilerSection
 {
 public:
-    explicit ProfilerSection(const std::string &name) : name_(name), destroyed_(false)
+    explicit ProfilerSection(u32 blockId) : blockId_(blockId), destroyed_(false)
     {
         assert(Framework::Instance() && "Cannot get Framework instance! Did you forget to call Framework::SetInstance(fw); in your TundraPluginMain?");
-        GetProfiler()->StartBlock(name);
+        GetProfiler()->StartBlock(blockId_);
+    }
+
+    explicit ProfilerSection(const std::string &name) : destroyed_(false)
+    {
+        assert(Framework::Instance() && "Cannot get Framework instance! Did you forget to call Framework::SetInstance(fw); in your TundraPluginMain?");
+        blockId_ = GetProfiler()->BlockId(name);
+        GetProfiler()->StartBlock(blockId_);
     }
 
     ~ProfilerSection()
@@ -361,7 +485,7 @@ public:
     {
         assert (Framework::Instance() && "Trying to profile before profiler initialized.");
 
-        GetProfiler()->EndBlock(name_);
+        GetProfiler()->EndBlock(blockId_);
         destroyed_ = true;
     }
     static Profiler *GetProfiler()
@@ -375,8 +499,8 @@ public:
     }
 
 private:
-    /// Name of this profiling section
-    const std::string name_;
+    /// Interned block ID of this profiling section
+    u32 blockId_;
 
     /// True if this section has explicitly been destroyed before it run out of scope
     bool destroyed_;
@@ -0,0 +1,216 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   AttributeInterpolator.cpp
+    @brief  Runs the attribute interpolations of a scene. */
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "AttributeInterpolator.h"
+#include "IComponent.h"
+#include "Profiler.h"
+
+#include "MemoryLeakCheck.h"
+
+AttributeInterpolator::AttributeInterpolator()
+{
+}
+
+AttributeInterpolator::~AttributeInterpolator()
+{
+    Clear();
+}
+
+bool AttributeInterpolator::Contains(IAttribute *dest) const
+{
+    return slots_.find(dest) != slots_.end();
+}
+
+void AttributeInterpolator::Start(IAttribute *dest, IAttribute *endValue, float length)
+{
+    switch(dest->TypeId())
+    {
+    case cAttributeReal:
+        StartTyped(floats_, FloatPool, dest, endValue, length);
+        break;
+    case cAttributeFloat3:
+        StartTyped(float3s_, Float3Pool, dest, endValue, length);
+        break;
+    case cAttributeQuat:
+        StartTyped(quats_, QuatPool, dest, endValue, length);
+        break;
+    case cAttributeTransform:
+        StartTyped(transforms_, TransformPool, dest, endValue, length);
+        break;
+    default:
+        StartGeneric(dest, endValue, length);
+        break;
+    }
+}
+
+template <typename I>
+void AttributeInterpolator::StartTyped(std::vector<I> &pool, PoolId poolId, IAttribute *dest, IAttribute *endValue, float length)
+{
+    typedef typename I::ValueType T;
+    if (endValue->TypeId() != dest->TypeId())
+        return;
+
+    // Replace a running interpolation in place.
+    size_t index = pool.size();
+    unordered_map<IAttribute*, Slot>::iterator slot = slots_.find(dest);
+    if (slot != slots_.end() && slot->second.pool == poolId)
+        index = slot->second.index;
+    else
+    {
+        if (slot != slots_.end())
+            End(dest);
+        Slot newSlot;
+        newSlot.pool = poolId;
+        newSlot.index = index;
+        slots_[dest] = newSlot;
+        pool.push_back(I());
+        pool.back().owner = dest->Owner()->shared_from_this();
+        pool.back().dest = static_cast<Attribute<T>*>(dest);
+    }
+
+    I &interp = pool[index];
+    interp.endpoints.Set(interp.dest->Get(), static_cast<Attribute<T>*>(endValue)->Get());
+    interp.time = 0.0f;
+    interp.length = length;
+    interp.active = false;
+}
+
+void AttributeInterpolator::StartGeneric(IAttribute *dest, IAttribute *endValue, float length)
+{
+    End(dest);
+
+    Slot slot;
+    slot.pool = GenericPool;
+    slot.index = generic_.size();
+    slots_[dest] = slot;
+
+    GenericInterpolation interp;
+    interp.owner = dest->Owner()->shared_from_this();
+    interp.dest = dest;
+    interp.start = dest->Clone();
+    interp.end = endValue->Clone();
+    interp.time = 0.0f;
+    interp.length = length;
+    generic_.push_back(interp);
+}
+
+bool AttributeInterpolator::End(IAttribute *dest)
+{
+    unordered_map<IAttribute*, Slot>::iterator slot = slots_.find(dest);
+    if (slot == slots_.end())
+        return false;
+
+    size_t index = slot->second.index;
+    switch(slot->second.pool)
+    {
+    case FloatPool: RemoveAt(floats_, index); break;
+    case Float3Pool: RemoveAt(float3s_, index); break;
+    case QuatPool: RemoveAt(quats_, index); break;
+    case TransformPool: RemoveAt(transforms_, index); break;
+    case GenericPool: RemoveGenericAt(index); break;
+    }
+    return true;
+}
+
+template <typename I>
+void AttributeInterpolator::RemoveAt(std::vector<I> &pool, size_t index)
+{
+    slots_.erase(pool[index].dest);
+    if (index + 1 < pool.size())
+    {
+        pool[index] = pool.back();
+        slots_[pool[index].dest].index = index;
+    }
+    pool.pop_back();
+}
+
+void AttributeInterpolator::RemoveGenericAt(size_t index)
+{
+    delete generic_[index].start;
+    delete generic_[index].end;
+    slots_.erase(generic_[index].dest);
+    if (index + 1 < generic_.size())
+    {
+        generic_[index] = generic_.back();
+        slots_[generic_[index].dest].index = index;
+    }
+    generic_.pop_back();
+}
+
+void AttributeInterpolator::Clear()
+{
+    for(size_t i = 0; i < generic_.size(); ++i)
+    {
+        delete generic_[i].start;
+        delete generic_[i].end;
+    }
+    floats_.clear();
+    float3s_.clear();
+    quats_.clear();
+    transforms_.clear();
+    generic_.clear();
+    slots_.clear();
+}
+
+void AttributeInterpolator::Update(float frameTime, AttributeChange::Type change)
+{
+    PROFILE(AttributeInterpolator_Update);
+    UpdateTyped(transforms_, frameTime, change);
+    UpdateTyped(float3s_, frameTime, change);
+    UpdateTyped(quats_, frameTime, change);
+    UpdateTyped(floats_, frameTime, change);
+    UpdateGeneric(frameTime, change);
+}
+
+template <typename I>
+void AttributeInterpolator::UpdateTyped(std::vector<I> &pool, float frameTime, AttributeChange::Type change)
+{
+    // Advance and evaluate all the interpolations in one pass over the pool, which does not touch the attributes.
+    // Allow the interpolation to persist for 2x time, though we are no longer setting the value
+    // This is for the continuous/discontinuous update detection in StartAttributeInterpolation()
+    for(size_t i = 0; i < pool.size(); ++i)
+    {
+        I &interp = pool[i];
+        interp.active = interp.time <= interp.length;
+        interp.time += frameTime;
+        if (interp.active)
+            interp.value = interp.endpoints.At(Min(interp.time / interp.length, 1.0f));
+    }
+
+    // Setting a value emits AttributeChanged, whose handlers may remove components, so the ownership is checked for each
+    // interpolation just before setting its value. Iterating backwards keeps the swap-remove from skipping interpolations.
+    for(size_t i = pool.size() - 1; i < pool.size(); --i)
+    {
+        I &interp = pool[i];
+        if (interp.owner.expired() || (!interp.active && interp.time >= interp.length * 2.0f))
+            RemoveAt(pool, i);
+        else if (interp.active)
+            interp.dest->Set(interp.value, change);
+    }
+}
+
+void AttributeInterpolator::UpdateGeneric(float frameTime, AttributeChange::Type change)
+{
+    for(size_t i = generic_.size() - 1; i < generic_.size(); --i)
+    {
+        GenericInterpolation &interp = generic_[i];
+        if (interp.owner.expired())
+        {
+            RemoveGenericAt(i);
+            continue;
+        }
+
+        bool active = interp.time <= interp.length;
+        interp.time += frameTime;
+        if (active)
+            interp.dest->Interpolate(interp.start, interp.end, Min(interp.time / interp.length, 1.0f), change);
+        else if (interp.time >= interp.length * 2.0f)
+            RemoveGenericAt(i);
+    }
+}
@@ -0,0 +1,170 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   AttributeInterpolator.h
+    @brief  Runs the attribute interpolations of a scene. */
+
+#pragma once
+
+#include "TundraCoreApi.h"
+#include "CoreTypes.h"
+#include "SceneFwd.h"
+#include "AttributeChangeType.h"
+#include "IAttribute.h"
+#include "Transform.h"
+#include "Math/float3.h"
+#include "Math/Quat.h"
+#include "Math/MathFunc.h"
+
+#include <vector>
+
+/// Runs the attribute interpolations of a scene. Used by Scene, see Scene::StartAttributeInterpolation.
+/** The float, float3, Quat and Transform interpolations, which are what the network sync uses, are kept in contiguous
+    per-type pools holding the start and end values by value, so that starting and updating them does not allocate.
+    The rotations of the Transforms are converted to quaternions once when the interpolation starts.
+    Interpolations of other types keep heap-allocated copies of the start and end attributes, and use IAttribute::Interpolate.
+    Finished interpolations are removed by swapping the last interpolation of the pool in their place, and a hash map from the
+    destination attribute to its pool slot makes finding the interpolation of an attribute O(1). */
+class TUNDRACORE_API AttributeInterpolator
+{
+public:
+    AttributeInterpolator();
+    ~AttributeInterpolator();
+
+    /// Returns whether @c dest is being interpolated.
+    bool Contains(IAttribute *dest) const;
+
+    /// Starts interpolating @c dest from its current value to @c endValue in @c length seconds.
+    /** A running interpolation of @c dest is replaced.
+        @param endValue Attribute of the same type as @c dest. Not stored. */
+    void Start(IAttribute *dest, IAttribute *endValue, float length);
+
+    /// Ends the interpolation of @c dest. The last set value will remain. @return True if an interpolation existed.
+    bool End(IAttribute *dest);
+
+    /// Ends all interpolations.
+    void Clear();
+
+    /// Advances all interpolations and sets the values of the attributes with the change type @c change.
+    /** The interpolations whose component has expired are removed.
+        @note An interpolation is kept for twice its length, though its value is no longer set after the length,
+        so that Scene::StartAttributeInterpolation can tell continuous updates from discontinuous ones. */
+    void Update(float frameTime, AttributeChange::Type change);
+
+    /// Returns number of running interpolations.
+    size_t Size() const { return slots_.size(); }
+
+private:
+    enum PoolId
+    {
+        FloatPool,
+        Float3Pool,
+        QuatPool,
+        TransformPool,
+        GenericPool
+    };
+
+    /// Start and end values of an interpolation that is a linear interpolation of the value.
+    template <typename T>
+    struct LerpEndpoints
+    {
+        T start;
+        T end;
+        void Set(const T &startValue, const T &endValue) { start = startValue; end = endValue; }
+        T At(float t) const { return Lerp(start, end, t); }
+    };
+
+    /// Start and end values of a rotation interpolation.
+    struct QuatEndpoints
+    {
+        Quat start;
+        Quat end;
+        void Set(const Quat &startValue, const Quat &endValue) { start = startValue; end = endValue; }
+        Quat At(float t) const { return Slerp(start, end, t); }
+    };
+
+    /// Start and end values of a Transform interpolation.
+    struct TransformEndpoints
+    {
+        float3 startPos, endPos;
+        float3 startScale, endScale;
+        Quat startRot, endRot; ///< The Euler angles converted to quaternions once, as Transform::Orientation() is not cheap.
+        void Set(const Transform &startValue, const Transform &endValue)
+        {
+            startPos = startValue.pos;
+            endPos = endValue.pos;
+            startScale = startValue.scale;
+            endScale = endValue.scale;
+            startRot = startValue.Orientation();
+            endRot = endValue.Orientation();
+        }
+        Transform At(float t) const
+        {
+            Transform value;
+            value.pos = Lerp(startPos, endPos, t);
+            value.SetOrientation(Slerp(startRot, endRot, t));
+            value.scale = Lerp(startScale, endScale, t);
+            return value;
+        }
+    };
+
+    /// Interpolation of an attribute of type T, whose start and end values are stored in E.
+    template <typename T, typename E>
+    struct Interpolation
+    {
+        typedef T ValueType;
+        ComponentWeakPtr owner;
+        Attribute<T> *dest;
+        E endpoints;
+        float time;
+        float length;
+        T value; ///< Value evaluated for the current update.
+        bool active; ///< The value is to be set in the current update.
+    };
+
+    typedef Interpolation<float, LerpEndpoints<float> > FloatInterpolation;
+    typedef Interpolation<float3, LerpEndpoints<float3> > Float3Interpolation;
+    typedef Interpolation<Quat, QuatEndpoints> QuatInterpolation;
+    typedef Interpolation<Transform, TransformEndpoints> TransformInterpolation;
+
+    /// Interpolation of an attribute of any other type.
+    struct GenericInterpolation
+    {
+        ComponentWeakPtr owner;
+        IAttribute *dest;
+        IAttribute *start; ///< Owned.
+        IAttribute *end; ///< Owned.
+        float time;
+        float length;
+    };
+
+    struct Slot
+    {
+        PoolId pool;
+        size_t index;
+    };
+
+    template <typename I>
+    void StartTyped(std::vector<I> &pool, PoolId poolId, IAttribute *dest, IAttribute *endValue, float length);
+    void StartGeneric(IAttribute *dest, IAttribute *endValue, float length);
+
+    template <typename I>
+    void UpdateTyped(std::vector<I> &pool, float frameTime, AttributeChange::Type change);
+    void UpdateGeneric(float frameTime, AttributeChange::Type change);
+
+    /// Removes the interpolation at @c index by moving the last interpolation of the pool in its place.
+    template <typename I>
+    void RemoveAt(std::vector<I> &pool, size_t index);
+    void RemoveGenericAt(size_t index);
+
+    std::vector<FloatInterpolation> floats_;
+    std::vector<Float3Interpolation> float3s_;
+    std::vector<QuatInterpolation> quats_;
+    std::vector<TransformInterpolation> transforms_;
+    std::vector<GenericInterpolation> generic_;
+    unordered_map<IAttribute*, Slot> slots_; ///< Pool slot of each interpolated attribute.
+
+    // Noncopyable
+    AttributeInterpolator(const AttributeInterpolator &);
+    void operator =(const AttributeInterpolator &);
+};
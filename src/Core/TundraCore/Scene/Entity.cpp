@@ -16,6 +16,8 @@
 
 #include <QDomDocument>
 
+#include <algorithm>
+
 #include <kNet/DataSerializer.h>
 #include <kNet/DataDeserializer.h>
 
@@ -44,6 +46,7 @@ Entity::~Entity()
         i->second->SetParentEntity(0);
    
     components_.clear();
+    componentsByType_.clear();
     qDeleteAll(actions_);
 }
 
@@ -62,9 +65,11 @@ void Entity::ChangeComponentId(component_id_t old_id, component_id_t new_id)
         RemoveComponentById(new_id, AttributeChange::LocalOnly);
     }
     
+    UnindexComponentType(old_comp.get());
     old_comp->SetNewId(new_id);
     components_.erase(old_id);
     components_[new_id] = old_comp;
+    IndexComponentType(old_comp);
 }
 
 void Entity::AddComponent(const ComponentPtr &component, AttributeChange::Type change)
@@ -121,6 +126,10 @@ void Entity::AddComponent(component_id_t id, const ComponentPtr &component, Attr
         component->SetNewId(id);
         component->SetParentEntity(this);
         components_[id] = component;
+        IndexComponentType(component);
+        IComponent::InternTypeName(component.get());
+        if (scene_)
+            scene_->IndexComponent(component.get());
         
         if (change != AttributeChange::Disconnected)
             emit ComponentAdded(component.get(), change == AttributeChange::Default ? component->UpdateMode() : change);
@@ -185,6 +194,9 @@ void Entity::RemoveComponent(ComponentMap::iterator iter, AttributeChange::Type
     if (scene_)
         scene_->EmitComponentRemoved(this, iter->second.get(), change);
 
+    if (scene_)
+        scene_->UnindexComponent(iter->second.get());
+    UnindexComponentType(iter->second.get());
     iter->second->SetParentEntity(0);
     components_.erase(iter);
 }
@@ -357,56 +369,82 @@ ComponentPtr Entity::ComponentById(component_id_t id) const
 
 ComponentPtr Entity::Component(const QString &typeName) const
 {
-    const QString ecTypeName = IComponent::EnsureTypeNameWithPrefix(typeName);
-    for (ComponentMap::const_iterator i = components_.begin(); i != components_.end(); ++i)
-        if (i->second->TypeName() == ecTypeName)
-            return i->second;
-
-    return ComponentPtr();
+    const u32 typeId = IComponent::TypeIdForTypeName(typeName);
+    return typeId ? Component(typeId) : ComponentPtr();
 }
 
 ComponentPtr Entity::Component(u32 typeId) const
 {
-    for (ComponentMap::const_iterator i = components_.begin(); i != components_.end(); ++i)
-        if (i->second->TypeId() == typeId)
-            return i->second;
-
-    return ComponentPtr();
+    ComponentTypeIndex::const_iterator iter = FirstComponentOfType(typeId);
+    return iter != componentsByType_.end() ? iter->second : ComponentPtr();
 }
 
 Entity::ComponentVector Entity::ComponentsOfType(const QString &typeName) const
 {
-    return ComponentsOfType(framework_->Scene()->GetComponentTypeId(typeName));
+    const u32 typeId = IComponent::TypeIdForTypeName(typeName);
+    return typeId ? ComponentsOfType(typeId) : ComponentVector();
 }
 
 Entity::ComponentVector Entity::ComponentsOfType(u32 typeId) const
 {
     ComponentVector ret;
-    for (ComponentMap::const_iterator i = components_.begin(); i != components_.end(); ++i)
-        if (i->second->TypeId() == typeId)
-            ret.push_back(i->second);
+    for(ComponentTypeIndex::const_iterator i = FirstComponentOfType(typeId); i != componentsByType_.end() && i->first == typeId; ++i)
+        ret.push_back(i->second);
     return ret;
 }
 
 ComponentPtr Entity::Component(const QString &type_name, const QString& name) const
 {
-    const QString ecTypeName = IComponent::EnsureTypeNameWithPrefix(type_name);
-    for (ComponentMap::const_iterator i = components_.begin(); i != components_.end(); ++i)
-        if (i->second->TypeName() == ecTypeName && i->second->Name() == name)
-            return i->second;
-
-    return ComponentPtr();
+    const u32 typeId = IComponent::TypeIdForTypeName(type_name);
+    return typeId ? Component(typeId, name) : ComponentPtr();
 }
 
 ComponentPtr Entity::Component(u32 typeId, const QString& name) const
 {
-    for (ComponentMap::const_iterator i = components_.begin(); i != components_.end(); ++i)
-        if (i->second->TypeId() == typeId && i->second->Name() == name)
+    for(ComponentTypeIndex::const_iterator i = FirstComponentOfType(typeId); i != componentsByType_.end() && i->first == typeId; ++i)
+        if (i->second->Name() == name)
             return i->second;
 
     return ComponentPtr();
 }
 
+/// Orders the entries of Entity::componentsByType_ by type ID.
+struct ComponentTypeLess
+{
+    bool operator()(const std::pair<u32, ComponentPtr> &entry, u32 typeId) const { return entry.first < typeId; }
+    // The checked iterators of MSVC debug builds compare also in the other order and between the entries.
+    bool operator()(u32 typeId, const std::pair<u32, ComponentPtr> &entry) const { return typeId < entry.first; }
+    bool operator()(const std::pair<u32, ComponentPtr> &a, const std::pair<u32, ComponentPtr> &b) const { return a.first < b.first; }
+};
+
+Entity::ComponentTypeIndex::const_iterator Entity::FirstComponentOfType(u32 typeId) const
+{
+    ComponentTypeIndex::const_iterator iter = std::lower_bound(componentsByType_.begin(), componentsByType_.end(), typeId, ComponentTypeLess());
+    return iter != componentsByType_.end() && iter->first == typeId ? iter : componentsByType_.end();
+}
+
+void Entity::IndexComponentType(const ComponentPtr &component)
+{
+    // Keep the components of the same type in the order of their IDs, which is the order of components_.
+    const u32 typeId = component->TypeId();
+    ComponentTypeIndex::iterator iter = std::lower_bound(componentsByType_.begin(), componentsByType_.end(), typeId, ComponentTypeLess());
+    while(iter != componentsByType_.end() && iter->first == typeId && iter->second->Id() < component->Id())
+        ++iter;
+    componentsByType_.insert(iter, std::make_pair(typeId, component));
+}
+
+void Entity::UnindexComponentType(IComponent *component)
+{
+    const u32 typeId = component->TypeId();
+    for(ComponentTypeIndex::iterator iter = std::lower_bound(componentsByType_.begin(), componentsByType_.end(), typeId, ComponentTypeLess());
+        iter != componentsByType_.end() && iter->first == typeId; ++iter)
+        if (iter->second.get() == component)
+        {
+            componentsByType_.erase(iter);
+            return;
+        }
+}
+
 QObjectList Entity::GetComponentsRaw(const QString &type_name) const
 {
     LogWarning("Entity::GetComponentsRaw: This function is deprecated and will be removed. Use GetComponents or Components instead.");
@@ -74,7 +74,8 @@ public:
     shared_ptr<T> GetOrCreateComponent(const QString &name = "", AttributeChange::Type change = AttributeChange::Default, bool replicated = true);
 
     /// Returns a component with certain type, already cast to correct type, or empty pointer if component was not found
-    /** If there are several components with the specified type, returns the first component found (arbitrary). */
+    /** If there are several components with the specified type, returns the first component found (arbitrary).
+        The type ID is resolved at compile time, and the lookup does not allocate memory. */
     template <class T>
     shared_ptr<T> Component() const;
 
@@ -430,8 +431,20 @@ private:
     /// Remove a component by iterator. Called internally
     void RemoveComponent(ComponentMap::iterator iter, AttributeChange::Type change);
 
+    /// Components by type ID, sorted by the type ID and then by the component ID.
+    /** The entities have only a handful of components, so a binary search of this vector is the fastest lookup by type. */
+    typedef std::vector<std::pair<u32, ComponentPtr> > ComponentTypeIndex;
+
+    /// Returns the first component of type @c typeId in componentsByType_, or the end of the index if there is none.
+    ComponentTypeIndex::const_iterator FirstComponentOfType(u32 typeId) const;
+    /// Adds @c component to componentsByType_.
+    void IndexComponentType(const ComponentPtr &component);
+    /// Removes @c component from componentsByType_.
+    void UnindexComponentType(IComponent *component);
+
     UniqueIdGenerator idGenerator_; ///< Component ID generator
     ComponentMap components_; ///< a list of all components
+    ComponentTypeIndex componentsByType_; ///< Type index of components_
     entity_id_t id_; ///< Unique id for this entity
     Framework* framework_; ///< Pointer to framework
     Scene* scene_; ///< Pointer to scene
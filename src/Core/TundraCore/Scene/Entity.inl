@@ -19,7 +19,9 @@ shared_ptr<T> Entity::GetOrCreateComponent(const QString &name, AttributeChange:
 template <class T>
 shared_ptr<T> Entity::Component() const
 {
-    return dynamic_pointer_cast<T>(Component(T::TypeIdStatic())); /**< @todo static_pointer_cast should be ok here. */
+    // The component found by the type ID of T is always a T.
+    ComponentTypeIndex::const_iterator iter = FirstComponentOfType(T::ComponentTypeId);
+    return iter != componentsByType_.end() ? static_pointer_cast<T>(iter->second) : shared_ptr<T>();
 }
 
 template <class T>
@@ -38,6 +40,6 @@ std::vector<shared_ptr<T> > Entity::ComponentsOfType() const
 template <class T>
 shared_ptr<T> Entity::Component(const QString& name) const
 {
-    return dynamic_pointer_cast<T>(Component(T::TypeIdStatic(), name));
+    return static_pointer_cast<T>(Component(T::ComponentTypeId, name));
 }
 
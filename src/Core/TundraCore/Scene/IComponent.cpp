@@ -17,6 +17,8 @@
 #include "LoggingFunctions.h"
 
 #include <QDomDocument>
+#include <QHash>
+#include <QReadWriteLock>
 
 #include <kNet.h>
 
@@ -387,8 +389,12 @@ void IComponent::EmitAttributeChanged(IAttribute* attribute, AttributeChange::Ty
     if (change == AttributeChange::Disconnected)
         return; // No signals
     
-    // Trigger scenemanager signal
+    // If the scene defers the attribute changes, the signals are emitted when it dispatches them.
     Scene* scene = ParentScene();
+    if (scene && scene->JournalAttributeChange(this, attribute, change))
+        return;
+
+    // Trigger scenemanager signal
     if (scene)
         scene->EmitAttributeChanged(this, attribute, change);
     
@@ -404,6 +410,27 @@ void IComponent::EmitAttributeChanged(IAttribute* attribute, AttributeChange::Ty
             attributes[i]->ClearChangedFlag();
 }
 
+void IComponent::EmitJournaledAttributeChanges(const std::vector<std::pair<u8, AttributeChange::Type> > &changes)
+{
+    for(size_t i = 0; i < changes.size(); ++i)
+    {
+        // The handlers of the previous changes may have removed the attribute.
+        const u8 index = changes[i].first;
+        if (index >= attributes.size() || !attributes[index])
+            continue;
+        IAttribute *attribute = attributes[index];
+        Scene* scene = ParentScene();
+        if (scene)
+            scene->EmitAttributeChanged(this, attribute, changes[i].second);
+        emit AttributeChanged(attribute, changes[i].second);
+    }
+
+    AttributesChanged();
+    for(size_t i = 0; i < attributes.size(); ++i)
+        if (attributes[i])
+            attributes[i]->ClearChangedFlag();
+}
+
 void IComponent::EmitAttributeMetadataChanged(IAttribute* attribute)
 {
     if (!attribute)
@@ -541,3 +568,29 @@ bool IComponent::ViewEnabled() const
     else
         return true;
 }
+
+/// Type IDs of the component type names seen so far, both with and without the "EC_" prefix.
+/** Components can be created and looked up by type name from any thread, so the table is guarded by internedTypeIdsLock.
+    Both are initialized statically, as a function-local static would not be initialized thread-safely by all compilers. */
+static QHash<QString, u32> internedTypeIds;
+static QReadWriteLock internedTypeIdsLock;
+
+u32 IComponent::TypeIdForTypeName(const QString &typeName)
+{
+    QReadLocker lock(&internedTypeIdsLock);
+    QHash<QString, u32>::const_iterator iter = internedTypeIds.find(typeName);
+    return iter != internedTypeIds.end() ? iter.value() : 0;
+}
+
+void IComponent::InternTypeName(const IComponent *component)
+{
+    const QString &typeName = component->TypeName();
+    {
+        QReadLocker lock(&internedTypeIdsLock);
+        if (internedTypeIds.contains(typeName))
+            return;
+    }
+    QWriteLocker lock(&internedTypeIdsLock);
+    internedTypeIds.insert(typeName, component->TypeId());
+    internedTypeIds.insert(EnsureTypeNameWithoutPrefix(typeName), component->TypeId());
+}
@@ -352,6 +352,14 @@ public slots:
     /// Crafts a component type name string that is guaranteed to have the "EC_" prefix.
     static QString EnsureTypeNameWithPrefix(const QString &tn) { return (tn.startsWith("EC_", Qt::CaseInsensitive) ? tn : "EC_" + tn); }
 
+    /// Returns the type ID of a component type name, with or without the "EC_" prefix, without allocating memory.
+    /** Only the types of the components that have been added to an entity are known. For other type names returns 0.
+        Can be called from any thread. */
+    static u32 TypeIdForTypeName(const QString &typeName);
+
+    /// Makes the type name of @c component known to TypeIdForTypeName. Called by Entity when the component is added to it.
+    static void InternTypeName(const IComponent *component);
+
     // DEPRECATED
     void SetNetworkSyncEnabled(bool enable); /**< @deprecated Currently a no-op, as replication mode can not be changed after adding to an entity. @todo Remove! */
 
@@ -417,6 +425,7 @@ protected:
 private:
     friend class ::IAttribute;
     friend class Entity;
+    friend class Scene;
     
     /// This function is called by the base class (IComponent) to signal to the derived class that one or more
     /// of its attributes have changed, and it should update its internal state accordingly.
@@ -426,4 +435,8 @@ private:
 
     /// Set component id. Called by Entity
     void SetNewId(component_id_t newId);
+
+    /// Emits the attribute changes deferred by the scene, and calls AttributesChanged once. Called by Scene.
+    /** @param changes Index and change type of each changed attribute. */
+    void EmitJournaledAttributeChanges(const std::vector<std::pair<u8, AttributeChange::Type> > &changes);
 };
@@ -7,6 +7,7 @@
 #include "Scene/Scene.h"
 #include "Entity.h"
 #include "SceneDesc.h"
+#include "SceneBinaryLoader.h"
 #include "IComponent.h"
 #include "IAttribute.h"
 #include "EC_Name.h"
@@ -32,6 +33,7 @@
 #include <kNet/DataSerializer.h>
 
 #include <utility>
+#include <algorithm>
 #include "MemoryLeakCheck.h"
 
 using namespace kNet;
@@ -40,13 +42,18 @@ Scene::Scene(const QString &name, Framework *framework, bool viewEnabled, bool a
     name_(name),
     framework_(framework),
     interpolating_(false),
-    authority_(authority)
+    authority_(authority),
+    deferAttributeChanges_(framework->HasCommandLineParameter("--deferAttributeChanges")),
+    dispatchingAttributeChanges_(false),
+    deferralSuspendCount_(0)
 {
     // In headless mode only view disabled-scenes can be created
     viewEnabled_ = framework->IsHeadless() ? false : viewEnabled;
 
     // Connect to frame update to handle signaling entities created on this frame
     connect(framework->Frame(), SIGNAL(Updated(float)), this, SLOT(OnUpdated(float)));
+    // and at frame end the deferred attribute changes
+    connect(framework->Frame(), SIGNAL(PostFrameUpdate(float)), this, SLOT(OnPostFrameUpdate(float)));
 }
 
 Scene::~Scene()
@@ -108,8 +115,10 @@ EntityPtr Scene::CreateEntity(entity_id_t id, const QStringList &components, Att
     }
     entities_[entity->Id()] = entity;
 
-    // Remember the creation and signal at end of frame if EmitEntityCreated() not called for this entity manually
-    entitiesCreatedThisFrame_.push_back(std::make_pair(entity, change));
+    // Remember the creation and signal at end of frame if EmitEntityCreated() not called for this entity manually.
+    // Disconnected creations are never signaled, so they need not be queued.
+    if (change != AttributeChange::Disconnected)
+        entitiesCreatedThisFrame_.push_back(std::make_pair(entity, change));
 
     return entity;
 }
@@ -217,6 +226,8 @@ void Scene::RemoveAllEntities(bool signal, AttributeChange::Type change)
     {
         LogWarning("Scene::RemoveAllEntities: entity map was not clear after removing all entities, clearing manually");
         entities_.clear();
+        componentsByType_.clear();
+        componentIndexPositions_.clear();
     }
     
     if (signal)
@@ -245,10 +256,17 @@ EntityList Scene::EntitiesWithComponent(const QString &typeName, const QString &
 
 EntityList Scene::EntitiesWithComponent(u32 typeId, const QString &name) const
 {
+    std::vector<IComponent*> components;
+    SortedComponentsOfType(typeId, name, components);
     EntityList entities;
-    for(const_iterator it = begin(); it != end(); ++it)
-        if ((name.isEmpty() && it->second->Component(typeId)) || it->second->Component(typeId, name))
-            entities.push_back(it->second);
+    Entity *previous = 0;
+    for(size_t i = 0; i < components.size(); ++i)
+    {
+        Entity *entity = components[i]->ParentEntity();
+        if (entity != previous)
+            entities.push_back(entity->shared_from_this());
+        previous = entity;
+    }
     return entities;
 }
 
@@ -272,26 +290,81 @@ Entity::ComponentVector Scene::Components(const QString &typeName, const QString
 
 Entity::ComponentVector Scene::Components(u32 typeId, const QString &name) const
 {
+    std::vector<IComponent*> components;
+    SortedComponentsOfType(typeId, name, components);
     Entity::ComponentVector ret;
-    if (name.isEmpty())
+    ret.reserve(components.size());
+    for(size_t i = 0; i < components.size(); ++i)
+        ret.push_back(components[i]->shared_from_this());
+    return ret;
+}
+
+const std::vector<IComponent*> &Scene::ComponentsOfType(u32 typeId) const
+{
+    static const std::vector<IComponent*> empty;
+    unordered_map<u32, std::vector<IComponent*> >::const_iterator it = componentsByType_.find(typeId);
+    return it != componentsByType_.end() ? it->second : empty;
+}
+
+namespace
+{
+    /// Orders components like iterating the entity map and the components of each entity does.
+    bool ComponentLessThan(IComponent *a, IComponent *b)
     {
-        for(const_iterator it = begin(); it != end(); ++it)
-        {
-            Entity::ComponentVector components =  it->second->ComponentsOfType(typeId);
-            if (!components.empty())
-                ret.insert(ret.end(), components.begin(), components.end());
-        }
+        entity_id_t entityA = a->ParentEntity()->Id();
+        entity_id_t entityB = b->ParentEntity()->Id();
+        return entityA < entityB || (entityA == entityB && a->Id() < b->Id());
     }
+}
+
+void Scene::SortedComponentsOfType(u32 typeId, const QString &name, std::vector<IComponent*> &result) const
+{
+    const std::vector<IComponent*> &components = ComponentsOfType(typeId);
+    result.clear();
+    if (name.isEmpty())
+        result = components;
     else
     {
-        for(const_iterator it = begin(); it != end(); ++it)
-        {
-            ComponentPtr component = it->second->GetComponent(typeId, name);
-            if (component)
-                ret.push_back(component);
-        }
+        for(size_t i = 0; i < components.size(); ++i)
+            if (components[i]->Name() == name)
+                result.push_back(components[i]);
+    }
+    std::sort(result.begin(), result.end(), ComponentLessThan);
+
+    // Entity::Component(typeId, name) returns only the first matching component of the entity.
+    if (!name.isEmpty())
+    {
+        size_t numUnique = 0;
+        for(size_t i = 0; i < result.size(); ++i)
+            if (numUnique == 0 || result[i]->ParentEntity() != result[numUnique - 1]->ParentEntity())
+                result[numUnique++] = result[i];
+        result.resize(numUnique);
+    }
+}
+
+void Scene::IndexComponent(IComponent *comp)
+{
+    std::vector<IComponent*> &components = componentsByType_[comp->TypeId()];
+    componentIndexPositions_[comp] = components.size();
+    components.push_back(comp);
+}
+
+void Scene::UnindexComponent(IComponent *comp)
+{
+    unordered_map<IComponent*, size_t>::iterator pos = componentIndexPositions_.find(comp);
+    if (pos == componentIndexPositions_.end())
+        return;
+    // Swap the last component of the type to the place of the removed one.
+    size_t index = pos->second;
+    componentIndexPositions_.erase(pos);
+    std::vector<IComponent*> &components = componentsByType_[comp->TypeId()];
+    IComponent *last = components.back();
+    components.pop_back();
+    if (last != comp)
+    {
+        components[index] = last;
+        componentIndexPositions_[last] = index;
     }
-    return ret;
 }
 
 EntityList Scene::GetAllEntities() const
@@ -332,6 +405,101 @@ void Scene::EmitAttributeChanged(IComponent* comp, IAttribute* attribute, Attrib
     emit AttributeChanged(comp, attribute, change);
 }
 
+bool Scene::JournalAttributeChange(IComponent* comp, IAttribute* attribute, AttributeChange::Type change)
+{
+    if (!deferAttributeChanges_ || deferralSuspendCount_ > 0 || interpolating_ || dispatchingAttributeChanges_ || !comp || !attribute)
+        return false;
+
+    size_t pos;
+    unordered_map<IComponent*, size_t>::iterator iter = changeJournalPositions_.find(comp);
+    if (iter == changeJournalPositions_.end())
+    {
+        pos = changeJournal_.size();
+        changeJournalPositions_[comp] = pos;
+        changeJournal_.push_back(JournaledComponent());
+        changeJournal_[pos].component = comp->shared_from_this();
+    }
+    else
+    {
+        pos = iter->second;
+        // A removed component may have been replaced by a new one at the same address.
+        if (changeJournal_[pos].component.expired())
+        {
+            changeJournal_[pos].component = comp->shared_from_this();
+            changeJournal_[pos].attributes.clear();
+        }
+    }
+
+    std::vector<std::pair<u8, AttributeChange::Type> > &attributes = changeJournal_[pos].attributes;
+    const u8 index = attribute->Index();
+    for(size_t i = 0; i < attributes.size(); ++i)
+        if (attributes[i].first == index)
+        {
+            // Replicate the attribute if any of its changes was replicated.
+            if (change == AttributeChange::Replicate)
+                attributes[i].second = change;
+            return true;
+        }
+    attributes.push_back(std::make_pair(index, change));
+    return true;
+}
+
+void Scene::SetAttributeChangesDeferred(bool enabled)
+{
+    if (enabled == deferAttributeChanges_)
+        return;
+    deferAttributeChanges_ = enabled;
+    if (!enabled)
+        FlushAttributeChanges();
+}
+
+void Scene::FlushAttributeChanges()
+{
+    if (changeJournal_.empty() || dispatchingAttributeChanges_)
+        return;
+
+    PROFILE(Scene_FlushAttributeChanges);
+
+    std::vector<JournaledComponent> journal;
+    journal.swap(changeJournal_);
+    changeJournalPositions_.clear();
+
+    // Hold the components alive during the dispatch, and drop the ones removed from the scene.
+    std::vector<ComponentPtr> components;
+    components.reserve(journal.size());
+    DeferredAttributeChangeList changes;
+    for(size_t i = 0; i < journal.size(); ++i)
+    {
+        ComponentPtr comp = journal[i].component.lock();
+        if (!comp || comp->ParentScene() != this)
+            continue;
+        const AttributeVector &attributes = comp->Attributes();
+        for(size_t j = 0; j < journal[i].attributes.size(); ++j)
+        {
+            const u8 index = journal[i].attributes[j].first;
+            if (index < attributes.size() && attributes[index])
+            {
+                DeferredAttributeChange change = { comp.get(), attributes[index], journal[i].attributes[j].second };
+                changes.push_back(change);
+            }
+        }
+        components.push_back(comp);
+        // Keep the attributes of the components at the same positions as the components.
+        if (components.size() != i + 1)
+            journal[components.size() - 1].attributes.swap(journal[i].attributes);
+    }
+    if (components.empty())
+        return;
+
+    dispatchingAttributeChanges_ = true;
+    emit AttributeChangesDispatched(changes);
+    changes.clear();
+    for(size_t i = 0; i < components.size(); ++i)
+        if (components[i]->ParentScene() == this) // The handlers may have removed the component.
+            components[i]->EmitJournaledAttributeChanges(journal[i].attributes);
+    dispatchingAttributeChanges_ = false;
+}
+
 void Scene::EmitAttributeAdded(IComponent* comp, IAttribute* attribute, AttributeChange::Type change)
 {
     // "Stealth" addition (disconnected changetype) is not supported. Always signal.
@@ -490,18 +658,14 @@ bool Scene::SaveSceneXML(const QString& filename, bool saveTemporary, bool saveL
 QList<Entity *> Scene::LoadSceneBinary(const QString& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change)
 {
     QList<Entity *> ret;
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly))
+    SceneBinaryFile file;
+    if (!file.Open(filename))
     {
         LogError("Failed to open file " + filename + " when loading scene binary.");
         return ret;
     }
 
-    ///\todo Use Latin 1?
-    QByteArray bytes = file.readAll();
-    file.close();
-
-    if (!bytes.size())
+    if (!file.Size())
     {
         LogError("File " + filename + " contained 0 bytes when loading scene binary.");
         return ret;
@@ -510,7 +674,21 @@ QList<Entity *> Scene::LoadSceneBinary(const QString& filename, bool clearScene,
     if (clearScene)
         RemoveAllEntities(true, change);
 
-    return CreateContentFromBinary(bytes.data(), bytes.size(), useEntityIDsFromFile, change);
+    return CreateContentFromBinary(file.Data(), (int)file.Size(), useEntityIDsFromFile, change);
+}
+
+SceneBinaryLoader *Scene::LoadSceneBinaryAsync(const QString& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change)
+{
+    SceneBinaryLoader *loader = new SceneBinaryLoader(this, filename, useEntityIDsFromFile, change);
+    if (!loader->Start())
+    {
+        delete loader;
+        return 0;
+    }
+
+    if (clearScene)
+        RemoveAllEntities(true, change);
+    return loader;
 }
 
 bool Scene::SaveSceneBinary(const QString& filename, bool getTemporary, bool getLocal) const
@@ -709,24 +887,20 @@ QList<Entity *> Scene::CreateContentFromXml(const QDomDocument &xml, bool useEnt
 
 QList<Entity *> Scene::CreateContentFromBinary(const QString &filename, bool useEntityIDsFromFile, AttributeChange::Type change)
 {
-
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly))
+    SceneBinaryFile file;
+    if (!file.Open(filename))
     {
         LogError("Failed to open file " + filename + " when loading scene binary.");
         return QList<Entity*>();
     }
 
-    QByteArray bytes = file.readAll();
-    file.close();
-    
-    if (!bytes.size())
+    if (!file.Size())
     {
-        LogError("File " + filename + "contained 0 bytes when loading scene binary.");
+        LogError("File " + filename + " contained 0 bytes when loading scene binary.");
         return QList<Entity*>();
     }
 
-    return CreateContentFromBinary(bytes.data(), bytes.size(), useEntityIDsFromFile, change);
+    return CreateContentFromBinary(file.Data(), (int)file.Size(), useEntityIDsFromFile, change);
 }
 
 QList<Entity *> Scene::CreateContentFromBinary(const char *data, int numBytes, bool useEntityIDsFromFile, AttributeChange::Type change)
@@ -735,129 +909,129 @@ QList<Entity *> Scene::CreateContentFromBinary(const char *data, int numBytes, b
     if (!IsAuthority() && !useEntityIDsFromFile)
         LogWarning("Scene: The created entitity IDs need to be verified from the server. This will break EC_Placeable parenting.");
 
-    std::vector<EntityWeakPtr> entities;
     assert(data);
     assert(numBytes > 0);
-    QHash<entity_id_t, entity_id_t> oldToNewIds;
-    try
+
+    // Validate the whole data before creating anything, so that a truncated file does not leave a partial scene behind.
+    SceneBinaryIndex index;
+    QString error;
+    if (!index.Parse(data, numBytes, &error))
     {
-        DataDeserializer source(data, numBytes);
+        LogError("Scene::CreateContentFromBinary: " + error);
+        return QList<Entity *>();
+    }
 
-        uint num_entities = source.Read<u32>();
-        for(uint i = 0; i < num_entities; ++i)
+    std::vector<EntityWeakPtr> entities;
+    entities.reserve(index.entities.size());
+    QHash<entity_id_t, entity_id_t> oldToNewIds;
+    for(size_t i = 0; i < index.entities.size(); ++i)
+    {
+        EntityPtr entity = CreateEntityFromBinary(data, index, i, useEntityIDsFromFile, oldToNewIds);
+        if (!entity)
         {
-            entity_id_t id = source.Read<u32>();
-            bool replicated = source.Read<u8>() ? true : false;
-            if (!useEntityIDsFromFile || id == 0)
-            {
-                entity_id_t originalId = id;
-                id = replicated ? NextFreeId() : NextFreeIdLocal();
-                if (originalId != 0 && !oldToNewIds.contains(originalId))
-                    oldToNewIds[originalId] = id;
-            }
-            else if (useEntityIDsFromFile && HasEntity(id))
-            {
-                entity_id_t newID = replicated ? NextFreeId() : NextFreeIdLocal();
-                ChangeEntityId(id, newID);
-            }
+            LogError("Failed to create entity, stopping scene load!");
+            return QList<Entity*>(); // If entity creation fails, stream desync is more than likely so stop right here
+        }
+        entities.push_back(entity);
+    }
 
-            if (HasEntity(id)) // If the entity we are about to add conflicts in ID with an existing entity in the scene.
-            {
-                LogDebug("Scene::CreateContentFromBinary: Destroying previous entity with id " + QString::number(id) + " to avoid conflict with new created entity with the same id.");
-                LogError("Warning: Invoking buggy behavior: Object with id " + QString::number(id) + "might not replicate properly!");
-                RemoveEntity(id, AttributeChange::Replicate); ///<@todo Consider do we want to always use Replicate
-            }
+    // Now that we have each entity spawned to the scene, trigger all the signals for EntityCreated/ComponentChanged messages.
+    for(unsigned i = 0; i < entities.size(); ++i)
+        EmitEntityCreatedFromBinary(entities[i], useEntityIDsFromFile, oldToNewIds, change);
 
-            EntityPtr entity = CreateEntity(id);
-            if (!entity)
-            {
-                LogError("Failed to create entity, stopping scene load!");
-                return QList<Entity*>(); // If entity creation fails, stream desync is more than likely so stop right here
-            }
-            
-            uint num_components = source.Read<u32>();
-            for(uint i = 0; i < num_components; ++i)
-            {
-                u32 typeId = source.Read<u32>(); ///\todo VLE this!
-                QString name = QString::fromStdString(source.ReadString());
-                bool compReplicated = source.Read<u8>() ? true : false;
-                uint data_size = source.Read<u32>();
-                
-                // Read the component data into a separate byte array, then deserialize from there.
-                // This way the whole stream should not desync even if something goes wrong
-                QByteArray comp_bytes;
-                comp_bytes.resize(data_size);
-                if (data_size)
-                    source.ReadArray<u8>((u8*)comp_bytes.data(), comp_bytes.size());
-                
-                try
-                {
-                    ComponentPtr new_comp = entity->GetOrCreateComponent(typeId, name, AttributeChange::Default, compReplicated);
-                    if (new_comp)
-                    {
-                        if (data_size)
-                        {
-                            DataDeserializer comp_source(comp_bytes.data(), comp_bytes.size());
-                            // Trigger no signal yet when scene is in incoherent state
-                            new_comp->DeserializeFromBinary(comp_source, AttributeChange::Disconnected);
-                        }
-                    }
-                    else
-                        LogError("Failed to load component \"" + framework_->Scene()->GetComponentTypeName(typeId) + "\"!");
-                }
-                catch(...)
-                {
-                    LogError("Failed to load component \"" + framework_->Scene()->GetComponentTypeName(typeId) + "\"!");
-                }
-            }
+    // The above signals may have caused scripts to remove entities. Return those that still exist.
+    QList<Entity *> ret;
+    for(unsigned i = 0; i < entities.size(); ++i)
+        if (!entities[i].expired())
+            ret.append(entities[i].lock().get());
 
-            entities.push_back(entity);
-        }
+    return ret;
+}
+
+EntityPtr Scene::CreateEntityFromBinary(const char *data, const SceneBinaryIndex &index, size_t entityIndex, bool useEntityIDsFromFile, QHash<entity_id_t, entity_id_t> &oldToNewIds)
+{
+    const SceneBinaryIndex::EntityRecord &record = index.entities[entityIndex];
+    entity_id_t id = record.id;
+    if (!useEntityIDsFromFile || id == 0)
+    {
+        entity_id_t originalId = id;
+        id = record.replicated ? NextFreeId() : NextFreeIdLocal();
+        if (originalId != 0 && !oldToNewIds.contains(originalId))
+            oldToNewIds[originalId] = id;
     }
-    catch(...)
+    else if (useEntityIDsFromFile && HasEntity(id))
     {
-        // Note: if exception happens, no change signals are emitted
-        return QList<Entity *>();
+        entity_id_t newID = record.replicated ? NextFreeId() : NextFreeIdLocal();
+        ChangeEntityId(id, newID);
     }
 
-    // Now that we have each entity spawned to the scene, trigger all the signals for EntityCreated/ComponentChanged messages.
-    for(unsigned i = 0; i < entities.size(); ++i)
+    if (HasEntity(id)) // If the entity we are about to add conflicts in ID with an existing entity in the scene.
     {
-        if (!entities[i].expired())
-            EmitEntityCreated(entities[i].lock().get(), change);
-        if (!entities[i].expired())
+        LogDebug("Scene::CreateContentFromBinary: Destroying previous entity with id " + QString::number(id) + " to avoid conflict with new created entity with the same id.");
+        LogError("Warning: Invoking buggy behavior: Object with id " + QString::number(id) + "might not replicate properly!");
+        RemoveEntity(id, AttributeChange::Replicate); ///<@todo Consider do we want to always use Replicate
+    }
+
+    // EntityCreated is emitted by EmitEntityCreatedFromBinary once the whole content exists.
+    EntityPtr entity = CreateEntity(id, QStringList(), AttributeChange::Disconnected);
+    if (!entity)
+        return entity;
+
+    for(size_t i = record.firstComponent; i < record.firstComponent + record.numComponents; ++i)
+    {
+        const SceneBinaryIndex::ComponentRecord &comp = index.components[i];
+        try
         {
-            EntityPtr entityShared = entities[i].lock();
-            const Entity::ComponentMap &components = entityShared->Components();
-            for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+            ComponentPtr new_comp = entity->GetOrCreateComponent(comp.typeId, comp.name, AttributeChange::Default, comp.replicated);
+            if (new_comp)
             {
-                /// @todo Duplicate code
-                if (!useEntityIDsFromFile && i->second->TypeId() == 20 /* EC_Placeable*/)
+                if (comp.dataSize)
                 {
-                    // Go and fix parent ref of EC_Placeable if new entity IDs were generated
-                    Attribute<EntityReference> *parentRef = dynamic_cast<Attribute<EntityReference> *>(i->second->AttributeById("parentRef"));
-                    if (parentRef && !parentRef->Get().IsEmpty())
-                    {
-                        // We only need to fix the id parent refs.
-                        // Ones with entity names should work as expected.
-                        bool isNumber = false;
-                        entity_id_t refId = parentRef->Get().ref.toUInt(&isNumber);
-                        if (isNumber && refId > 0 && oldToNewIds.contains(refId))
-                            parentRef->Set(EntityReference(oldToNewIds[refId]), change);
-                    }
+                    // The index has validated the data bounds, so the component data can be deserialized in place.
+                    DataDeserializer comp_source(data + comp.dataOffset, comp.dataSize);
+                    // Trigger no signal yet when scene is in incoherent state
+                    new_comp->DeserializeFromBinary(comp_source, AttributeChange::Disconnected);
                 }
-                i->second->ComponentChanged(change);
             }
+            else
+                LogError("Failed to load component \"" + framework_->Scene()->GetComponentTypeName(comp.typeId) + "\"!");
+        }
+        catch(...)
+        {
+            LogError("Failed to load component \"" + framework_->Scene()->GetComponentTypeName(comp.typeId) + "\"!");
         }
     }
-    
-    // The above signals may have caused scripts to remove entities. Return those that still exist.
-    QList<Entity *> ret;
-    for(unsigned i = 0; i < entities.size(); ++i)
-        if (!entities[i].expired())
-            ret.append(entities[i].lock().get());
+    return entity;
+}
 
-    return ret;
+void Scene::EmitEntityCreatedFromBinary(const EntityWeakPtr &entity, bool useEntityIDsFromFile, const QHash<entity_id_t, entity_id_t> &oldToNewIds, AttributeChange::Type change)
+{
+    if (!entity.expired())
+        EmitEntityCreated(entity.lock().get(), change);
+    EntityPtr entityShared = entity.lock();
+    if (!entityShared)
+        return; // Removed by a handler of EntityCreated.
+
+    const Entity::ComponentMap &components = entityShared->Components();
+    for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+    {
+        /// @todo Duplicate code
+        if (!useEntityIDsFromFile && i->second->TypeId() == 20 /* EC_Placeable*/)
+        {
+            // Go and fix parent ref of EC_Placeable if new entity IDs were generated
+            Attribute<EntityReference> *parentRef = dynamic_cast<Attribute<EntityReference> *>(i->second->AttributeById("parentRef"));
+            if (parentRef && !parentRef->Get().IsEmpty())
+            {
+                // We only need to fix the id parent refs.
+                // Ones with entity names should work as expected.
+                bool isNumber = false;
+                entity_id_t refId = parentRef->Get().ref.toUInt(&isNumber);
+                if (isNumber && refId > 0 && oldToNewIds.contains(refId))
+                    parentRef->Set(EntityReference(oldToNewIds[refId]), change);
+            }
+        }
+        i->second->ComponentChanged(change);
+    }
 }
 
 QList<Entity *> Scene::CreateContentFromSceneDesc(const SceneDesc &desc, bool useEntityIDsFromFile, AttributeChange::Type change)
@@ -1185,16 +1359,15 @@ SceneDesc Scene::CreateSceneDescFromBinary(const QString &filename) const
 
     sceneDesc.filename = filename;
 
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly))
+    SceneBinaryFile file;
+    if (!file.Open(filename))
     {
         LogError("Failed to open file " + filename + " when trying to create scene description.");
         return sceneDesc;
     }
 
-    QByteArray bytes = file.readAll();
-    file.close();
-
+    // Refer to the file contents without copying them.
+    QByteArray bytes = QByteArray::fromRawData(file.Data(), (int)file.Size());
     return CreateSceneDescFromBinary(bytes, sceneDesc);
 }
 
@@ -1209,7 +1382,7 @@ SceneDesc Scene::CreateSceneDescFromBinary(QByteArray &data, SceneDesc &sceneDes
 
     try
     {
-        DataDeserializer source(bytes.data(), bytes.size());
+        DataDeserializer source(bytes.constData(), bytes.size());
         
         uint num_entities = source.Read<u32>();
         for(uint i = 0; i < num_entities; ++i)
@@ -1342,62 +1515,39 @@ bool Scene::StartAttributeInterpolation(IAttribute* attr, IAttribute* endvalue,
     if (!endvalue)
         return false;
     
+    bool success = InterpolateAttributeTo(attr, endvalue, length);
+    delete endvalue;
+    return success;
+}
+
+bool Scene::InterpolateAttributeTo(IAttribute* attr, IAttribute* endValue, float length)
+{
     IComponent* comp = attr ? attr->Owner() : 0;
     Entity* entity = comp ? comp->ParentEntity() : 0;
     Scene* scene = entity ? entity->ParentScene() : 0;
     
-    if (length <= 0.0f || !attr || !attr->Metadata() || attr->Metadata()->interpolation == AttributeMetadata::None ||
+    if (!endValue || length <= 0.0f || !attr || !attr->Metadata() || attr->Metadata()->interpolation == AttributeMetadata::None ||
         !comp || !entity || !scene || scene != this)
-    {
-        delete endvalue;
         return false;
-    }
-    
-    // End previous interpolation if existed
-    bool previous = EndAttributeInterpolation(attr);
     
     // If previous interpolation does not exist, perform a direct snapping to the end value
     // but still start an interpolation period, so that on the next update we detect that an interpolation is going on,
-    // and will interpolate normally
-    if (!previous)
-        attr->CopyValue(endvalue, AttributeChange::LocalOnly);
-    
-    AttributeInterpolation newInterp;
-    newInterp.dest = AttributeWeakPtr(comp->shared_from_this(), attr);
-    newInterp.start = AttributeWeakPtr(comp->shared_from_this(), attr->Clone());
-    newInterp.end = AttributeWeakPtr(comp->shared_from_this(), endvalue);
-    newInterp.length = length;
+    // and will interpolate normally. A previous interpolation is replaced, starting from the current value.
+    if (!interpolator_.Contains(attr))
+        attr->CopyValue(endValue, AttributeChange::LocalOnly);
     
-    interpolations_.push_back(newInterp);
+    interpolator_.Start(attr, endValue, length);
     return true;
 }
 
 bool Scene::EndAttributeInterpolation(IAttribute* attr)
 {
-    for(uint i = 0; i < interpolations_.size(); ++i)
-    {
-        AttributeInterpolation& interp = interpolations_[i];
-        if (interp.dest.Get() == attr)
-        {
-            delete interp.start.Get();
-            delete interp.end.Get();
-            interpolations_.erase(interpolations_.begin() + i);
-            return true;
-        }
-    }
-    return false;
+    return interpolator_.End(attr);
 }
 
 void Scene::EndAllAttributeInterpolations()
 {
-    for(uint i = 0; i < interpolations_.size(); ++i)
-    {
-        AttributeInterpolation& interp = interpolations_[i];
-        delete interp.start.Get();
-        delete interp.end.Get();
-    }
-    
-    interpolations_.clear();
+    interpolator_.Clear();
 }
 
 void Scene::UpdateAttributeInterpolations(float frametime)
@@ -1405,44 +1555,7 @@ void Scene::UpdateAttributeInterpolations(float frametime)
     PROFILE(Scene_UpdateInterpolation);
     
     interpolating_ = true;
-    
-    for(size_t i = interpolations_.size() - 1; i < interpolations_.size(); --i)
-    {
-        AttributeInterpolation& interp = interpolations_[i];
-        bool finished = false;
-        
-        // Check that the component still exists i.e. it's safe to access the attribute
-        if (!interp.start.owner.expired())
-        {
-            // Allow the interpolation to persist for 2x time, though we are no longer setting the value
-            // This is for the continuous/discontinuous update detection in StartAttributeInterpolation()
-            if (interp.time <= interp.length)
-            {
-                interp.time += frametime;
-                float t = interp.time / interp.length;
-                if (t > 1.0f)
-                    t = 1.0f;
-                interp.dest.Get()->Interpolate(interp.start.Get(), interp.end.Get(), t, AttributeChange::LocalOnly);
-            }
-            else
-            {
-                interp.time += frametime;
-                if (interp.time >= interp.length * 2.0f)
-                    finished = true;
-            }
-        }
-        else // Component pointer has expired, abort this interpolation
-            finished = true;
-        
-        // Remove interpolation (& delete start/endpoints) when done
-        if (finished)
-        {
-            delete interp.start.Get();
-            delete interp.end.Get();
-            interpolations_.erase(interpolations_.begin() + i);
-        }
-    }
-
+    interpolator_.Update(frametime, AttributeChange::LocalOnly);
     interpolating_ = false;
 }
 
@@ -1467,6 +1580,11 @@ void Scene::OnUpdated(float /*frameTime*/)
     entitiesCreatedThisFrame_.clear();
 }
 
+void Scene::OnPostFrameUpdate(float /*frameTime*/)
+{
+    FlushAttributeChanges();
+}
+
 EntityList Scene::FindEntities(const QString &pattern) const
 {
     QRegExp regex = QRegExp(pattern, Qt::CaseSensitive, QRegExp::WildcardUnix);
@@ -11,9 +11,11 @@
 #include "Math/float3.h"
 #include "SceneDesc.h"
 #include "Entity.h"
+#include "AttributeInterpolator.h"
 
 #include <QObject>
 #include <QVariant>
+#include <QHash>
 
 #include <map>
 
@@ -22,6 +24,17 @@ class Framework;
 /// Maybe have some kind of UserConnection interface class defined in Framework and use that instead.
 class UserConnection;
 class QDomDocument;
+class SceneBinaryLoader;
+struct SceneBinaryIndex;
+
+/// An attribute change dispatched from the attribute change journal of a scene.
+/** @see Scene::SetAttributeChangesDeferred */
+struct DeferredAttributeChange
+{
+    IComponent *component;
+    IAttribute *attribute;
+    AttributeChange::Type change;
+};
 
 /// A collection of entities which form an observable world.
 /** Acts as a factory for all entities.
@@ -91,6 +104,12 @@ public:
                 must be static-structured, component must be in an entity which is in a scene, scene must be us) */
     bool StartAttributeInterpolation(IAttribute* attr, IAttribute* endvalue, float length);
 
+    /// Starts an attribute interpolation, copying the end value.
+    /** Same as StartAttributeInterpolation, but the Scene does not take ownership of @c endValue, so the caller may reuse it.
+        Does not allocate for float, float3, Quat and Transform attributes.
+        @param endValue Same kind of attribute holding the endpoint value. */
+    bool InterpolateAttributeTo(IAttribute* attr, IAttribute* endValue, float length);
+
     /// Ends an attribute interpolation. The last set value will remain.
     /** @param attr Attribute inside a static-structured component.
         @return true if an interpolation existed */
@@ -106,6 +125,17 @@ public:
     /// See if scene is currently performing interpolations, to differentiate between interpolative & non-interpolative attribute changes.
     bool IsInterpolating() const { return interpolating_; }
 
+    /// Returns whether the attribute changes are deferred to the end of the frame. @see SetAttributeChangesDeferred
+    bool AttributeChangesDeferred() const { return deferAttributeChanges_; }
+
+    /// Returns true while the deferred attribute changes are being dispatched.
+    /** Network synchronization managers which handle AttributeChangesDispatched ignore AttributeChanged meanwhile. */
+    bool IsDispatchingAttributeChanges() const { return dispatchingAttributeChanges_; }
+
+    /// Records an attribute change to the change journal, if the attribute changes are deferred. Called by IComponent.
+    /** @return False if the change should be signalled immediately. */
+    bool JournalAttributeChange(IComponent* comp, IAttribute* attribute, AttributeChange::Type change);
+
     /// Returns Framework
     Framework *GetFramework() const { return framework_; }
 
@@ -192,15 +222,23 @@ public:
     void EmitComponentAcked(IComponent* component, component_id_t oldId);
 
     /// Returns all components of type T (and additionally with specific name) in the scene.
+    /** @note O(m log m), where m is the number of components of type T. */
     template <typename T>
     std::vector<shared_ptr<T> > Components(const QString &name = "") const;
 
     /// Returns list of entities with a specific component present.
     /** @param name Name of the component, optional.
-        @note O(n) */
+        @note O(m log m), where m is the number of components of type T. */
     template <typename T>
     EntityList EntitiesWithComponent(const QString &name = "") const;
 
+    /// Returns all components of a specific type in the scene, without allocating.
+    /** The order of the components is unspecified. The returned vector changes when a component of the type is added
+        to or removed from the scene, so the scene may not be modified while iterating it.
+        @param typeId Component type ID.
+        @note O(1) */
+    const std::vector<IComponent*> &ComponentsOfType(u32 typeId) const;
+
     /// @cond PRIVATE
     /// Do not directly allocate new scenes using operator new, but use the factory-based SceneAPI::CreateScene functions instead.
     /** @param name Name of the scene.
@@ -312,7 +350,7 @@ public slots:
     /// Returns list of entities with a specific component present.
     /** @param typeId Type ID of the component
         @param name Name of the component, optional.
-        @note O(n) */
+        @note O(m log m), where m is the number of components of the type. */
     EntityList EntitiesWithComponent(u32 typeId, const QString &name = "") const;
     /// @overload
     /** @param typeName typeName Type name of the component.
@@ -376,6 +414,12 @@ public slots:
         @return List of created entities. */
     QList<Entity *> LoadSceneBinary(const QString& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change);
 
+    /// Starts loading the scene from a binary file incrementally, without blocking the main loop.
+    /** The file is indexed in a worker thread, after which the entities are created over several frames.
+        The parameters are the same as in LoadSceneBinary. Clearing the scene is done immediately.
+        @return Loader that emits Finished(bool, QList<Entity *>) when done and then deletes itself, or null if the file could not be opened. */
+    SceneBinaryLoader *LoadSceneBinaryAsync(const QString& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change);
+
     /// Save the scene to binary
     /** @param filename File name
         @param saveTemporary Are temporary entities wanted to be included.
@@ -415,6 +459,26 @@ public slots:
         @param change Change signaling mode */
     void EmitEntityCreated(Entity *entity, AttributeChange::Type change = AttributeChange::Default);
 
+    /// Sets whether the attribute changes are deferred to the end of the frame.
+    /** When enabled, IComponent::EmitAttributeChanged only records which attributes of each component have changed.
+        At the end of the frame, or in FlushAttributeChanges, AttributeChangesDispatched is emitted once for all the changes,
+        and then the AttributeChanged signals of the scene and the components once for each changed attribute, and
+        IComponent::AttributesChanged once for each changed component. Setting an attribute several times during the frame
+        signals it once. Disabled by default, as code which reads a component right after setting its attributes may rely
+        on the component having reacted to the change. Enabled for all the scenes with --deferAttributeChanges. Disabling dispatches the pending changes.
+        @note The changes made while interpolating attributes, or by the handlers of the dispatched changes, are signalled immediately. */
+    void SetAttributeChangesDeferred(bool enabled);
+
+    /// Dispatches the deferred attribute changes now. @see SetAttributeChangesDeferred
+    void FlushAttributeChanges();
+
+    /// Signals the attribute changes immediately until ResumeAttributeChangeDeferral, without dispatching the pending deferred changes.
+    /** Unlike disabling the deferral, this leaves the changes already recorded in the journal to be dispatched at the end of the frame.
+        Calls can be nested, and each must be paired with a call to ResumeAttributeChangeDeferral. */
+    void SuspendAttributeChangeDeferral() { ++deferralSuspendCount_; }
+    /// Ends a SuspendAttributeChangeDeferral.
+    void ResumeAttributeChangeDeferral() { if (deferralSuspendCount_ > 0) --deferralSuspendCount_; }
+
     /// @cond PRIVATE
     // DEPRECATED function signatures
     EntityPtr GetEntity(entity_id_t id) const { return EntityById(id); } /**< @deprecated Use EntityById @todo Add warning print, remove in some distant future */
@@ -435,6 +499,11 @@ signals:
     /** Network synchronization managers should connect to this. */
     void AttributeChanged(IComponent* comp, IAttribute* attribute, AttributeChange::Type change);
 
+    /// Signal when the deferred attribute changes are dispatched, before the AttributeChanged signals of the changes.
+    /** Network synchronization managers can connect to this to handle all the changes of a frame in one pass.
+        @see SetAttributeChangesDeferred, IsDispatchingAttributeChanges */
+    void AttributeChangesDispatched(const DeferredAttributeChangeList &changes);
+
     /// Signal when an attribute of a component has been added (dynamic structure components only)
     /** Network synchronization managers should connect to this. */
     void AttributeAdded(IComponent* comp, IAttribute* attribute, AttributeChange::Type change);
@@ -489,18 +558,34 @@ private slots:
     /// Handle frame update. Signal this frame's entity creations.
     void OnUpdated(float frameTime);
 
+    /// Handle frame end. Dispatch this frame's deferred attribute changes.
+    void OnPostFrameUpdate(float frameTime);
+
 private:
     friend class ::SceneAPI;
+    friend class ::SceneBinaryLoader;
+    friend class ::Entity;
+
+    /// Creates an entity of a binary scene. The component data is deserialized directly from @c data.
+    /** Signals are not emitted, see EmitEntityCreatedFromBinary. @return Null if the entity could not be created. */
+    EntityPtr CreateEntityFromBinary(const char *data, const SceneBinaryIndex &index, size_t entityIndex, bool useEntityIDsFromFile, QHash<entity_id_t, entity_id_t> &oldToNewIds);
+    /// Fixes the EC_Placeable parent ref of an entity created from a binary scene, and emits EntityCreated and ComponentChanged.
+    void EmitEntityCreatedFromBinary(const EntityWeakPtr &entity, bool useEntityIDsFromFile, const QHash<entity_id_t, entity_id_t> &oldToNewIds, AttributeChange::Type change);
 
-    /// Container for an ongoing attribute interpolation
-    struct AttributeInterpolation
+    /// Changed attributes of a component, recorded to the attribute change journal.
+    struct JournaledComponent
     {
-        AttributeInterpolation() : time(0.0f), length(0.0f) {}
-        AttributeWeakPtr dest, start, end;
-        float time;
-        float length;
+        ComponentWeakPtr component;
+        std::vector<std::pair<u8, AttributeChange::Type> > attributes; ///< Index and change type of each changed attribute.
     };
 
+    /// Adds a component to the per-type component index. Called by Entity when a component is added.
+    void IndexComponent(IComponent *comp);
+    /// Removes a component from the per-type component index. Called by Entity when a component is removed.
+    void UnindexComponent(IComponent *comp);
+    /// Returns the components of a type sorted by the parent entity ID and component ID, optionally only the ones with a specific name.
+    void SortedComponentsOfType(u32 typeId, const QString &name, std::vector<IComponent*> &result) const;
+
     UniqueIdGenerator idGenerator_; ///< Entity ID generator
     EntityMap entities_; ///< All entities in the scene.
     Framework *framework_; ///< Parent framework.
@@ -508,8 +593,15 @@ private:
     bool viewEnabled_; ///< View enabled -flag.
     bool interpolating_; ///< Currently doing interpolation-flag.
     bool authority_; ///< Authority -flag
-    std::vector<AttributeInterpolation> interpolations_; ///< Running attribute interpolations.
+    AttributeInterpolator interpolator_; ///< Running attribute interpolations.
     std::vector<std::pair<EntityWeakPtr, AttributeChange::Type> > entitiesCreatedThisFrame_; ///< Entities to signal for creation at frame end.
+    unordered_map<u32, std::vector<IComponent*> > componentsByType_; ///< Components of the entities in the scene by type ID, unordered.
+    unordered_map<IComponent*, size_t> componentIndexPositions_; ///< Position of each component in its componentsByType_ vector.
+    bool deferAttributeChanges_; ///< Whether the attribute changes are recorded to changeJournal_ instead of signalled immediately.
+    bool dispatchingAttributeChanges_; ///< Dispatching the deferred attribute changes -flag.
+    int deferralSuspendCount_; ///< Nesting count of SuspendAttributeChangeDeferral.
+    std::vector<JournaledComponent> changeJournal_; ///< Components with deferred attribute changes, in the order they were first changed.
+    unordered_map<IComponent*, size_t> changeJournalPositions_; ///< Position of each component in changeJournal_.
 };
 
 #include "Scene.inl"
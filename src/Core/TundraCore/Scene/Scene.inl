@@ -12,25 +12,12 @@ shared_ptr<T> Scene::Subsystem() const
 template <typename T>
 std::vector<shared_ptr<T> > Scene::Components(const QString &name) const
 {
+    std::vector<IComponent*> components;
+    SortedComponentsOfType(T::ComponentTypeId, name, components);
     std::vector<shared_ptr<T> > ret;
-    if (name.isEmpty())
-    {
-        for(const_iterator it = begin(); it != end(); ++it)
-        {
-            std::vector<shared_ptr<T> > components =  it->second->ComponentsOfType<T>();
-            if (!components.empty())
-                ret.insert(ret.end(), components.begin(), components.end());
-        }
-    }
-    else
-    {
-        for(const_iterator it = begin(); it != end(); ++it)
-        {
-            shared_ptr<T> component = it->second->GetComponent<T>(name);
-            if (component)
-                ret.push_back(component);
-        }
-    }
+    ret.reserve(components.size());
+    for(size_t i = 0; i < components.size(); ++i)
+        ret.push_back(static_pointer_cast<T>(components[i]->shared_from_this()));
     return ret;
 }
 
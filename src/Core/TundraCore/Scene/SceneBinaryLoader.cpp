@@ -0,0 +1,296 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "SceneBinaryLoader.h"
+#include "Scene/Scene.h"
+#include "Entity.h"
+#include "Framework.h"
+#include "FrameAPI.h"
+#include "HighPerfClock.h"
+#include "Profiler.h"
+#include "LoggingFunctions.h"
+
+#include <QThread>
+
+#include <kNet/DataDeserializer.h>
+
+#include <algorithm>
+#include "MemoryLeakCheck.h"
+
+using namespace kNet;
+
+SceneBinaryFile::SceneBinaryFile() :
+    map_(0),
+    data_(0),
+    size_(0)
+{
+}
+
+SceneBinaryFile::~SceneBinaryFile()
+{
+    Close();
+}
+
+bool SceneBinaryFile::Open(const QString &filename)
+{
+    Close();
+    file_.setFileName(filename);
+    if (!file_.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = file_.size();
+    if (size > 0)
+        map_ = file_.map(0, size);
+    if (map_)
+    {
+        data_ = (const char *)map_;
+        size_ = (size_t)size;
+    }
+    else
+    {
+        // Mapping is not supported for all files, e.g. Qt resources.
+        bytes_ = file_.readAll();
+        data_ = bytes_.constData();
+        size_ = (size_t)bytes_.size();
+    }
+    return true;
+}
+
+void SceneBinaryFile::Close()
+{
+    if (map_)
+        file_.unmap(map_);
+    map_ = 0;
+    bytes_.clear();
+    data_ = 0;
+    size_ = 0;
+    if (file_.isOpen())
+        file_.close();
+}
+
+bool SceneBinaryIndex::Parse(const char *data, size_t numBytes, QString *error)
+{
+    PROFILE(SceneBinaryIndex_Parse);
+
+    entities.clear();
+    components.clear();
+    if (!data || !numBytes)
+    {
+        if (error)
+            *error = "No data.";
+        return false;
+    }
+
+    try
+    {
+        DataDeserializer source(data, numBytes);
+        const u32 numEntities = source.Read<u32>();
+        // An entity takes at least 9 bytes, so that a corrupted count does not make us reserve excessive amounts of memory.
+        entities.reserve(std::min<size_t>(numEntities, source.BytesLeft() / 9));
+        for(u32 i = 0; i < numEntities; ++i)
+        {
+            EntityRecord entity;
+            entity.id = source.Read<u32>();
+            entity.replicated = source.Read<u8>() != 0;
+            entity.numComponents = source.Read<u32>();
+            entity.firstComponent = components.size();
+            for(u32 j = 0; j < entity.numComponents; ++j)
+            {
+                ComponentRecord comp;
+                comp.typeId = source.Read<u32>(); ///\todo VLE this!
+                comp.name = QString::fromStdString(source.ReadString());
+                comp.replicated = source.Read<u8>() != 0;
+                comp.dataSize = source.Read<u32>();
+                comp.dataOffset = source.BytePos();
+                if (comp.dataSize > source.BytesLeft())
+                {
+                    if (error)
+                        *error = QString("Component data of entity %1 exceeds the end of data.").arg(entity.id);
+                    return false;
+                }
+                source.SkipBytes(comp.dataSize);
+                components.push_back(comp);
+            }
+            entities.push_back(entity);
+        }
+    }
+    catch(...)
+    {
+        if (error)
+            *error = QString("Unexpected end of data after %1 entities.").arg(entities.size());
+        return false;
+    }
+    return true;
+}
+
+/// Worker thread that indexes the file of a SceneBinaryLoader.
+class SceneBinaryIndexThread : public QThread
+{
+public:
+    explicit SceneBinaryIndexThread(SceneBinaryLoader *loader) : loader_(loader) {}
+
+protected:
+    void run()
+    {
+        loader_->indexOk_ = loader_->index_.Parse(loader_->file_.Data(), loader_->file_.Size(), &loader_->indexError_);
+    }
+
+private:
+    SceneBinaryLoader *loader_;
+};
+
+SceneBinaryLoader::SceneBinaryLoader(Scene *scene, const QString &filename, bool useEntityIDsFromFile, AttributeChange::Type change) :
+    scene_(scene->shared_from_this()),
+    framework_(scene->GetFramework()),
+    filename_(filename),
+    useEntityIDsFromFile_(useEntityIDsFromFile),
+    change_(change),
+    timeBudgetMsecs_(5.f),
+    state_(Idle),
+    indexThread_(0),
+    indexOk_(false),
+    next_(0)
+{
+}
+
+SceneBinaryLoader::~SceneBinaryLoader()
+{
+    if (indexThread_)
+    {
+        indexThread_->wait();
+        delete indexThread_;
+    }
+}
+
+bool SceneBinaryLoader::Start()
+{
+    ScenePtr scene = scene_.lock();
+    if (state_ != Idle || !scene)
+        return false;
+
+    if (!file_.Open(filename_))
+    {
+        LogError("Failed to open file " + filename_ + " when loading scene binary.");
+        return false;
+    }
+    if (!file_.Size())
+    {
+        LogError("File " + filename_ + " contained 0 bytes when loading scene binary.");
+        return false;
+    }
+
+    /// @todo Make server fix any broken parenting when it changes the entity IDs from unacked to replicated!
+    if (!scene->IsAuthority() && !useEntityIDsFromFile_)
+        LogWarning("Scene: The created entitity IDs need to be verified from the server. This will break EC_Placeable parenting.");
+
+    state_ = Indexing;
+    indexThread_ = new SceneBinaryIndexThread(this);
+    indexThread_->start();
+    connect(framework_->Frame(), SIGNAL(Updated(float)), SLOT(OnUpdated(float)));
+    return true;
+}
+
+float SceneBinaryLoader::Progress() const
+{
+    switch(state_)
+    {
+    case Creating:
+        return index_.entities.empty() ? 0.5f : 0.5f * next_ / index_.entities.size();
+    case Signaling:
+        return entities_.empty() ? 1.f : 0.5f + 0.5f * next_ / entities_.size();
+    case Done:
+        return 1.f;
+    default:
+        return 0.f;
+    }
+}
+
+QList<Entity *> SceneBinaryLoader::Entities() const
+{
+    QList<Entity *> ret;
+    for(size_t i = 0; i < entities_.size(); ++i)
+        if (!entities_[i].expired())
+            ret.append(entities_[i].lock().get());
+    return ret;
+}
+
+void SceneBinaryLoader::OnUpdated(float /*frameTime*/)
+{
+    if (state_ == Done)
+        return;
+
+    PROFILE(SceneBinaryLoader_Update);
+
+    ScenePtr scene = scene_.lock();
+    if (!scene)
+    {
+        Finish(false);
+        return;
+    }
+
+    if (state_ == Indexing)
+    {
+        if (!indexThread_->isFinished())
+            return;
+        if (!indexOk_)
+        {
+            LogError("Failed to load scene binary " + filename_ + ": " + indexError_);
+            Finish(false);
+            return;
+        }
+        state_ = Creating;
+        next_ = 0;
+        entities_.reserve(index_.entities.size());
+    }
+
+    const tick_t start = GetCurrentClockTime();
+    const tick_t budget = (tick_t)(timeBudgetMsecs_ * GetCurrentClockFreq() / 1000.0);
+    bool first = true;
+    while(state_ == Creating || state_ == Signaling)
+    {
+        if (!first && GetCurrentClockTime() - start >= budget)
+            return;
+        first = false;
+
+        if (state_ == Creating)
+        {
+            if (next_ >= index_.entities.size())
+            {
+                // All entities exist now, so parent refs can be resolved and the signals emitted.
+                state_ = Signaling;
+                next_ = 0;
+                continue;
+            }
+            EntityPtr entity = scene->CreateEntityFromBinary(file_.Data(), index_, next_++, useEntityIDsFromFile_, oldToNewIds_);
+            if (!entity)
+            {
+                LogError("Failed to create entity, stopping scene load!");
+                Finish(false);
+                return;
+            }
+            entities_.push_back(entity);
+        }
+        else
+        {
+            if (next_ >= entities_.size())
+            {
+                Finish(true);
+                return;
+            }
+            scene->EmitEntityCreatedFromBinary(entities_[next_++], useEntityIDsFromFile_, oldToNewIds_, change_);
+        }
+    }
+}
+
+void SceneBinaryLoader::Finish(bool success)
+{
+    state_ = Done;
+    disconnect(framework_->Frame(), SIGNAL(Updated(float)), this, SLOT(OnUpdated(float)));
+    if (indexThread_)
+        indexThread_->wait(); // The thread reads the file until it has finished.
+    file_.Close();
+    emit Finished(success, Entities());
+    deleteLater();
+}
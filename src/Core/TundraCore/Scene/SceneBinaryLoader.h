@@ -0,0 +1,146 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraCoreApi.h"
+#include "CoreTypes.h"
+#include "SceneFwd.h"
+#include "AttributeChangeType.h"
+
+#include <QObject>
+#include <QFile>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <vector>
+
+class QThread;
+class Framework;
+
+/// Read-only view of the contents of a file. The file is memory-mapped when possible, and read to memory otherwise.
+class TUNDRACORE_API SceneBinaryFile
+{
+public:
+    SceneBinaryFile();
+    ~SceneBinaryFile();
+
+    /// Opens the file. Returns false if the file could not be opened.
+    bool Open(const QString &filename);
+    /// Unmaps and closes the file.
+    void Close();
+
+    const char *Data() const { return data_; }
+    size_t Size() const { return size_; }
+
+private:
+    QFile file_;
+    uchar *map_; ///< Memory-mapped file contents, or null if mapping was not possible.
+    QByteArray bytes_; ///< File contents if mapping was not possible.
+    const char *data_;
+    size_t size_;
+};
+
+/// Index of the entities and components in a binary scene (.tbin) buffer.
+/** The index refers to the component data by offset to the buffer, so the data is not copied.
+    Parsing touches no scene or framework state, and can be done in any thread. */
+struct TUNDRACORE_API SceneBinaryIndex
+{
+    struct ComponentRecord
+    {
+        u32 typeId;
+        QString name;
+        bool replicated;
+        size_t dataOffset; ///< Offset of the serialized attribute data from the start of the buffer.
+        u32 dataSize;
+    };
+
+    struct EntityRecord
+    {
+        entity_id_t id;
+        bool replicated;
+        size_t firstComponent; ///< Index of the first component of the entity in @c components.
+        u32 numComponents;
+    };
+
+    std::vector<EntityRecord> entities;
+    std::vector<ComponentRecord> components;
+
+    /// Builds the index from a buffer. Returns false and fills @c error if the buffer is truncated or malformed.
+    bool Parse(const char *data, size_t numBytes, QString *error = 0);
+};
+
+/// Loads a binary scene file incrementally, without blocking the main loop.
+/** The file is memory-mapped and indexed in a worker thread. The entities are then created in the main thread in
+    time-budgeted chunks, one chunk per frame, and finally EntityCreated and ComponentChanged are signaled in the
+    same way as Scene::LoadSceneBinary does it. Component data is deserialized directly from the mapped file.
+    Use Scene::LoadSceneBinaryAsync to create the loader. The loader deletes itself after Finished has been emitted. */
+class TUNDRACORE_API SceneBinaryLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    SceneBinaryLoader(Scene *scene, const QString &filename, bool useEntityIDsFromFile, AttributeChange::Type change);
+    ~SceneBinaryLoader();
+
+    /// Opens the file and starts indexing it. Returns false if the file could not be opened.
+    bool Start();
+
+public slots:
+    /// Returns the name of the file being loaded.
+    QString Filename() const { return filename_; }
+
+    /// Returns the load progress in range [0,1].
+    float Progress() const;
+
+    /// Returns the maximum time spent in scene loading per frame, in milliseconds.
+    float TimeBudget() const { return timeBudgetMsecs_; }
+    /// Sets the maximum time spent in scene loading per frame, in milliseconds. At least one entity is processed per frame.
+    void SetTimeBudget(float msecs) { timeBudgetMsecs_ = msecs; }
+
+    /// Returns the entities created so far.
+    QList<Entity *> Entities() const;
+
+signals:
+    /// Emitted when the loading has finished.
+    /** @param success False if the file was malformed or an entity could not be created.
+        @param entities The created entities. */
+    void Finished(bool success, const QList<Entity *> &entities);
+
+private slots:
+    void OnUpdated(float frameTime);
+
+private:
+    enum State
+    {
+        Idle,
+        Indexing,
+        Creating,
+        Signaling,
+        Done
+    };
+
+    /// Emits Finished and schedules the loader for deletion.
+    void Finish(bool success);
+
+    SceneWeakPtr scene_;
+    Framework *framework_;
+    QString filename_;
+    bool useEntityIDsFromFile_;
+    AttributeChange::Type change_;
+    float timeBudgetMsecs_;
+    State state_;
+
+    SceneBinaryFile file_;
+    SceneBinaryIndex index_;
+    QThread *indexThread_;
+    bool indexOk_;
+    QString indexError_;
+
+    size_t next_; ///< Index of the next entity to create or signal.
+    std::vector<EntityWeakPtr> entities_;
+    QHash<entity_id_t, entity_id_t> oldToNewIds_;
+
+    friend class SceneBinaryIndexThread;
+};
@@ -25,6 +25,7 @@ struct ComponentDesc;
 struct AttributeDesc;
 struct AssetDesc;
 struct EntityReference;
+struct DeferredAttributeChange;
 
 typedef shared_ptr<Scene> ScenePtr;
 typedef weak_ptr<Scene> SceneWeakPtr;
@@ -36,3 +37,4 @@ typedef weak_ptr<IComponent> ComponentWeakPtr;
 typedef shared_ptr<IComponentFactory> ComponentFactoryPtr;
 typedef std::vector<IAttribute*> AttributeVector;
 typedef std::map<QString, ScenePtr> SceneMap;
+typedef std::vector<DeferredAttributeChange> DeferredAttributeChangeList;
@@ -0,0 +1,98 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Math/float3.h"
+
+#include <vector>
+#include <cmath>
+
+/// Uniform spatial hash grid, which stores only its non-empty cells in a hash map, so it has no fixed bounds.
+/** The user decides what a cell holds and how its contents are kept up to date: the grid maps positions to cell keys,
+    and finds the cells that may hold positions near a point. Used by InterestManager and EC_ProximityTrigger.
+    @tparam Cell Contents of a cell, for example a vector of entries. */
+template<typename Cell>
+class SpatialHashGrid
+{
+public:
+    typedef unordered_map<u64, Cell> CellMap;
+
+    explicit SpatialHashGrid(float cellSize = 1.f) :
+        cellSize_(1.f),
+        invCellSize_(1.f)
+    {
+        SetCellSize(cellSize);
+    }
+
+    /// Returns the edge length of the cells.
+    float CellSize() const { return cellSize_; }
+    /// Sets the edge length of the cells, and removes all cells. The contents have to be inserted again.
+    /** A non-positive size is replaced with 1. */
+    void SetCellSize(float cellSize)
+    {
+        if (!(cellSize > 0.f))
+            cellSize = 1.f;
+        cellSize_ = cellSize;
+        invCellSize_ = 1.f / cellSize;
+        cells_.clear();
+    }
+
+    /// Returns the key of the cell containing @c pos. Positions beyond the range of the keys map to the outermost cells.
+    u64 CellKey(const float3 &pos) const { return CellKey(CellCoord(pos.x), CellCoord(pos.y), CellCoord(pos.z)); }
+
+    /// Returns the non-empty cells. Empty cells should be erased, as they slow down the queries.
+    CellMap &Cells() { return cells_; }
+    const CellMap &Cells() const { return cells_; } ///< @overload
+
+    /// Appends to @c result the cells that may hold positions within @c radius of @c center.
+    void CellsNear(const float3 &center, float radius, std::vector<const Cell*> &result) const
+    {
+        const int minX = CellCoord(center.x - radius), maxX = CellCoord(center.x + radius);
+        const int minY = CellCoord(center.y - radius), maxY = CellCoord(center.y + radius);
+        const int minZ = CellCoord(center.z - radius), maxZ = CellCoord(center.z + radius);
+
+        // If the query box covers more cells than there are non-empty cells, it is cheaper to scan the non-empty cells.
+        const double numBoxCells = (double)(maxX - minX + 1) * (double)(maxY - minY + 1) * (double)(maxZ - minZ + 1);
+        if (numBoxCells > (double)cells_.size())
+        {
+            for(typename CellMap::const_iterator i = cells_.begin(); i != cells_.end(); ++i)
+                result.push_back(&i->second);
+            return;
+        }
+
+        for(int x = minX; x <= maxX; ++x)
+            for(int y = minY; y <= maxY; ++y)
+                for(int z = minZ; z <= maxZ; ++z)
+                {
+                    typename CellMap::const_iterator i = cells_.find(CellKey(x, y, z));
+                    if (i != cells_.end())
+                        result.push_back(&i->second);
+                }
+    }
+
+private:
+    /// Cell coordinates are clamped to 21 bits so that three of them fit in a 64-bit key.
+    static const int cCellCoordBias = 1 << 20;
+
+    /// Returns the cell coordinate of a position component.
+    int CellCoord(float x) const
+    {
+        float c = floor(x * invCellSize_);
+        if (c < (float)-cCellCoordBias)
+            return -cCellCoordBias;
+        if (c > (float)(cCellCoordBias - 1))
+            return cCellCoordBias - 1;
+        return (int)c;
+    }
+
+    /// Packs cell coordinates into a cell key.
+    static u64 CellKey(int x, int y, int z)
+    {
+        return ((u64)(x + cCellCoordBias) << 42) | ((u64)(y + cCellCoordBias) << 21) | (u64)(z + cCellCoordBias);
+    }
+
+    float cellSize_;
+    float invCellSize_;
+    CellMap cells_;
+};
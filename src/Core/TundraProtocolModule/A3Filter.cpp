@@ -9,6 +9,8 @@
 #include "LoggingFunctions.h"
 #include "Profiler.h"
 
+#include <algorithm>
+
 A3Filter::A3Filter(InterestManager *im, int criticalrange, int maxrange, int updateinterval, bool enabled) :
     im_(im),
     MessageFilter(A3, enabled)
@@ -28,6 +30,15 @@ QString A3Filter::ToString()
     return QString("A3");
 }
 
+float A3Filter::Range()
+{
+    float critical = euclideandistance_->Range();
+    float relevance = relevance_->Range();
+    if (!enabled_ || critical < 0 || relevance < 0)
+        return -1.f;
+    return std::max(critical, relevance);
+}
+
 bool A3Filter::Filter(const IMParameters& params)
 {
     if(enabled_)
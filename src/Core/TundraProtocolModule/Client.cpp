@@ -161,6 +161,8 @@ void Client::Login(const QString& address, unsigned short port, kNet::SocketTran
     SetLoginProperty("client-version", Application::Version());
     SetLoginProperty("client-name", Application::ApplicationName());
     SetLoginProperty("client-organization", Application::OrganizationName());
+    // This client can receive the scene as a SceneSnapshot when joining, see SyncManager::SetSceneSnapshot.
+    SetLoginProperty("client-scene-snapshot", "1");
 
     KristalliProtocolModule *kristalli = framework_->GetModule<KristalliProtocolModule>();
     connect(kristalli, SIGNAL(NetworkMessageReceived(kNet::MessageConnection *, kNet::packet_id_t, kNet::message_id_t, const char *, size_t)), 
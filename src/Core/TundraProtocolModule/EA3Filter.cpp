@@ -10,6 +10,8 @@
 #include "LoggingFunctions.h"
 #include "Profiler.h"
 
+#include <algorithm>
+
 EA3Filter::EA3Filter(InterestManager *im, int criticalrange, int maxrange, int raycastinterval, int updateinterval, bool enabled) :
     im_(im),
     MessageFilter(EA3, enabled)
@@ -31,6 +33,16 @@ QString EA3Filter::ToString()
     return QString("EA3");
 }
 
+float EA3Filter::Range()
+{
+    // Ray visibility is always followed by the relevance filter, so the relevance range bounds both.
+    float critical = euclideandistance_->Range();
+    float relevance = relevance_->Range();
+    if (!enabled_ || critical < 0 || relevance < 0)
+        return -1.f;
+    return std::max(critical, relevance);
+}
+
 bool EA3Filter::Filter(const IMParameters& params)
 {  
     if(enabled_)
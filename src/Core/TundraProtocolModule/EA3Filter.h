@@ -17,6 +17,8 @@ public:
 
     bool Filter(const IMParameters& params);
 
+    float Range();
+
     QString ToString();
 
 private:
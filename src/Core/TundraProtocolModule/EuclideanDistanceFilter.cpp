@@ -18,6 +18,11 @@ QString EuclideanDistanceFilter::ToString()
     return QString("Euclidean distance");
 }
 
+float EuclideanDistanceFilter::Range()
+{
+    return enabled_ ? (float)radius_ : -1.f;
+}
+
 bool EuclideanDistanceFilter::Filter(const IMParameters& params)
 {
     if(enabled_)
@@ -0,0 +1,102 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "InterestGrid.h"
+
+#include <cassert>
+
+InterestGrid::InterestGrid(float cellSize) :
+    grid_(cellSize)
+{
+}
+
+void InterestGrid::SetCellSize(float cellSize)
+{
+    if (!(cellSize > 0.f))
+        cellSize = 1.f;
+    if (cellSize == grid_.CellSize())
+        return;
+
+    std::vector<Entry> entries;
+    entries.reserve(locations_.size());
+    for(unordered_map<u64, Cell>::const_iterator i = grid_.Cells().begin(); i != grid_.Cells().end(); ++i)
+        entries.insert(entries.end(), i->second.begin(), i->second.end());
+
+    Clear();
+    grid_.SetCellSize(cellSize);
+    for(size_t i = 0; i < entries.size(); ++i)
+        Update(entries[i].id, entries[i].pos);
+}
+
+void InterestGrid::Update(entity_id_t id, const float3 &pos)
+{
+    if (!pos.IsFinite())
+    {
+        Remove(id);
+        return;
+    }
+
+    u64 key = grid_.CellKey(pos);
+    unordered_map<entity_id_t, Location>::iterator loc = locations_.find(id);
+    if (loc != locations_.end())
+    {
+        if (loc->second.cell == key)
+        {
+            grid_.Cells()[key][loc->second.index].pos = pos;
+            return;
+        }
+        Remove(id);
+    }
+
+    Cell &cell = grid_.Cells()[key];
+    Location newLoc;
+    newLoc.cell = key;
+    newLoc.index = (u32)cell.size();
+    Entry entry;
+    entry.id = id;
+    entry.pos = pos;
+    cell.push_back(entry);
+    locations_[id] = newLoc;
+}
+
+void InterestGrid::Remove(entity_id_t id)
+{
+    unordered_map<entity_id_t, Location>::iterator loc = locations_.find(id);
+    if (loc == locations_.end())
+        return;
+
+    unordered_map<u64, Cell>::iterator cellIter = grid_.Cells().find(loc->second.cell);
+    assert(cellIter != grid_.Cells().end());
+    Cell &cell = cellIter->second;
+    u32 index = loc->second.index;
+    if (index + 1 < cell.size())
+    {
+        // Move the last entity of the cell to the freed position.
+        cell[index] = cell.back();
+        locations_[cell[index].id].index = index;
+    }
+    cell.pop_back();
+    if (cell.empty())
+        grid_.Cells().erase(cellIter);
+    locations_.erase(loc);
+}
+
+void InterestGrid::Clear()
+{
+    grid_.Cells().clear();
+    locations_.clear();
+}
+
+void InterestGrid::QuerySphere(const float3 &center, float radius, std::vector<Entry> &result) const
+{
+    if (grid_.Cells().empty() || !center.IsFinite() || !(radius >= 0.f))
+        return;
+
+    const float radiusSq = radius * radius;
+    std::vector<const Cell*> cells;
+    grid_.CellsNear(center, radius, cells);
+    for(size_t i = 0; i < cells.size(); ++i)
+        for(Cell::const_iterator j = cells[i]->begin(); j != cells[i]->end(); ++j)
+            if (j->pos.DistanceSq(center) <= radiusSq)
+                result.push_back(*j);
+}
@@ -0,0 +1,58 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraProtocolModuleApi.h"
+#include "CoreTypes.h"
+#include "SceneFwd.h"
+#include "SpatialHashGrid.h"
+#include "Math/float3.h"
+
+#include <vector>
+
+/// Uniform hash grid of entity positions, used by InterestManager for range queries.
+/** Only non-empty cells are stored, so the grid has no fixed bounds. Moving an entity within its cell only updates
+    the stored position, moving it to another cell is a constant time swap-remove and append.
+    @remarks InterestManager functionality */
+class TUNDRAPROTOCOL_MODULE_API InterestGrid
+{
+public:
+    struct Entry
+    {
+        entity_id_t id;
+        float3 pos;
+    };
+
+    explicit InterestGrid(float cellSize = 50.f);
+
+    /// Returns the edge length of the grid cells.
+    float CellSize() const { return grid_.CellSize(); }
+    /// Sets the edge length of the grid cells, and re-inserts all entities.
+    /** Queries are fastest when the cell size is about the query radius. */
+    void SetCellSize(float cellSize);
+
+    /// Inserts an entity, or updates its position. Entities with a non-finite position are removed.
+    void Update(entity_id_t id, const float3 &pos);
+    /// Removes an entity. Does nothing if the entity is not in the grid.
+    void Remove(entity_id_t id);
+    /// Removes all entities.
+    void Clear();
+
+    /// Returns number of entities in the grid.
+    size_t Size() const { return locations_.size(); }
+
+    /// Appends all entities within @c radius of @c center to @c result.
+    void QuerySphere(const float3 &center, float radius, std::vector<Entry> &result) const;
+
+private:
+    typedef std::vector<Entry> Cell;
+
+    struct Location
+    {
+        u64 cell;
+        u32 index; ///< Index of the entity in the cell.
+    };
+
+    SpatialHashGrid<Cell> grid_;
+    unordered_map<entity_id_t, Location> locations_;
+};
@@ -11,9 +11,15 @@
 
 InterestManager* InterestManager::thisPointer_ = NULL;
 
+/// Margin of the interest sets, relative to the filter range.
+static const float cInterestMarginFactor = 0.25f;
+
 InterestManager::InterestManager()
 {
     activeFilter_ = 0;
+    tick_ = 0;
+    interestMargin_ = 0.f;
+    raycastBudget_ = 2.f;
     timer_ = new QTime();
     timer_->start();
 }
@@ -38,6 +44,14 @@ InterestManager* InterestManager::getInstance()
 void InterestManager::AssignFilter(MessageFilter *filter)
 {
     activeFilter_ = filter;
+
+    // The interest sets were computed for the range of the previous filter.
+    NextTick();
+
+    // Cells of about the query size keep the queries to a few cells.
+    float range = activeFilter_ ? activeFilter_->Range() : -1.f;
+    if (range > 0)
+        grid_.SetCellSize(range);
 }
 
 int InterestManager::ElapsedTime()
@@ -59,6 +73,14 @@ bool InterestManager::CheckRelevance(UserConnectionPtr conn, Entity* changed_ent
     if(!conn->syncState->locationInitialized || !entity_location) //If the client hasn't informed the server about the orientation yet, do not proceed
         return true;
 
+    // If the batched pass of this tick covered this user, entities out of range would be rejected by the filter anyway.
+    // The set is only trusted if neither the user nor the entity has moved out of the margin it was computed with.
+    const EntityInterestTable &interest = conn->syncState->interest;
+    if(tick_ != 0 && interest.InterestTick() == tick_ && !interest.InRange(changed_entity->Id()) &&
+        interest.InterestCenter().DistanceSq(conn->syncState->clientLocation) <= interestMargin_ * interestMargin_ &&
+        !MovedSinceInterestSets(changed_entity->Id()))
+        return false;
+
     bool accepted = false;  //By default, we assume that the update will be rejected
 
     Quat client_orientation = conn->syncState->clientOrientation.Normalized();
@@ -86,56 +108,118 @@ bool InterestManager::CheckRelevance(UserConnectionPtr conn, Entity* changed_ent
     return accepted;
 }
 
-void InterestManager::UpdateRelevance(UserConnectionPtr conn, entity_id_t id, float relevance)
+void InterestManager::UpdateInterestSets(UserConnectionList &users)
 {
-    std::map<entity_id_t, float>::iterator it = conn->syncState->relevanceFactors.find(id);
-    if(it == conn->syncState->relevanceFactors.end()) //Theres no entry with this entity_id
-        conn->syncState->relevanceFactors.insert(std::make_pair(id, relevance));
+    PROFILE(Interest_Management_UpdateInterestSets);
+
+    NextTick();
+
+    // If the filter is not range-limited, no user gets an interest set on this tick, and every entity goes through the filter.
+    float range = activeFilter_ ? activeFilter_->Range() : -1.f;
+    if (range < 0)
+        return;
+
+    // The sets include a margin, so that they stay valid while the users move less than it before the next pass.
+    interestMargin_ = range * cInterestMarginFactor;
+
+    for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
+    {
+        SceneSyncState *state = (*i)->syncState.get();
+        if (!state || !state->locationInitialized)
+            continue;
+
+        nearby_.clear();
+        grid_.QuerySphere(state->clientLocation, range + interestMargin_, nearby_);
+
+        state->interest.BeginInterestSet(tick_, state->clientLocation);
+        for(size_t j = 0; j < nearby_.size(); ++j)
+            state->interest.SetInRange(nearby_[j].id, tick_);
+    }
+}
+
+void InterestManager::UpdateEntityPosition(Entity *entity)
+{
+    EC_Placeable *placeable = entity->GetComponent<EC_Placeable>().get();
+    if (placeable)
+        grid_.Update(entity->Id(), placeable->transform.Get().pos);
     else
-        it->second = relevance;
+        grid_.Remove(entity->Id());
+    positionTicks_[entity->Id()] = tick_;
+}
+
+void InterestManager::RemoveEntityPosition(entity_id_t id)
+{
+    grid_.Remove(id);
+    positionTicks_.erase(id);
+}
+
+bool InterestManager::MovedSinceInterestSets(entity_id_t id) const
+{
+    unordered_map<entity_id_t, u32>::const_iterator i = positionTicks_.find(id);
+    return i == positionTicks_.end() || i->second == tick_;
+}
+
+void InterestManager::NextTick()
+{
+    ++tick_;
+    if (tick_ == 0)
+        tick_ = 1;
+}
+
+void InterestManager::RebuildSpatialIndex(ScenePtr scene)
+{
+    PROFILE(Interest_Management_RebuildSpatialIndex);
+
+    grid_.Clear();
+    positionTicks_.clear();
+    if (!scene)
+        return;
+
+    for(Scene::iterator iter = scene->begin(); iter != scene->end(); ++iter)
+        if (!iter->second->IsLocal())
+            UpdateEntityPosition(iter->second.get());
+}
+
+void InterestManager::RequestVisibilityTest(UserConnectionPtr conn, entity_id_t id)
+{
+    visibilityQueue_.Request(conn, id);
+}
+
+void InterestManager::ProcessVisibilityTests(ScenePtr scene, bool headless)
+{
+    if (visibilityQueue_.Size() == 0)
+        return;
+
+    PROFILE(Interest_Management_VisibilityTests);
+    visibilityQueue_.Process(this, scene, headless, raycastBudget_);
+}
+
+void InterestManager::UpdateRelevance(UserConnectionPtr conn, entity_id_t id, float relevance)
+{
+    conn->syncState->interest.SetRelevance(id, relevance);
 }
 
 void InterestManager::UpdateEntityVisibility(UserConnectionPtr conn, entity_id_t id, bool visible)
 {
-    std::map<entity_id_t, bool>::iterator it = conn->syncState->visibleEntities.find(id);
-    if(it == conn->syncState->visibleEntities.end()) //Theres no entry with this entity_id
-        conn->syncState->visibleEntities.insert(std::make_pair(id, visible));
-    else
-        it->second = visible;
+    conn->syncState->interest.SetEntityVisible(id, visible);
 }
 
 void InterestManager::UpdateLastUpdatedEntity(UserConnectionPtr conn, entity_id_t id)
 {
-    std::map<entity_id_t, float>::iterator it = conn->syncState->lastUpdatedEntitys_.find(id);
-    if(it == conn->syncState->lastUpdatedEntitys_.end())
-        conn->syncState->lastUpdatedEntitys_.insert(std::make_pair(id, (float)ElapsedTime()));
-    else
-        it->second = (float)ElapsedTime();
+    conn->syncState->interest.SetLastUpdated(id, (float)ElapsedTime());
 }
 
 float InterestManager::FindLastUpdatedEntity(UserConnectionPtr conn, entity_id_t id)
 {
-    std::map<entity_id_t, float>::iterator it = conn->syncState->lastUpdatedEntitys_.find(id);
-    if(it == conn->syncState->lastUpdatedEntitys_.end())
-        return 0;
-    else
-        return it->second;
+    return conn->syncState->interest.LastUpdated(id);
 }
 
 void InterestManager::UpdateLastRaycastedEntity(UserConnectionPtr conn, entity_id_t id)
 {
-    std::map<entity_id_t, float>::iterator it = conn->syncState->lastRaycastedEntitys_.find(id);
-    if(it == conn->syncState->lastRaycastedEntitys_.end())
-        conn->syncState->lastRaycastedEntitys_.insert(std::make_pair(id, (float)ElapsedTime()));
-    else
-        it->second = (float)ElapsedTime();
+    conn->syncState->interest.SetLastRaycasted(id, (float)ElapsedTime());
 }
 
 float InterestManager::FindLastRaycastedEntity(UserConnectionPtr conn, entity_id_t id)
 {
-    std::map<entity_id_t, float>::iterator it = conn->syncState->lastRaycastedEntitys_.find(id);
-    if(it == conn->syncState->lastRaycastedEntitys_.end())
-        return 0;
-    else
-        return it->second;
+    return conn->syncState->interest.LastRaycasted(id);
 }
@@ -10,8 +10,8 @@
 #include "EuclideanDistanceFilter.h"
 #include "RayVisibilityFilter.h"
 #include "RelevanceFilter.h"
-
-#define IM_DEBUG
+#include "InterestGrid.h"
+#include "RayVisibilityQueue.h"
 
 class InterestManager
 {
@@ -28,8 +28,38 @@ public:
     void AssignFilter(MessageFilter *filter);
 
     /// Main entrance method for the filtering process
+    /** If the user was included in the latest UpdateInterestSets pass, entities which were out of the filter's range
+        are rejected right away, and the filter chain is only run for the entities in range. Entities which have moved
+        since the pass, and all entities of users which have moved farther than the margin of the pass, go through the
+        filter chain. */
     bool CheckRelevance(UserConnectionPtr userconnection, Entity* changed_entity, SceneWeakPtr scene, bool headless);
 
+    /// Computes the set of in-range entities for each user with a known location, with one spatial query per user.
+    /** Call once per network tick, before the attribute changes of the tick are checked with CheckRelevance.
+        The sets extend a margin beyond the filter range, so that they stay valid while the users move within it. */
+    void UpdateInterestSets(UserConnectionList &users);
+
+    /// Updates the position of an entity in the spatial index from its EC_Placeable, or removes it if it has no placeable.
+    void UpdateEntityPosition(Entity *entity);
+
+    /// Removes an entity from the spatial index.
+    void RemoveEntityPosition(entity_id_t id);
+
+    /// Rebuilds the spatial index from all entities of the scene.
+    void RebuildSpatialIndex(ScenePtr scene);
+
+    /// Queues a visibility raycast from the user to the entity, unless one is already pending.
+    void RequestVisibilityTest(UserConnectionPtr conn, entity_id_t id);
+
+    /// Runs queued visibility raycasts within the raycast time budget. Call once per frame.
+    void ProcessVisibilityTests(ScenePtr scene, bool headless);
+
+    /// Sets the time in milliseconds that visibility raycasts may take per frame.
+    void SetRaycastBudget(float msecs) { raycastBudget_ = msecs; }
+
+    /// Returns the time in milliseconds that visibility raycasts may take per frame.
+    float RaycastBudget() const { return raycastBudget_; }
+
     /// Returns the current active filtering time in milliseconds
     int ElapsedTime();
 
@@ -56,6 +86,12 @@ private:
     /// Private constructor because singleton instance is gotten from getInstance()
     InterestManager();
 
+    /// Returns whether the position of an entity has been updated, or is not known, since the latest UpdateInterestSets pass.
+    bool MovedSinceInterestSets(entity_id_t id) const;
+
+    /// Advances the tick, invalidating the interest sets of all users.
+    void NextTick();
+
     /// Pointer to this singleton class
     static InterestManager* thisPointer_;
 
@@ -67,4 +103,25 @@ private:
 
     /// Parameters used by the filtering process
     IMParameters params_;
+
+    /// Spatial index of the entity positions, maintained incrementally by SyncManager.
+    InterestGrid grid_;
+
+    /// Number of UpdateInterestSets passes done. 0 means none.
+    u32 tick_;
+
+    /// Distance beyond the filter range the interest sets of the latest pass extend to.
+    float interestMargin_;
+
+    /// The tick on which the position of each entity in the spatial index was last updated.
+    unordered_map<entity_id_t, u32> positionTicks_;
+
+    /// Scratch buffer for spatial queries.
+    std::vector<InterestGrid::Entry> nearby_;
+
+    /// Pending visibility raycasts of RayVisibilityFilter.
+    RayVisibilityQueue visibilityQueue_;
+
+    /// Time in milliseconds that visibility raycasts may take per frame.
+    float raycastBudget_;
 };
@@ -45,6 +45,10 @@ public:
 
     virtual bool Filter(const IMParameters& params) = 0;
 
+    /// Returns the distance beyond which the filter rejects all updates, or a negative value if the filter is not range-limited.
+    /** Used by InterestManager to skip the filter for entities that are out of range of the client. */
+    virtual float Range()               { return -1.f; }
+
     virtual void SetEnabled(bool e)     { enabled_ = e; }
     virtual bool Enabled()              { return enabled_; }
     virtual IMFilter Info()             { return type_; }
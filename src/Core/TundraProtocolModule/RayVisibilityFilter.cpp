@@ -2,14 +2,7 @@
 
 #include "StableHeaders.h"
 
-#include "map"
-
-#include "Geometry/Ray.h"
-#include "EC_Camera.h"
-#include "EC_Placeable.h"
 #include "Entity.h"
-#include "OgreWorld.h"
-#include "Scene.h"
 #include "InterestManager.h"
 #include "RayVisibilityFilter.h"
 #include "LoggingFunctions.h"
@@ -35,65 +28,20 @@ bool RayVisibilityFilter::Filter(const IMParameters& params)
     {
         float cutoffrange = range_ * range_;
 
-        if(params.headless)
-            return true;
-
-        if(params.distance < cutoffrange)  //If the entity is close enough, only then do a raycast
+        if(params.distance < cutoffrange)  //If the entity is close enough, only then check the visibility
         {
-            std::map<entity_id_t, bool>::iterator it;
+            entity_id_t id = params.changed_entity->Id();
+            EntityInterestTable::Visibility visibility = params.connection->syncState->interest.EntityVisibility(id);
 
-            it = params.connection->syncState->visibleEntities.find(params.changed_entity->Id());
-
-            /*Check when was the last time we raycasted and dont do it if its not the time*/
-            int lastRaycasted = im_->FindLastRaycastedEntity(params.connection, params.changed_entity->Id());
+            /*Request a new raycast if the entity has not been raycasted yet, or the last result is too old. The raycasts are done
+              later by the InterestManager within a per-frame time budget, so meanwhile the last known result is used.*/
+            int lastRaycasted = im_->FindLastRaycastedEntity(params.connection, id);
             int currentTime = im_->ElapsedTime();
 
-            if(it != params.connection->syncState->visibleEntities.end() && (lastRaycasted + raycastinterval_) > currentTime)   //If the entity is located from the map
-            {
-                if(it->second == true) //bool which contains a value determining if the entity was visible to the user last time it was raycasted
-                {
-#ifdef IM_DEBUG
-                    if(params.connection->ConnectionId() == 1)
-                        ::LogInfo("Not the time to raycast, returning true. Last " + QString::number(lastRaycasted + raycastinterval_) + " Current " + QString::number(currentTime));
-#endif
-                    return true;
-                }
-                else
-                {
-#ifdef IM_DEBUG
-                    if(params.connection->ConnectionId() == 1)
-                        ::LogInfo("Not the time to raycast, returning false. Last " + QString::number(lastRaycasted + raycastinterval_) + " Current " + QString::number(currentTime));
-#endif
-                    return false;
-                }
-            }
-
-            else
-            {
-                Ray ray(params.client_position, (params.entity_position - params.client_position).Normalized());
-                RaycastResult *result = 0;
-                OgreWorldPtr w = params.scene->GetWorld<OgreWorld>();
-
-                result = w->Raycast(ray, 0xFFFFFFFF);
-                im_->UpdateLastRaycastedEntity(params.connection, params.changed_entity->Id());
-
-                if(result && result->entity && result->entity->Id() == params.changed_entity->Id())  //If the ray hit someone and its our target entity
-                {
-                    im_->UpdateEntityVisibility(params.connection, params.changed_entity->Id(), true);
-#ifdef IM_DEBUG
-                    ::LogInfo("Entity " + QString::number(params.changed_entity->Id()) + " is visible to connection " + QString::number(params.connection->ConnectionId()));
-#endif
-                    return true;
-                }
-                else
-                {
-                    im_->UpdateEntityVisibility(params.connection, params.changed_entity->Id(), false);
-                    im_->UpdateRelevance(params.connection, params.changed_entity->Id(), 0);
-                    return false;
-                }
-
-            }
+            if(visibility == EntityInterestTable::VisibilityUnknown || (lastRaycasted + raycastinterval_) <= currentTime)
+                im_->RequestVisibilityTest(params.connection, id);
 
+            return visibility != EntityInterestTable::Hidden; //Until the first result is known, let the updates through
         }
         else
             return false;
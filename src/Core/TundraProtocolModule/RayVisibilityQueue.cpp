@@ -0,0 +1,115 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "RayVisibilityQueue.h"
+#include "InterestManager.h"
+#include "UserConnection.h"
+#include "SyncState.h"
+#include "Scene/Scene.h"
+#include "Entity.h"
+#include "EC_Placeable.h"
+#include "OgreWorld.h"
+#include "PhysicsWorld.h"
+#include "IRenderer.h"
+#include "Geometry/Ray.h"
+#include "LoggingFunctions.h"
+#include "Profiler.h"
+
+RayVisibilityQueue::RayVisibilityQueue() :
+    noBackendWarned_(false)
+{
+}
+
+void RayVisibilityQueue::Request(const UserConnectionPtr &connection, entity_id_t id)
+{
+    EntityInterestTable &interest = connection->syncState->interest;
+    if (interest.RaycastPending(id))
+        return;
+
+    interest.SetRaycastPending(id, true);
+    Query query;
+    query.connection = connection;
+    query.entityId = id;
+    queue_.push_back(query);
+}
+
+void RayVisibilityQueue::Clear()
+{
+    queue_.clear();
+}
+
+size_t RayVisibilityQueue::Process(InterestManager *im, const ScenePtr &scene, bool headless, float timeBudgetMsecs)
+{
+    if (queue_.empty() || !scene)
+        return 0;
+
+    PhysicsWorld *physics = scene->GetWorld<PhysicsWorld>().get();
+    OgreWorld *renderer = headless ? 0 : scene->GetWorld<OgreWorld>().get();
+    if (!physics && !renderer && !noBackendWarned_)
+    {
+        LogWarning("[InterestManager] No physics world in the scene, ray visibility tests consider all entities visible.");
+        noBackendWarned_ = true;
+    }
+
+    const tick_t start = GetCurrentClockTime();
+    const tick_t budget = (tick_t)(timeBudgetMsecs * GetCurrentClockFreq() / 1000.0);
+    size_t numTests = 0;
+    while(!queue_.empty())
+    {
+        if (numTests > 0 && GetCurrentClockTime() - start >= budget)
+            break;
+
+        Query query = queue_.front();
+        queue_.pop_front();
+
+        UserConnectionPtr connection = query.connection.lock();
+        if (!connection || !connection->syncState)
+            continue; // The user has left.
+        SceneSyncState *state = connection->syncState.get();
+
+        EntityPtr entity = scene->GetEntity(query.entityId);
+        if (!entity)
+        {
+            state->interest.SetRaycastPending(query.entityId, false);
+            continue; // The entity has been removed.
+        }
+
+        // Entities which cannot be tested are considered visible, so that the filter does not request them again right away.
+        // The target is the same position the filters and the spatial index use.
+        EC_Placeable *placeable = entity->GetComponent<EC_Placeable>().get();
+        bool visible = true;
+        if (placeable && state->locationInitialized)
+        {
+            visible = IsVisible(physics, renderer, state->clientLocation, entity.get(), placeable->transform.Get().pos);
+            ++numTests;
+        }
+
+        im->UpdateLastRaycastedEntity(connection, query.entityId);
+        im->UpdateEntityVisibility(connection, query.entityId, visible);
+        if (!visible)
+            im->UpdateRelevance(connection, query.entityId, 0);
+        state->interest.SetRaycastPending(query.entityId, false);
+    }
+    return numTests;
+}
+
+bool RayVisibilityQueue::IsVisible(PhysicsWorld *physics, OgreWorld *renderer, const float3 &origin, Entity *target, const float3 &targetPos) const
+{
+    float3 dir = targetPos - origin;
+    float distance = dir.Length();
+    if (distance < 1e-3f)
+        return true;
+
+    if (physics)
+    {
+        // Visible if nothing is hit before the target. Entities without a collision shape are not hit themselves.
+        PhysicsRaycastResult *result = physics->Raycast(origin, dir, distance);
+        return !result || !result->entity || result->entity == target;
+    }
+    if (renderer)
+    {
+        RaycastResult *result = renderer->Raycast(Ray(origin, dir / distance), 0xFFFFFFFF);
+        return result && result->entity == target;
+    }
+    return true;
+}
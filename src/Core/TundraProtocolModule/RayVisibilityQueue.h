@@ -0,0 +1,55 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraProtocolModuleApi.h"
+#include "TundraProtocolModuleFwd.h"
+#include "CoreTypes.h"
+#include "SceneFwd.h"
+#include "Math/float3.h"
+
+#include <deque>
+
+class InterestManager;
+class PhysicsWorld;
+class OgreWorld;
+
+/// Queue of pending user-to-entity visibility raycasts of RayVisibilityFilter.
+/** The filter only requests tests, and answers from the results cached in the user's EntityInterestTable. The tests
+    are run later in Process(), in request order, until the time budget of the frame runs out.
+    Rays are cast against the Bullet PhysicsWorld of the scene, so that the tests also work on a headless server.
+    If the scene has no physics world, the renderer (OgreWorld) is used when not running headless.
+    @remarks InterestManager functionality */
+class TUNDRAPROTOCOL_MODULE_API RayVisibilityQueue
+{
+public:
+    RayVisibilityQueue();
+
+    /// Queues a visibility test of the entity for the user. Does nothing if a test for the pair is already pending.
+    void Request(const UserConnectionPtr &connection, entity_id_t id);
+
+    /// Runs queued tests until the queue is empty or @c timeBudgetMsecs has elapsed. At least one test is run.
+    /** The results are stored through @c im to the users' EntityInterestTables. Entities without a placeable, and
+        entities of users whose location is not known yet, are recorded as visible without a raycast.
+        @return Number of tests run. */
+    size_t Process(InterestManager *im, const ScenePtr &scene, bool headless, float timeBudgetMsecs);
+
+    /// Returns number of pending tests.
+    size_t Size() const { return queue_.size(); }
+
+    /// Forgets all pending tests.
+    void Clear();
+
+private:
+    struct Query
+    {
+        UserConnectionWeakPtr connection;
+        entity_id_t entityId;
+    };
+
+    /// Returns whether @c target is visible from @c origin.
+    bool IsVisible(PhysicsWorld *physics, OgreWorld *renderer, const float3 &origin, Entity *target, const float3 &targetPos) const;
+
+    std::deque<Query> queue_;
+    bool noBackendWarned_;
+};
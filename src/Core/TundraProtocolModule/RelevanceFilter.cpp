@@ -22,6 +22,11 @@ QString RelevanceFilter::ToString()
     return QString("Relevance");
 }
 
+float RelevanceFilter::Range()
+{
+    return enabled_ ? (float)range_ : -1.f;
+}
+
 bool RelevanceFilter::Filter(const IMParameters& params)
 {   
     if(enabled_)
@@ -0,0 +1,173 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "SceneSnapshot.h"
+
+#include <kNet/DataSerializer.h>
+#include <kNet/DataDeserializer.h>
+#include <kNet/NetException.h>
+
+/// Size of the records in a chunk in bytes, after which new records go to another chunk. A larger record gets a chunk of its own.
+static const size_t cChunkSize = 32 * 1024;
+/// Maximum size of the record length prefix in a chunk.
+static const size_t cMaxLengthPrefixSize = 4;
+
+SceneSnapshot::SceneSnapshot() :
+    version_(0),
+    needsRebuild_(true)
+{
+}
+
+void SceneSnapshot::Clear()
+{
+    chunks_.clear();
+    chunkOfEntity_.clear();
+    dirty_.clear();
+    ++version_;
+    needsRebuild_ = true;
+}
+
+void SceneSnapshot::TakeDirty(std::vector<entity_id_t> &ids)
+{
+    ids.insert(ids.end(), dirty_.begin(), dirty_.end());
+    dirty_.clear();
+}
+
+void SceneSnapshot::SetRecord(entity_id_t id, const char *data, size_t numBytes)
+{
+    std::map<entity_id_t, size_t>::iterator iter = chunkOfEntity_.find(id);
+    if (iter != chunkOfEntity_.end())
+    {
+        // Replace in place if the chunk still has room, otherwise move the record to another chunk.
+        Chunk &chunk = chunks_[iter->second];
+        QByteArray &record = chunk.records[id];
+        const size_t rawSize = chunk.rawSize - (size_t)record.size() + numBytes;
+        if (rawSize <= cChunkSize || chunk.records.size() == 1)
+        {
+            chunk.rawSize = rawSize;
+            record = QByteArray(data, (int)numBytes);
+            chunk.changed = true;
+            return;
+        }
+        RemoveRecord(id);
+    }
+
+    size_t index = ChunkWithRoom(numBytes);
+    Chunk &chunk = chunks_[index];
+    chunk.records[id] = QByteArray(data, (int)numBytes);
+    chunk.rawSize += numBytes;
+    chunk.changed = true;
+    chunkOfEntity_[id] = index;
+}
+
+void SceneSnapshot::RemoveRecord(entity_id_t id)
+{
+    std::map<entity_id_t, size_t>::iterator iter = chunkOfEntity_.find(id);
+    if (iter == chunkOfEntity_.end())
+        return;
+    Chunk &chunk = chunks_[iter->second];
+    std::map<entity_id_t, QByteArray>::iterator record = chunk.records.find(id);
+    if (record != chunk.records.end())
+    {
+        chunk.rawSize -= (size_t)record->second.size();
+        chunk.records.erase(record);
+    }
+    chunk.changed = true;
+    chunkOfEntity_.erase(iter);
+}
+
+size_t SceneSnapshot::ChunkWithRoom(size_t numBytes)
+{
+    // Fill the last chunk first, then reuse the chunks emptied by removals.
+    if (!chunks_.empty() && (chunks_.back().records.empty() || chunks_.back().rawSize + numBytes <= cChunkSize))
+        return chunks_.size() - 1;
+    for(size_t i = 0; i < chunks_.size(); ++i)
+        if (chunks_[i].records.empty())
+            return i;
+    chunks_.push_back(Chunk());
+    return chunks_.size() - 1;
+}
+
+void SceneSnapshot::Compress()
+{
+    bool changed = false;
+    std::vector<char> buffer;
+    for(size_t i = 0; i < chunks_.size(); ++i)
+    {
+        Chunk &chunk = chunks_[i];
+        if (!chunk.changed)
+            continue;
+        chunk.changed = false;
+        changed = true;
+
+        if (chunk.records.empty())
+        {
+            chunk.compressed.clear();
+            continue;
+        }
+
+        // Each record is prefixed with its length.
+        buffer.resize(chunk.rawSize + chunk.records.size() * cMaxLengthPrefixSize);
+        kNet::DataSerializer ds(&buffer[0], buffer.size());
+        for(std::map<entity_id_t, QByteArray>::const_iterator j = chunk.records.begin(); j != chunk.records.end(); ++j)
+        {
+            ds.AddVLE<kNet::VLE8_16_32>((u32)j->second.size());
+            ds.AddArray<u8>((const u8*)j->second.constData(), (u32)j->second.size());
+        }
+        chunk.compressed = qCompress((const uchar*)ds.GetData(), (int)ds.BytesFilled());
+    }
+
+    if (changed)
+        ++version_;
+    needsRebuild_ = false;
+}
+
+std::vector<QByteArray> SceneSnapshot::CompressedChunks() const
+{
+    std::vector<QByteArray> compressed;
+    for(size_t i = 0; i < chunks_.size(); ++i)
+        if (!chunks_[i].records.empty())
+            compressed.push_back(chunks_[i].compressed);
+    return compressed;
+}
+
+void SceneSnapshot::EntityIds(std::vector<entity_id_t> &ids) const
+{
+    for(std::map<entity_id_t, size_t>::const_iterator i = chunkOfEntity_.begin(); i != chunkOfEntity_.end(); ++i)
+        ids.push_back(i->first);
+}
+
+size_t SceneSnapshot::RawSize() const
+{
+    size_t size = 0;
+    for(size_t i = 0; i < chunks_.size(); ++i)
+        size += chunks_[i].rawSize;
+    return size;
+}
+
+bool SceneSnapshot::ReadChunk(const QByteArray &compressed, std::vector<QByteArray> &records)
+{
+    QByteArray data = qUncompress(compressed);
+    if (data.isEmpty())
+        return false;
+
+    try
+    {
+        kNet::DataDeserializer ds(data.constData(), data.size());
+        while(ds.BytesLeft() > 0)
+        {
+            u32 size = ds.ReadVLE<kNet::VLE8_16_32>();
+            if (size > ds.BytesLeft())
+                return false;
+            QByteArray record(size, 0);
+            if (size > 0)
+                ds.ReadArray<u8>((u8*)record.data(), size);
+            records.push_back(record);
+        }
+    }
+    catch(kNet::NetException &/*e*/)
+    {
+        return false;
+    }
+    return true;
+}
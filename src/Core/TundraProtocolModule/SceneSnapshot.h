@@ -0,0 +1,81 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraProtocolModuleApi.h"
+#include "CoreTypes.h"
+#include "SceneFwd.h"
+
+#include <QByteArray>
+
+#include <vector>
+#include <map>
+#include <set>
+
+/// Compressed snapshot of the replicated entities of a scene, sent in bulk to the clients joining the server.
+/** The snapshot holds one record per replicated entity. A record is the body of the cCreateEntityMessage that would create
+    the entity, so the client handles each record as if it had received the message. The records are grouped to chunks
+    of about 32 KB, and each chunk is compressed with qCompress and sent as one cSceneSnapshotMessage.
+    The snapshot is refreshed incrementally: SyncManager marks the entities dirty as they change, and before the snapshot is
+    sent, serializes only the dirty entities again with SetRecord() or RemoveRecord(), after which Compress() compresses again
+    only the chunks whose records changed. Version() is increased each time the contents change. */
+class TUNDRAPROTOCOL_MODULE_API SceneSnapshot
+{
+public:
+    SceneSnapshot();
+
+    /// Forgets all records. The whole scene has to be serialized again before the snapshot is used, see NeedsRebuild().
+    void Clear();
+
+    /// Returns true after Clear(), until the next Compress().
+    bool NeedsRebuild() const { return needsRebuild_; }
+
+    /// Marks the record of an entity to be serialized again.
+    void MarkDirty(entity_id_t id) { dirty_.insert(id); }
+
+    /// Moves the IDs of the dirty entities to @c ids.
+    void TakeDirty(std::vector<entity_id_t> &ids);
+
+    /// Sets the record of an entity, the body of a cCreateEntityMessage.
+    void SetRecord(entity_id_t id, const char *data, size_t numBytes);
+
+    /// Removes the record of an entity, if it exists.
+    void RemoveRecord(entity_id_t id);
+
+    /// Compresses the chunks whose records have changed since the last call.
+    void Compress();
+
+    /// Returns the number of times the contents have changed.
+    u32 Version() const { return version_; }
+
+    /// Returns the compressed chunks that have records, in sending order.
+    std::vector<QByteArray> CompressedChunks() const;
+
+    /// Returns the IDs of the entities that have a record.
+    void EntityIds(std::vector<entity_id_t> &ids) const;
+
+    /// Returns the total size of the records in bytes.
+    size_t RawSize() const;
+
+    /// Decompresses a chunk and splits it to records. @return False if the chunk is corrupt.
+    static bool ReadChunk(const QByteArray &compressed, std::vector<QByteArray> &records);
+
+private:
+    struct Chunk
+    {
+        Chunk() : rawSize(0), changed(false) {}
+        std::map<entity_id_t, QByteArray> records;
+        size_t rawSize; ///< Total size of the records in bytes.
+        QByteArray compressed;
+        bool changed; ///< The records have changed since the chunk was compressed.
+    };
+
+    /// Returns the index of a chunk that has room for a record of @c numBytes, creating a new chunk if necessary.
+    size_t ChunkWithRoom(size_t numBytes);
+
+    std::vector<Chunk> chunks_;
+    std::map<entity_id_t, size_t> chunkOfEntity_; ///< Index of the chunk holding the record of each entity.
+    std::set<entity_id_t> dirty_;
+    u32 version_;
+    bool needsRebuild_;
+};
@@ -0,0 +1,140 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "SyncFragmentCache.h"
+
+#include "IComponent.h"
+#include "IAttribute.h"
+
+void SyncFragment::AppendTo(kNet::DataSerializer &ds) const
+{
+    const size_t numWholeBytes = numBits >> 3;
+    const size_t numTrailingBits = numBits & 7;
+    if (numWholeBytes > 0)
+    {
+        if ((ds.BitsFilled() & 7) == 0)
+            ds.AddAlignedByteArray(&data[0], (u32)numWholeBytes);
+        else
+            for (size_t i = 0; i < numWholeBytes; ++i)
+                ds.Add<u8>(data[i]);
+    }
+    if (numTrailingBits > 0)
+        ds.AppendBits(data[numWholeBytes], (int)numTrailingBits);
+}
+
+SyncFragmentCache::SyncFragmentCache() :
+    numHits_(0),
+    numMisses_(0)
+{
+}
+
+void SyncFragmentCache::Clear()
+{
+    QMutexLocker lock(&mutex_);
+    attributes_.clear();
+    editBodies_.clear();
+    numHits_ = 0;
+    numMisses_ = 0;
+}
+
+SyncFragmentPtr SyncFragmentCache::MakeFragment(const kNet::DataSerializer &ds)
+{
+    SyncFragmentPtr fragment = MAKE_SHARED(SyncFragment);
+    fragment->numBits = ds.BitsFilled();
+    if (fragment->numBits)
+        fragment->data.assign((const u8*)ds.GetData(), (const u8*)ds.GetData() + fragment->NumBytes());
+    return fragment;
+}
+
+SyncFragmentPtr SyncFragmentCache::Attribute(entity_id_t entityId, IAttribute *attr, char *scratch, size_t scratchSize)
+{
+    AttributeKey key;
+    key.entityId = entityId;
+    key.componentId = attr->Owner() ? attr->Owner()->Id() : 0;
+    key.index = attr->Index();
+
+    {
+        QMutexLocker lock(&mutex_);
+        std::map<AttributeKey, SyncFragmentPtr>::iterator i = attributes_.find(key);
+        if (i != attributes_.end())
+        {
+            ++numHits_;
+            return i->second;
+        }
+    }
+
+    kNet::DataSerializer ds(scratch, scratchSize);
+    attr->ToBinary(ds);
+    SyncFragmentPtr fragment = MakeFragment(ds);
+
+    // Another thread may have serialized the same attribute meanwhile. If so, use its fragment so that all users share one.
+    QMutexLocker lock(&mutex_);
+    ++numMisses_;
+    return attributes_.insert(std::make_pair(key, fragment)).first->second;
+}
+
+SyncFragmentPtr SyncFragmentCache::EditAttributesBody(entity_id_t entityId, IComponent *comp, const u8 *dirtyAttributes,
+    const std::vector<u8> &changedAttributes, char *scratch, size_t scratchSize)
+{
+    EditBodyKey key;
+    key.entityId = entityId;
+    key.componentId = comp->Id();
+    memcpy(key.dirtyAttributes, dirtyAttributes, sizeof(key.dirtyAttributes));
+
+    {
+        QMutexLocker lock(&mutex_);
+        std::map<EditBodyKey, SyncFragmentPtr>::iterator i = editBodies_.find(key);
+        if (i != editBodies_.end())
+        {
+            ++numHits_;
+            return i->second;
+        }
+    }
+
+    // Build the body out of the attribute fragments, which are shared with cCreateAttributesMessage.
+    // The fragments are copied out of the scratch buffer, so it can be reused for the body.
+    // Note: the serialization format must match the one in SyncManager::ProcessSyncState.
+    std::vector<SyncFragmentPtr> attrFragments;
+    attrFragments.reserve(changedAttributes.size());
+    const AttributeVector &attrs = comp->Attributes();
+    for (size_t j = 0; j < changedAttributes.size(); ++j)
+        attrFragments.push_back(Attribute(entityId, attrs[changedAttributes[j]], scratch, scratchSize));
+
+    kNet::DataSerializer ds(scratch, scratchSize);
+    // Check if it is more optimal to send attribute indices, or the whole bitmask
+    unsigned bitsMethod1 = (unsigned)changedAttributes.size() * 8 + 8;
+    unsigned bitsMethod2 = (unsigned)attrs.size();
+    // Method 1: indices
+    if (bitsMethod1 <= bitsMethod2)
+    {
+        ds.Add<kNet::bit>(0);
+        ds.Add<u8>((u8)changedAttributes.size());
+        for (size_t j = 0; j < changedAttributes.size(); ++j)
+        {
+            ds.Add<u8>(changedAttributes[j]);
+            attrFragments[j]->AppendTo(ds);
+        }
+    }
+    // Method 2: bitmask
+    else
+    {
+        ds.Add<kNet::bit>(1);
+        size_t fragmentIndex = 0;
+        for (unsigned j = 0; j < attrs.size(); ++j)
+        {
+            if ((dirtyAttributes[j >> 3] & (1 << (j & 7))) && attrs[j])
+            {
+                ds.Add<kNet::bit>(1);
+                attrFragments[fragmentIndex++]->AppendTo(ds);
+            }
+            else
+                ds.Add<kNet::bit>(0);
+        }
+    }
+
+    SyncFragmentPtr fragment = MakeFragment(ds);
+
+    QMutexLocker lock(&mutex_);
+    ++numMisses_;
+    return editBodies_.insert(std::make_pair(key, fragment)).first->second;
+}
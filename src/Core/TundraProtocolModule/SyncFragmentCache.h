@@ -0,0 +1,106 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraProtocolModuleApi.h"
+#include "CoreTypes.h"
+#include "SceneFwd.h"
+
+#include <kNet/DataSerializer.h>
+
+#include <QMutex>
+
+#include <map>
+#include <cstring>
+
+/// A piece of serialized data that can be appended to any DataSerializer at any bit offset.
+/** Fragments are shared between all user connections during one network tick. */
+struct TUNDRAPROTOCOL_MODULE_API SyncFragment
+{
+    SyncFragment() : numBits(0) {}
+
+    /// Appends the fragment's bits to @c ds. The result is bit-identical to having serialized the data directly to @c ds.
+    void AppendTo(kNet::DataSerializer &ds) const;
+
+    /// Returns the size of the fragment in whole bytes, rounded up.
+    size_t NumBytes() const { return (numBits + 7) >> 3; }
+
+    std::vector<u8> data; ///< Serialized data.
+    size_t numBits; ///< Number of valid bits in data.
+};
+typedef shared_ptr<SyncFragment> SyncFragmentPtr;
+
+/// Per network tick cache of serialized attribute data ("encode once" mode of SyncManager).
+/** Without the cache, every dirty attribute is serialized again with IAttribute::ToBinary for each user connection.
+    With the cache, each dirty attribute, and each per-component cEditAttributesMessage body, is serialized once per
+    network tick, and per-user processing only concatenates the precomputed fragments.
+    The cache must be cleared at the beginning of each network tick, as the fragments refer to the attribute values
+    at the time of serialization.
+    Attribute() and EditAttributesBody() can be called from several threads at once (parallel sync processing),
+    as long as the scene is not modified meanwhile. The data is serialized into the caller's scratch buffer outside
+    the lock; the lock is held only for the cache lookups and inserts. */
+class TUNDRAPROTOCOL_MODULE_API SyncFragmentCache
+{
+public:
+    SyncFragmentCache();
+
+    /// Forgets all cached fragments. Call at the beginning of each network tick.
+    void Clear();
+
+    /// Returns serialized value of the attribute (IAttribute::ToBinary), serializing it if not yet cached.
+    /** @param scratch Buffer used for the serialization, owned by the calling thread.
+        @param scratchSize Size of the scratch buffer in bytes. */
+    SyncFragmentPtr Attribute(entity_id_t entityId, IAttribute *attr, char *scratch, size_t scratchSize);
+
+    /// Returns the attribute data block of a cEditAttributesMessage for the component, with the given dirty attribute bitfield.
+    /** @param dirtyAttributes Dirty attributes bitfield of 32 bytes, as in ComponentSyncState.
+        @param changedAttributes Indices of the changed attributes, in ascending order.
+        @param scratch Buffer used for the serialization, owned by the calling thread.
+        @param scratchSize Size of the scratch buffer in bytes. */
+    SyncFragmentPtr EditAttributesBody(entity_id_t entityId, IComponent *comp, const u8 *dirtyAttributes, const std::vector<u8> &changedAttributes,
+        char *scratch, size_t scratchSize);
+
+    /// Number of cache hits since the last Clear().
+    size_t NumHits() const { return numHits_; }
+    /// Number of cache misses, i.e. actual serializations, since the last Clear().
+    size_t NumMisses() const { return numMisses_; }
+
+private:
+    struct AttributeKey
+    {
+        entity_id_t entityId;
+        component_id_t componentId;
+        u8 index;
+
+        bool operator <(const AttributeKey &rhs) const
+        {
+            if (entityId != rhs.entityId) return entityId < rhs.entityId;
+            if (componentId != rhs.componentId) return componentId < rhs.componentId;
+            return index < rhs.index;
+        }
+    };
+
+    struct EditBodyKey
+    {
+        entity_id_t entityId;
+        component_id_t componentId;
+        u8 dirtyAttributes[32];
+
+        bool operator <(const EditBodyKey &rhs) const
+        {
+            if (entityId != rhs.entityId) return entityId < rhs.entityId;
+            if (componentId != rhs.componentId) return componentId < rhs.componentId;
+            return memcmp(dirtyAttributes, rhs.dirtyAttributes, sizeof(dirtyAttributes)) < 0;
+        }
+    };
+
+    /// Copies the contents of a DataSerializer into a new fragment.
+    static SyncFragmentPtr MakeFragment(const kNet::DataSerializer &ds);
+
+    std::map<AttributeKey, SyncFragmentPtr> attributes_;
+    std::map<EditBodyKey, SyncFragmentPtr> editBodies_;
+    size_t numHits_;
+    size_t numMisses_;
+    /// Protects the maps and the counters.
+    QMutex mutex_;
+};
@@ -28,7 +28,11 @@
 
 #include <kNet.h>
 
+#include <QThread>
+
 #include <cstring>
+#include <cfloat>
+#include <algorithm>
 
 #include "MemoryLeakCheck.h"
 
@@ -40,17 +44,95 @@ static std::set<u32> mismatchingComponentTypes;
 namespace TundraLogic
 {
 
-void SyncManager::QueueMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, kNet::DataSerializer& ds)
+void SyncWorkContext::LogWarning(const QString &msg)
+{
+    if (!deferred)
+    {
+        ::LogWarning(msg);
+        return;
+    }
+    LogMessage entry;
+    entry.error = false;
+    entry.text = msg;
+    log.push_back(entry);
+}
+
+void SyncWorkContext::LogError(const QString &msg)
 {
-    kNet::NetworkMessage* msg = connection->StartNewMessage(id, ds.BytesFilled());
-    memcpy(msg->data, ds.GetData(), ds.BytesFilled());
+    if (!deferred)
+    {
+        ::LogError(msg);
+        return;
+    }
+    LogMessage entry;
+    entry.error = true;
+    entry.text = msg;
+    log.push_back(entry);
+}
+
+/// Crafts and queues a message to a connection.
+static void SendSyncMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, bool fixedPriority, const char *data, size_t numBytes)
+{
+    kNet::NetworkMessage* msg = connection->StartNewMessage(id, numBytes);
+    memcpy(msg->data, data, numBytes);
+    msg->contentID = 0;
     msg->reliable = reliable;
     msg->inOrder = inOrder;
-    msg->priority = 100; // Fixed priority as in those defined with xml
+    if (fixedPriority)
+        msg->priority = 100; // Fixed priority as in those defined with xml
     connection->EndAndQueueMessage(msg);
 }
 
-void SyncManager::WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPtr comp)
+void SyncManager::QueueMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, kNet::DataSerializer& ds)
+{
+    if (!connection)
+        return; // Dry run, see BenchmarkSync
+    SendSyncMessage(connection, id, reliable, inOrder, true, ds.GetData(), ds.BytesFilled());
+}
+
+void SyncManager::QueueMessage(SyncWorkContext& ctx, kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, kNet::DataSerializer& ds, bool fixedPriority)
+{
+    ctx.bytesQueued += ds.BytesFilled();
+    if (!connection)
+        return; // Dry run, see BenchmarkSync
+    if (!ctx.deferred)
+    {
+        SendSyncMessage(connection, id, reliable, inOrder, fixedPriority, ds.GetData(), ds.BytesFilled());
+        return;
+    }
+
+    SyncWorkContext::Message msg;
+    msg.destination = connection;
+    msg.id = id;
+    msg.reliable = reliable;
+    msg.inOrder = inOrder;
+    msg.fixedPriority = fixedPriority;
+    msg.offset = ctx.messageData.size();
+    msg.size = ds.BytesFilled();
+    ctx.messageData.insert(ctx.messageData.end(), ds.GetData(), ds.GetData() + ds.BytesFilled());
+    ctx.messages.push_back(msg);
+}
+
+void SyncManager::FlushDeferred(SyncWorkContext& ctx)
+{
+    for(size_t i = 0; i < ctx.log.size(); ++i)
+    {
+        if (ctx.log[i].error)
+            LogError(ctx.log[i].text);
+        else
+            LogWarning(ctx.log[i].text);
+    }
+    for(size_t i = 0; i < ctx.messages.size(); ++i)
+    {
+        const SyncWorkContext::Message &msg = ctx.messages[i];
+        SendSyncMessage(msg.destination, msg.id, msg.reliable, msg.inOrder, msg.fixedPriority, msg.size ? &ctx.messageData[msg.offset] : 0, msg.size);
+    }
+    ctx.log.clear();
+    ctx.messages.clear();
+    ctx.messageData.clear();
+}
+
+void SyncManager::WriteComponentFullUpdate(SyncWorkContext& ctx, kNet::DataSerializer& ds, ComponentPtr comp)
 {
     // Component identification
     ds.AddVLE<kNet::VLE8_16_32>(comp->Id() & UniqueIdGenerator::LAST_REPLICATED_ID);
@@ -58,7 +140,7 @@ void SyncManager::WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPt
     ds.AddString(comp->Name().toStdString());
     
     // Create a nested dataserializer for the attributes, so we can survive unknown or incompatible components
-    kNet::DataSerializer attrDs(attrDataBuffer_, 16 * 1024);
+    kNet::DataSerializer attrDs(ctx.attrDataBuffer, 16 * 1024);
     
     // Static-structured attributes
     unsigned numStaticAttrs = comp->NumStaticAttributes();
@@ -80,7 +162,33 @@ void SyncManager::WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPt
     
     // Add the attribute array to the main serializer
     ds.AddVLE<kNet::VLE8_16_32>((u32)attrDs.BytesFilled());
-    ds.AddArray<u8>((unsigned char*)attrDataBuffer_, (u32)attrDs.BytesFilled());
+    ds.AddArray<u8>((unsigned char*)ctx.attrDataBuffer, (u32)attrDs.BytesFilled());
+}
+
+void SyncManager::WriteEntityCreate(SyncWorkContext& ctx, kNet::DataSerializer& ds, unsigned sceneId, Entity* entity)
+{
+    // Entity identification and temporary flag
+    ds.AddVLE<kNet::VLE8_16_32>(sceneId);
+    ds.AddVLE<kNet::VLE8_16_32>(entity->Id() & UniqueIdGenerator::LAST_REPLICATED_ID);
+    // Do not write the temporary flag as a bit to not desync the byte alignment at this point, as a lot of data potentially follows
+    ds.Add<u8>(entity->IsTemporary() ? 1 : 0);
+    
+    const Entity::ComponentMap& components = entity->Components();
+    // Count the amount of replicated components
+    uint numReplicatedComponents = 0;
+    for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+    {
+        if (i->second->IsReplicated())
+            ++numReplicatedComponents;
+    }
+    ds.AddVLE<kNet::VLE8_16_32>(numReplicatedComponents);
+    
+    // Serialize each replicated component
+    for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+    {
+        if (i->second->IsReplicated())
+            WriteComponentFullUpdate(ctx, ds, i->second);
+    }
 }
 
 SyncManager::SyncManager(TundraLogicModule* owner) :
@@ -90,7 +198,14 @@ SyncManager::SyncManager(TundraLogicModule* owner) :
     interestmanager_(0),
     updateAcc_(0.0),
     maxLinExtrapTime_(3.0f),
-    noClientPhysicsHandoff_(false)
+    noClientPhysicsHandoff_(false),
+    workerPool_(0),
+    encodeOnce_(false),
+    bandwidthBudget_(false),
+    sceneSnapshot_(false),
+    receivedSnapshotVersion_(0),
+    receivedSnapshotNumChunks_(0),
+    receivedSnapshotNextChunk_(0)
 {
     KristalliProtocolModule *kristalli = framework_->GetModule<KristalliProtocolModule>();
     connect(kristalli, SIGNAL(NetworkMessageReceived(kNet::MessageConnection *, kNet::packet_id_t, kNet::message_id_t, const char *, size_t)), 
@@ -98,6 +213,22 @@ SyncManager::SyncManager(TundraLogicModule* owner) :
 
     if (framework_->HasCommandLineParameter("--noclientphysics"))
         noClientPhysicsHandoff_ = true;
+    if (framework_->HasCommandLineParameter("--syncEncodeOnce"))
+        encodeOnce_ = true;
+    if (framework_->HasCommandLineParameter("--syncBudget"))
+        bandwidthBudget_ = true;
+    if (framework_->HasCommandLineParameter("--syncSnapshot"))
+        sceneSnapshot_ = true;
+    QStringList syncThreadsParam = framework_->CommandLineParameters("--syncThreads");
+    if (syncThreadsParam.size() > 0)
+    {
+        bool ok = false;
+        int numThreads = syncThreadsParam.first().toInt(&ok);
+        if (ok)
+            SetSyncThreads(numThreads);
+        else
+            LogError("SyncManager: Invalid value for --syncThreads: " + syncThreadsParam.first());
+    }
 
     /*Parse through possible Interest Management parameterṣ*/
     if (framework_->CommandLineParameters("--im").size() == 1)
@@ -148,6 +279,7 @@ SyncManager::SyncManager(TundraLogicModule* owner) :
 
 SyncManager::~SyncManager()
 {
+    SetSyncThreads(0);
 }
 
 void SyncManager::SendCameraUpdateRequest(UserConnectionPtr conn, bool enabled)
@@ -183,10 +315,7 @@ void SyncManager::UpdateInterestManagerSettings(bool enabled, bool eucl, bool ra
                 if ((*i)->syncState)
                 {
                     SendCameraUpdateRequest((*i), enabled);
-                    (*i)->syncState->visibleEntities.clear();
-                    (*i)->syncState->relevanceFactors.clear();
-                    (*i)->syncState->lastUpdatedEntitys_.clear();
-                    (*i)->syncState->lastRaycastedEntitys_.clear();
+                    (*i)->syncState->interest.Clear();
                 }
         }
 
@@ -201,16 +330,8 @@ void SyncManager::UpdateInterestManagerSettings(bool enabled, bool eucl, bool ra
 
         IM = GetInterestManager();
 
-        if(eucl && ray && rel)          //In other words the EA3 algorithm
-        {
-            if(framework_->IsHeadless())    //If running in headless mode, do not enable EA3. Instead, use A3. Raycasting cannot be done in headless mode at the moment.
-            {
-                LogError("[InterestManager] EA3 algorithm cannot be used in headless mode. Fallbacking to A3 algorithm.");
-                filter = new A3Filter(IM, critrange, relrange, updateint, true);
-            }
-            else
-                filter = new EA3Filter(IM, critrange, relrange, raycastint, updateint, true);
-        }
+        if(eucl && ray && rel)          //In other words the EA3 algorithm. Also works in headless mode, as the visibility raycasts are done against the physics world.
+            filter = new EA3Filter(IM, critrange, relrange, raycastint, updateint, true);
         else if(eucl && rel && !ray)    //Combination that the A3 uses
             filter = new A3Filter(IM, critrange, relrange, updateint, true);
 
@@ -218,6 +339,7 @@ void SyncManager::UpdateInterestManagerSettings(bool enabled, bool eucl, bool ra
             filter = new EuclideanDistanceFilter(IM, critrange, true);
 
         IM->AssignFilter(filter);
+        IM->RebuildSpatialIndex(scene_.lock());
 
         SetInterestManager(IM);
 
@@ -258,6 +380,199 @@ void SyncManager::SetUpdatePeriod(float period)
     GetClientExtrapolationTime();
 }
 
+void SyncManager::SetSyncThreads(int numThreads)
+{
+    if (numThreads < 0)
+        numThreads = std::max(QThread::idealThreadCount() - 1, 0);
+    if (numThreads == (int)workerContexts_.size())
+        return;
+
+    delete workerPool_;
+    workerPool_ = 0;
+    for(size_t i = 0; i < workerContexts_.size(); ++i)
+        delete workerContexts_[i];
+    workerContexts_.clear();
+
+    if (numThreads > 0)
+    {
+        for(int i = 0; i < numThreads; ++i)
+        {
+            workerContexts_.push_back(new SyncWorkContext());
+            workerContexts_.back()->deferred = true;
+        }
+        workerPool_ = new SyncWorkerPool(numThreads);
+        LogInfo("SyncManager: Processing user sync states with " + QString::number(numThreads + 1) + " threads.");
+    }
+}
+
+void SyncManager::SetEncodeOnce(bool enabled)
+{
+    encodeOnce_ = enabled;
+    fragmentCache_.Clear();
+}
+
+void SyncManager::SetBandwidthBudget(bool enabled)
+{
+    if (enabled == bandwidthBudget_)
+        return;
+    bandwidthBudget_ = enabled;
+
+    // Start from the initial send rate, as the connections may have changed while the budget was not in use.
+    if (owner_->IsServer())
+    {
+        UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
+        for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
+            if ((*i)->syncState)
+                (*i)->syncState->budget.Reset();
+    }
+    else
+        server_syncstate_.budget.Reset();
+}
+
+void SyncManager::SetSceneSnapshot(bool enabled)
+{
+    if (enabled == sceneSnapshot_)
+        return;
+    sceneSnapshot_ = enabled;
+    // The changes were not tracked while the snapshot was not in use.
+    snapshot_.Clear();
+}
+
+void SyncManager::BeginBudgetTick(kNet::MessageConnection* connection, SceneSyncState* state)
+{
+    if (connection)
+        state->budget.BeginTick(connection->BytesOutPerSec(), connection->RoundTripTime(), connection->NumOutboundMessagesPending(), updatePeriod_);
+}
+
+/// Distance from the client at which the distance halves the send priority of an entity.
+static const float cPriorityHalvingDistance = 50.f;
+
+float SyncManager::SendPriority(Scene* scene, SceneSyncState* state, const EntitySyncState& entityState) const
+{
+    // Removes are small, and make the client stop processing the entity.
+    if (entityState.removed)
+        return FLT_MAX;
+
+    // Relevance is in [0,1] when the interest manager has evaluated the entity. Keep irrelevant entities above zero,
+    // so that their priority still grows with age.
+    float importance = 1.f;
+    float relevance = state->interest.Relevance(entityState.id);
+    if (relevance >= 0.f)
+        importance = 0.1f + relevance;
+
+    if (state->locationInitialized)
+    {
+        EntityPtr entity = scene->GetEntity(entityState.id);
+        shared_ptr<EC_Placeable> placeable = entity ? entity->GetComponent<EC_Placeable>() : shared_ptr<EC_Placeable>();
+        // The parent of the placeable is not taken into account, so the distance of a parented entity is an approximation.
+        if (placeable)
+            importance *= cPriorityHalvingDistance / (cPriorityHalvingDistance + placeable->transform.Get().pos.Distance(state->clientLocation));
+    }
+
+    // The ticks since the last send, so that no entity is starved. New entities have never been sent, and are the oldest.
+    u32 age = state->syncTick - entityState.lastSentTick;
+    return importance * (1.f + (float)age);
+}
+
+void SyncManager::BenchmarkSync(int maxUsers, int userStep)
+{
+    ScenePtr scene = scene_.lock();
+    if (!scene)
+    {
+        LogError("SyncManager::BenchmarkSync: No scene registered, cannot run benchmark.");
+        return;
+    }
+    if (maxUsers <= 0)
+        maxUsers = 200;
+    if (userStep <= 0 || userStep > maxUsers)
+        userStep = maxUsers;
+
+    const bool originalEncodeOnce = encodeOnce_;
+    SyncWorkerPool *originalWorkerPool = workerPool_;
+    const int numModes = workerPool_ ? 3 : 2;
+    const Scene::EntityMap &entities = static_cast<const Scene*>(scene.get())->Entities();
+    LogInfo(QString("SyncManager::BenchmarkSync: %1 entities, every attribute dirty, simulated users from %2 to %3").arg(entities.size()).arg(userStep).arg(maxUsers));
+    if (workerPool_)
+        LogInfo(QString("Parallel mode uses encode once with %1 threads.").arg(workerPool_->NumWorkers()));
+    LogInfo(QString("Users   Per-user encode (ms)   Encode once (ms)   %1Cache hits / misses   Sync state (KB/user)").arg(workerPool_ ? "Parallel (ms)   " : ""));
+
+    for(int numUsers = userStep; numUsers <= maxUsers; numUsers += userStep)
+    {
+        double msecs[3];
+        size_t hits = 0, misses = 0, stateBytes = 0;
+        for(int mode = 0; mode < numModes; ++mode)
+        {
+            encodeOnce_ = (mode >= 1);
+            workerPool_ = (mode == 2 ? originalWorkerPool : 0);
+            fragmentCache_.Clear();
+
+            std::vector<shared_ptr<SceneSyncState> > states;
+            SyncJobList jobs;
+            for(int i = 0; i < numUsers; ++i)
+            {
+                shared_ptr<SceneSyncState> state = MAKE_SHARED(SceneSyncState, (u32)(i + 1), false);
+                state->SetParentScene(scene_);
+                DirtyAllForBenchmark(state.get());
+                states.push_back(state);
+                jobs.push_back(std::make_pair((kNet::MessageConnection*)0, state.get()));
+            }
+            stateBytes = states.front()->MemoryUsage();
+
+            tick_t start = GetCurrentClockTime();
+            ProcessUserSyncStates(jobs);
+            msecs[mode] = (double)(GetCurrentClockTime() - start) * 1000.0 / (double)GetCurrentClockFreq();
+
+            if (mode == 1)
+            {
+                hits = fragmentCache_.NumHits();
+                misses = fragmentCache_.NumMisses();
+            }
+        }
+        QString parallel = (numModes > 2 ? QString("%1   ").arg(msecs[2], 13, 'f', 3) : QString());
+        LogInfo(QString("%1   %2   %3   %4%5 / %6   %7").arg(numUsers, 5).arg(msecs[0], 20, 'f', 3).arg(msecs[1], 16, 'f', 3).arg(parallel)
+            .arg(hits).arg(misses).arg(stateBytes / 1024.0, 20, 'f', 1));
+    }
+
+    encodeOnce_ = originalEncodeOnce;
+    workerPool_ = originalWorkerPool;
+    fragmentCache_.Clear();
+}
+
+void SyncManager::DirtyAllForBenchmark(SceneSyncState* state)
+{
+    ScenePtr scene = scene_.lock();
+    if (!scene)
+        return;
+
+    for(Scene::iterator iter = scene->begin(); iter != scene->end(); ++iter)
+    {
+        EntityPtr entity = iter->second;
+        if (entity->IsLocal())
+            continue;
+        // Pretend that the user already has the entity, so that attribute edits are sent instead of a full create.
+        state->MarkEntityProcessed(entity->Id());
+        const Entity::ComponentMap &components = entity->Components();
+        for(Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+        {
+            if (!i->second->IsReplicated())
+                continue;
+            state->MarkComponentProcessed(entity->Id(), i->second->Id());
+            const AttributeVector &attrs = i->second->Attributes();
+            for(size_t j = 0; j < attrs.size(); ++j)
+                if (attrs[j])
+                    state->MarkAttributeDirty(entity->Id(), i->second->Id(), (u8)j);
+        }
+    }
+}
+
+IAttribute* SyncManager::InterpolationEndValue(IAttribute* attr)
+{
+    shared_ptr<IAttribute> &endValue = interpolationEndValues_[attr->TypeId()];
+    if (!endValue)
+        endValue = shared_ptr<IAttribute>(attr->Clone());
+    return endValue.get();
+}
+
 void SyncManager::GetClientExtrapolationTime()
 {
     QStringList extrapTimeParam = framework_->CommandLineParameters("--clientextrapolationtime");
@@ -309,9 +624,16 @@ void SyncManager::RegisterToScene(ScenePtr scene)
     
     scene_ = scene;
     Scene* sceneptr = scene.get();
+    snapshot_.Clear();
+    receivedSnapshotNextChunk_ = 0;
+
+    if (interestmanager_)
+        interestmanager_->RebuildSpatialIndex(scene);
     
     connect(sceneptr, SIGNAL( AttributeChanged(IComponent*, IAttribute*, AttributeChange::Type) ),
         SLOT( OnAttributeChanged(IComponent*, IAttribute*, AttributeChange::Type) ));
+    connect(sceneptr, SIGNAL( AttributeChangesDispatched(const DeferredAttributeChangeList &) ),
+        SLOT( OnAttributeChangesDispatched(const DeferredAttributeChangeList &) ));
     connect(sceneptr, SIGNAL( AttributeAdded(IComponent*, IAttribute*, AttributeChange::Type) ),
         SLOT( OnAttributeAdded(IComponent*, IAttribute*, AttributeChange::Type) ));
     connect(sceneptr, SIGNAL( AttributeRemoved(IComponent*, IAttribute*, AttributeChange::Type) ),
@@ -341,6 +663,9 @@ void SyncManager::HandleKristalliMessage(kNet::MessageConnection* source, kNet::
         case cCreateEntityMessage:
             HandleCreateEntity(source, data, numBytes);
             break;
+        case cSceneSnapshotMessage:
+            HandleSceneSnapshot(source, data, numBytes);
+            break;
         case cCreateComponentsMessage:
             HandleCreateComponents(source, data, numBytes);
             break;
@@ -412,6 +737,15 @@ void SyncManager::NewUserConnected(const UserConnectionPtr &user)
     if (owner_->IsServer())
         emit SceneStateCreated(user.get(), user->syncState.get());
 
+    // Send the scene in a snapshot on the next network tick, after the login reply, if the client supports it.
+    // If a script or the interest management filters the entities of this user, the entities have to go through the sync state one by one.
+    if (sceneSnapshot_ && !interestmanager_ && owner_->IsServer() && user->properties["client-scene-snapshot"] == "1" &&
+        !user->syncState->HasChangeRequestListeners())
+    {
+        snapshotJoins_.push_back(user);
+        return;
+    }
+
     for(Scene::iterator iter = scene->begin(); iter != scene->end(); ++iter)
     {
         EntityPtr entity = iter->second;
@@ -422,12 +756,136 @@ void SyncManager::NewUserConnected(const UserConnectionPtr &user)
     }
 }
 
+void SyncManager::MarkSnapshotDirty(Entity* entity)
+{
+    if (sceneSnapshot_ && entity && !entity->IsLocal() && owner_->IsServer())
+        snapshot_.MarkDirty(entity->Id());
+}
+
+void SyncManager::RefreshSnapshot(Scene* scene)
+{
+    PROFILE(SyncManager_RefreshSnapshot);
+
+    if (snapshot_.NeedsRebuild())
+    {
+        for(Scene::iterator iter = scene->begin(); iter != scene->end(); ++iter)
+            if (!iter->second->IsLocal())
+                snapshot_.MarkDirty(iter->first);
+    }
+
+    std::vector<entity_id_t> ids;
+    snapshot_.TakeDirty(ids);
+    for(size_t i = 0; i < ids.size(); ++i)
+    {
+        EntityPtr entity = scene->GetEntity(ids[i]);
+        if (!entity || entity->IsLocal())
+        {
+            snapshot_.RemoveRecord(ids[i]);
+            continue;
+        }
+        kNet::DataSerializer ds(syncContext_.createEntityBuffer, 64 * 1024);
+        WriteEntityCreate(syncContext_, ds, 0, entity.get()); ///\todo Replace with proper scene ID once multiscene support is in place.
+        snapshot_.SetRecord(ids[i], ds.GetData(), ds.BytesFilled());
+    }
+    snapshot_.Compress();
+}
+
+void SyncManager::SendSnapshotToJoinedUsers(Scene* scene)
+{
+    PROFILE(SyncManager_SendSnapshotToJoinedUsers);
+
+    std::vector<UserConnectionWeakPtr> joins;
+    joins.swap(snapshotJoins_);
+
+    // An InterestManager may have been set after the users joined.
+    const bool useSnapshot = sceneSnapshot_ && !interestmanager_;
+    if (useSnapshot)
+        RefreshSnapshot(scene);
+    std::vector<QByteArray> chunks;
+    std::vector<entity_id_t> ids;
+    if (useSnapshot)
+    {
+        chunks = snapshot_.CompressedChunks();
+        snapshot_.EntityIds(ids);
+    }
+    std::vector<char> buffer;
+
+    for(size_t i = 0; i < joins.size(); ++i)
+    {
+        UserConnectionPtr user = joins[i].lock();
+        if (!user || !user->syncState || !user->connection)
+            continue;
+        SceneSyncState* state = user->syncState.get();
+
+        if (!useSnapshot)
+        {
+            // Disabled after the user joined, send the entities one by one.
+            for(Scene::iterator iter = scene->begin(); iter != scene->end(); ++iter)
+                if (!iter->second->IsLocal())
+                    state->MarkEntityDirty(iter->first);
+            continue;
+        }
+
+        size_t compressedSize = 0;
+        for(size_t j = 0; j < chunks.size(); ++j)
+        {
+            buffer.resize(chunks[j].size() + 32);
+            kNet::DataSerializer ds(&buffer[0], buffer.size());
+            ds.AddVLE<kNet::VLE8_16_32>(0); ///\todo Replace with proper scene ID once multiscene support is in place.
+            ds.Add<u32>(snapshot_.Version());
+            ds.AddVLE<kNet::VLE8_16_32>((u32)j);
+            ds.AddVLE<kNet::VLE8_16_32>((u32)chunks.size());
+            ds.AddVLE<kNet::VLE8_16_32>((u32)chunks[j].size());
+            ds.AddArray<u8>((const u8*)chunks[j].constData(), (u32)chunks[j].size());
+            QueueMessage(user->connection, cSceneSnapshotMessage, true, true, ds);
+            compressedSize += chunks[j].size();
+        }
+
+        // The user has now got the entities as they are in the snapshot. Any changes made to them after this are sent as usual.
+        // Changes made between the join and now are included in the snapshot, so clear them from the sync state.
+        for(size_t j = 0; j < ids.size(); ++j)
+        {
+            EntityPtr entity = scene->GetEntity(ids[j]);
+            if (!entity)
+                continue;
+            state->RemoveFromQueue(ids[j]);
+            const Entity::ComponentMap& components = entity->Components();
+            for (Entity::ComponentMap::const_iterator k = components.begin(); k != components.end(); ++k)
+            {
+                if (k->second->IsReplicated())
+                    state->MarkComponentProcessed(ids[j], k->second->Id());
+            }
+            state->MarkEntityProcessed(ids[j]);
+        }
+
+        LogDebug("SyncManager: Sent scene snapshot version " + QString::number(snapshot_.Version()) + " with " + QString::number(ids.size()) +
+            " entities to user " + QString::number(user->ConnectionId()) + ", " + QString::number(snapshot_.RawSize() / 1024) + " KB compressed to " +
+            QString::number(compressedSize / 1024) + " KB in " + QString::number(chunks.size()) + " chunks.");
+    }
+}
+
+void SyncManager::OnAttributeChangesDispatched(const DeferredAttributeChangeList &changes)
+{
+    PROFILE(SyncManager_OnAttributeChangesDispatched);
+    for(size_t i = 0; i < changes.size(); ++i)
+        HandleAttributeChange(changes[i].component, changes[i].attribute, changes[i].change);
+}
+
 void SyncManager::OnAttributeChanged(IComponent* comp, IAttribute* attr, AttributeChange::Type change)
 {
     assert(comp && attr);
     if (!comp || !attr)
         return;
+    // The deferred changes were already handled in OnAttributeChangesDispatched.
+    Scene *scene = comp->ParentScene();
+    if (scene && scene->IsDispatchingAttributeChanges())
+        return;
+
+    HandleAttributeChange(comp, attr, change);
+}
 
+void SyncManager::HandleAttributeChange(IComponent* comp, IAttribute* attr, AttributeChange::Type change)
+{
     bool isServer = owner_->IsServer();
     
     // Client: Check for stopping interpolation, if we change a currently interpolating variable ourselves
@@ -442,6 +900,18 @@ void SyncManager::OnAttributeChanged(IComponent* comp, IAttribute* attr, Attribu
         }
     }
     
+    // Keep the interest management spatial index up to date, also for changes that are not replicated.
+    if (isServer && interestmanager_ && comp->TypeId() == EC_Placeable::ComponentTypeId && attr == &static_cast<EC_Placeable*>(comp)->transform)
+    {
+        Entity* parent = comp->ParentEntity();
+        if (parent && !parent->IsLocal())
+            interestmanager_->UpdateEntityPosition(parent);
+    }
+
+    // The snapshot holds the current values, also of the changes that are not replicated, as does a cCreateEntityMessage.
+    if (!comp->IsLocal())
+        MarkSnapshotDirty(comp->ParentEntity());
+
     // Is this change even supposed to go to the network?
     if (change != AttributeChange::Replicate || comp->IsLocal())
         return;
@@ -498,6 +968,7 @@ void SyncManager::OnAttributeAdded(IComponent* comp, IAttribute* attr, Attribute
     
     if (isServer)
     {
+        MarkSnapshotDirty(entity);
         UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
         for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
             if ((*i)->syncState) (*i)->syncState->MarkAttributeCreated(entity->Id(), comp->Id(), attr->Index());
@@ -527,6 +998,7 @@ void SyncManager::OnAttributeRemoved(IComponent* comp, IAttribute* attr, Attribu
     
     if (isServer)
     {
+        MarkSnapshotDirty(entity);
         UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
         for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
             if ((*i)->syncState) (*i)->syncState->MarkAttributeRemoved(entity->Id(), comp->Id(), attr->Index());
@@ -543,6 +1015,11 @@ void SyncManager::OnComponentAdded(Entity* entity, IComponent* comp, AttributeCh
     if (!entity || !comp)
         return;
 
+    if (interestmanager_ && owner_->IsServer() && comp->TypeId() == EC_Placeable::ComponentTypeId && !entity->IsLocal())
+        interestmanager_->UpdateEntityPosition(entity);
+
+    if (!comp->IsLocal())
+        MarkSnapshotDirty(entity);
     if ((change != AttributeChange::Replicate) || (comp->IsLocal()))
         return;
     if (entity->IsLocal())
@@ -565,6 +1042,11 @@ void SyncManager::OnComponentRemoved(Entity* entity, IComponent* comp, Attribute
     assert(entity && comp);
     if (!entity || !comp)
         return;
+
+    if (interestmanager_ && comp->TypeId() == EC_Placeable::ComponentTypeId)
+        interestmanager_->RemoveEntityPosition(entity->Id());
+    if (!comp->IsLocal())
+        MarkSnapshotDirty(entity);
     if ((change != AttributeChange::Replicate) || (comp->IsLocal()))
         return;
     if (entity->IsLocal())
@@ -587,6 +1069,7 @@ void SyncManager::OnEntityCreated(Entity* entity, AttributeChange::Type change)
     assert(entity);
     if (!entity)
         return;
+    MarkSnapshotDirty(entity);
     if ((change != AttributeChange::Replicate) || (entity->IsLocal()))
         return;
 
@@ -617,6 +1100,10 @@ void SyncManager::OnEntityRemoved(Entity* entity, AttributeChange::Type change)
     assert(entity);
     if (!entity)
         return;
+
+    if (interestmanager_)
+        interestmanager_->RemoveEntityPosition(entity->Id());
+    MarkSnapshotDirty(entity);
     if (change != AttributeChange::Replicate)
         return;
     if (entity->IsLocal())
@@ -700,6 +1187,7 @@ void SyncManager::OnEntityPropertiesChanged(Entity* entity, AttributeChange::Typ
     assert(entity);
     if (!entity)
         return;
+    MarkSnapshotDirty(entity);
     if ((change != AttributeChange::Replicate) || (entity->IsLocal()))
         return;
 
@@ -863,6 +1351,9 @@ void SyncManager::Update(f64 frametime)
     // For the client, smoothly update all rigid bodies by interpolating.
     if (!owner_->IsServer())
         InterpolateRigidBodies(frametime, &server_syncstate_);
+    // For the server, spread the interest management visibility raycasts over frames.
+    else if (interestmanager_)
+        interestmanager_->ProcessVisibilityTests(scene_.lock(), framework_->IsHeadless());
 
     // Check if it is yet time to perform a network update tick.
     updateAcc_ += (float)frametime;
@@ -875,59 +1366,124 @@ void SyncManager::Update(f64 frametime)
     ScenePtr scene = scene_.lock();
     if (!scene)
         return;
+
+    // Serialized data from the previous tick is stale.
+    if (encodeOnce_)
+        fragmentCache_.Clear();
     
     if (owner_->IsServer())
     {
         // If we are server, process all authenticated users
-
-        // Then send out changes to other attributes via the generic sync mechanism.
+        SyncJobList jobs;
         UserConnectionList& users = owner_->GetKristalliModule()->GetUserConnections();
-        for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
-            if ((*i)->syncState)
-            {
-                // First send out all changes to rigid bodies.
-                // After processing this function, the bits related to rigid body states have been cleared,
-                // so the generic sync will not double-replicate the rigid body positions and velocities.
-                ReplicateRigidBodyChanges((*i)->connection, (*i)->syncState.get());
 
-                ProcessSyncState((*i)->connection, (*i)->syncState.get());
-            }
+        // Find out which entities are in range of each user, for filtering the attribute changes until the next tick.
+        if (interestmanager_)
+            interestmanager_->UpdateInterestSets(users);
+
+        if (!snapshotJoins_.empty())
+            SendSnapshotToJoinedUsers(scene.get());
+
+        for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
+        {
+            if (!(*i)->syncState)
+                continue;
+            if (bandwidthBudget_)
+                BeginBudgetTick((*i)->connection, (*i)->syncState.get());
+            jobs.push_back(std::make_pair((*i)->connection, (*i)->syncState.get()));
+        }
+        ProcessUserSyncStates(jobs);
     }
     else
     {
         // If we are client, process just the server sync state
         kNet::MessageConnection* connection = owner_->GetKristalliModule()->GetMessageConnection();
         if (connection)
-            ProcessSyncState(connection, &server_syncstate_);
+        {
+            PROFILE(SyncManager_ProcessSyncState);
+            if (bandwidthBudget_)
+                BeginBudgetTick(connection, &server_syncstate_);
+            ProcessSyncState(syncContext_, connection, &server_syncstate_);
+        }
     }
 }
 
-void SyncManager::ReplicateRigidBodyChanges(kNet::MessageConnection* destination, SceneSyncState* state)
+/// Processes the sync states of the users on the worker threads.
+class SyncManager::ParallelSyncTask : public SyncWorkerPool::Task
+{
+public:
+    ParallelSyncTask(SyncManager *owner, const SyncJobList &jobs) : owner_(owner), jobs_(jobs) {}
+
+    void Run(size_t jobIndex, size_t workerIndex)
+    {
+        PROFILE(SyncManager_ProcessUserSyncState); // Recorded only to the profiler trace on the worker threads.
+        SyncWorkContext &ctx = (workerIndex == 0 ? owner_->syncContext_ : *owner_->workerContexts_[workerIndex - 1]);
+        owner_->ReplicateRigidBodyChanges(ctx, jobs_[jobIndex].first, jobs_[jobIndex].second);
+        owner_->ProcessSyncState(ctx, jobs_[jobIndex].first, jobs_[jobIndex].second);
+    }
+
+private:
+    SyncManager *owner_;
+    const SyncJobList &jobs_;
+};
+
+void SyncManager::ProcessUserSyncStates(const SyncJobList &jobs)
+{
+    if (!workerPool_ || jobs.size() < 2)
+    {
+        for(size_t i = 0; i < jobs.size(); ++i)
+        {
+            // First send out all changes to rigid bodies.
+            // After processing this function, the bits related to rigid body states have been cleared,
+            // so the generic sync will not double-replicate the rigid body positions and velocities.
+            {
+                PROFILE(SyncManager_ReplicateRigidBodyChanges);
+                ReplicateRigidBodyChanges(syncContext_, jobs[i].first, jobs[i].second);
+            }
+
+            // Then send out changes to other attributes via the generic sync mechanism.
+            PROFILE(SyncManager_ProcessSyncState);
+            ProcessSyncState(syncContext_, jobs[i].first, jobs[i].second);
+        }
+        return;
+    }
+
+    PROFILE(SyncManager_ProcessUserSyncStatesParallel);
+    // The per-user processing only reads the scene and writes to the user's own sync state. Messages and log output are
+    // collected to the worker contexts, and sent out here once all users have been processed, so that only the main thread
+    // touches the connections. The messages of one user are all crafted by one worker, so their order is preserved.
+    syncContext_.deferred = true;
+    ParallelSyncTask task(this, jobs);
+    workerPool_->Run(&task, jobs.size());
+    syncContext_.deferred = false;
+
+    FlushDeferred(syncContext_);
+    for(size_t i = 0; i < workerContexts_.size(); ++i)
+        FlushDeferred(*workerContexts_[i]);
+}
+
+void SyncManager::ReplicateRigidBodyChanges(SyncWorkContext& ctx, kNet::MessageConnection* destination, SceneSyncState* state)
 {
-    PROFILE(SyncManager_ReplicateRigidBodyChanges);
-    
     ScenePtr scene = scene_.lock();
     if (!scene)
         return;
 
-    const int maxMessageSizeBytes = 1400;
-    kNet::NetworkMessage *msg = destination->StartNewMessage(cRigidBodyUpdateMessage, maxMessageSizeBytes);
-    msg->contentID = 0;
-    msg->inOrder = true;
-    msg->reliable = false;
-    kNet::DataSerializer ds(msg->data, maxMessageSizeBytes);
+    const size_t bytesQueuedBefore = ctx.bytesQueued;
+    const int maxMessageSizeBytes = sizeof(ctx.rigidBodyBuffer);
+    bool reliable = false;
+    kNet::DataSerializer ds(ctx.rigidBodyBuffer, maxMessageSizeBytes);
 
-    for(std::list<EntitySyncState*>::iterator iter = state->dirtyQueue.begin(); iter != state->dirtyQueue.end(); ++iter)
+    for(EntitySyncState *iter = state->dirtyQueue.Front(); iter; iter = iter->nextDirty)
     {
         const int maxRigidBodyMessageSizeBits = 350; // An update for a single rigid body can take at most this many bits. (conservative bound)
         // If we filled up this message, send it out and start crafting anothero one.
         if (maxMessageSizeBytes * 8 - (int)ds.BitsFilled() <= maxRigidBodyMessageSizeBits)
         {
-            destination->EndAndQueueMessage(msg, ds.BytesFilled());
-            msg = destination->StartNewMessage(cRigidBodyUpdateMessage, maxMessageSizeBytes);
-            ds = kNet::DataSerializer(msg->data, maxMessageSizeBytes);
+            QueueMessage(ctx, destination, cRigidBodyUpdateMessage, reliable, true, ds, false);
+            reliable = false;
+            ds = kNet::DataSerializer(ctx.rigidBodyBuffer, maxMessageSizeBytes);
         }
-        EntitySyncState &ess = **iter;
+        EntitySyncState &ess = *iter;
 
         if (ess.isNew || ess.removed)
             continue; // Newly created and removed entities are handled through the traditional sync mechanism.
@@ -937,12 +1493,12 @@ void SyncManager::ReplicateRigidBodyChanges(kNet::MessageConnection* destination
         if (!placeable.get())
             continue;
 
-        std::map<component_id_t, ComponentSyncState>::iterator placeableComp = ess.components.find(placeable->Id());
+        ComponentSyncState *placeableComp = ess.components.Find(placeable->Id());
 
         bool transformDirty = false;
-        if (placeableComp != ess.components.end())
+        if (placeableComp)
         {
-            ComponentSyncState &pss = placeableComp->second;
+            ComponentSyncState &pss = *placeableComp;
             if (!pss.isNew && !pss.removed) // Newly created and deleted components are handled through the traditional sync mechanism.
             {
                 transformDirty = (pss.dirtyAttributes[0] & 1) != 0; // The Transform of an EC_Placeable is the first attibute in the component.
@@ -955,10 +1511,10 @@ void SyncManager::ReplicateRigidBodyChanges(kNet::MessageConnection* destination
         shared_ptr<EC_RigidBody> rigidBody = e->GetComponent<EC_RigidBody>();
         if (rigidBody)
         {
-            std::map<component_id_t, ComponentSyncState>::iterator rigidBodyComp = ess.components.find(rigidBody->Id());
-            if (rigidBodyComp != ess.components.end())
+            ComponentSyncState *rigidBodyComp = ess.components.Find(rigidBody->Id());
+            if (rigidBodyComp)
             {
-                ComponentSyncState &rss = rigidBodyComp->second;
+                ComponentSyncState &rss = *rigidBodyComp;
                 if (!rss.isNew && !rss.removed) // Newly created and deleted components are handled through the traditional sync mechanism.
                 {
                     velocityDirty = (rss.dirtyAttributes[1] & (1 << 5)) != 0;
@@ -975,12 +1531,12 @@ void SyncManager::ReplicateRigidBodyChanges(kNet::MessageConnection* destination
                     if (rigidBody->linearVelocity.Get().IsZero(1e-4f) && !ess.linearVelocity.IsZero(1e-4f))
                     {
                         velocityDirty = true;
-                        msg->reliable = true;
+                        reliable = true;
                     }
                     if (rigidBody->angularVelocity.Get().IsZero(1e-4f) && !ess.angularVelocity.IsZero(1e-4f))
                     {
                         angularVelocityDirty = true;
-                        msg->reliable = true;
+                        reliable = true;
                     }
                 }
             }
@@ -1149,9 +1705,9 @@ void SyncManager::ReplicateRigidBodyChanges(kNet::MessageConnection* destination
         ess.lastNetworkSendTime = kNet::Clock::Tick();
     }
     if (ds.BytesFilled() > 0)
-        destination->EndAndQueueMessage(msg, ds.BytesFilled());
-    else
-        destination->FreeMessage(msg);
+        QueueMessage(ctx, destination, cRigidBodyUpdateMessage, reliable, true, ds, false);
+    // The rigid body updates are always sent, but take from the budget of the other changes.
+    state->budget.Spend(ctx.bytesQueued - bytesQueuedBefore);
 }
 
 void SyncManager::HandleRigidBodyChanges(kNet::MessageConnection* source, kNet::packet_id_t packetId, const char* data, size_t numBytes)
@@ -1379,31 +1935,72 @@ void SyncManager::HandleEditEntityProperties(kNet::MessageConnection* source, co
     state->entities[entityID].hasPropertyChanges = false;
 }
 
-void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state)
+/// Orders dirty entities by descending send priority.
+static bool HigherPriority(const std::pair<float, EntitySyncState*> &a, const std::pair<float, EntitySyncState*> &b)
+{
+    return a.first > b.first;
+}
+
+void SyncManager::ProcessSyncState(SyncWorkContext& ctx, kNet::MessageConnection* destination, SceneSyncState* state)
 {
-    PROFILE(SyncManager_ProcessSyncState);
-    
     unsigned sceneId = 0; ///\todo Replace with proper scene ID once multiscene support is in place.
     
     ScenePtr scene = scene_.lock();
     int numMessagesSent = 0;
     bool isServer = owner_->IsServer();
     UNREFERENCED_PARAM(isServer)
+    ++state->syncTick;
     
+    // With the bandwidth budget, order the dirty entities by their send priority. Only the ones that fit in the budget are
+    // processed, the rest stay dirty in the queue. Without a connection (benchmarking) there is no throughput to budget for.
+    const bool limitBandwidth = bandwidthBudget_ && destination;
+    size_t nextPrioritized = 0;
+    bool anyProcessed = false;
+    if (limitBandwidth)
+    {
+        ctx.prioritizedEntities.clear();
+        for(EntitySyncState *iter = state->dirtyQueue.Front(); iter; iter = iter->nextDirty)
+            ctx.prioritizedEntities.push_back(std::make_pair(SendPriority(scene.get(), state, *iter), iter));
+        // Stable, so that entities of equal priority are sent in the order they became dirty.
+        std::stable_sort(ctx.prioritizedEntities.begin(), ctx.prioritizedEntities.end(), HigherPriority);
+    }
+
     // Process the state's dirty entity queue.
-    /// \todo Limit and prioritize the data sent. For now the whole queue is processed, regardless of whether the connection is being saturated.
-    while (!state->dirtyQueue.empty())
+    for(;;)
     {
-        EntitySyncState& entityState = *state->dirtyQueue.front();
-        state->dirtyQueue.pop_front();
+        EntitySyncState *next = 0;
+        if (limitBandwidth)
+        {
+            if (nextPrioritized >= ctx.prioritizedEntities.size())
+                break;
+            // Always send something, even if a single entity does not fit in the budget.
+            if (anyProcessed && state->budget.Exhausted())
+            {
+                state->budget.SetLimited(true);
+                break;
+            }
+            next = ctx.prioritizedEntities[nextPrioritized++].second;
+        }
+        else
+        {
+            if (state->dirtyQueue.Empty())
+                break;
+            next = state->dirtyQueue.Front();
+        }
+
+        EntitySyncState& entityState = *next;
+        state->dirtyQueue.Remove(&entityState);
         entityState.isInQueue = false;
+        entityState.lastSentTick = state->syncTick;
+        anyProcessed = true;
+        const size_t bytesQueuedBefore = ctx.bytesQueued;
         
         EntityPtr entity = scene->GetEntity(entityState.id);
         bool removeState = false;
         if (!entity)
         {
             if (!entityState.removed)
-                LogWarning("Entity " + QString::number(entityState.id) + " has gone missing from the scene without the remove properly signalled. Removing from replication state");
+                ctx.LogWarning("Entity " + QString::number(entityState.id) + " has gone missing from the scene without the remove properly signalled. Removing from replication state");
             entityState.isNew = false;
             removeState = true;
         }
@@ -1420,55 +2017,37 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
             // If we have both new & removed flags on the entity, it will probably result in buggy behaviour
             if (entityState.isNew)
             {
-                LogWarning("Entity " + QString::number(entityState.id) + " queued for both deletion and creation. Buggy behaviour will possibly result!");
+                ctx.LogWarning("Entity " + QString::number(entityState.id) + " queued for both deletion and creation. Buggy behaviour will possibly result!");
                 // The delete has been processed. Do not remember it anymore, but requeue the state for creation
                 entityState.removed = false;
                 removeState = false;
-                state->dirtyQueue.push_back(&entityState);
+                state->dirtyQueue.PushBack(&entityState);
                 entityState.isInQueue = true;
             }
             else
                 removeState = true;
             
-            kNet::DataSerializer ds(removeEntityBuffer_, 1024);
+            kNet::DataSerializer ds(ctx.removeEntityBuffer, 1024);
             ds.AddVLE<kNet::VLE8_16_32>(sceneId);
             ds.AddVLE<kNet::VLE8_16_32>(entityState.id & UniqueIdGenerator::LAST_REPLICATED_ID);
-            QueueMessage(destination, cRemoveEntityMessage, true, true, ds);
+            QueueMessage(ctx, destination, cRemoveEntityMessage, true, true, ds);
             ++numMessagesSent;
         }
         // New entity
         else if (entityState.isNew)
         {
-            kNet::DataSerializer ds(createEntityBuffer_, 64 * 1024);
-            
-            // Entity identification and temporary flag
-            ds.AddVLE<kNet::VLE8_16_32>(sceneId);
-            ds.AddVLE<kNet::VLE8_16_32>(entityState.id & UniqueIdGenerator::LAST_REPLICATED_ID);
-            // Do not write the temporary flag as a bit to not desync the byte alignment at this point, as a lot of data potentially follows
-            ds.Add<u8>(entity->IsTemporary() ? 1 : 0);
+            kNet::DataSerializer ds(ctx.createEntityBuffer, 64 * 1024);
+            WriteEntityCreate(ctx, ds, sceneId, entity.get());
             
+            // Mark the components undirty in the receiver's syncstate
             const Entity::ComponentMap& components = entity->Components();
-            // Count the amount of replicated components
-            uint numReplicatedComponents = 0;
             for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
             {
                 if (i->second->IsReplicated())
-                    ++numReplicatedComponents;
+                    state->MarkComponentProcessed(entity->Id(), i->second->Id());
             }
-            ds.AddVLE<kNet::VLE8_16_32>(numReplicatedComponents);
             
-            // Serialize each replicated component
-            for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
-            {
-                ComponentPtr comp = i->second;
-                if (!comp->IsReplicated())
-                    continue;
-                WriteComponentFullUpdate(ds, comp);
-                // Mark the component undirty in the receiver's syncstate
-                state->MarkComponentProcessed(entity->Id(), comp->Id());
-            }
-            
-            QueueMessage(destination, cCreateEntityMessage, true, true, ds);
+            QueueMessage(ctx, destination, cCreateEntityMessage, true, true, ds);
             ++numMessagesSent;
             
             // The create has been processed fully. Clear dirty flags.
@@ -1476,19 +2055,21 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
         }
         else if (entity)
         {
-            if (!entityState.dirtyQueue.empty())
+            if (entityState.HasDirtyComponents())
             {
                 // Components or attributes have been added, changed, or removed. Prepare the dataserializers
-                kNet::DataSerializer removeCompsDs(removeCompsBuffer_, 1024);
-                kNet::DataSerializer removeAttrsDs(removeAttrsBuffer_, 1024);
-                kNet::DataSerializer createCompsDs(createCompsBuffer_, 64 * 1024);
-                kNet::DataSerializer createAttrsDs(createAttrsBuffer_, 16 * 1024);
-                kNet::DataSerializer editAttrsDs(editAttrsBuffer_, 64 * 1024);
+                kNet::DataSerializer removeCompsDs(ctx.removeCompsBuffer, 1024);
+                kNet::DataSerializer removeAttrsDs(ctx.removeAttrsBuffer, 1024);
+                kNet::DataSerializer createCompsDs(ctx.createCompsBuffer, 64 * 1024);
+                kNet::DataSerializer createAttrsDs(ctx.createAttrsBuffer, 16 * 1024);
+                kNet::DataSerializer editAttrsDs(ctx.editAttrsBuffer, 64 * 1024);
                 
-                while (!entityState.dirtyQueue.empty())
+                ctx.removedComponents.clear();
+                for (size_t compIndex = 0; compIndex < entityState.components.Size(); ++compIndex)
                 {
-                    ComponentSyncState& compState = *entityState.dirtyQueue.front();
-                    entityState.dirtyQueue.pop_front();
+                    ComponentSyncState& compState = entityState.components.At(compIndex);
+                    if (!compState.isInQueue)
+                        continue;
                     compState.isInQueue = false;
                     
                     ComponentPtr comp = entity->GetComponentById(compState.id);
@@ -1496,7 +2077,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                     if (!comp)
                     {
                         if (!compState.removed)
-                            LogWarning("Component " + QString::number(compState.id) + " of " + entity->ToString() + " has gone missing from the scene without the remove properly signalled. Removing from client replication state->");
+                            ctx.LogWarning("Component " + QString::number(compState.id) + " of " + entity->ToString() + " has gone missing from the scene without the remove properly signalled. Removing from client replication state->");
                         compState.isNew = false;
                         removeCompState = true;
                     }
@@ -1531,7 +2112,7 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                             createCompsDs.AddVLE<kNet::VLE8_16_32>(entityState.id & UniqueIdGenerator::LAST_REPLICATED_ID);
                         }
                         // Then add the component data
-                        WriteComponentFullUpdate(createCompsDs, comp);
+                        WriteComponentFullUpdate(ctx, createCompsDs, comp);
                         // Mark the component undirty in the receiver's syncstate
                         state->MarkComponentProcessed(entity->Id(), comp->Id());
                     }
@@ -1540,19 +2121,24 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                     {
                         const AttributeVector& attrs = comp->Attributes();
                         
-                        for (std::map<u8, bool>::iterator i = compState.newAndRemovedAttributes.begin(); i != compState.newAndRemovedAttributes.end(); ++i)
+                        const bool hasCreatedOrRemovedAttributes = compState.HasCreatedOrRemovedAttributes();
+                        for (unsigned i = 0; hasCreatedOrRemovedAttributes && i < 256; ++i)
                         {
-                            u8 attrIndex = i->first;
+                            u8 attrIndex = (u8)i;
+                            if (!compState.IsAttributeCreated(attrIndex) && !compState.IsAttributeRemoved(attrIndex))
+                                continue;
+                            const bool created = compState.IsAttributeCreated(attrIndex);
+                            compState.ClearAttributeCreatedOrRemoved(attrIndex);
                             // Clear the corresponding dirty flags, so that we don't redundantly send attribute edited data.
                             compState.dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
                             
-                            if (i->second)
+                            if (created)
                             {
                                 // Create attribute. Make sure it exists and is dynamic.
                                 if (attrIndex >= attrs.size() || !attrs[attrIndex])
-                                    LogError("CreateAttribute for nonexisting attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
+                                    ctx.LogError("CreateAttribute for nonexisting attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
                                 else if (!attrs[attrIndex]->IsDynamic())
-                                    LogError("CreateAttribute for a static attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
+                                    ctx.LogError("CreateAttribute for a static attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
                                 else
                                 {
                                     // If first attribute, write the entity ID first
@@ -1567,7 +2153,10 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                                     createAttrsDs.Add<u8>(attrIndex); // Index
                                     createAttrsDs.Add<u8>(attr->TypeId());
                                     createAttrsDs.AddString(attr->Name().toStdString());
-                                    attr->ToBinary(createAttrsDs);
+                                    if (encodeOnce_)
+                                        fragmentCache_.Attribute(entityState.id, attr, ctx.fragmentBuffer, sizeof(ctx.fragmentBuffer))->AppendTo(createAttrsDs);
+                                    else
+                                        attr->ToBinary(createAttrsDs);
                                 }
                             }
                             else
@@ -1583,10 +2172,9 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                                 removeAttrsDs.Add<u8>(attrIndex);
                             }
                         }
-                        compState.newAndRemovedAttributes.clear();
                         
                         // Now, if remaining dirty bits exist, they must be sent in the edit attributes message. These are the majority of our network data.
-                        changedAttributes_.clear();
+                        ctx.changedAttributes.clear();
                         unsigned numBytes = ((unsigned)attrs.size() + 7) >> 3;
                         for (unsigned i = 0; i < numBytes; ++i)
                         {
@@ -1599,14 +2187,14 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                                     {
                                         u8 attrIndex = i * 8 + j;
                                         if (attrIndex < attrs.size() && attrs[attrIndex])
-                                            changedAttributes_.push_back(attrIndex);
+                                            ctx.changedAttributes.push_back(attrIndex);
                                         else
-                                            LogError("Attribute change for a nonexisting attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
+                                            ctx.LogError("Attribute change for a nonexisting attribute index " + QString::number(attrIndex) + " was queued for component " + comp->TypeName() + " in " + entity->ToString() + ". Discarding.");
                                     }
                                 }
                             }
                         }
-                        if (changedAttributes_.size())
+                        if (ctx.changedAttributes.size())
                         {
                             // If first component for which attribute changes are sent, write the entity ID first
                             if (!editAttrsDs.BytesFilled())
@@ -1616,43 +2204,54 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                             }
                             editAttrsDs.AddVLE<kNet::VLE8_16_32>(compState.id & UniqueIdGenerator::LAST_REPLICATED_ID);
                             
-                            // Create a nested dataserializer for the actual attribute data, so we can skip components
-                            kNet::DataSerializer attrDataDs(attrDataBuffer_, 16 * 1024);
-                            
-                            // There are changed attributes. Check if it is more optimal to send attribute indices, or the whole bitmask
-                            unsigned bitsMethod1 = (unsigned)changedAttributes_.size() * 8 + 8;
-                            unsigned bitsMethod2 = (unsigned)attrs.size();
-                            // Method 1: indices
-                            if (bitsMethod1 <= bitsMethod2)
+                            if (encodeOnce_)
                             {
-                                attrDataDs.Add<kNet::bit>(0);
-                                attrDataDs.Add<u8>((u8)changedAttributes_.size());
-                                for (unsigned i = 0; i < changedAttributes_.size(); ++i)
-                                {
-                                    attrDataDs.Add<u8>(changedAttributes_[i]);
-                                    attrs[changedAttributes_[i]]->ToBinary(attrDataDs);
-                                }
+                                // All users which have the same attributes of this component dirty share the same attribute data.
+                                SyncFragmentPtr body = fragmentCache_.EditAttributesBody(entityState.id, comp.get(), compState.dirtyAttributes, ctx.changedAttributes,
+                                    ctx.fragmentBuffer, sizeof(ctx.fragmentBuffer));
+                                editAttrsDs.AddVLE<kNet::VLE8_16_32>((u32)body->NumBytes());
+                                editAttrsDs.AddArray<u8>(&body->data[0], (u32)body->NumBytes());
                             }
-                            // Method 2: bitmask
                             else
                             {
-                                attrDataDs.Add<kNet::bit>(1);
-                                for (unsigned i = 0; i < attrs.size(); ++i)
+                                // Create a nested dataserializer for the actual attribute data, so we can skip components
+                                kNet::DataSerializer attrDataDs(ctx.attrDataBuffer, 16 * 1024);
+                                
+                                // There are changed attributes. Check if it is more optimal to send attribute indices, or the whole bitmask
+                                unsigned bitsMethod1 = (unsigned)ctx.changedAttributes.size() * 8 + 8;
+                                unsigned bitsMethod2 = (unsigned)attrs.size();
+                                // Method 1: indices
+                                if (bitsMethod1 <= bitsMethod2)
                                 {
-                                    if (compState.dirtyAttributes[i >> 3] & (1 << (i & 7)))
+                                    attrDataDs.Add<kNet::bit>(0);
+                                    attrDataDs.Add<u8>((u8)ctx.changedAttributes.size());
+                                    for (unsigned i = 0; i < ctx.changedAttributes.size(); ++i)
                                     {
-                                        attrDataDs.Add<kNet::bit>(1);
-                                        attrs[i]->ToBinary(attrDataDs);
+                                        attrDataDs.Add<u8>(ctx.changedAttributes[i]);
+                                        attrs[ctx.changedAttributes[i]]->ToBinary(attrDataDs);
                                     }
-                                    else
-                                        attrDataDs.Add<kNet::bit>(0);
                                 }
+                                // Method 2: bitmask
+                                else
+                                {
+                                    attrDataDs.Add<kNet::bit>(1);
+                                    for (unsigned i = 0; i < attrs.size(); ++i)
+                                    {
+                                        if (compState.dirtyAttributes[i >> 3] & (1 << (i & 7)))
+                                        {
+                                            attrDataDs.Add<kNet::bit>(1);
+                                            attrs[i]->ToBinary(attrDataDs);
+                                        }
+                                        else
+                                            attrDataDs.Add<kNet::bit>(0);
+                                    }
+                                }
+                                
+                                // Add the attribute data array to the main serializer
+                                editAttrsDs.AddVLE<kNet::VLE8_16_32>((u32)attrDataDs.BytesFilled());
+                                editAttrsDs.AddArray<u8>((unsigned char*)ctx.attrDataBuffer, (u32)attrDataDs.BytesFilled());
                             }
                             
-                            // Add the attribute data array to the main serializer
-                            editAttrsDs.AddVLE<kNet::VLE8_16_32>((u32)attrDataDs.BytesFilled());
-                            editAttrsDs.AddArray<u8>((unsigned char*)attrDataBuffer_, (u32)attrDataDs.BytesFilled());
-                            
                             // Now zero out all remaining dirty bits
                             for (unsigned i = 0; i < numBytes; ++i)
                                 compState.dirtyAttributes[i] = 0;
@@ -1660,33 +2259,36 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
                     }
                     
                     if (removeCompState)
-                        entityState.components.erase(compState.id);
+                        ctx.removedComponents.push_back(compState.id);
                 }
+                // Erase the removed component states only now, as erasing moves the other states
+                for (size_t i = 0; i < ctx.removedComponents.size(); ++i)
+                    entityState.components.Erase(ctx.removedComponents[i]);
                 
                 // Send the messages which have data
                 if (removeCompsDs.BytesFilled())
                 {
-                    QueueMessage(destination, cRemoveComponentsMessage, true, true, removeCompsDs);
+                    QueueMessage(ctx, destination, cRemoveComponentsMessage, true, true, removeCompsDs);
                     ++numMessagesSent;
                 }
                 if (removeAttrsDs.BytesFilled())
                 {
-                    QueueMessage(destination, cRemoveAttributesMessage, true, true, removeAttrsDs);
+                    QueueMessage(ctx, destination, cRemoveAttributesMessage, true, true, removeAttrsDs);
                     ++numMessagesSent;
                 }
                 if (createCompsDs.BytesFilled())
                 {
-                    QueueMessage(destination, cCreateComponentsMessage, true, true, createCompsDs);
+                    QueueMessage(ctx, destination, cCreateComponentsMessage, true, true, createCompsDs);
                     ++numMessagesSent;
                 }
                 if (createAttrsDs.BytesFilled())
                 {
-                    QueueMessage(destination, cCreateAttributesMessage, true, true, createAttrsDs);
+                    QueueMessage(ctx, destination, cCreateAttributesMessage, true, true, createAttrsDs);
                     ++numMessagesSent;
                 }
                 if (editAttrsDs.BytesFilled())
                 {
-                    QueueMessage(destination, cEditAttributesMessage, true, true, editAttrsDs);
+                    QueueMessage(ctx, destination, cEditAttributesMessage, true, true, editAttrsDs);
                     ++numMessagesSent;
                 }
             }
@@ -1694,11 +2296,11 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
             // Check if entity has other property changes (temporary flag)
             if (entityState.hasPropertyChanges)
             {
-                kNet::DataSerializer editPropertiesDs(editAttrsBuffer_, 1024);
+                kNet::DataSerializer editPropertiesDs(ctx.editAttrsBuffer, 1024);
                 editPropertiesDs.AddVLE<kNet::VLE8_16_32>(sceneId);
                 editPropertiesDs.AddVLE<kNet::VLE8_16_32>(entityState.id & UniqueIdGenerator::LAST_REPLICATED_ID);
                 editPropertiesDs.Add<u8>(entity->IsTemporary() ? 1 : 0);
-                QueueMessage(destination, cEditEntityPropertiesMessage, true, true, editPropertiesDs);
+                QueueMessage(ctx, destination, cEditEntityPropertiesMessage, true, true, editPropertiesDs);
                 ++numMessagesSent;
             }
             
@@ -1706,8 +2308,9 @@ void SyncManager::ProcessSyncState(kNet::MessageConnection* destination, SceneSy
             state->MarkEntityProcessed(entity->Id());
         }
         
+        state->budget.Spend(ctx.bytesQueued - bytesQueuedBefore);
         if (removeState)
-            state->entities.erase(entityState.id);
+            state->entities.Erase(entityState.id);
     }
     //if (numMessagesSent)
     //    std::cout << "Sent " << numMessagesSent << " scenesync messages" << std::endl;
@@ -1949,6 +2552,71 @@ void SyncManager::HandleCreateEntity(kNet::MessageConnection* source, const char
     state->MarkEntityProcessed(entityID);
 }
 
+void SyncManager::HandleSceneSnapshot(kNet::MessageConnection* source, const char* data, size_t numBytes)
+{
+    if (owner_->IsServer())
+    {
+        LogWarning("Received a scene snapshot from a client, disregarding SceneSnapshot message");
+        return;
+    }
+
+    kNet::DataDeserializer ds(data, numBytes);
+    ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    u32 version = ds.Read<u32>();
+    u32 chunkIndex = ds.ReadVLE<kNet::VLE8_16_32>();
+    u32 numChunks = ds.ReadVLE<kNet::VLE8_16_32>();
+    u32 compressedSize = ds.ReadVLE<kNet::VLE8_16_32>();
+    if (compressedSize > ds.BytesLeft())
+    {
+        LogError("Chunk size " + QString::number(compressedSize) + " exceeds the message size, disregarding SceneSnapshot message");
+        return;
+    }
+    QByteArray compressed(compressedSize, 0);
+    if (compressedSize > 0)
+        ds.ReadArray<u8>((u8*)compressed.data(), compressedSize);
+
+    if (chunkIndex >= numChunks)
+    {
+        LogError("Invalid chunk " + QString::number(chunkIndex) + " of " + QString::number(numChunks) + " of scene snapshot version " + QString::number(version) + ", disregarding SceneSnapshot message");
+        return;
+    }
+    // The chunks of a snapshot are sent reliably and in order, one snapshot at a time.
+    if (chunkIndex == 0)
+    {
+        if (receivedSnapshotNextChunk_ != 0)
+            LogWarning("Scene snapshot version " + QString::number(receivedSnapshotVersion_) + " ended after " + QString::number(receivedSnapshotNextChunk_) +
+                " of " + QString::number(receivedSnapshotNumChunks_) + " chunks, the scene may be incomplete.");
+        receivedSnapshotVersion_ = version;
+        receivedSnapshotNumChunks_ = numChunks;
+    }
+    else if (receivedSnapshotNextChunk_ == 0 || version != receivedSnapshotVersion_ || numChunks != receivedSnapshotNumChunks_ || chunkIndex != receivedSnapshotNextChunk_)
+    {
+        LogError("Received chunk " + QString::number(chunkIndex) + " of " + QString::number(numChunks) + " of scene snapshot version " + QString::number(version) +
+            " out of order, disregarding SceneSnapshot message");
+        return;
+    }
+
+    std::vector<QByteArray> records;
+    if (!SceneSnapshot::ReadChunk(compressed, records))
+    {
+        LogError("Failed to decompress chunk " + QString::number(chunkIndex) + " of scene snapshot version " + QString::number(version) + ", disregarding SceneSnapshot message");
+        // The rest of the snapshot is disregarded too.
+        receivedSnapshotNextChunk_ = 0;
+        return;
+    }
+
+    // Each record is the body of a cCreateEntityMessage.
+    for(size_t i = 0; i < records.size(); ++i)
+        HandleCreateEntity(source, records[i].constData(), (size_t)records[i].size());
+
+    receivedSnapshotNextChunk_ = chunkIndex + 1;
+    if (receivedSnapshotNextChunk_ == numChunks)
+    {
+        receivedSnapshotNextChunk_ = 0;
+        LogDebug("SyncManager: Received scene snapshot version " + QString::number(version) + " in " + QString::number(numChunks) + " chunks.");
+    }
+}
+
 void SyncManager::HandleCreateComponents(kNet::MessageConnection* source, const char* data, size_t numBytes)
 {
     assert(source);
@@ -2143,7 +2811,7 @@ void SyncManager::HandleRemoveEntity(kNet::MessageConnection* source, const char
     scene->RemoveEntity(entityID, change);
     // Delete from the sender's syncstate so that we don't echo the delete back needlessly
     state->RemoveFromQueue(entityID); // Be sure to erase from dirty queue so that we don't invoke UDB
-    state->entities.erase(entityID);
+    state->entities.Erase(entityID);
 }
 
 void SyncManager::HandleRemoveComponents(kNet::MessageConnection* source, const char* data, size_t numBytes)
@@ -2193,11 +2861,9 @@ void SyncManager::HandleRemoveComponents(kNet::MessageConnection* source, const
         }
         entity->RemoveComponent(comp, change);
         // Delete from the sender's syncstate, so that we don't echo the delete back needlessly
-        if (state->entities.find(entityID) != state->entities.end())
-        {
-            state->entities[entityID].RemoveFromQueue(compID); // Be sure to erase from dirty queue so that we don't invoke UDB
-            state->entities[entityID].components.erase(compID);
-        }
+        EntitySyncState *entityState = state->entities.Find(entityID);
+        if (entityState)
+            entityState->components.Erase(compID); // Also erases from the dirty queue so that we don't invoke UDB
     }
 }
 
@@ -2281,10 +2947,12 @@ void SyncManager::HandleCreateAttributes(kNet::MessageConnection* source, const
         }
         
         // Remove the corresponding add command from the sender's syncstate, so that the attribute add is not echoed back
-        state->entities[entityID].components[compID].newAndRemovedAttributes.erase(attrIndex);
+        state->entities[entityID].components[compID].ClearAttributeCreatedOrRemoved(attrIndex);
     }
     
-    // Signal attribute changes after creating and reading all
+    // Signal attribute changes after creating and reading all. Signal them immediately even if the scene defers
+    // the attribute changes, so that the dirty bits set by them can be removed. The other changes of the frame stay deferred.
+    scene->SuspendAttributeChangeDeferral();
     for (unsigned i = 0; i < addedAttrs.size(); ++i)
     {
         IComponent* owner = addedAttrs[i]->Owner();
@@ -2293,6 +2961,7 @@ void SyncManager::HandleCreateAttributes(kNet::MessageConnection* source, const
         // Remove the dirty bit from sender's syncstate so that we do not echo the change back
         state->entities[entityID].components[owner->Id()].dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
     }
+    scene->ResumeAttributeChangeDeferral();
 }
 
 void SyncManager::HandleRemoveAttributes(kNet::MessageConnection* source, const char* data, size_t numBytes)
@@ -2345,7 +3014,7 @@ void SyncManager::HandleRemoveAttributes(kNet::MessageConnection* source, const
         
         comp->RemoveAttribute(attrIndex, change);
         // Remove the corresponding remove command from the sender's syncstate, so that the attribute remove is not echoed back
-        state->entities[entityID].components[compID].newAndRemovedAttributes.erase(attrIndex);
+        state->entities[entityID].components[compID].ClearAttributeCreatedOrRemoved(attrIndex);
     }
 }
 
@@ -2387,12 +3056,12 @@ void SyncManager::HandleEditAttributes(kNet::MessageConnection* source, const ch
     
     // Record the update time for calculating the update interval
     float updateInterval = updatePeriod_; // Default update interval if state not found or interval not measured yet
-    std::map<entity_id_t, EntitySyncState>::iterator it = state->entities.find(entityID);
-    if (it != state->entities.end())
+    EntitySyncState *entityState = state->entities.Find(entityID);
+    if (entityState)
     {
-        it->second.UpdateReceived();
-        if (it->second.avgUpdateInterval > 0.0f)
-            updateInterval = it->second.avgUpdateInterval;
+        entityState->UpdateReceived();
+        if (entityState->avgUpdateInterval > 0.0f)
+            updateInterval = entityState->avgUpdateInterval;
     }
     // Add a fudge factor in case there is jitter in packet receipt or the server is too taxed
     updateInterval *= 1.25f;
@@ -2441,9 +3110,9 @@ void SyncManager::HandleEditAttributes(kNet::MessageConnection* source, const ch
                 }
                 else
                 {
-                    IAttribute* endValue = attr->Clone();
+                    IAttribute* endValue = InterpolationEndValue(attr);
                     endValue->FromBinary(attrDs, AttributeChange::Disconnected);
-                    scene->StartAttributeInterpolation(attr, endValue, updateInterval);
+                    scene->InterpolateAttributeTo(attr, endValue, updateInterval);
                 }
             }
         }
@@ -2473,16 +3142,18 @@ void SyncManager::HandleEditAttributes(kNet::MessageConnection* source, const ch
                     }
                     else
                     {
-                        IAttribute* endValue = attr->Clone();
+                        IAttribute* endValue = InterpolationEndValue(attr);
                         endValue->FromBinary(attrDs, AttributeChange::Disconnected);
-                        scene->StartAttributeInterpolation(attr, endValue, updateInterval);
+                        scene->InterpolateAttributeTo(attr, endValue, updateInterval);
                     }
                 }
             }
         }
     }
     
-    // Signal attribute changes after reading all
+    // Signal attribute changes after reading all. Signal them immediately even if the scene defers the attribute
+    // changes, so that the dirty bits set by them can be removed. The other changes of the frame stay deferred.
+    scene->SuspendAttributeChangeDeferral();
     for (unsigned i = 0; i < changedAttrs.size(); ++i)
     {
         IComponent* owner = changedAttrs[i]->Owner();
@@ -2491,6 +3162,7 @@ void SyncManager::HandleEditAttributes(kNet::MessageConnection* source, const ch
         // Remove the dirty bit from sender's syncstate so that we do not echo the change back
         state->entities[entityID].components[owner->Id()].dirtyAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
     }
+    scene->ResumeAttributeChangeDeferral();
 }
 
 void SyncManager::HandleCreateEntityReply(kNet::MessageConnection* source, const char* data, size_t numBytes)
@@ -2518,9 +3190,8 @@ void SyncManager::HandleCreateEntityReply(kNet::MessageConnection* source, const
     entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
     scene->ChangeEntityId(senderEntityID, entityID);
     state->RemoveFromQueue(senderEntityID); // Make sure we don't have stale pointers in the dirty queue
-    state->entities[entityID] = state->entities[senderEntityID]; // Copy the sync state to the new ID
-    state->entities[entityID].id = entityID; // Must remember to change ID manually
-    state->entities.erase(senderEntityID);
+    state->RemoveFromQueue(entityID); // The state of the new ID, if any, is replaced below
+    state->entities.ChangeId(senderEntityID, entityID); // Move the sync state to the new ID
     
     //std::cout << "CreateEntityReply, entity " << senderEntityID << " -> " << entityID << std::endl;
     
@@ -2542,9 +3213,7 @@ void SyncManager::HandleCreateEntityReply(kNet::MessageConnection* source, const
         //std::cout << "CreateEntityReply, component " << senderCompID << " -> " << compID << std::endl;
         
         entity->ChangeComponentId(senderCompID, compID);
-        entityState.components[compID] = entityState.components[senderCompID]; // Copy the sync state to the new ID
-        entityState.components[compID].id = compID; // Must remember to change ID manually
-        entityState.components.erase(senderCompID);
+        entityState.components.ChangeId(senderCompID, compID); // Move the sync state to the new ID
         
         // Send notification
         IComponent* comp = entity->GetComponentById(compID).get();
@@ -2554,10 +3223,10 @@ void SyncManager::HandleCreateEntityReply(kNet::MessageConnection* source, const
     // Send notification
     scene->EmitEntityAcked(entity.get(), senderEntityID);
     
-    for (std::map<component_id_t, ComponentSyncState>::iterator i = entityState.components.begin(); i != entityState.components.end(); ++i)
+    for (ComponentSyncStateMap::iterator i = entityState.components.begin(); i != entityState.components.end(); ++i)
     {
         // Now mark every component dirty so they will be inspected for changes on the next update
-        state->MarkComponentDirty(entityID, i->first);
+        state->MarkComponentDirty(entityID, i->id);
     }
 }
 
@@ -2602,19 +3271,17 @@ void SyncManager::HandleCreateComponentsReply(kNet::MessageConnection* source, c
         //std::cout << "CreateComponentReply, component " << senderCompID << " -> " << compID << std::endl;
         
         entity->ChangeComponentId(senderCompID, compID);
-        entityState.components[compID] = entityState.components[senderCompID]; // Copy the sync state to the new ID
-        entityState.components[compID].id = compID; // Must remember to change ID manually
-        entityState.components.erase(senderCompID);
+        entityState.components.ChangeId(senderCompID, compID); // Move the sync state to the new ID
         
         // Send notification
         IComponent* comp = entity->GetComponentById(compID).get();
         scene->EmitComponentAcked(comp, senderCompID);
     }
     
-    for (std::map<component_id_t, ComponentSyncState>::iterator i = entityState.components.begin(); i != entityState.components.end(); ++i)
+    for (ComponentSyncStateMap::iterator i = entityState.components.begin(); i != entityState.components.end(); ++i)
     {
         // Now mark every component dirty so they will be inspected for changes on the next update
-        state->MarkComponentDirty(entityID, i->first);
+        state->MarkComponentDirty(entityID, i->id);
     }
 }
 
@@ -6,6 +6,9 @@
 #include "TundraProtocolModuleApi.h"
 
 #include "SyncState.h"
+#include "SyncFragmentCache.h"
+#include "SyncWorkerPool.h"
+#include "SceneSnapshot.h"
 #include "SceneFwd.h"
 #include "AttributeChangeType.h"
 #include "EntityAction.h"
@@ -21,6 +24,60 @@ class Framework;
 
 namespace TundraLogic
 {
+/// Scratch buffers and output of a thread processing user sync states.
+/** SyncManager processes the sync states on the main thread with one context. When the sync states are processed
+    in parallel, each worker has its own context in deferred mode: the crafted messages and the log output are collected
+    to the context and flushed from the main thread after all workers have finished. */
+struct SyncWorkContext
+{
+    SyncWorkContext() : deferred(false), bytesQueued(0) {}
+
+    /// A message crafted in deferred mode.
+    struct Message
+    {
+        kNet::MessageConnection *destination;
+        kNet::message_id_t id;
+        bool reliable;
+        bool inOrder;
+        bool fixedPriority; ///< Whether to use the fixed priority of the sync messages, or the kNet default.
+        size_t offset; ///< Offset of the message data in messageData.
+        size_t size; ///< Size of the message data in bytes.
+    };
+
+    /// Log output written in deferred mode.
+    struct LogMessage
+    {
+        bool error; ///< Error if true, warning otherwise.
+        QString text;
+    };
+
+    /// Logs a warning, or stores it if in deferred mode.
+    void LogWarning(const QString &msg);
+    /// Logs an error, or stores it if in deferred mode.
+    void LogError(const QString &msg);
+
+    bool deferred; ///< If true, messages and log output are collected instead of being sent out immediately.
+    size_t bytesQueued; ///< Running count of the message bytes queued or stored with this context. Differences give the bytes sent.
+    std::vector<Message> messages;
+    std::vector<char> messageData;
+    std::vector<LogMessage> log;
+
+    /// Fixed buffers for crafting messages
+    char createEntityBuffer[64 * 1024];
+    char createCompsBuffer[64 * 1024];
+    char editAttrsBuffer[64 * 1024];
+    char createAttrsBuffer[16 * 1024];
+    char attrDataBuffer[16 * 1024];
+    char fragmentBuffer[16 * 1024]; ///< Serialization buffer for SyncFragmentCache.
+    char removeCompsBuffer[1024];
+    char removeEntityBuffer[1024];
+    char removeAttrsBuffer[1024];
+    char rigidBodyBuffer[1400];
+    std::vector<u8> changedAttributes;
+    std::vector<component_id_t> removedComponents;
+    std::vector<std::pair<float, EntitySyncState*> > prioritizedEntities; ///< Dirty entities and their send priorities.
+};
+
 /// Performs synchronization of the changes in a scene between the server and the client.
 /** SyncManager and SceneSyncState combined can be used to implement prioritization logic on how and when
     a sync state is filled per client connection. SyncManager object is only exposed to scripting on the server. */
@@ -53,6 +110,61 @@ public slots:
     /// Get update period
     float GetUpdatePeriod() const { return updatePeriod_; }
 
+    /// Enables or disables the "encode once" mode.
+    /** In encode once mode each dirty attribute and each cEditAttributesMessage body is serialized only once per network tick,
+        and the serialized data is shared between all user connections. Can be enabled from the command line with --syncEncodeOnce. */
+    void SetEncodeOnce(bool enabled);
+
+    /// Returns whether the "encode once" mode is enabled.
+    bool IsEncodeOnce() const { return encodeOnce_; }
+
+    /// Enables or disables the per-connection bandwidth budget.
+    /** With the budget each connection is sent only as much scene sync data on each network tick as its measured
+        throughput and round-trip time allow, see SyncBudget. The dirty entities are sent in the order of their priority,
+        which grows with the relevance factor of the entity and its closeness to the client, and with the time since its
+        changes were last sent. Entities left over stay dirty, so their changes are coalesced into the next update.
+        Can be enabled from the command line with --syncBudget. */
+    void SetBandwidthBudget(bool enabled);
+
+    /// Returns whether the per-connection bandwidth budget is enabled.
+    bool IsBandwidthBudget() const { return bandwidthBudget_; }
+
+    /// Enables or disables sending the scene to joining clients as a compressed snapshot.
+    /** Without the snapshot, every entity of the scene is marked dirty in the sync state of a joining user, and serialized
+        for that user alone, one cCreateEntityMessage at a time. With the snapshot, the server keeps a SceneSnapshot of the
+        replicated entities, serializing again only the entities that have changed since it was last sent, and sends it
+        to the joining user in compressed chunks on the next network tick. The entities of the snapshot are then marked
+        processed in the user's sync state, and their later changes are sent as usual.
+        The snapshot is sent only to the clients that announce support for it with the "client-scene-snapshot" login property,
+        and only if no script is connected to the SceneSyncState::AboutToDirtyEntity signal of the user, as the script could
+        reject or delay entities. It is not sent while an InterestManager is set, as the snapshot holds the whole scene
+        instead of the entities relevant to the user. Can be enabled from the command line with --syncSnapshot. */
+    void SetSceneSnapshot(bool enabled);
+
+    /// Returns whether the joining clients are sent a scene snapshot.
+    bool IsSceneSnapshot() const { return sceneSnapshot_; }
+
+    /// Sets the number of worker threads used to process the sync states of the user connections on the server.
+    /** With 0 threads (the default) the users are processed one after another on the main thread. Otherwise the users
+        are spread across a pool of worker threads, the main thread included. The workers only read the scene, and the
+        messages they craft are sent out from the main thread once all users have been processed.
+        Can be set from the command line with --syncThreads.
+        @param numThreads Number of worker threads in addition to the main thread. If negative, uses one thread less than
+        the number of CPU cores. */
+    void SetSyncThreads(int numThreads);
+
+    /// Returns the number of worker threads used to process the sync states, 0 if processed on the main thread only.
+    int SyncThreads() const { return (int)workerContexts_.size(); }
+
+    /// Measures the server's sync state processing time against the number of connected users.
+    /** Creates simulated sync states for a range of user counts, marks every attribute of every replicated entity
+        in the scene dirty for each of them, and times ProcessSyncState for all users both with and without the
+        "encode once" mode, and with the parallel mode if sync threads are in use. No network messages are sent.
+        The results, along with the memory used by one sync state, are printed to the log.
+        @param maxUsers Maximum number of simulated users.
+        @param userStep Step by which the number of simulated users is increased. */
+    void BenchmarkSync(int maxUsers = 200, int userStep = 20);
+
     /// Returns SceneSyncState for a client connection.
     /** @note This slot is only exposed on Server, other wise will return null ptr.
         @param u32 connection ID of the client. */
@@ -82,6 +194,9 @@ private slots:
     /// Trigger EC sync because of component attributes changing
     void OnAttributeChanged(IComponent* comp, IAttribute* attr, AttributeChange::Type change);
 
+    /// Trigger EC sync because of the deferred attribute changes of a frame being dispatched
+    void OnAttributeChangesDispatched(const DeferredAttributeChangeList &changes);
+
     /// Trigger EC sync because of component attribute added
     void OnAttributeAdded(IComponent* comp, IAttribute* attr, AttributeChange::Type change);
 
@@ -113,14 +228,29 @@ private slots:
     void HandleKristalliMessage(kNet::MessageConnection* source, kNet::packet_id_t, kNet::message_id_t id, const char* data, size_t numBytes);
 
 private:
+    class ParallelSyncTask;
+    friend class ParallelSyncTask;
+    typedef std::vector<std::pair<kNet::MessageConnection*, SceneSyncState*> > SyncJobList;
+
     /// Queue a message to the receiver from a given DataSerializer.
     void QueueMessage(kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, kNet::DataSerializer& ds);
+    /// Queue a message to the receiver, or store it to the context if in deferred mode.
+    /** @param fixedPriority Whether to use the fixed priority of the sync messages, or the kNet default. */
+    void QueueMessage(SyncWorkContext& ctx, kNet::MessageConnection* connection, kNet::message_id_t id, bool reliable, bool inOrder, kNet::DataSerializer& ds, bool fixedPriority = true);
+    /// Sends the messages and prints the log output stored to a context in deferred mode, and clears them.
+    void FlushDeferred(SyncWorkContext& ctx);
     /// Craft a component full update, with all static and dynamic attributes.
-    void WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPtr comp);
+    void WriteComponentFullUpdate(SyncWorkContext& ctx, kNet::DataSerializer& ds, ComponentPtr comp);
+    /// Craft the body of a cCreateEntityMessage, with the full updates of all replicated components of the entity.
+    void WriteEntityCreate(SyncWorkContext& ctx, kNet::DataSerializer& ds, unsigned sceneId, Entity* entity);
+    /// Marks a changed attribute dirty for the network sync, and updates the interest management spatial index and the snapshot.
+    void HandleAttributeChange(IComponent* comp, IAttribute* attr, AttributeChange::Type change);
     /// Handle entity action message.
     void HandleEntityAction(kNet::MessageConnection* source, MsgEntityAction& msg);
     /// Handle create entity message.
     void HandleCreateEntity(kNet::MessageConnection* source, const char* data, size_t numBytes);
+    /// Handle scene snapshot message (client only).
+    void HandleSceneSnapshot(kNet::MessageConnection* source, const char* data, size_t numBytes);
     /// Handle create components message.
     void HandleCreateComponents(kNet::MessageConnection* source, const char* data, size_t numBytes);
     /// Handle a Camera Orientation Update message
@@ -144,7 +274,7 @@ private:
     
     void HandleRigidBodyChanges(kNet::MessageConnection* source, kNet::packet_id_t packetId, const char* data, size_t numBytes);
     
-    void ReplicateRigidBodyChanges(kNet::MessageConnection* destination, SceneSyncState* state);
+    void ReplicateRigidBodyChanges(SyncWorkContext& ctx, kNet::MessageConnection* destination, SceneSyncState* state);
 
     void InterpolateRigidBodies(f64 frametime, SceneSyncState* state);
 
@@ -152,11 +282,41 @@ private:
     void GetClientExtrapolationTime();
 
     /// Process one sync state for changes in the scene
-    /** \todo For now, sends all changed entities/components. In the future, this shall be subject to interest management
-        @param destination MessageConnection where to send the messages
+    /** Sends all changed entities/components, or with the bandwidth budget, as many of them as the budget allows in priority order.
+        @note Can be called from worker threads, so must not modify the scene, nor use the profiler.
+        @param ctx Context providing the scratch buffers. In deferred mode, messages are stored to it instead of being sent.
+        @param destination MessageConnection where to send the messages. If null, the messages are crafted but not sent (benchmarking).
         @param state Syncstate to process */
-    void ProcessSyncState(kNet::MessageConnection* destination, SceneSyncState* state);
+    void ProcessSyncState(SyncWorkContext& ctx, kNet::MessageConnection* destination, SceneSyncState* state);
+
+    /// Replicates rigid body changes and processes the sync states of the users, in parallel if sync threads are in use.
+    void ProcessUserSyncStates(const SyncJobList &jobs);
+
+    /// Starts a new tick of the bandwidth budget of a sync state from the statistics of its connection.
+    /** Called from the main thread before processing the sync state. */
+    void BeginBudgetTick(kNet::MessageConnection* connection, SceneSyncState* state);
+
+    /// Returns the send priority of a dirty entity in a sync state. Higher is sent first.
+    float SendPriority(Scene* scene, SceneSyncState* state, const EntitySyncState& entityState) const;
+
+    /// Marks an entity to be serialized again to the scene snapshot, if the snapshot is in use.
+    void MarkSnapshotDirty(Entity* entity);
+
+    /// Serializes the changed entities to the scene snapshot and compresses the changed chunks.
+    void RefreshSnapshot(Scene* scene);
+
+    /// Sends the scene snapshot to the users that have joined since the last network tick, and marks its entities processed
+    /// in their sync states. If the snapshot has been disabled or an InterestManager set meanwhile, marks the whole scene dirty for them instead.
+    void SendSnapshotToJoinedUsers(Scene* scene);
     
+    /// Marks all attributes of all replicated entities of the scene dirty in @c state, as if everything had changed during one tick.
+    /** Used by BenchmarkSync. */
+    void DirtyAllForBenchmark(SceneSyncState* state);
+
+    /// Returns an unowned attribute of the same type as @c attr, for reading a received interpolation end value into.
+    /** The attributes are reused, as the scene copies the end value. */
+    IAttribute* InterpolationEndValue(IAttribute* attr);
+
     /// Validate the scene manipulation action. If returns false, it is ignored
     /** @param source Where the action came from
         @param messageID Network message id
@@ -191,16 +351,37 @@ private:
     /// Server sync state (client only)
     SceneSyncState server_syncstate_;
     
-    /// Fixed buffers for crafting messages
+    /// Fixed buffers for handling received messages and crafting replies
     char createEntityBuffer_[64 * 1024];
-    char createCompsBuffer_[64 * 1024];
-    char editAttrsBuffer_[64 * 1024];
-    char createAttrsBuffer_[16 * 1024];
     char attrDataBuffer_[16 * 1024];
-    char removeCompsBuffer_[1024];
-    char removeEntityBuffer_[1024];
-    char removeAttrsBuffer_[1024];
-    std::vector<u8> changedAttributes_;
+    /// Attributes for reading received interpolation end values, by attribute type ID.
+    unordered_map<u32, shared_ptr<IAttribute> > interpolationEndValues_;
+
+    /// Context for processing the sync states on the main thread.
+    SyncWorkContext syncContext_;
+    /// Worker threads for parallel sync state processing, null if not in use.
+    SyncWorkerPool *workerPool_;
+    /// Contexts of the worker threads. The main thread, worker 0, uses syncContext_.
+    std::vector<SyncWorkContext*> workerContexts_;
+
+    /// "Encode once" mode enabled.
+    bool encodeOnce_;
+    /// Per-connection bandwidth budget enabled.
+    bool bandwidthBudget_;
+    /// Scene snapshot for joining clients enabled.
+    bool sceneSnapshot_;
+    /// Snapshot of the replicated entities, refreshed when sent.
+    SceneSnapshot snapshot_;
+    /// Users waiting for the scene snapshot to be sent on the next network tick.
+    std::vector<UserConnectionWeakPtr> snapshotJoins_;
+    /// Version of the scene snapshot being received (client only).
+    u32 receivedSnapshotVersion_;
+    /// Number of chunks of the scene snapshot being received (client only).
+    u32 receivedSnapshotNumChunks_;
+    /// Index of the next expected chunk of the scene snapshot being received, or 0 if none is being received (client only).
+    u32 receivedSnapshotNextChunk_;
+    /// Serialized attribute data shared between the user connections during one network tick.
+    SyncFragmentCache fragmentCache_;
 
     InterestManager *interestmanager_;
 };
@@ -15,13 +15,298 @@ typedef std::vector<entity_id_t> EntityIdList;
 typedef EntityIdList::const_iterator PendingConstIter;
 typedef EntityIdList::iterator PendingIter;
 
+#include <algorithm>
+
+// SyncBudget
+
+/// Send rate at the start, in bytes per second.
+static const float cInitialSendRate = 128.f * 1024.f;
+/// The send rate is never cut below this, in bytes per second.
+static const float cMinSendRate = 8.f * 1024.f;
+/// Upper bound for the send rate, in bytes per second.
+static const float cMaxSendRate = 128.f * 1024.f * 1024.f;
+/// Growth of the send rate after a tick limited by the budget.
+static const float cSendRateIncrease = 1.25f;
+/// Cut of the send rate, relative to the measured throughput, when the connection is congested.
+static const float cSendRateDecrease = 0.75f;
+/// The connection is congested if more messages than this are waiting in its outbound queue.
+static const size_t cMaxOutboundPending = 64;
+/// The connection is congested if the round-trip time exceeds the lowest one by this factor and cRttSlackMs.
+static const float cRttCongestionFactor = 2.f;
+static const float cRttSlackMs = 50.f;
+/// A tick may always send at least this many bytes, about one datagram.
+static const size_t cMinTickBytes = 1400;
+
+void SyncBudget::Reset()
+{
+    rate_ = cInitialSendRate;
+    minRtt_ = 0.f;
+    tickBytes_ = cMinTickBytes;
+    spent_ = 0;
+    limited_ = false;
+}
+
+void SyncBudget::BeginTick(float bytesOutPerSec, float rttMs, size_t numOutboundPending, float period)
+{
+    bool congested = numOutboundPending > cMaxOutboundPending;
+    if (rttMs > 0.f)
+    {
+        if (minRtt_ > 0.f && rttMs > minRtt_ * cRttCongestionFactor + cRttSlackMs)
+            congested = true;
+        if (minRtt_ <= 0.f || rttMs < minRtt_)
+            minRtt_ = rttMs;
+        else
+            minRtt_ += (rttMs - minRtt_) * 0.01f;
+    }
+
+    if (congested)
+        rate_ = std::max(std::min(rate_, bytesOutPerSec) * cSendRateDecrease, cMinSendRate);
+    else if (limited_)
+        rate_ = std::min(rate_ * cSendRateIncrease, cMaxSendRate);
+
+    tickBytes_ = std::max((size_t)(rate_ * period), cMinTickBytes);
+    spent_ = 0;
+    limited_ = false;
+}
+
+// ComponentSyncStateMap
+
+ComponentSyncStateMap::iterator ComponentSyncStateMap::LowerBound(component_id_t id)
+{
+    iterator first = states_.begin();
+    size_t count = states_.size();
+    while (count > 0)
+    {
+        size_t step = count / 2;
+        iterator mid = first + step;
+        if (mid->id < id)
+        {
+            first = mid + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+    return first;
+}
+
+ComponentSyncStateMap::const_iterator ComponentSyncStateMap::LowerBound(component_id_t id) const
+{
+    return const_cast<ComponentSyncStateMap*>(this)->LowerBound(id);
+}
+
+ComponentSyncState *ComponentSyncStateMap::Find(component_id_t id)
+{
+    iterator i = LowerBound(id);
+    return (i != states_.end() && i->id == id) ? &*i : 0;
+}
+
+const ComponentSyncState *ComponentSyncStateMap::Find(component_id_t id) const
+{
+    const_iterator i = LowerBound(id);
+    return (i != states_.end() && i->id == id) ? &*i : 0;
+}
+
+ComponentSyncState &ComponentSyncStateMap::operator [](component_id_t id)
+{
+    iterator i = LowerBound(id);
+    if (i != states_.end() && i->id == id)
+        return *i;
+    return *states_.insert(i, ComponentSyncState(id));
+}
+
+void ComponentSyncStateMap::Erase(component_id_t id)
+{
+    iterator i = LowerBound(id);
+    if (i != states_.end() && i->id == id)
+        states_.erase(i);
+}
+
+void ComponentSyncStateMap::ChangeId(component_id_t oldId, component_id_t newId)
+{
+    ComponentSyncState *old = Find(oldId);
+    if (!old || oldId == newId)
+        return;
+    ComponentSyncState moved = *old;
+    moved.id = newId; // Must remember to change ID manually
+    Erase(oldId);
+    (*this)[newId] = moved;
+}
+
+// EntityIdIndex
+
+void EntityIdIndex::Set(entity_id_t id, u32 slot)
+{
+    if (id < cMaxDirectId)
+    {
+        if (id >= direct_.size())
+        {
+            // Grow geometrically, as replicated IDs are allocated sequentially.
+            size_t newSize = std::max((size_t)id + 1, direct_.size() * 2);
+            direct_.resize(std::min(newSize, (size_t)cMaxDirectId), (u32)cInvalidSlot);
+        }
+        direct_[id] = slot;
+    }
+    else
+        overflow_[id] = slot;
+}
+
+void EntityIdIndex::Remove(entity_id_t id)
+{
+    if (id < cMaxDirectId)
+    {
+        if (id < direct_.size())
+            direct_[id] = cInvalidSlot;
+    }
+    else
+        overflow_.erase(id);
+}
+
+void EntityIdIndex::Clear()
+{
+    direct_.clear();
+    overflow_.clear();
+}
+
+size_t EntityIdIndex::MemoryUsage() const
+{
+    // Estimate the hash map with one node (key, value and a next pointer) and one bucket pointer per element.
+    return direct_.capacity() * sizeof(u32) + overflow_.size() * (sizeof(entity_id_t) + sizeof(u32) + 2 * sizeof(void*));
+}
+
+// EntitySyncStateMap
+
+EntitySyncStateMap::EntitySyncStateMap() :
+    size_(0),
+    numSlots_(0)
+{
+}
+
+EntitySyncStateMap::~EntitySyncStateMap()
+{
+    for (size_t i = 0; i < blocks_.size(); ++i)
+        delete[] blocks_[i];
+}
+
+EntitySyncState &EntitySyncStateMap::operator [](entity_id_t id)
+{
+    u32 slot = index_.Find(id);
+    if (slot != EntityIdIndex::cInvalidSlot)
+        return Slot(slot);
+
+    if (!freeSlots_.empty())
+    {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    else
+    {
+        slot = numSlots_++;
+        if (slot / cBlockSize >= blocks_.size())
+            blocks_.push_back(new EntitySyncState[cBlockSize]);
+    }
+
+    index_.Set(id, slot);
+    ++size_;
+    EntitySyncState &state = Slot(slot);
+    state.id = id;
+    return state;
+}
+
+void EntitySyncStateMap::Erase(entity_id_t id)
+{
+    u32 slot = index_.Find(id);
+    if (slot == EntityIdIndex::cInvalidSlot)
+        return;
+
+    EntitySyncState &state = Slot(slot);
+    assert(!state.prevDirty && !state.nextDirty && "Erasing an entity sync state which is still in the dirty queue!");
+    state = EntitySyncState(); // Resets also the ID, which marks the slot free
+    index_.Remove(id);
+    freeSlots_.push_back(slot);
+    --size_;
+}
+
+void EntitySyncStateMap::ChangeId(entity_id_t oldId, entity_id_t newId)
+{
+    u32 slot = index_.Find(oldId);
+    if (slot == EntityIdIndex::cInvalidSlot || oldId == newId)
+        return;
+
+    Erase(newId);
+    index_.Remove(oldId);
+    index_.Set(newId, slot);
+    Slot(slot).id = newId; // Must remember to change ID manually
+}
+
+void EntitySyncStateMap::Clear()
+{
+    for (size_t i = 0; i < blocks_.size(); ++i)
+        delete[] blocks_[i];
+    blocks_.clear();
+    freeSlots_.clear();
+    index_.Clear();
+    size_ = 0;
+    numSlots_ = 0;
+}
+
+size_t EntitySyncStateMap::MemoryUsage() const
+{
+    size_t bytes = blocks_.size() * cBlockSize * sizeof(EntitySyncState) + blocks_.capacity() * sizeof(EntitySyncState*) +
+        freeSlots_.capacity() * sizeof(u32) + index_.MemoryUsage();
+    for (u32 i = 0; i < numSlots_; ++i)
+        bytes += Slot(i).components.MemoryUsage();
+    return bytes;
+}
+
+// EntityInterestTable
+
+u32 EntityInterestTable::Slot(entity_id_t id)
+{
+    u32 slot = index_.Find(id);
+    if (slot == EntityIdIndex::cInvalidSlot)
+    {
+        slot = (u32)visibility_.size();
+        index_.Set(id, slot);
+        visibility_.push_back((u8)VisibilityUnknown);
+        relevance_.push_back(-1.f);
+        lastUpdated_.push_back(0.f);
+        lastRaycasted_.push_back(0.f);
+        raycastPending_.push_back(0);
+        inRangeTick_.push_back(0);
+    }
+    return slot;
+}
+
+void EntityInterestTable::Clear()
+{
+    index_.Clear();
+    visibility_.clear();
+    relevance_.clear();
+    lastUpdated_.clear();
+    lastRaycasted_.clear();
+    raycastPending_.clear();
+    inRangeTick_.clear();
+    interestTick_ = 0;
+}
+
+size_t EntityInterestTable::MemoryUsage() const
+{
+    return index_.MemoryUsage() + (visibility_.capacity() + raycastPending_.capacity()) * sizeof(u8) +
+        (relevance_.capacity() + lastUpdated_.capacity() + lastRaycasted_.capacity()) * sizeof(float) +
+        inRangeTick_.capacity() * sizeof(u32);
+}
+
+// SceneSyncState
+
 SceneSyncState::SceneSyncState(u32 userConnectionID, bool isServer) :
     userConnectionID_(userConnectionID),
     changeRequest_(userConnectionID),
     isServer_(isServer),
     locationInitialized(false),
     clientLocation(float3::nan),
-    initialLocation(float3::nan)
+    initialLocation(float3::nan),
+    syncTick(0)
 {
     Clear();
 }
@@ -81,8 +366,7 @@ void SceneSyncState::MarkEntityPending(entity_id_t id)
 
     // If user does not have the entity in the first place, do nothing.
     // Its going to be asked to be added to the state via the permission signals later.
-    std::map<entity_id_t, EntitySyncState>::iterator i = entities.find(id);
-    if (i == entities.end())
+    if (!entities.Find(id))
         return;
 
     MarkEntityRemoved(id);  // Remove from current sync state (removes entity from client)
@@ -133,53 +417,41 @@ void SceneSyncState::SetParentScene(SceneWeakPtr scene)
 
 void SceneSyncState::Clear()
 {
-    dirtyQueue.clear();
-    entities.clear();
+    dirtyQueue.Clear();
+    entities.Clear();
+    interest.Clear();
+    budget.Reset();
     pendingEntities_.clear();
     changeRequest_.Reset();
     scene_.reset();
 }
 
+size_t SceneSyncState::MemoryUsage() const
+{
+    return sizeof(SceneSyncState) + entities.MemoryUsage() + interest.MemoryUsage() + pendingEntities_.capacity() * sizeof(entity_id_t) +
+        entityInterpolations.size() * (sizeof(std::pair<entity_id_t, RigidBodyInterpolationState>) + 4 * sizeof(void*));
+}
+
 void SceneSyncState::RemoveFromQueue(entity_id_t id)
 {
-    std::map<entity_id_t, EntitySyncState>::iterator i = entities.find(id);
-    if (i != entities.end())
+    EntitySyncState *entityState = entities.Find(id);
+    if (entityState && entityState->isInQueue)
     {
-        if (i->second.isInQueue)
-        {
-            for (std::list<EntitySyncState*>::iterator j = dirtyQueue.begin(); j != dirtyQueue.end(); ++j)
-            {
-                if ((*j) == &i->second)
-                {
-                    dirtyQueue.erase(j);
-                    break;
-                }
-            }
-            i->second.isInQueue = false;
-            for (std::map<component_id_t, ComponentSyncState>::iterator j = i->second.components.begin(); j != i->second.components.end(); ++j)
-                j->second.isInQueue = false;
-            i->second.dirtyQueue.clear();
-        }
+        dirtyQueue.Remove(entityState);
+        entityState->isInQueue = false;
+        for (ComponentSyncStateMap::iterator j = entityState->components.begin(); j != entityState->components.end(); ++j)
+            j->isInQueue = false;
     }
 }
 
 void SceneSyncState::MarkEntityProcessed(entity_id_t id)
 {
-    EntitySyncState& entityState = entities[id];
-    if (!entityState.id)
-        entityState.id = id;
-    entityState.DirtyProcessed();
+    entities[id].DirtyProcessed();
 }
 
 void SceneSyncState::MarkComponentProcessed(entity_id_t id, component_id_t compId)
 {
-    EntitySyncState& entityState = entities[id];
-    if (!entityState.id)
-        entityState.id = id;
-    ComponentSyncState& compState = entityState.components[compId];
-    if (!compState.id)
-        compState.id = compId;
-    compState.DirtyProcessed();
+    entities[id].components[compId].DirtyProcessed();
 }
 
 void SceneSyncState::MarkEntityDirty(entity_id_t id, bool hasPropertyChanges)
@@ -192,11 +464,9 @@ void SceneSyncState::MarkEntityDirty(entity_id_t id, bool hasPropertyChanges)
         return;
 
     EntitySyncState& entityState = entities[id]; // Creates new if did not exist
-    if (!entityState.id)
-        entityState.id = id;
     if (!entityState.isInQueue)
     {
-        dirtyQueue.push_back(&entityState);
+        dirtyQueue.PushBack(&entityState);
         entityState.isInQueue = true;
     }
     if (hasPropertyChanges)
@@ -210,22 +480,22 @@ void SceneSyncState::MarkEntityRemoved(entity_id_t id)
         RemovePendingEntity(id);
 
     // If user did not have the entity in the first place, do nothing
-    std::map<entity_id_t, EntitySyncState>::iterator i = entities.find(id);
-    if (i == entities.end())
+    EntitySyncState *entityState = entities.Find(id);
+    if (!entityState)
         return;
     // If entity is marked new, it was not sent yet and can be simply removed from the sync state
-    if (i->second.isNew)
+    if (entityState->isNew)
     {
         RemoveFromQueue(id);
-        entities.erase(id);
+        entities.Erase(id);
         return;
     }
     // Else mark as removed and queue the update
-    i->second.removed = true;
-    if (!i->second.isInQueue)
+    entityState->removed = true;
+    if (!entityState->isInQueue)
     {
-        dirtyQueue.push_back(&i->second);
-        i->second.isInQueue = true;
+        dirtyQueue.PushBack(entityState);
+        entityState->isInQueue = true;
     }
 }
 
@@ -235,46 +505,40 @@ void SceneSyncState::MarkComponentDirty(entity_id_t id, component_id_t compId)
         return;
 
     MarkEntityDirty(id);
-    EntitySyncState& entityState = entities[id]; // Creates new if did not exist
-    if (!entityState.id)
-        entityState.id = id;
-    entityState.MarkComponentDirty(compId);
+    entities[id].MarkComponentDirty(compId); // Creates new if did not exist
 }
 
 void SceneSyncState::MarkComponentRemoved(entity_id_t id, component_id_t compId)
 {
     // If user did not have the entity or component in the first place, do nothing
-    std::map<entity_id_t, EntitySyncState>::iterator i = entities.find(id);
-    if (i == entities.end())
+    EntitySyncState *entityState = entities.Find(id);
+    if (!entityState)
         return;
     MarkEntityDirty(id);
-    i->second.MarkComponentRemoved(compId);
+    entityState->MarkComponentRemoved(compId);
 }
 
 void SceneSyncState::MarkAttributeDirty(entity_id_t id, component_id_t compId, u8 attrIndex)
 {
     MarkEntityDirty(id);
-    EntitySyncState& entityState = entities[id];
-    entityState.MarkComponentDirty(compId);
-    ComponentSyncState& compState = entityState.components[compId];
+    ComponentSyncState& compState = entities[id].components[compId];
+    compState.isInQueue = true;
     compState.MarkAttributeDirty(attrIndex);
 }
 
 void SceneSyncState::MarkAttributeCreated(entity_id_t id, component_id_t compId, u8 attrIndex)
 {
     MarkEntityDirty(id);
-    EntitySyncState& entityState = entities[id];
-    entityState.MarkComponentDirty(compId);
-    ComponentSyncState& compState = entityState.components[compId];
+    ComponentSyncState& compState = entities[id].components[compId];
+    compState.isInQueue = true;
     compState.MarkAttributeCreated(attrIndex);
 }
 
 void SceneSyncState::MarkAttributeRemoved(entity_id_t id, component_id_t compId, u8 attrIndex)
 {
     MarkEntityDirty(id);
-    EntitySyncState& entityState = entities[id];
-    entityState.MarkComponentDirty(compId);
-    ComponentSyncState& compState = entityState.components[compId];
+    ComponentSyncState& compState = entities[id].components[compId];
+    compState.isInQueue = true;
     compState.MarkAttributeRemoved(attrIndex);
 }
 
@@ -292,8 +556,7 @@ bool SceneSyncState::ShouldMarkAsDirty(entity_id_t id)
     // Only request if this entity does not have a sync state yet.
     // Otherwise this id will spam the signal handler on every change if
     // the addition to sync state was accepted.
-    std::map<entity_id_t, EntitySyncState>::iterator i = entities.find(id);
-    if (i == entities.end())
+    if (!entities.Find(id))
     {
         PROFILE(SyncState_Emit_AboutToDirtyEntity);
         
@@ -324,6 +587,11 @@ void SceneSyncState::RemovePendingEntity(entity_id_t id)
     }
 }
 
+bool SceneSyncState::HasChangeRequestListeners() const
+{
+    return receivers(SIGNAL(AboutToDirtyEntity(StateChangeRequest*))) > 0;
+}
+
 bool SceneSyncState::FillRequest(entity_id_t id)
 {
     changeRequest_.Reset(id);
@@ -380,11 +648,9 @@ void SceneSyncState::AddPendingEntity(entity_id_t id)
 EntitySyncState& SceneSyncState::MarkEntityDirtySilent(entity_id_t id)
 {
     EntitySyncState& entityState = entities[id]; // Creates new if did not exist
-    if (!entityState.id)
-        entityState.id = id;
     if (!entityState.isInQueue)
     {
-        dirtyQueue.push_back(&entityState);
+        dirtyQueue.PushBack(&entityState);
         entityState.isInQueue = true;
     }
     return entityState;
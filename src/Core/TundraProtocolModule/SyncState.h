@@ -18,18 +18,19 @@
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
+#include <cassert>
 
 /// Component's per-user network sync state
 struct ComponentSyncState
 {
-    ComponentSyncState() :
+    explicit ComponentSyncState(component_id_t compId = 0) :
         removed(false),
         isNew(true),
         isInQueue(false),
-        id(0)
+        id(compId)
     {
-        for (unsigned i = 0; i < 32; ++i)
-            dirtyAttributes[i] = 0;
+        ClearBits();
     }
     
     void MarkAttributeDirty(u8 attrIndex)
@@ -39,28 +40,100 @@ struct ComponentSyncState
     
     void MarkAttributeCreated(u8 attrIndex)
     {
-        newAndRemovedAttributes[attrIndex] = true;
+        createdAttributes[attrIndex >> 3] |= (1 << (attrIndex & 7));
+        removedAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
     }
     
     void MarkAttributeRemoved(u8 attrIndex)
     {
-        newAndRemovedAttributes[attrIndex] = false;
+        removedAttributes[attrIndex >> 3] |= (1 << (attrIndex & 7));
+        createdAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
+    }
+
+    /// Forgets a pending create or remove of a dynamic attribute.
+    void ClearAttributeCreatedOrRemoved(u8 attrIndex)
+    {
+        createdAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
+        removedAttributes[attrIndex >> 3] &= ~(1 << (attrIndex & 7));
+    }
+
+    bool IsAttributeCreated(u8 attrIndex) const { return (createdAttributes[attrIndex >> 3] & (1 << (attrIndex & 7))) != 0; }
+    bool IsAttributeRemoved(u8 attrIndex) const { return (removedAttributes[attrIndex >> 3] & (1 << (attrIndex & 7))) != 0; }
+
+    /// Returns whether any dynamic attributes have been created or removed since last update.
+    bool HasCreatedOrRemovedAttributes() const
+    {
+        for (unsigned i = 0; i < 32; ++i)
+            if (createdAttributes[i] | removedAttributes[i])
+                return true;
+        return false;
     }
     
     void DirtyProcessed()
+    {
+        ClearBits();
+        isNew = false;
+    }
+
+    void ClearBits()
     {
         for (unsigned i = 0; i < 32; ++i)
+        {
             dirtyAttributes[i] = 0;
-        newAndRemovedAttributes.clear();
-        isNew = false;
+            createdAttributes[i] = 0;
+            removedAttributes[i] = 0;
+        }
     }
     
     u8 dirtyAttributes[32]; ///< Dirty attributes bitfield. A maximum of 256 attributes are supported.
-    std::map<u8, bool> newAndRemovedAttributes; ///< Dynamic attributes by index that have been removed or created since last update. True = create, false = delete
+    u8 createdAttributes[32]; ///< Dynamic attributes that have been created since last update, bitfield.
+    u8 removedAttributes[32]; ///< Dynamic attributes that have been removed since last update, bitfield.
     component_id_t id; ///< Component ID. Duplicated here intentionally to allow recognizing the component without the parent map.
     bool removed; ///< The component has been removed since last update
     bool isNew; ///< The client does not have the component and it must be serialized in full
-    bool isInQueue; ///< The component is already in the entity's dirty queue
+    bool isInQueue; ///< The component is dirty and will be processed on the next update
+};
+
+/// Component sync states of an entity, stored contiguously and sorted by component ID.
+/** Entities typically have only a handful of components, so a sorted vector is both smaller and faster to search than a map.
+    @note Inserting a new state with operator[] invalidates pointers and references to the other states. */
+class TUNDRAPROTOCOL_MODULE_API ComponentSyncStateMap
+{
+public:
+    typedef std::vector<ComponentSyncState>::iterator iterator;
+    typedef std::vector<ComponentSyncState>::const_iterator const_iterator;
+
+    iterator begin() { return states_.begin(); }
+    iterator end() { return states_.end(); }
+    const_iterator begin() const { return states_.begin(); }
+    const_iterator end() const { return states_.end(); }
+    size_t Size() const { return states_.size(); }
+    bool Empty() const { return states_.empty(); }
+    ComponentSyncState &At(size_t index) { return states_[index]; }
+
+    /// Returns the state of a component, or null if not found.
+    ComponentSyncState *Find(component_id_t id);
+    const ComponentSyncState *Find(component_id_t id) const; ///< @overload
+
+    /// Returns the state of a component, creating it if it does not exist.
+    ComponentSyncState &operator [](component_id_t id);
+
+    /// Removes the state of a component.
+    void Erase(component_id_t id);
+
+    /// Moves the state of a component to a new ID, f.ex. when an unacked component receives its final ID.
+    void ChangeId(component_id_t oldId, component_id_t newId);
+
+    void Clear() { states_.clear(); }
+
+    /// Returns heap memory used by the states in bytes.
+    size_t MemoryUsage() const { return states_.capacity() * sizeof(ComponentSyncState); }
+
+private:
+    iterator LowerBound(component_id_t id);
+    const_iterator LowerBound(component_id_t id) const;
+
+    std::vector<ComponentSyncState> states_;
 };
 
 /// Entity's per-user network sync state
@@ -72,72 +145,58 @@ struct EntitySyncState
         isInQueue(false),
         hasPropertyChanges(false),
         id(0),
-        avgUpdateInterval(0.0f)
+        avgUpdateInterval(0.0f),
+        lastSentTick(0),
+        prevDirty(0),
+        nextDirty(0)
     {
     }
     
     void RemoveFromQueue(component_id_t id)
     {
-        std::map<component_id_t, ComponentSyncState>::iterator i = components.find(id);
-        if (i != components.end())
-        {
-            if (i->second.isInQueue)
-            {
-                for (std::list<ComponentSyncState*>::iterator j = dirtyQueue.begin(); j != dirtyQueue.end(); ++j)
-                {
-                    if ((*j) == &i->second)
-                    {
-                        dirtyQueue.erase(j);
-                        break;
-                    }
-                }
-                i->second.isInQueue = false;
-            }
-        }
+        ComponentSyncState *compState = components.Find(id);
+        if (compState)
+            compState->isInQueue = false;
     }
     
     void MarkComponentDirty(component_id_t id)
     {
-        ComponentSyncState& compState = components[id]; // Creates new if did not exist
-        if (!compState.id)
-            compState.id = id;
-        if (!compState.isInQueue)
-        {
-            dirtyQueue.push_back(&compState);
-            compState.isInQueue = true;
-        }
+        components[id].isInQueue = true; // Creates new if did not exist
     }
     
     void MarkComponentRemoved(component_id_t id)
     {
         // If user did not have the component in the first place, do nothing
-        std::map<component_id_t, ComponentSyncState>::iterator i = components.find(id);
-        if (i == components.end())
+        ComponentSyncState *compState = components.Find(id);
+        if (!compState)
             return;
         // If component is marked new, it was not sent yet and can be simply removed from the sync state
-        if (i->second.isNew)
+        if (compState->isNew)
         {
-            RemoveFromQueue(id);
-            components.erase(id);
+            components.Erase(id);
             return;
         }
         // Else mark as removed and queue the update
-        i->second.removed = true;
-        if (!i->second.isInQueue)
-        {
-            dirtyQueue.push_back(&i->second);
-            i->second.isInQueue = true;
-        }
+        compState->removed = true;
+        compState->isInQueue = true;
+    }
+
+    /// Returns whether any of the components are dirty.
+    bool HasDirtyComponents() const
+    {
+        for (ComponentSyncStateMap::const_iterator i = components.begin(); i != components.end(); ++i)
+            if (i->isInQueue)
+                return true;
+        return false;
     }
     
     void DirtyProcessed()
     {
-        for (std::map<component_id_t, ComponentSyncState>::iterator i = components.begin(); i != components.end(); ++i)
+        for (ComponentSyncStateMap::iterator i = components.begin(); i != components.end(); ++i)
         {
-            i->second.DirtyProcessed();
-            i->second.isInQueue = false;
+            i->DirtyProcessed();
+            i->isInQueue = false;
         }
-        dirtyQueue.clear();
         isNew = false;
         hasPropertyChanges = false;
     }
@@ -156,8 +215,7 @@ struct EntitySyncState
             avgUpdateInterval = 0.5 * time + 0.5 * avgUpdateInterval;
     }
     
-    std::list<ComponentSyncState*> dirtyQueue; ///< Dirty components
-    std::map<component_id_t, ComponentSyncState> components; ///< Component syncstates
+    ComponentSyncStateMap components; ///< Component syncstates. Dirty components have the isInQueue flag set.
     entity_id_t id; ///< Entity ID. Duplicated here intentionally to allow recognizing the entity without the parent map.
     bool removed; ///< The entity has been removed since last update
     bool isNew; ///< The client does not have the entity and it must be serialized in full
@@ -173,6 +231,278 @@ struct EntitySyncState
     float3 linearVelocity;
     float3 angularVelocity;
     kNet::tick_t lastNetworkSendTime;
+
+    u32 lastSentTick; ///< SceneSyncState::syncTick on which the changes of the entity were last sent. Ages the send priority.
+
+    EntitySyncState *prevDirty; ///< Previous entity in the dirty queue. Managed by EntitySyncStateQueue.
+    EntitySyncState *nextDirty; ///< Next entity in the dirty queue. Managed by EntitySyncStateQueue.
+};
+
+/// Maps entity IDs to dense slot indices.
+/** Replicated IDs, which are allocated sequentially, are looked up from a flat array. IDs outside of the array range
+    (unacked and local IDs, or very large replicated IDs) fall back to a hash map. */
+class TUNDRAPROTOCOL_MODULE_API EntityIdIndex
+{
+public:
+    static const u32 cInvalidSlot = 0xffffffff;
+    /// Entity IDs below this are stored in the flat array. Limits the array to 1MB per index.
+    static const entity_id_t cMaxDirectId = 1 << 18;
+
+    /// Returns the slot of an entity ID, or cInvalidSlot if not found.
+    u32 Find(entity_id_t id) const
+    {
+        if (id < cMaxDirectId)
+        {
+            if (id < direct_.size())
+                return direct_[id];
+        }
+        else
+        {
+            unordered_map<entity_id_t, u32>::const_iterator i = overflow_.find(id);
+            if (i != overflow_.end())
+                return i->second;
+        }
+        return cInvalidSlot;
+    }
+
+    void Set(entity_id_t id, u32 slot);
+    void Remove(entity_id_t id);
+    void Clear();
+
+    /// Returns heap memory used by the index in bytes (approximate for the hash map part).
+    size_t MemoryUsage() const;
+
+private:
+    std::vector<u32> direct_;
+    unordered_map<entity_id_t, u32> overflow_;
+};
+
+/// Entity sync states of a SceneSyncState.
+/** The states are stored in fixed-size blocks so that pointers to them stay valid while other states are created or removed.
+    Slots of removed states are reused. Lookup by entity ID goes through EntityIdIndex. */
+class TUNDRAPROTOCOL_MODULE_API EntitySyncStateMap
+{
+public:
+    EntitySyncStateMap();
+    ~EntitySyncStateMap();
+
+    /// Returns the state of an entity, or null if not found.
+    EntitySyncState *Find(entity_id_t id)
+    {
+        u32 slot = index_.Find(id);
+        return slot != EntityIdIndex::cInvalidSlot ? &Slot(slot) : 0;
+    }
+
+    /// Returns the state of an entity, creating it if it does not exist.
+    EntitySyncState &operator [](entity_id_t id);
+
+    /// Removes the state of an entity. The state must not be in a dirty queue.
+    void Erase(entity_id_t id);
+
+    /// Moves the state of an entity to a new ID, f.ex. when an unacked entity receives its final ID.
+    /** If a state for the new ID already exists, it is replaced. Neither state must be in a dirty queue. */
+    void ChangeId(entity_id_t oldId, entity_id_t newId);
+
+    /// Removes all states.
+    void Clear();
+
+    /// Returns number of entity states.
+    size_t Size() const { return size_; }
+
+    /// Returns number of slots, including free ones. Use with SlotAt to iterate all states.
+    size_t NumSlots() const { return numSlots_; }
+
+    /// Returns the state in the slot, or null if the slot is free.
+    EntitySyncState *SlotAt(size_t slot) { EntitySyncState &s = Slot((u32)slot); return s.id ? &s : 0; }
+
+    /// Returns heap memory used by the states and the index in bytes, including the component states.
+    size_t MemoryUsage() const;
+
+private:
+    static const u32 cBlockSize = 256;
+
+    EntitySyncState &Slot(u32 slot) { return blocks_[slot / cBlockSize][slot % cBlockSize]; }
+    const EntitySyncState &Slot(u32 slot) const { return blocks_[slot / cBlockSize][slot % cBlockSize]; }
+
+    std::vector<EntitySyncState*> blocks_;
+    std::vector<u32> freeSlots_;
+    EntityIdIndex index_;
+    size_t size_;
+    u32 numSlots_;
+
+    // Noncopyable
+    EntitySyncStateMap(const EntitySyncStateMap &);
+    void operator =(const EntitySyncStateMap &);
+};
+
+/// FIFO queue of dirty entity sync states, linked through the states themselves.
+/** Pushing, popping and removing from the middle of the queue are all O(1) and never allocate. */
+class TUNDRAPROTOCOL_MODULE_API EntitySyncStateQueue
+{
+public:
+    EntitySyncStateQueue() : head_(0), tail_(0), size_(0) {}
+
+    bool Empty() const { return head_ == 0; }
+    size_t Size() const { return size_; }
+    /// Returns the first state in the queue. Iterate the queue with EntitySyncState::nextDirty.
+    EntitySyncState *Front() const { return head_; }
+
+    /// Adds a state to the back of the queue. The state must not be in a queue already.
+    void PushBack(EntitySyncState *state)
+    {
+        assert(!state->prevDirty && !state->nextDirty && head_ != state);
+        state->prevDirty = tail_;
+        state->nextDirty = 0;
+        if (tail_)
+            tail_->nextDirty = state;
+        else
+            head_ = state;
+        tail_ = state;
+        ++size_;
+    }
+
+    /// Removes the first state from the queue.
+    void PopFront()
+    {
+        if (head_)
+            Remove(head_);
+    }
+
+    /// Removes a state from the queue.
+    void Remove(EntitySyncState *state)
+    {
+        if (state->prevDirty)
+            state->prevDirty->nextDirty = state->nextDirty;
+        else
+            head_ = state->nextDirty;
+        if (state->nextDirty)
+            state->nextDirty->prevDirty = state->prevDirty;
+        else
+            tail_ = state->prevDirty;
+        state->prevDirty = state->nextDirty = 0;
+        --size_;
+    }
+
+    /// Empties the queue. Does not touch the isInQueue flags of the states.
+    void Clear()
+    {
+        while (head_)
+            Remove(head_);
+    }
+
+private:
+    EntitySyncState *head_;
+    EntitySyncState *tail_;
+    size_t size_;
+};
+
+/// Byte budget of the scene sync messages sent to one connection on each network tick.
+/** The send rate is adapted on each tick to the measured state of the connection. It grows by a fixed factor after a tick
+    on which data was left unsent because of the budget, as long as the connection keeps up. When the outbound message
+    queue of the connection backs up, or the round-trip time rises well above the lowest measured one, a sign of queuing
+    along the route, the rate is cut below the measured outbound throughput. */
+class TUNDRAPROTOCOL_MODULE_API SyncBudget
+{
+public:
+    SyncBudget() { Reset(); }
+
+    /// Returns to the initial send rate.
+    void Reset();
+
+    /// Adapts the send rate and starts a new tick.
+    /** @param bytesOutPerSec Measured outbound throughput of the connection.
+        @param rttMs Measured round-trip time of the connection in milliseconds, or 0 if not known.
+        @param numOutboundPending Number of messages waiting in the outbound queue of the connection.
+        @param period Length of the network tick in seconds. */
+    void BeginTick(float bytesOutPerSec, float rttMs, size_t numOutboundPending, float period);
+
+    /// Counts bytes sent on this tick against the budget.
+    void Spend(size_t numBytes) { spent_ += numBytes; }
+
+    /// Returns whether the budget of this tick has been used up.
+    bool Exhausted() const { return spent_ >= tickBytes_; }
+
+    /// Records whether data was left unsent on this tick because of the budget, which allows the rate to grow.
+    void SetLimited(bool limited) { limited_ = limited; }
+
+    /// Returns the current send rate in bytes per second.
+    float Rate() const { return rate_; }
+
+    /// Returns the budget of this tick in bytes.
+    size_t TickBytes() const { return tickBytes_; }
+
+private:
+    float rate_;
+    float minRtt_; ///< Lowest measured round-trip time, drifts slowly up to adapt to route changes.
+    size_t tickBytes_;
+    size_t spent_;
+    bool limited_;
+};
+
+/// Per-entity interest management data of a SceneSyncState, stored as a structure of arrays.
+/** @remarks InterestManager functionality */
+class TUNDRAPROTOCOL_MODULE_API EntityInterestTable
+{
+public:
+    EntityInterestTable() : interestTick_(0), interestCenter_(float3::zero) {}
+
+    enum Visibility
+    {
+        VisibilityUnknown = 0,
+        Visible,
+        Hidden
+    };
+
+    /// Returns the last raycasted visibility of an entity.
+    Visibility EntityVisibility(entity_id_t id) const { u32 slot = index_.Find(id); return slot != EntityIdIndex::cInvalidSlot ? (Visibility)visibility_[slot] : VisibilityUnknown; }
+    void SetEntityVisible(entity_id_t id, bool visible) { visibility_[Slot(id)] = (u8)(visible ? Visible : Hidden); }
+
+    /// Returns the relevance factor of an entity, or -1 if not known.
+    float Relevance(entity_id_t id) const { u32 slot = index_.Find(id); return slot != EntityIdIndex::cInvalidSlot ? relevance_[slot] : -1.f; }
+    void SetRelevance(entity_id_t id, float relevance) { relevance_[Slot(id)] = relevance; }
+
+    /// Returns the timestamp of last update of an entity, or 0 if not updated yet.
+    float LastUpdated(entity_id_t id) const { u32 slot = index_.Find(id); return slot != EntityIdIndex::cInvalidSlot ? lastUpdated_[slot] : 0.f; }
+    void SetLastUpdated(entity_id_t id, float time) { lastUpdated_[Slot(id)] = time; }
+
+    /// Returns the timestamp of last raycast of an entity, or 0 if not raycasted yet.
+    float LastRaycasted(entity_id_t id) const { u32 slot = index_.Find(id); return slot != EntityIdIndex::cInvalidSlot ? lastRaycasted_[slot] : 0.f; }
+    void SetLastRaycasted(entity_id_t id, float time) { lastRaycasted_[Slot(id)] = time; }
+
+    /// Returns whether a visibility raycast of an entity is queued in RayVisibilityQueue.
+    bool RaycastPending(entity_id_t id) const { u32 slot = index_.Find(id); return slot != EntityIdIndex::cInvalidSlot && raycastPending_[slot] != 0; }
+    void SetRaycastPending(entity_id_t id, bool pending) { raycastPending_[Slot(id)] = pending ? 1 : 0; }
+
+    /// Returns the InterestManager tick of the last batched interest set update that included this user, or 0 if none.
+    u32 InterestTick() const { return interestTick_; }
+    /// Returns the user location the current interest set was computed for.
+    const float3 &InterestCenter() const { return interestCenter_; }
+    /// Starts a new interest set around @c center. All entities not marked with SetInRange() for @c tick are considered out of range.
+    void BeginInterestSet(u32 tick, const float3 &center) { interestTick_ = tick; interestCenter_ = center; }
+    /// Marks an entity to be within the filtering range of the user on the given tick.
+    void SetInRange(entity_id_t id, u32 tick) { inRangeTick_[Slot(id)] = tick; }
+    /// Returns whether the entity was marked to be within range in the current interest set.
+    bool InRange(entity_id_t id) const { u32 slot = index_.Find(id); return slot != EntityIdIndex::cInvalidSlot && interestTick_ != 0 && inRangeTick_[slot] == interestTick_; }
+
+    /// Forgets all data.
+    void Clear();
+
+    /// Returns heap memory used by the table in bytes.
+    size_t MemoryUsage() const;
+
+private:
+    /// Returns the slot of an entity, allocating it if necessary.
+    u32 Slot(entity_id_t id);
+
+    EntityIdIndex index_;
+    std::vector<u8> visibility_;
+    std::vector<float> relevance_;
+    std::vector<float> lastUpdated_;
+    std::vector<float> lastRaycasted_;
+    std::vector<u8> raycastPending_;
+    std::vector<u32> inRangeTick_;
+    u32 interestTick_;
+    float3 interestCenter_;
 };
 
 struct RigidBodyInterpolationState
@@ -274,23 +604,23 @@ public:
     virtual ~SceneSyncState();
 
     /// Dirty entities pending processing
-    std::list<EntitySyncState*> dirtyQueue; 
+    EntitySyncStateQueue dirtyQueue; 
 
     /// Entity sync states
-    std::map<entity_id_t, EntitySyncState> entities; 
+    EntitySyncStateMap entities; 
 
     /// Entity interpolations
     std::map<entity_id_t, RigidBodyInterpolationState> entityInterpolations;
 
-    /// Maps containing the relevance factors and visibility data
-    /// @remarks InterestManager functionality
-    std::map<entity_id_t, bool> visibleEntities;
-    std::map<entity_id_t, float> relevanceFactors;
+    /// Byte budget of the sync messages, used if SyncManager::IsBandwidthBudget().
+    SyncBudget budget;
+
+    /// Number of times the sync state has been processed. Used to age the send priority of the dirty entities.
+    u32 syncTick;
 
-    /// Couple of maps containing the timestamps of last updates and raycasts
+    /// Relevance factors, visibility data and the timestamps of last updates and raycasts
     /// @remarks InterestManager functionality
-    std::map<entity_id_t, float> lastUpdatedEntitys_;
-    std::map<entity_id_t, float> lastRaycastedEntitys_;
+    EntityInterestTable interest;
 
     /// @remarks InterestManager functionality
     Quat clientOrientation;
@@ -340,6 +670,9 @@ public slots:
 public:
     void SetParentScene(SceneWeakPtr scene);
     void Clear();
+
+    /// Returns the approximate heap memory used by the sync state in bytes.
+    size_t MemoryUsage() const;
     
     void RemoveFromQueue(entity_id_t id);
 
@@ -362,6 +695,9 @@ public:
     // Removes entity from pending lists.
     void RemovePendingEntity(entity_id_t id);
 
+    // Returns if something is connected to AboutToDirtyEntity, i.e. a script may reject or delay entities.
+    bool HasChangeRequestListeners() const;
+
 private:
     // Returns if entity with id should be added to the sync state.
     bool ShouldMarkAsDirty(entity_id_t id);
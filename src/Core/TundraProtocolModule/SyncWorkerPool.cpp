@@ -0,0 +1,105 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "SyncWorkerPool.h"
+
+#include <QThread>
+
+class SyncWorkerPool::WorkerThread : public QThread
+{
+public:
+    WorkerThread(SyncWorkerPool *pool, size_t workerIndex) : pool_(pool), workerIndex_(workerIndex) {}
+
+protected:
+    void run() { pool_->ThreadMain(workerIndex_); }
+
+private:
+    SyncWorkerPool *pool_;
+    size_t workerIndex_;
+};
+
+SyncWorkerPool::SyncWorkerPool(size_t numThreads) :
+    task_(0),
+    numJobs_(0),
+    nextJob_(0),
+    numBusy_(0),
+    batch_(0),
+    quit_(false)
+{
+    for(size_t i = 0; i < numThreads; ++i)
+    {
+        WorkerThread *thread = new WorkerThread(this, i + 1);
+        threads_.push_back(thread);
+        thread->start();
+    }
+}
+
+SyncWorkerPool::~SyncWorkerPool()
+{
+    {
+        QMutexLocker lock(&mutex_);
+        quit_ = true;
+        workAvailable_.wakeAll();
+    }
+    for(size_t i = 0; i < threads_.size(); ++i)
+    {
+        threads_[i]->wait();
+        delete threads_[i];
+    }
+}
+
+void SyncWorkerPool::Run(Task *task, size_t numJobs)
+{
+    if (!task || !numJobs)
+        return;
+
+    {
+        QMutexLocker lock(&mutex_);
+        task_ = task;
+        numJobs_ = numJobs;
+        nextJob_ = 0;
+        numBusy_ = threads_.size();
+        ++batch_;
+        workAvailable_.wakeAll();
+    }
+
+    Work(0);
+
+    QMutexLocker lock(&mutex_);
+    while(numBusy_ > 0)
+        workDone_.wait(&mutex_);
+    task_ = 0;
+}
+
+void SyncWorkerPool::ThreadMain(size_t workerIndex)
+{
+    unsigned lastBatch = 0;
+    for(;;)
+    {
+        {
+            QMutexLocker lock(&mutex_);
+            while(!quit_ && batch_ == lastBatch)
+                workAvailable_.wait(&mutex_);
+            if (quit_)
+                return;
+            lastBatch = batch_;
+        }
+
+        Work(workerIndex);
+
+        QMutexLocker lock(&mutex_);
+        if (--numBusy_ == 0)
+            workDone_.wakeAll();
+    }
+}
+
+void SyncWorkerPool::Work(size_t workerIndex)
+{
+    for(;;)
+    {
+        size_t jobIndex = (size_t)nextJob_.fetchAndAddOrdered(1);
+        if (jobIndex >= numJobs_)
+            break;
+        task_->Run(jobIndex, workerIndex);
+    }
+}
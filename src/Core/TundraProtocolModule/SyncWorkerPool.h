@@ -0,0 +1,67 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraProtocolModuleApi.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+#include <vector>
+
+/// Fixed-size thread pool which runs a batch of independent jobs and waits for all of them to finish.
+/** Used by SyncManager to process the sync states of the user connections in parallel. The calling thread
+    takes part in the work as worker 0, the pool's own threads are workers 1...NumWorkers()-1.
+    Jobs are handed out one at a time, so that expensive jobs (users with lots of dirty state) even out. */
+class TUNDRAPROTOCOL_MODULE_API SyncWorkerPool
+{
+public:
+    /// Work to be done for each job of a batch.
+    class Task
+    {
+    public:
+        virtual ~Task() {}
+        /// Runs one job. Called concurrently from several threads, each job index exactly once.
+        /** @param jobIndex Index of the job, [0, numJobs).
+            @param workerIndex Index of the worker running the job, [0, NumWorkers()). Can be used to pick per-thread scratch data. */
+        virtual void Run(size_t jobIndex, size_t workerIndex) = 0;
+    };
+
+    /// Starts the worker threads.
+    /** @param numThreads Number of threads to start in addition to the calling thread. */
+    explicit SyncWorkerPool(size_t numThreads);
+    /// Stops and joins the worker threads.
+    ~SyncWorkerPool();
+
+    /// Returns number of workers, including the calling thread.
+    size_t NumWorkers() const { return threads_.size() + 1; }
+
+    /// Runs @c task for job indices [0, numJobs) and returns when all of them have finished.
+    /** Must not be called recursively, or from several threads at once. */
+    void Run(Task *task, size_t numJobs);
+
+private:
+    class WorkerThread;
+    friend class WorkerThread;
+
+    /// Worker thread main loop.
+    void ThreadMain(size_t workerIndex);
+    /// Runs jobs of the current batch until none are left.
+    void Work(size_t workerIndex);
+
+    QMutex mutex_;
+    QWaitCondition workAvailable_;
+    QWaitCondition workDone_;
+    Task *task_;
+    size_t numJobs_;
+    QAtomicInt nextJob_;
+    size_t numBusy_; ///< Number of worker threads which have not yet finished the current batch.
+    unsigned batch_; ///< Incremented for each Run.
+    bool quit_;
+    std::vector<WorkerThread*> threads_;
+
+    // Noncopyable
+    SyncWorkerPool(const SyncWorkerPool &);
+    void operator =(const SyncWorkerPool &);
+};
@@ -18,6 +18,7 @@
 #include "ConfigAPI.h"
 #include "IComponentFactory.h"
 #include "Scene/Scene.h"
+#include "SceneBinaryLoader.h"
 #include "AssetAPI.h"
 #include "ConsoleAPI.h"
 #include "AssetAPI.h"
@@ -152,6 +153,15 @@ void TundraLogicModule::Initialize()
         "Usage: importMesh(filename, pos = 0 0 0, rot = 0 0 0, scale = 1 1 1, inspectForMaterialsAndSkeleton=true)",
         this, SLOT(ImportMesh(QString, const float3 &, const float3 &, const float3 &, bool)), SLOT(ImportMesh(QString)));
 
+    framework_->Console()->RegisterCommand("benchmarkSync",
+        "Measures server scene sync processing time against the number of users, with and without the \"encode once\" mode. "
+        "Usage: benchmarkSync(maxUsers=200,userStep=20)",
+        syncManager_.get(), SLOT(BenchmarkSync(int, int)), SLOT(BenchmarkSync()));
+    framework_->Console()->RegisterCommand("syncThreads",
+        "Sets the number of worker threads used to process the users' scene sync states on the server. 0 processes them on the main thread only, "
+        "a negative value uses one thread less than the number of CPU cores. Usage: syncThreads(numThreads)",
+        syncManager_.get(), SLOT(SetSyncThreads(int)));
+
     // Take a pointer to KristalliProtocolModule so that we don't have to take/check it every time
     kristalliModule_ = framework_->GetModule<KristalliProtocolModule>();
     if (!kristalliModule_)
@@ -367,6 +377,15 @@ bool TundraLogicModule::LoadScene(QString filename, bool clearScene, bool useEnt
     LogInfo("Loading startup scene from " + filename + " ...");
     kNet::PolledTimer timer;
     bool useBinary = filename.indexOf(".tbin", 0, Qt::CaseInsensitive) != -1;
+    if (useBinary && framework_->HasCommandLineParameter("--asyncSceneLoad"))
+    {
+        SceneBinaryLoader *loader = scene->LoadSceneBinaryAsync(filename, clearScene, useEntityIDsFromFile, AttributeChange::Default);
+        if (!loader)
+            return false;
+        connect(loader, SIGNAL(Finished(bool, const QList<Entity *> &)), SLOT(OnSceneLoadFinished(bool, const QList<Entity *> &)));
+        return true;
+    }
+
     QList<Entity *> entities;
     if (useBinary)
         entities = scene->LoadSceneBinary(filename, clearScene, useEntityIDsFromFile, AttributeChange::Default);
@@ -376,6 +395,15 @@ bool TundraLogicModule::LoadScene(QString filename, bool clearScene, bool useEnt
     return entities.size() > 0;
 }
 
+void TundraLogicModule::OnSceneLoadFinished(bool success, const QList<Entity *> &entities)
+{
+    SceneBinaryLoader *loader = dynamic_cast<SceneBinaryLoader *>(sender());
+    if (success)
+        LogInfo(QString("Loading of startup scene %1 finished. %2 entities created.").arg(loader ? loader->Filename() : QString()).arg(entities.size()));
+    else
+        LogError(QString("Loading of startup scene %1 failed. %2 entities created.").arg(loader ? loader->Filename() : QString()).arg(entities.size()));
+}
+
 bool TundraLogicModule::ImportScene(QString filename, bool clearScene, bool replace)
 {
     Scene *scene = GetFramework()->Scene()->MainCameraScene();
@@ -6,6 +6,7 @@
 #include "TundraProtocolModuleApi.h"
 #include "TundraProtocolModuleFwd.h"
 #include "AssetFwd.h"
+#include "SceneFwd.h"
 #include "Math/float3.h"
 
 #include <kNetFwd.h>
@@ -56,7 +57,9 @@ public slots:
         @param useEntityIDsFromFile If true, the created entities will use the Entity IDs from the original file.
             If the scene contains any previous entities with conflicting IDs, those are removed. If false, the entity
             IDs from the files are ignored, and new IDs are generated for the created entities.
-        @return Was the operation successful.*/
+        @return Was the operation successful.
+        @note With the --asyncSceneLoad command line parameter, binary scenes are loaded over several frames and
+            true is returned when the loading has started. */
     bool LoadScene(QString filename, bool clearScene = true, bool useEntityIDsFromFile = true);
 
     /// Imports a dotscene.
@@ -81,6 +84,8 @@ private slots:
     void ReadStartupParameters();
     void StartupSceneTransfedSucceeded(AssetPtr asset);
     void StartupSceneTransferFailed(IAssetTransfer *transfer, QString reason);
+    /// Logs the result of a scene loaded with --asyncSceneLoad.
+    void OnSceneLoadFinished(bool success, const QList<Entity *> &entities);
 
 private:
     /// Handles a Kristalli protocol message
@@ -32,6 +32,12 @@ const unsigned long cEntityActionMessage = 120;
 const unsigned long cAssetDiscoveryMessage = 121;
 const unsigned long cAssetDeletedMessage = 122;
 
+// Scene snapshot for joining clients
+const unsigned long cSceneSnapshotMessage = 123; // Server->client only
+
+// Several messages coalesced to one WebSocket frame, see WebSocket::UserConnection::Queue
+const unsigned long cMessageBundle = 124; // WebSocket server->client only
+
 
 
 // In case of network message structs are regenerated and descriptions get deleted., saving their descriptions here.
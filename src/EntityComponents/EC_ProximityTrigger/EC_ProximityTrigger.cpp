@@ -5,98 +5,55 @@
     @brief  Reports distance, each frame, of other entities that also have this same component. */
 
 #include "EC_ProximityTrigger.h"
+#include "ProximityTriggerWorld.h"
 
-#include "Framework.h"
 #include "Scene/Scene.h"
 #include "Entity.h"
 
-#include "EC_Placeable.h"
-#include "LoggingFunctions.h"
-#include "FrameAPI.h"
-
 EC_ProximityTrigger::EC_ProximityTrigger(Scene *scene) :
     IComponent(scene),
     INIT_ATTRIBUTE_VALUE(active, "Is active", true),
     INIT_ATTRIBUTE_VALUE(thresholdDistance, "Threshold distance", 0.0f),
     INIT_ATTRIBUTE_VALUE(interval, "Trigger signal interval", 0.0f)
 {
-    SetUpdateMode();
+    connect(this, SIGNAL(ParentEntitySet()), SLOT(OnParentEntitySet()));
+    connect(this, SIGNAL(ParentEntityDetached()), SLOT(OnParentEntityDetached()));
 }
 
 EC_ProximityTrigger::~EC_ProximityTrigger()
 {
+    OnParentEntityDetached();
 }
 
-void EC_ProximityTrigger::AttributesChanged()
-{
-    if (interval.ValueChanged())
-        SetUpdateMode();
-}
-
-void EC_ProximityTrigger::Update(float /*timeStep*/)
+void EC_ProximityTrigger::OnParentEntitySet()
 {
-    if (!active.Get())
-        return;
-    float threshold = thresholdDistance.Get();
-    
-    Entity* entity = ParentEntity();
-    if (!entity)
-        return;
-    Scene* scene = entity->ParentScene();
+    Scene* scene = ParentScene();
     if (!scene)
         return;
-    EC_Placeable* placeable = entity->Component<EC_Placeable>().get();
-    if (!placeable)
-        return;
-
-    float3 pos = placeable->WorldPosition();
-
-    EntityList otherTriggers = scene->EntitiesWithComponent<EC_ProximityTrigger>();
-    for(EntityList::iterator i = otherTriggers.begin(); i != otherTriggers.end(); ++i)
-    {
-        Entity* otherEntity = (*i).get();
-        if (otherEntity != entity)
-        {
-            EC_Placeable* otherPlaceable = otherEntity->Component<EC_Placeable>().get();
-            if (!otherPlaceable)
-                continue;
+    OnParentEntityDetached();
+    world_ = ProximityTriggerWorld::ForScene(scene);
+    world_->AddTrigger(this);
+}
 
-            float3 offset = pos - otherPlaceable->WorldPosition();
-            float distance = offset.Length();
-            if (threshold <= 0.0f || distance <= threshold)
-            {
-                emit Triggered(otherEntity, distance);
-                emit triggered(otherEntity, distance);
-            }
-        }
-    }
+void EC_ProximityTrigger::OnParentEntityDetached()
+{
+    if (world_)
+        world_->RemoveTrigger(this);
+    world_.reset();
 }
 
-void EC_ProximityTrigger::SetUpdateMode()
+void EC_ProximityTrigger::EmitTriggered(Entity* otherEntity, float distance)
 {
-    FrameAPI* frame = framework->Frame();
-    
-    float intervalSec = interval.Get();
-    if (intervalSec <= 0.0f)
-    {
-        // Update every frame
-        connect(frame, SIGNAL(Updated(float)), this, SLOT(Update(float)), Qt::UniqueConnection);
-    }
-    else
-    {
-        // Update periodically
-        disconnect(frame, SIGNAL(Updated(float)), this, SLOT(Update(float)));
-        frame->DelayedExecute(intervalSec, this, SLOT(PeriodicUpdate()));
-    }
+    emit Triggered(otherEntity, distance);
+    emit triggered(otherEntity, distance);
 }
 
-void EC_ProximityTrigger::PeriodicUpdate()
+void EC_ProximityTrigger::EmitEntered(Entity* otherEntity)
 {
-    // Set up the next periodic update
-    float intervalSec = interval.Get();
-    if (intervalSec > 0.0f)
-        framework->Frame()->DelayedExecute(intervalSec, this, SLOT(PeriodicUpdate()));
-    
-    Update(intervalSec);
+    emit Entered(otherEntity);
 }
 
+void EC_ProximityTrigger::EmitLeft(Entity* otherEntity)
+{
+    emit Left(otherEntity);
+}
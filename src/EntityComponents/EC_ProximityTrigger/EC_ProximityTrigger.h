@@ -8,6 +8,8 @@
 
 #include "IComponent.h"
 
+class ProximityTriggerWorld;
+
 /// Reports distance, each frame, of other entities that also have this same component.
 /** <table class="header">
     <tr>
@@ -15,6 +17,8 @@
     <h2>ProximityTrigger</h2>
     Reports distance, each frame, of other entities that also have this same component.
     The entities also need to have EC_Placeable component so that distance can be calculated.
+    Additionally reports when other entities enter or leave the threshold distance.
+    All the triggers of a scene are checked together in one batched pass per frame, using a spatial hash grid.
 
     <b>Attributes</b>:
     <ul>
@@ -26,6 +30,13 @@
     <div> @copydoc interval </div>
     </ul>
 
+    <b>Emits the following signals:</b>
+    <ul>
+    <li>"Triggered": @copydoc Triggered
+    <li>"Entered": @copydoc Entered
+    <li>"Left": @copydoc Left
+    </ul>
+
     <b>Exposes the following scriptable functions:</b>
     <ul>
     <li>None.
@@ -75,20 +86,30 @@ signals:
     /** When active flag is on, is sent each frame for every other entity that also has an EC_ProximityTrigger and is close enough. */
     void Triggered(Entity* otherEntity, float distance);
 
+    /// Sent when another entity with an EC_ProximityTrigger comes within the threshold distance, before Triggered.
+    void Entered(Entity* otherEntity);
+
+    /// Sent when another entity with an EC_ProximityTrigger is no longer within the threshold distance, or this trigger is deactivated.
+    /** Not sent for entities that have been removed from the scene. */
+    void Left(Entity* otherEntity);
+
     // DEPRECATED
     void triggered(Entity* otherEntity, float distance); /**< @deprecated Use Triggered instead. @todo Remove. */
 
 private:
-    /// Attribute has been updated
-    void AttributesChanged();
-    
-private slots:
-    /// Check for other triggers and emit signals
-    void Update(float timeStep);
+    friend class ProximityTriggerWorld;
+
+    /// Emitters used by ProximityTriggerWorld.
+    void EmitTriggered(Entity* otherEntity, float distance);
+    void EmitEntered(Entity* otherEntity);
+    void EmitLeft(Entity* otherEntity);
 
-    /// Periodic update. Set up the next periodic update, then check triggers
-    void PeriodicUpdate();
+    shared_ptr<ProximityTriggerWorld> world_; ///< World of the scene, while the trigger has a parent entity.
+
+private slots:
+    /// Registers to the proximity trigger world of the scene.
+    void OnParentEntitySet();
 
-    /// Change update mode (periodic, or every frame)
-    void SetUpdateMode();
+    /// Unregisters from the proximity trigger world.
+    void OnParentEntityDetached();
 };
@@ -0,0 +1,342 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   ProximityTriggerWorld.cpp
+    @brief  Shared per-scene proximity checking of EC_ProximityTrigger components. */
+
+#include "ProximityTriggerWorld.h"
+#include "EC_ProximityTrigger.h"
+
+#include "Framework.h"
+#include "FrameAPI.h"
+#include "Scene/Scene.h"
+#include "Entity.h"
+#include "EC_Placeable.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /// Cell size used when no trigger has a threshold distance.
+    const float cDefaultCellSize = 10.f;
+}
+
+ProximityTriggerWorld::ProximityTriggerWorld(Scene *scene) :
+    scene_(scene->shared_from_this()),
+    grid_(cDefaultCellSize)
+{
+    connect(scene->GetFramework()->Frame(), SIGNAL(Updated(float)), SLOT(Update(float)));
+    connect(scene, SIGNAL(AttributeChanged(IComponent*, IAttribute*, AttributeChange::Type)),
+        SLOT(OnAttributeChanged(IComponent*, IAttribute*, AttributeChange::Type)));
+    connect(scene, SIGNAL(ComponentAdded(Entity*, IComponent*, AttributeChange::Type)),
+        SLOT(OnComponentAddedOrRemoved(Entity*, IComponent*, AttributeChange::Type)));
+    connect(scene, SIGNAL(ComponentRemoved(Entity*, IComponent*, AttributeChange::Type)),
+        SLOT(OnComponentAddedOrRemoved(Entity*, IComponent*, AttributeChange::Type)));
+}
+
+ProximityTriggerWorld::~ProximityTriggerWorld()
+{
+    ScenePtr scene = scene_.lock();
+    if (scene && scene->property(PropertyName()).value<QObject*>() == this)
+        scene->setProperty(PropertyName(), QVariant());
+}
+
+shared_ptr<ProximityTriggerWorld> ProximityTriggerWorld::ForScene(Scene *scene)
+{
+    shared_ptr<ProximityTriggerWorld> world = scene->Subsystem<ProximityTriggerWorld>();
+    if (!world)
+    {
+        world = MAKE_SHARED(ProximityTriggerWorld, scene);
+        scene->setProperty(PropertyName(), QVariant::fromValue<QObject*>(world.get()));
+    }
+    return world;
+}
+
+void ProximityTriggerWorld::AddTrigger(EC_ProximityTrigger *trigger)
+{
+    Entity *entity = trigger->ParentEntity();
+    if (!entity || triggers_.find(trigger) != triggers_.end())
+        return;
+
+    Trigger &t = triggers_[trigger];
+    t.entity = entity;
+    t.hasPos = false;
+    t.parented = false;
+    t.dirty = true;
+    t.cell = 0;
+    t.timeSinceCheck = 0.f;
+    entityTriggers_[entity].push_back(trigger);
+}
+
+void ProximityTriggerWorld::RemoveTrigger(EC_ProximityTrigger *trigger)
+{
+    TriggerMap::iterator iter = triggers_.find(trigger);
+    if (iter == triggers_.end())
+        return;
+
+    if (iter->second.hasPos)
+        RemoveFromCell(trigger, iter->second);
+
+    unordered_map<Entity*, std::vector<EC_ProximityTrigger*> >::iterator e = entityTriggers_.find(iter->second.entity);
+    if (e != entityTriggers_.end())
+    {
+        e->second.erase(std::remove(e->second.begin(), e->second.end(), trigger), e->second.end());
+        if (e->second.empty())
+            entityTriggers_.erase(e);
+    }
+    triggers_.erase(iter);
+}
+
+void ProximityTriggerWorld::OnAttributeChanged(IComponent *comp, IAttribute * /*attribute*/, AttributeChange::Type /*change*/)
+{
+    if (comp->TypeId() == EC_Placeable::TypeIdStatic())
+        SetDirty(comp->ParentEntity());
+}
+
+void ProximityTriggerWorld::OnComponentAddedOrRemoved(Entity *entity, IComponent *comp, AttributeChange::Type /*change*/)
+{
+    if (comp->TypeId() == EC_Placeable::TypeIdStatic())
+        SetDirty(entity);
+}
+
+void ProximityTriggerWorld::SetDirty(Entity *entity)
+{
+    unordered_map<Entity*, std::vector<EC_ProximityTrigger*> >::iterator e = entityTriggers_.find(entity);
+    if (e == entityTriggers_.end())
+        return;
+    for(size_t i = 0; i < e->second.size(); ++i)
+        triggers_[e->second[i]].dirty = true;
+}
+
+void ProximityTriggerWorld::UpdatePositions()
+{
+    // Size the cells by the largest threshold, so that a query touches only a few cells.
+    float maxThreshold = 0.f;
+    for(TriggerMap::const_iterator i = triggers_.begin(); i != triggers_.end(); ++i)
+        maxThreshold = std::max(maxThreshold, i->first->thresholdDistance.Get());
+    float cellSize = maxThreshold > 0.f ? maxThreshold : cDefaultCellSize;
+    if (cellSize > 2.f * grid_.CellSize() || cellSize < 0.5f * grid_.CellSize())
+        SetCellSize(cellSize);
+
+    for(TriggerMap::iterator i = triggers_.begin(); i != triggers_.end(); ++i)
+    {
+        Trigger &t = i->second;
+        if (!t.dirty && !t.parented)
+            continue;
+        t.dirty = false;
+
+        EC_Placeable *placeable = t.entity->Component<EC_Placeable>().get();
+        float3 pos = placeable ? placeable->WorldPosition() : float3::zero;
+        bool hasPos = placeable && pos.IsFinite();
+        t.parented = placeable && !placeable->parentRef.Get().IsEmpty();
+
+        if (t.hasPos)
+        {
+            u64 cell = grid_.CellKey(pos);
+            if (!hasPos || cell != t.cell)
+                RemoveFromCell(i->first, t);
+            else
+            {
+                t.pos = pos;
+                continue;
+            }
+        }
+        t.pos = pos;
+        t.hasPos = hasPos;
+        if (hasPos)
+            InsertToCell(i->first, t);
+    }
+}
+
+void ProximityTriggerWorld::Update(float frameTime)
+{
+    PROFILE(ProximityTriggerWorld_Update);
+
+    if (triggers_.empty() || !scene_.lock())
+        return;
+
+    UpdatePositions();
+
+    events_.clear();
+    for(TriggerMap::iterator i = triggers_.begin(); i != triggers_.end(); ++i)
+    {
+        EC_ProximityTrigger *trigger = i->first;
+        Trigger &t = i->second;
+
+        if (!trigger->active.Get())
+        {
+            LeaveAll(trigger, t);
+            continue;
+        }
+
+        // Triggers with an interval are checked periodically, the others every frame.
+        t.timeSinceCheck += frameTime;
+        float interval = trigger->interval.Get();
+        if (interval > 0.f && t.timeSinceCheck < interval)
+            continue;
+        t.timeSinceCheck = 0.f;
+
+        if (!t.hasPos)
+        {
+            LeaveAll(trigger, t);
+            continue;
+        }
+
+        float threshold = trigger->thresholdDistance.Get();
+        neighbors_.clear();
+        FindNeighbors(trigger, t, threshold > 0.f ? threshold : -1.f, neighbors_);
+        std::sort(neighbors_.begin(), neighbors_.end());
+
+        // Both lists are sorted by entity id, so they can be compared in one sweep.
+        Event e;
+        e.trigger = trigger;
+        size_t oldIndex = 0;
+        for(size_t j = 0; j < neighbors_.size(); ++j)
+        {
+            const Neighbor &n = neighbors_[j];
+            if (j > 0 && neighbors_[j - 1].id == n.id)
+                continue; // Several triggers in the same entity.
+            while(oldIndex < t.inside.size() && t.inside[oldIndex] < n.id)
+            {
+                e.type = Left;
+                e.other = t.inside[oldIndex++];
+                e.distance = 0.f;
+                events_.push_back(e);
+            }
+            if (oldIndex < t.inside.size() && t.inside[oldIndex] == n.id)
+                ++oldIndex;
+            else
+            {
+                e.type = Entered;
+                e.other = n.id;
+                e.distance = n.distance;
+                events_.push_back(e);
+            }
+            e.type = Inside;
+            e.other = n.id;
+            e.distance = n.distance;
+            events_.push_back(e);
+        }
+        while(oldIndex < t.inside.size())
+        {
+            e.type = Left;
+            e.other = t.inside[oldIndex++];
+            e.distance = 0.f;
+            events_.push_back(e);
+        }
+
+        t.inside.clear();
+        for(size_t j = 0; j < neighbors_.size(); ++j)
+            if (t.inside.empty() || t.inside.back() != neighbors_[j].id)
+                t.inside.push_back(neighbors_[j].id);
+    }
+
+    // Emit the signals only now, as the handlers may modify the scene and the triggers.
+    // The events refer to the entities by id so that removed entities are skipped.
+    // Keep the world alive until the end, even if the handlers remove all the triggers.
+    shared_ptr<ProximityTriggerWorld> keepAlive = shared_from_this();
+    for(size_t i = 0; i < events_.size(); ++i)
+    {
+        ScenePtr scene = scene_.lock();
+        if (!scene)
+            break;
+        EC_ProximityTrigger *trigger = events_[i].trigger;
+        if (!trigger)
+            continue;
+        EntityPtr other = scene->EntityById(events_[i].other);
+        if (!other)
+            continue;
+        switch(events_[i].type)
+        {
+        case Left:
+            trigger->EmitLeft(other.get());
+            break;
+        case Entered:
+            trigger->EmitEntered(other.get());
+            break;
+        case Inside:
+            trigger->EmitTriggered(other.get(), events_[i].distance);
+            break;
+        }
+    }
+    events_.clear();
+}
+
+void ProximityTriggerWorld::FindNeighbors(EC_ProximityTrigger *trigger, const Trigger &t, float threshold, std::vector<Neighbor> &result) const
+{
+    if (threshold < 0.f)
+    {
+        for(TriggerMap::const_iterator i = triggers_.begin(); i != triggers_.end(); ++i)
+            if (i->first != trigger && i->second.hasPos)
+                TestNeighbor(t, i->first, -1.f, result);
+        return;
+    }
+
+    const float thresholdSq = threshold * threshold;
+    std::vector<const Cell*> cells;
+    grid_.CellsNear(t.pos, threshold, cells);
+    for(size_t i = 0; i < cells.size(); ++i)
+        for(Cell::const_iterator j = cells[i]->begin(); j != cells[i]->end(); ++j)
+            if (*j != trigger)
+                TestNeighbor(t, *j, thresholdSq, result);
+}
+
+void ProximityTriggerWorld::TestNeighbor(const Trigger &t, EC_ProximityTrigger *other, float thresholdSq, std::vector<Neighbor> &result) const
+{
+    const Trigger &o = triggers_.find(other)->second;
+    if (o.entity == t.entity)
+        return;
+    float distanceSq = t.pos.DistanceSq(o.pos);
+    if (thresholdSq >= 0.f && distanceSq > thresholdSq)
+        return;
+    Neighbor n;
+    n.id = o.entity->Id();
+    n.distance = sqrt(distanceSq);
+    result.push_back(n);
+}
+
+void ProximityTriggerWorld::LeaveAll(EC_ProximityTrigger *trigger, Trigger &t)
+{
+    Event e;
+    e.trigger = trigger;
+    e.type = Left;
+    e.distance = 0.f;
+    for(size_t i = 0; i < t.inside.size(); ++i)
+    {
+        e.other = t.inside[i];
+        events_.push_back(e);
+    }
+    t.inside.clear();
+}
+
+void ProximityTriggerWorld::InsertToCell(EC_ProximityTrigger *trigger, Trigger &t)
+{
+    t.cell = grid_.CellKey(t.pos);
+    grid_.Cells()[t.cell].push_back(trigger);
+}
+
+void ProximityTriggerWorld::RemoveFromCell(EC_ProximityTrigger *trigger, const Trigger &t)
+{
+    unordered_map<u64, Cell>::iterator i = grid_.Cells().find(t.cell);
+    if (i == grid_.Cells().end())
+        return;
+    Cell &cell = i->second;
+    Cell::iterator j = std::find(cell.begin(), cell.end(), trigger);
+    if (j != cell.end())
+    {
+        *j = cell.back();
+        cell.pop_back();
+    }
+    if (cell.empty())
+        grid_.Cells().erase(i);
+}
+
+void ProximityTriggerWorld::SetCellSize(float cellSize)
+{
+    grid_.SetCellSize(cellSize);
+    for(TriggerMap::iterator i = triggers_.begin(); i != triggers_.end(); ++i)
+        if (i->second.hasPos)
+            InsertToCell(i->first, i->second);
+}
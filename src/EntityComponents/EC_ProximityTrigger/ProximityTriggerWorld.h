@@ -0,0 +1,124 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   ProximityTriggerWorld.h
+    @brief  Shared per-scene proximity checking of EC_ProximityTrigger components. */
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "SceneFwd.h"
+#include "AttributeChangeType.h"
+#include "SpatialHashGrid.h"
+#include "Math/float3.h"
+
+#include <QObject>
+#include <QPointer>
+
+#include <vector>
+
+class EC_ProximityTrigger;
+class IAttribute;
+
+/// Shared per-scene proximity checking of EC_ProximityTrigger components.
+/** All the triggers of a scene are kept in a uniform hash grid, and checked in one batched pass per frame.
+    A trigger's position is re-read only when the transform of its placeable changes, or every pass if the placeable
+    is parented, as the parent may move. The signals are emitted after all the due triggers have been checked, so
+    that signal handlers can freely modify the scene.
+    The world is created on demand by the first trigger in a scene, and is destroyed with the last one. */
+class ProximityTriggerWorld : public QObject, public enable_shared_from_this<ProximityTriggerWorld>
+{
+    Q_OBJECT
+
+public:
+    explicit ProximityTriggerWorld(Scene *scene);
+    ~ProximityTriggerWorld();
+
+    /// Name of the scene property which stores the world.
+    static const char* PropertyName() { return "proximityTriggers"; }
+
+    /// Returns the world of a scene, and creates it if it does not exist.
+    static shared_ptr<ProximityTriggerWorld> ForScene(Scene *scene);
+
+    /// Adds a trigger whose parent entity has been set.
+    void AddTrigger(EC_ProximityTrigger *trigger);
+    /// Removes a trigger. Does nothing if the trigger is not in the world.
+    void RemoveTrigger(EC_ProximityTrigger *trigger);
+
+    /// Returns number of triggers.
+    size_t NumTriggers() const { return triggers_.size(); }
+
+private slots:
+    /// Checks the due triggers and emits their signals.
+    void Update(float frameTime);
+
+    void OnAttributeChanged(IComponent *comp, IAttribute *attribute, AttributeChange::Type change);
+    void OnComponentAddedOrRemoved(Entity *entity, IComponent *comp, AttributeChange::Type change);
+
+private:
+    struct Trigger
+    {
+        Entity *entity;
+        float3 pos;
+        bool hasPos; ///< False if the entity has no placeable.
+        bool parented; ///< Placeable is parented, so the position is re-read every pass.
+        bool dirty; ///< Position needs to be re-read.
+        u64 cell; ///< Grid cell, valid if hasPos.
+        float timeSinceCheck;
+        std::vector<entity_id_t> inside; ///< Sorted ids of the entities that were inside the threshold in the last check.
+    };
+
+    typedef std::vector<EC_ProximityTrigger*> Cell;
+    typedef unordered_map<EC_ProximityTrigger*, Trigger> TriggerMap;
+
+    enum EventType
+    {
+        Left,
+        Entered,
+        Inside
+    };
+
+    /// A signal to emit after the batched pass.
+    struct Event
+    {
+        QPointer<EC_ProximityTrigger> trigger;
+        EventType type;
+        entity_id_t other;
+        float distance;
+    };
+
+    /// A trigger that is within the threshold of the trigger being checked.
+    struct Neighbor
+    {
+        entity_id_t id;
+        float distance;
+        bool operator <(const Neighbor &rhs) const { return id < rhs.id; }
+    };
+
+    /// Re-reads the positions of the dirty and parented triggers, and moves them in the grid.
+    void UpdatePositions();
+    /// Marks the triggers of an entity dirty.
+    void SetDirty(Entity *entity);
+
+    /// Finds the neighbors of a trigger, sorted by entity id. Negative @c threshold finds all triggers.
+    void FindNeighbors(EC_ProximityTrigger *trigger, const Trigger &t, float threshold, std::vector<Neighbor> &result) const;
+    /// Appends a neighbor to @c result if @c other is another entity within the threshold.
+    void TestNeighbor(const Trigger &t, EC_ProximityTrigger *other, float thresholdSq, std::vector<Neighbor> &result) const;
+
+    /// Queues the Left events for all the entities inside a trigger.
+    void LeaveAll(EC_ProximityTrigger *trigger, Trigger &t);
+
+    /// Adds a trigger to the grid cell of its position.
+    void InsertToCell(EC_ProximityTrigger *trigger, Trigger &t);
+    /// Removes a trigger from its grid cell.
+    void RemoveFromCell(EC_ProximityTrigger *trigger, const Trigger &t);
+    /// Sets the cell size and re-inserts all triggers.
+    void SetCellSize(float cellSize);
+
+    SceneWeakPtr scene_;
+    TriggerMap triggers_;
+    unordered_map<Entity*, std::vector<EC_ProximityTrigger*> > entityTriggers_; ///< Triggers of each entity.
+    SpatialHashGrid<Cell> grid_;
+    std::vector<Event> events_;
+    std::vector<Neighbor> neighbors_;
+};